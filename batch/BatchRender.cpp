@@ -0,0 +1,340 @@
+// Headless batch renderer: renders every frame of a keyframed camera path with the CPU renderer
+// Frames that already exist are skipped, so an interrupted batch picks up where it stopped
+// With --listen the frames are rendered by worker processes instead, started with --worker here or on other hosts
+#include "raylib.h"
+#include "CameraPath.h"
+#include "CpuRenderer.h"
+#include "CustomCamera.h"
+#include "DistributedRender.h"
+#include "JsonLoader.h"
+#include "Process.h"
+#include "SceneCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Tiles every render thread should get in a frame, so stealing can even out slow tiles
+// Frames with fewer are rendered several at a time, each on a share of the threads
+#define BATCH_TILES_PER_THREAD 8
+
+struct BatchOptions {
+    std::string worldPath = "world";
+    const char* cameraPath = nullptr;
+    std::string output = "frames/frame_%05d.png"; // printf pattern of the frame number, the extension picks the format
+    int width = 1920;
+    int height = 1080;
+    RenderSettings settings;
+    int threads = 0; // Every hardware thread when 0
+    int framesInFlight = 0; // Picked from the tiles per frame when 0
+    int firstFrame = -1; // First and last keyframe when -1
+    int lastFrame = -1;
+    bool denoise = false;
+    bool floatOutput = false; // Also write the linear radiance as a PFM next to every image
+    bool verbose = false;
+    int listenPort = 0; // Coordinate workers on this port instead of rendering when not 0
+    int localWorkers = 0; // Workers the coordinator starts on this host, each on a share of the threads
+    int jobSamples = 0; // Samples of one worker job, picked from the samples per pixel when 0
+    const char* workerAddress = nullptr; // host:port of the coordinator to render jobs for
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string frameFileName(const std::string& pattern, int frame) {
+    char name[4096];
+    snprintf(name, sizeof(name), pattern.c_str(), frame);
+    return name;
+}
+
+static std::string floatFileName(const std::string& fileName) {
+    return std::filesystem::path(fileName).replace_extension(".pfm").string();
+}
+
+// Written next to the final name, with the same extension so ExportImage picks the same format
+static std::string temporaryFileName(const std::string& fileName) {
+    std::filesystem::path path(fileName);
+    std::string extension = path.extension().string();
+    return path.replace_extension(".tmp" + extension).string();
+}
+
+// Files are written under a temporary name and renamed, so a frame that exists was written completely
+static bool frameExists(const BatchOptions& options, const std::string& fileName) {
+    return FileExists(fileName.c_str()) && (!options.floatOutput || FileExists(floatFileName(fileName).c_str()));
+}
+
+static bool replaceFile(const std::string& from, const std::string& to) {
+    std::error_code error;
+    std::filesystem::rename(from, to, error);
+    return !error;
+}
+
+// View and settings of one frame of the camera path
+static DistributedFrame cameraPathFrame(const BatchOptions& options, const std::vector<CameraKeyframe>& keyframes, int frame) {
+    CameraKeyframe keyframe = sampleCameraPath(keyframes, frame);
+    CustomCamera camera(options.width, options.height, keyframe.fovy);
+    camera.camera.position = keyframe.position;
+    camera.camera.target = keyframe.target;
+    camera.update(options.width, options.height);
+
+    DistributedFrame result;
+    result.frame = frame;
+    result.view = camera.getView();
+    result.settings = options.settings;
+    result.settings.defocusAngle = keyframe.defocusAngle;
+    return result;
+}
+
+// Denoise a rendered frame if asked to and write its files, false when they could not be written
+// denoiser may be null when options.denoise is off
+static bool writeFrame(CpuRenderer* denoiser, const BatchOptions& options, const DistributedFrame& frame, std::vector<Vector3>& radiance, const std::string& fileName) {
+    if (options.denoise) {
+        DenoiseFeatures features;
+        denoiser->renderFeatures(frame.view, options.width, options.height, features);
+        std::vector<Vector3> denoised;
+        denoiser->denoise(radiance, features, options.width, options.height, denoised);
+        radiance.swap(denoised);
+    }
+
+    // The PFM goes first, the image is what marks the frame as done
+    if (options.floatOutput) {
+        std::string floatName = floatFileName(fileName);
+        std::string temporaryName = temporaryFileName(floatName);
+        if (!exportRadiancePfm(radiance, options.width, options.height, temporaryName.c_str()) || !replaceFile(temporaryName, floatName)) return false;
+    }
+    Image image = radianceToImage(radiance, options.width, options.height, frame.settings.gamma);
+    std::string temporaryName = temporaryFileName(fileName);
+    bool written = ExportImage(image, temporaryName.c_str());
+    UnloadImage(image);
+    return written && replaceFile(temporaryName, fileName);
+}
+
+// Render one frame and write its files, false when they could not be written
+static bool renderFrame(CpuRenderer& renderer, const BatchOptions& options, const std::vector<CameraKeyframe>& keyframes, int frame, const std::string& fileName) {
+    DistributedFrame pathFrame = cameraPathFrame(options, keyframes, frame);
+    std::vector<Vector3> radiance;
+    renderer.render(pathFrame.view, pathFrame.settings, options.width, options.height, radiance);
+    return writeFrame(&renderer, options, pathFrame, radiance, fileName);
+}
+
+static void printUsage() {
+    fprintf(stderr,
+        "Usage: batch --camera-path FILE [options]\n"
+        "       batch --worker HOST:PORT [--world DIR] [--threads N] [--verbose]\n"
+        "  --camera-path FILE   JSON array of keyframes: frame, position, target, fovy, defocusAngle\n"
+        "  --world DIR          World folder, world by default\n"
+        "  --output PATTERN     Frame file names, printf pattern of the frame number, frames/frame_%%05d.png by default\n"
+        "  --size WxH           Image size, 1920x1080 by default\n"
+        "  --spp N              Samples per pixel\n"
+        "  --bounces N          Bounces before Russian roulette\n"
+        "  --threads N          CPU render threads, every hardware thread by default\n"
+        "  --frames-in-flight N Frames rendered at the same time, picked from the tiles per frame by default\n"
+        "  --first N            First frame, the first keyframe by default\n"
+        "  --last N             Last frame, the last keyframe by default\n"
+        "  --denoise            Run the CPU denoiser on every frame\n"
+        "  --float              Also write the linear radiance of every frame as a PFM\n"
+        "  --verbose            Keep raylib's info log\n"
+        "  --listen PORT        Hand the frames to workers connecting on PORT instead of rendering them here\n"
+        "  --local-workers N    Start N workers on this host when listening, the threads are split between them\n"
+        "  --job-samples N      Samples of one worker job, a power of two, an eighth of the samples per pixel by default\n"
+        "  --worker HOST:PORT   Render jobs for the coordinator at HOST:PORT until it is done, needs the same world\n");
+}
+
+static bool parseOptions(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--camera-path") == 0 && hasValue) options.cameraPath = argv[++i];
+        else if (strcmp(arg, "--world") == 0 && hasValue) options.worldPath = argv[++i];
+        else if (strcmp(arg, "--output") == 0 && hasValue) options.output = argv[++i];
+        else if (strcmp(arg, "--size") == 0 && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0) return false;
+        }
+        else if (strcmp(arg, "--spp") == 0 && hasValue) options.settings.samples = atoi(argv[++i]);
+        else if (strcmp(arg, "--bounces") == 0 && hasValue) options.settings.maxBounces = atoi(argv[++i]);
+        else if (strcmp(arg, "--threads") == 0 && hasValue) options.threads = atoi(argv[++i]);
+        else if (strcmp(arg, "--frames-in-flight") == 0 && hasValue) options.framesInFlight = atoi(argv[++i]);
+        else if (strcmp(arg, "--first") == 0 && hasValue) options.firstFrame = atoi(argv[++i]);
+        else if (strcmp(arg, "--last") == 0 && hasValue) options.lastFrame = atoi(argv[++i]);
+        else if (strcmp(arg, "--denoise") == 0) options.denoise = true;
+        else if (strcmp(arg, "--float") == 0) options.floatOutput = true;
+        else if (strcmp(arg, "--verbose") == 0) options.verbose = true;
+        else if (strcmp(arg, "--listen") == 0 && hasValue) options.listenPort = atoi(argv[++i]);
+        else if (strcmp(arg, "--local-workers") == 0 && hasValue) options.localWorkers = atoi(argv[++i]);
+        else if (strcmp(arg, "--job-samples") == 0 && hasValue) options.jobSamples = atoi(argv[++i]);
+        else if (strcmp(arg, "--worker") == 0 && hasValue) options.workerAddress = argv[++i];
+        else return false;
+    }
+    // Workers get the camera and the samples of every job from the coordinator
+    if (options.workerAddress) return true;
+    return options.cameraPath != nullptr && options.settings.samples > 0 && options.listenPort >= 0 && options.listenPort < 65536;
+}
+
+static bool loadWorld(const BatchOptions& options, Scene& scene) {
+    if (!loadScene(options.worldPath, scene)) {
+        fprintf(stderr, "Could not load the world in %s\n", options.worldPath.c_str());
+        return false;
+    }
+    loadSceneTextures(scene);
+    return true;
+}
+
+// Render jobs for a coordinator until it has every frame
+static int runWorker(const BatchOptions& options) {
+    std::string host;
+    int port = 0;
+    if (!parseAddress(options.workerAddress, host, port)) {
+        fprintf(stderr, "Expected HOST:PORT, got %s\n", options.workerAddress);
+        return 1;
+    }
+    Scene scene;
+    if (!loadWorld(options, scene)) return 1;
+    return runRenderWorker(host, port, scene, hashSceneSources(options.worldPath), options.threads) ? 0 : 1;
+}
+
+// Hand the frames to workers and write what they return
+static int renderDistributed(const BatchOptions& options, const std::vector<CameraKeyframe>& keyframes, const std::vector<int>& frames, const char* program) {
+    // Workers only take jobs for the world the coordinator hashed
+    RenderCoordinator coordinator(hashSceneSources(options.worldPath), options.width, options.height, options.jobSamples);
+    if (!coordinator.listen(options.listenPort)) {
+        fprintf(stderr, "Could not listen on port %d\n", options.listenPort);
+        return 1;
+    }
+
+    // The scene is only needed here for the denoiser's guides
+    Scene scene;
+    std::unique_ptr<CpuRenderer> renderer;
+    if (options.denoise) {
+        if (!loadWorld(options, scene)) return 1;
+        renderer = std::make_unique<CpuRenderer>(scene, options.threads);
+    }
+
+    // Local workers connect once they loaded the world, the coordinator waits for them
+    for (int i = 0; i < options.localWorkers; i++) {
+        int threads = std::max(1, options.threads / options.localWorkers + (i < options.threads % options.localWorkers ? 1 : 0));
+        std::vector<std::string> args = { program, "--worker", "127.0.0.1:" + std::to_string(options.listenPort), "--world", options.worldPath, "--threads", std::to_string(threads) };
+        if (options.verbose) args.push_back("--verbose");
+        if (!launchProcess(args)) fprintf(stderr, "Could not start local worker %d\n", i);
+    }
+
+    std::vector<DistributedFrame> pathFrames;
+    for (int frame : frames) pathFrames.push_back(cameraPathFrame(options, keyframes, frame));
+    printf("Rendering %d frames at %dx%d, %d spp in jobs of %d samples, listening on port %d\n", (int)frames.size(), options.width, options.height,
+        options.settings.samples, coordinator.samplesPerJob(options.settings.samples), options.listenPort);
+    fflush(stdout);
+
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    int failed = coordinator.render(pathFrames, [&](const DistributedFrame& frame, std::vector<Vector3>& radiance) {
+        std::string fileName = frameFileName(options.output, frame.frame);
+        if (!writeFrame(renderer.get(), options, frame, radiance, fileName)) {
+            fprintf(stderr, "Could not write frame %d to %s\n", frame.frame, fileName.c_str());
+            return false;
+        }
+        printf("[%d/%d] %s (%.1f s)\n", ++done, (int)frames.size(), fileName.c_str(), secondsSince(start));
+        fflush(stdout);
+        return true;
+    });
+
+    double seconds = secondsSince(start);
+    printf("%d frames in %.1f s (%.2f s per frame)\n", done, seconds, done > 0 ? seconds / done : 0.0);
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    if (!options.verbose) SetTraceLogLevel(LOG_WARNING);
+    if (options.threads <= 0) options.threads = (int)std::thread::hardware_concurrency();
+    if (options.threads <= 0) options.threads = 1;
+    if (options.workerAddress) return runWorker(options);
+
+    std::vector<CameraKeyframe> keyframes;
+    if (!loadCameraPath(options.cameraPath, keyframes) || keyframes.empty()) {
+        fprintf(stderr, "No keyframes in %s\n", options.cameraPath);
+        return 1;
+    }
+    if (options.firstFrame < 0) options.firstFrame = keyframes.front().frame;
+    if (options.lastFrame < 0) options.lastFrame = keyframes.back().frame;
+
+    // The job queue: every frame that is not on disk yet, in order
+    std::vector<int> frames;
+    int skipped = 0;
+    for (int frame = options.firstFrame; frame <= options.lastFrame; frame++) {
+        if (frameExists(options, frameFileName(options.output, frame))) skipped++;
+        else frames.push_back(frame);
+    }
+    printf("%d frames, %d already rendered\n", options.lastFrame - options.firstFrame + 1, skipped);
+    if (frames.empty()) return 0;
+
+    std::filesystem::path outputDirectory = std::filesystem::path(frameFileName(options.output, frames.front())).parent_path();
+    if (!outputDirectory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(outputDirectory, error);
+    }
+
+    if (options.listenPort > 0) return renderDistributed(options, keyframes, frames, argv[0]);
+
+    Scene scene;
+    if (!loadWorld(options, scene)) return 1;
+
+    // Small frames do not have enough tiles for every thread, so several of them are rendered at once
+    if (options.framesInFlight <= 0) {
+        int tileSize = std::max(options.settings.tileSize, 1);
+        int tiles = ((options.width + tileSize - 1) / tileSize) * ((options.height + tileSize - 1) / tileSize);
+        options.framesInFlight = (options.threads * BATCH_TILES_PER_THREAD + tiles - 1) / tiles;
+    }
+    int framesInFlight = std::max(1, std::min({ options.framesInFlight, options.threads, (int)frames.size() }));
+
+    // One renderer per frame in flight, the threads are split between them
+    std::vector<std::unique_ptr<CpuRenderer>> renderers;
+    for (int i = 0; i < framesInFlight; i++) {
+        int threads = options.threads / framesInFlight + (i < options.threads % framesInFlight ? 1 : 0);
+        renderers.push_back(std::make_unique<CpuRenderer>(scene, threads));
+    }
+    printf("Rendering %d frames at %dx%d, %d spp, %d at a time on %d threads\n", (int)frames.size(), options.width, options.height, options.settings.samples, framesInFlight, options.threads);
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> nextJob{ 0 };
+    std::atomic<int> done{ 0 };
+    std::atomic<int> failed{ 0 };
+    std::atomic<uint64_t> rays{ 0 };
+    auto work = [&](CpuRenderer& renderer) {
+        for (int job = nextJob++; job < (int)frames.size(); job = nextJob++) {
+            int frame = frames[job];
+            std::string fileName = frameFileName(options.output, frame);
+            auto frameStart = std::chrono::steady_clock::now();
+            bool written = renderFrame(renderer, options, keyframes, frame, fileName);
+            rays += renderer.getStats().rays;
+            if (!written) {
+                failed++;
+                fprintf(stderr, "Could not write frame %d to %s\n", frame, fileName.c_str());
+                continue;
+            }
+            printf("[%d/%d] %s (%.2f s, %.2f Mrays/s)\n", ++done, (int)frames.size(), fileName.c_str(), secondsSince(frameStart), renderer.getStats().raysPerSecond() / 1e6);
+            fflush(stdout);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < framesInFlight; i++) {
+        workers.emplace_back(work, std::ref(*renderers[i]));
+    }
+    work(*renderers[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    double seconds = secondsSince(start);
+    printf("%d frames in %.1f s (%.2f s per frame, %.2f Mrays/s)\n", done.load(), seconds, done > 0 ? seconds / done : 0.0, rays / seconds / 1e6);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,440 @@
+// Rendering benchmarks over procedural scenes
+// Results go to stdout as JSON (or --json FILE) and optionally to --csv FILE, one row per measurement
+#include "raylib.h"
+#include "CpuRenderer.h"
+#include "CustomCamera.h"
+#include "JsonLoader.h"
+#include "ProceduralScene.h"
+#include "SceneCache.h"
+#include "SimdKernels.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bump when a metric changes meaning, so trend tracking can tell old rows apart
+#define BENCHMARK_FORMAT_VERSION 1
+
+struct BenchmarkResult {
+    std::string scene;
+    int size;
+    std::string metric;
+    std::string variant; // Kernel level, sample count or loader, empty when there is only one
+    double value;
+    std::string unit;
+};
+
+struct BenchmarkOptions {
+    const char* jsonPath = nullptr; // stdout when not set
+    const char* csvPath = nullptr;
+    const char* sceneFilter = nullptr; // Only run scenes with this name
+    std::string workDir = "benchmark_worlds"; // Generated world folders for the loader benchmarks
+    int threads = 0; // Every hardware thread when 0, resolved before running so the output records it
+    bool quick = false; // Smaller scenes and images, for smoke tests
+    bool verbose = false;
+};
+
+struct BenchmarkCase {
+    ProceduralSceneType type;
+    int size;
+    bool quick; // Part of the --quick run
+};
+
+static const BenchmarkCase benchmarkCases[] = {
+    { PROCEDURAL_RANDOM_SPHERES, 100, true },
+    { PROCEDURAL_RANDOM_SPHERES, 10000, false },
+    { PROCEDURAL_QUAD_GRID, 32, true },
+    { PROCEDURAL_QUAD_GRID, 256, false },
+    { PROCEDURAL_GLASS_SPHERES, 100, true },
+    { PROCEDURAL_GLASS_SPHERES, 1000, false },
+    { PROCEDURAL_EMISSIVE_ROOM, 16, true },
+    { PROCEDURAL_EMISSIVE_ROOM, 64, false },
+    { PROCEDURAL_HEIGHT_FIELD, 64, true },
+    { PROCEDURAL_HEIGHT_FIELD, 512, false },
+    { PROCEDURAL_INSTANCED_ROCKS, 32, true },
+    { PROCEDURAL_INSTANCED_ROCKS, 1000, false },
+};
+
+static std::vector<BenchmarkResult> results;
+
+static void report(const char* scene, int size, const char* metric, const char* variant, double value, const char* unit) {
+    results.push_back({ scene, size, metric, variant, value, unit });
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Levels that are compiled in and supported by this CPU, getSimdKernels() falls back otherwise
+static std::vector<SimdLevel> availableSimdLevels() {
+    std::vector<SimdLevel> levels;
+    for (int level = SIMD_SCALAR; level <= SIMD_AVX512; level++) {
+        if (getSimdKernels((SimdLevel)level).level == level) levels.push_back((SimdLevel)level);
+    }
+    return levels;
+}
+
+// Run body until minSeconds have passed, returns the calls per second
+template <typename Body>
+static double callsPerSecond(double minSeconds, Body&& body) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    do {
+        body();
+        calls++;
+        seconds = secondsSince(start);
+    } while (seconds < minSeconds);
+    return calls / seconds;
+}
+
+
+
+// --------------------------
+// --- Kernel Micro Bench ---
+// --------------------------
+
+// Ray-primitive tests per second of every packet kernel, rays from one origin into a field of primitives
+static void benchmarkKernels(const BenchmarkOptions& options) {
+    const int packetCount = 64;
+    const int primitiveCount = 256;
+    double minSeconds = options.quick ? 0.05 : 0.5;
+
+    std::vector<RayPacket> packets(packetCount);
+    std::vector<Vector3> centers(primitiveCount);
+    std::vector<float> radii(primitiveCount);
+    std::vector<PacketQuad> quads(primitiveCount);
+    unsigned int seed = 1;
+    auto random = [&]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    };
+    for (RayPacket& packet : packets) {
+        for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+            packet.originX[i] = 0.0f;
+            packet.originY[i] = 0.0f;
+            packet.originZ[i] = 0.0f;
+            packet.directionX[i] = random() - 0.5f;
+            packet.directionY[i] = random() - 0.5f;
+            packet.directionZ[i] = -1.0f;
+        }
+        packet.tmin = 0.001f;
+        finishRayPacket(packet);
+    }
+    for (int i = 0; i < primitiveCount; i++) {
+        centers[i] = { (random() - 0.5f) * 20.0f, (random() - 0.5f) * 20.0f, -5.0f - random() * 20.0f };
+        radii[i] = 0.2f + random() * 0.8f;
+        quads[i] = makePacketQuad(centers[i], { radii[i], 0.0f, 0.0f }, { 0.0f, radii[i], 0.0f });
+    }
+
+    auto resetPackets = [&]() {
+        for (RayPacket& packet : packets) {
+            for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+                packet.tmax[i] = INFINITY;
+                packet.hitItem[i] = -1;
+            }
+        }
+    };
+
+    double testsPerCall = (double)packetCount * RAY_PACKET_SIZE * primitiveCount;
+    volatile unsigned int sink = 0; // Keeps the box tests from being optimized away
+    for (SimdLevel level : availableSimdLevels()) {
+        const SimdKernels& kernels = getSimdKernels(level);
+
+        double calls = callsPerSecond(minSeconds, [&]() {
+            resetPackets();
+            for (RayPacket& packet : packets) {
+                for (int i = 0; i < primitiveCount; i++) kernels.intersectSphere(packet, centers[i], radii[i], i);
+            }
+        });
+        report("kernels", primitiveCount, "sphere_tests_per_second", kernels.name, calls * testsPerCall, "tests/s");
+
+        calls = callsPerSecond(minSeconds, [&]() {
+            resetPackets();
+            for (RayPacket& packet : packets) {
+                for (int i = 0; i < primitiveCount; i++) kernels.intersectQuad(packet, quads[i], i);
+            }
+        });
+        report("kernels", primitiveCount, "quad_tests_per_second", kernels.name, calls * testsPerCall, "tests/s");
+
+        calls = callsPerSecond(minSeconds, [&]() {
+            resetPackets();
+            unsigned int mask = 0;
+            for (RayPacket& packet : packets) {
+                for (int i = 0; i < primitiveCount; i++) {
+                    Vector3 radius = { radii[i], radii[i], radii[i] };
+                    mask ^= kernels.intersectAabb(packet, Vector3Subtract(centers[i], radius), Vector3Add(centers[i], radius));
+                }
+            }
+            sink = sink + mask;
+        });
+        report("kernels", primitiveCount, "box_tests_per_second", kernels.name, calls * testsPerCall, "tests/s");
+    }
+}
+
+
+
+// -------------------------
+// --- Scene Macro Bench ---
+// -------------------------
+
+// Fastest of a few renders, the first one also warms up the caches and the thread pool
+static RenderStats bestRender(CpuRenderer& renderer, const CameraView& view, const RenderSettings& settings, int width, int height, int runs) {
+    std::vector<Vector3> radiance;
+    RenderStats best;
+    for (int i = 0; i < runs; i++) {
+        renderer.render(view, settings, width, height, radiance);
+        if (i == 0 || renderer.getStats().seconds < best.seconds) best = renderer.getStats();
+    }
+    return best;
+}
+
+// JSON and OBJ files of the world, one OBJ file per mesh
+static uint64_t worldBytes(const std::string& worldPath) {
+    uint64_t bytes = 0;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(worldPath, error)) {
+        std::string extension = entry.path().extension().string();
+        if (extension != ".json" && extension != ".obj") continue;
+        uint64_t size = entry.file_size(error);
+        if (!error) bytes += size;
+    }
+    return bytes;
+}
+
+// Write the scene as a world folder and time the JSON/OBJ parsers and the binary cache on it
+static void benchmarkLoaders(const char* name, int size, const Scene& scene, const BenchmarkOptions& options) {
+    std::string worldPath = options.workDir + "/" + name + "_" + std::to_string(size);
+    std::error_code error;
+    std::filesystem::create_directories(worldPath, error);
+    if (error || !writeSceneWorld(scene, worldPath)) {
+        fprintf(stderr, "Could not write %s, skipping the loader benchmarks\n", worldPath.c_str());
+        return;
+    }
+    double megabytes = worldBytes(worldPath) / (1024.0 * 1024.0);
+
+    // Parsing only, the same loaders loadScene() calls before building the BVH
+    std::vector<Material> materials;
+    std::vector<Sphere> spheres;
+    std::vector<Quad> quads;
+    std::vector<MeshVertex> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = loadMaterials(worldPath + "/materials.json", materials);
+    int materialCount = (int)materials.size();
+    ok = loadSpheres(worldPath + "/spheres.json", materialCount, spheres) && ok;
+    ok = loadQuads(worldPath + "/quads.json", materialCount, quads) && ok;
+    ok = loadMeshes(worldPath + "/meshes.json", materialCount, vertices, triangles, meshes, instances) && ok;
+    double parseSeconds = secondsSince(start);
+    if (!ok || spheres.size() != scene.spheres.size() || quads.size() != scene.quads.size() || triangles.size() != scene.triangles.size()
+        || instances.size() != scene.instances.size()) {
+        fprintf(stderr, "%s %d: the written world does not load back the same, skipping the loader benchmarks\n", name, size);
+        return;
+    }
+    report(name, size, "parse_mb_per_second", "json_obj", megabytes / parseSeconds, "MB/s");
+
+    // The first load parses, builds the BVH and writes the cache, the second maps the cache
+    std::remove((worldPath + "/" + SCENE_CACHE_FILE_NAME).c_str());
+    Scene cold;
+    start = std::chrono::steady_clock::now();
+    loadScene(worldPath, cold);
+    report(name, size, "load_ms", "cold", secondsSince(start) * 1000.0, "ms");
+
+    Scene warm;
+    start = std::chrono::steady_clock::now();
+    loadScene(worldPath, warm);
+    report(name, size, "load_ms", "cache", secondsSince(start) * 1000.0, "ms");
+}
+
+static void benchmarkScene(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options) {
+    const char* name = getProceduralSceneName(benchmarkCase.type);
+    int size = benchmarkCase.size;
+    int width = options.quick ? 160 : 320;
+    int height = options.quick ? 90 : 180;
+    int runs = options.quick ? 1 : 3;
+    auto sceneStart = std::chrono::steady_clock::now();
+
+    ProceduralSceneParams params;
+    params.type = benchmarkCase.type;
+    params.size = size;
+    Scene scene;
+    ProceduralView procedural = generateProceduralScene(params, scene);
+
+    const BvhBuildStats& bvhStats = scene.bvh.buildStats;
+    report(name, size, "primitives", "", (double)bvhStats.itemCount, "count");
+    report(name, size, "bvh_build_ms", "", bvhStats.buildSeconds * 1000.0, "ms");
+    report(name, size, "bvh_nodes", "", (double)bvhStats.nodeCount, "count");
+    report(name, size, "bvh_sah_cost", "", bvhStats.sahCost, "cost");
+    if (!scene.instances.empty()) {
+        // Bottom level, built once per mesh however many instances there are
+        const BvhBuildStats& meshStats = scene.meshBvh.buildStats;
+        report(name, size, "primitives", "mesh_triangles", (double)meshStats.itemCount, "count");
+        report(name, size, "bvh_build_ms", "meshes", meshStats.buildSeconds * 1000.0, "ms");
+        report(name, size, "bvh_nodes", "meshes", (double)meshStats.nodeCount, "count");
+        // The instance record and its share of the top level
+        double topLevelBytes = scene.bvh.nodes.size() * sizeof(BvhNode) + scene.bvh.itemIndices.size() * sizeof(int);
+        report(name, size, "bytes_per_instance", "", sizeof(Instance) + topLevelBytes / bvhStats.itemCount, "bytes");
+    }
+
+    CustomCamera camera(width, height, 62.3458f);
+    camera.camera.position = procedural.cameraPosition;
+    camera.camera.target = procedural.cameraTarget;
+    camera.update(width, height);
+    CpuRenderer renderer(scene, options.threads);
+
+    // Primary rays only, one intersection per ray through each kernel level and the scalar path
+    RenderSettings primary;
+    primary.samples = 1;
+    primary.maxBounces = 0;
+    primary.nextEventEstimation = false;
+    primary.russianRoulette = false;
+    primary.backgroundOpacity = procedural.backgroundOpacity;
+    for (SimdLevel level : availableSimdLevels()) {
+        renderer.setSimdLevel(level);
+        RenderStats stats = bestRender(renderer, camera.getView(), primary, width, height, runs);
+        report(name, size, "primary_rays_per_second", getSimdKernels(level).name, stats.raysPerSecond(), "rays/s");
+    }
+    renderer.setSimdLevel(detectSimdLevel());
+    primary.packetTracing = false;
+    RenderStats stats = bestRender(renderer, camera.getView(), primary, width, height, runs);
+    report(name, size, "primary_rays_per_second", "no_packets", stats.raysPerSecond(), "rays/s");
+
+    // Whole frames at a fixed sample count
+    RenderSettings frame;
+    frame.samples = options.quick ? 4 : 16;
+    frame.maxBounces = 4;
+    frame.backgroundOpacity = procedural.backgroundOpacity;
+    std::string variant = std::to_string(frame.samples) + "spp_" + std::to_string(width) + "x" + std::to_string(height);
+    stats = bestRender(renderer, camera.getView(), frame, width, height, runs);
+    report(name, size, "frame_ms", variant.c_str(), stats.seconds * 1000.0, "ms");
+    report(name, size, "rays_per_second", variant.c_str(), stats.raysPerSecond(), "rays/s");
+    report(name, size, "nodes_per_ray", variant.c_str(), stats.rays > 0 ? (double)stats.nodeVisits / stats.rays : 0.0, "nodes");
+
+    // The same frames traced one bounce at a time through the sorted ray queues
+    frame.wavefront = true;
+    std::string wavefrontVariant = "wavefront_" + variant;
+    stats = bestRender(renderer, camera.getView(), frame, width, height, runs);
+    report(name, size, "frame_ms", wavefrontVariant.c_str(), stats.seconds * 1000.0, "ms");
+    report(name, size, "rays_per_second", wavefrontVariant.c_str(), stats.raysPerSecond(), "rays/s");
+
+    benchmarkLoaders(name, size, scene, options);
+
+    fprintf(stderr, "%s %d: %.2f s\n", name, size, secondsSince(sceneStart));
+}
+
+
+
+// --------------
+// --- Output ---
+// --------------
+
+static void writeJsonString(FILE* file, const std::string& text) {
+    fputc('"', file);
+    for (char c : text) {
+        if (c == '"' || c == '\\') fputc('\\', file);
+        fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static void writeJson(FILE* file, const BenchmarkOptions& options) {
+    fprintf(file, "{\n    \"formatVersion\": %d,\n    \"quick\": %s,\n    \"threads\": %d,\n    \"simd\": ", BENCHMARK_FORMAT_VERSION, options.quick ? "true" : "false", options.threads);
+    writeJsonString(file, getBestSimdKernels().name);
+    fprintf(file, ",\n    \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        fprintf(file, "        {\"scene\": ");
+        writeJsonString(file, result.scene);
+        fprintf(file, ", \"size\": %d, \"metric\": ", result.size);
+        writeJsonString(file, result.metric);
+        fprintf(file, ", \"variant\": ");
+        writeJsonString(file, result.variant);
+        fprintf(file, ", \"value\": %.9g, \"unit\": ", result.value);
+        writeJsonString(file, result.unit);
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "    ]\n}\n");
+}
+
+static void writeCsv(FILE* file) {
+    fprintf(file, "scene,size,metric,variant,value,unit\n");
+    for (const BenchmarkResult& result : results) {
+        fprintf(file, "%s,%d,%s,%s,%.9g,%s\n", result.scene.c_str(), result.size, result.metric.c_str(), result.variant.c_str(), result.value, result.unit.c_str());
+    }
+}
+
+static void printUsage() {
+    fprintf(stderr,
+        "Usage: benchmark [options]\n"
+        "  --json FILE      Write the results as JSON to FILE instead of stdout\n"
+        "  --csv FILE       Also write the results as CSV\n"
+        "  --quick          Small scenes and images, for smoke tests\n"
+        "  --threads N      CPU render threads, every hardware thread by default\n"
+        "  --scene NAME     Only run this scene (kernels, random_spheres, quad_grid, glass_spheres, emissive_room, height_field)\n"
+        "  --work-dir DIR   Folder for the generated worlds, benchmark_worlds by default\n"
+        "  --verbose        Keep raylib's info log\n");
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--json") == 0 && hasValue) options.jsonPath = argv[++i];
+        else if (strcmp(arg, "--csv") == 0 && hasValue) options.csvPath = argv[++i];
+        else if (strcmp(arg, "--scene") == 0 && hasValue) options.sceneFilter = argv[++i];
+        else if (strcmp(arg, "--work-dir") == 0 && hasValue) options.workDir = argv[++i];
+        else if (strcmp(arg, "--threads") == 0 && hasValue) options.threads = atoi(argv[++i]);
+        else if (strcmp(arg, "--quick") == 0) options.quick = true;
+        else if (strcmp(arg, "--verbose") == 0) options.verbose = true;
+        else return false;
+    }
+    return true;
+}
+
+static bool selected(const BenchmarkOptions& options, const char* name) {
+    return options.sceneFilter == nullptr || strcmp(options.sceneFilter, name) == 0;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    if (!options.verbose) SetTraceLogLevel(LOG_WARNING);
+    if (options.threads <= 0) options.threads = (int)std::thread::hardware_concurrency();
+    if (options.threads <= 0) options.threads = 1;
+
+    if (selected(options, "kernels")) benchmarkKernels(options);
+    for (const BenchmarkCase& benchmarkCase : benchmarkCases) {
+        if (options.quick && !benchmarkCase.quick) continue;
+        if (!selected(options, getProceduralSceneName(benchmarkCase.type))) continue;
+        benchmarkScene(benchmarkCase, options);
+    }
+
+    FILE* json = options.jsonPath ? fopen(options.jsonPath, "wb") : stdout;
+    if (!json) {
+        fprintf(stderr, "Could not write %s\n", options.jsonPath);
+        return 1;
+    }
+    writeJson(json, options);
+    if (json != stdout) fclose(json);
+
+    if (options.csvPath) {
+        FILE* csv = fopen(options.csvPath, "wb");
+        if (!csv) {
+            fprintf(stderr, "Could not write %s\n", options.csvPath);
+            return 1;
+        }
+        writeCsv(csv);
+        fclose(csv);
+    }
+    return 0;
+}
@@ -86,6 +86,49 @@ function platform_defines()
     filter{}
 end
 
+-- The SIMD kernels are built once per instruction set, the renderer picks one at runtime from CPUID
+function simd_build_options()
+    filter {"files:../src/SimdKernelsSse.cpp", "platforms:x64 or x86", "action:gmake*"}
+        buildoptions { "-msse4.1" }
+
+    filter {"files:../src/SimdKernelsAvx2.cpp", "platforms:x64 or x86", "action:gmake*"}
+        buildoptions { "-mavx2", "-mfma" }
+
+    filter {"files:../src/SimdKernelsAvx512.cpp", "platforms:x64 or x86", "action:gmake*"}
+        buildoptions { "-mavx512f" }
+
+    filter {"files:../src/SimdKernelsAvx2.cpp", "action:vs*"}
+        buildoptions { "/arch:AVX2" }
+
+    filter {"files:../src/SimdKernelsAvx512.cpp", "action:vs*"}
+        buildoptions { "/arch:AVX512" }
+
+    filter{}
+end
+
+-- Libraries every executable linking raylib needs
+function raylib_app_links()
+    filter "action:vs*"
+        defines{"_WINSOCK_DEPRECATED_NO_WARNINGS", "_CRT_SECURE_NO_WARNINGS"}
+        dependson {"raylib"}
+        links {"raylib.lib"}
+        characterset ("Unicode")
+        buildoptions { "/Zc:__cplusplus" }
+
+    filter "system:windows"
+        defines{"_WIN32"}
+        links {"winmm", "gdi32", "opengl32", "ws2_32"}
+        libdirs {"../bin/%{cfg.buildcfg}"}
+
+    filter "system:linux"
+        links {"pthread", "m", "dl", "rt", "X11"}
+
+    filter "system:macosx"
+        links {"OpenGL.framework", "Cocoa.framework", "IOKit.framework", "CoreFoundation.framework", "CoreAudio.framework", "CoreVideo.framework", "AudioToolbox.framework"}
+
+    filter{}
+end
+
 -- if you don't want to download raylib, then set this to false, and set the raylib dir to where you want raylib to be pulled from, must be full sources.
 downloadRaylib = true
 raylib_dir = "external/raylib-master"
@@ -175,26 +218,78 @@ if (downloadRaylib) then
         includedirs { raylib_dir .."/src/external/glfw/include" }
         flags { "ShadowedVariables"}
         platform_defines()
+        simd_build_options()
+        raylib_app_links()
+
+    -- Procedural scene benchmarks, the renderer sources without the app's main
+    project "benchmark"
+        kind "ConsoleApp"
+        location "build_files/"
+        targetdir "../bin/%{cfg.buildcfg}"
 
         filter "action:vs*"
-            defines{"_WINSOCK_DEPRECATED_NO_WARNINGS", "_CRT_SECURE_NO_WARNINGS"}
-            dependson {"raylib"}
-            links {"raylib.lib"}
-            characterset ("Unicode")
-            buildoptions { "/Zc:__cplusplus" }
+            debugdir "$(SolutionDir)"
+
+        filter{}
 
-        filter "system:windows"
-            defines{"_WIN32"}
-            links {"winmm", "gdi32", "opengl32"}
-            libdirs {"../bin/%{cfg.buildcfg}"}
+        vpaths
+        {
+            ["Header Files/*"] = { "../src/**.h", "../src/**.hpp"},
+            ["Source Files/*"] = { "../benchmark/**.cpp", "../src/**.cpp"},
+        }
+        files {"../benchmark/**.cpp", "../src/**.c", "../src/**.cpp", "../src/**.h", "../src/**.hpp"}
+        removefiles {"../src/main.cpp"}
 
-        filter "system:linux"
-            links {"pthread", "m", "dl", "rt", "X11"}
+        includedirs { "../src" }
+        includedirs { "../include" }
 
-        filter "system:macosx"
-            links {"OpenGL.framework", "Cocoa.framework", "IOKit.framework", "CoreFoundation.framework", "CoreAudio.framework", "CoreVideo.framework", "AudioToolbox.framework"}
+        links {"raylib"}
+
+        cdialect "C17"
+        cppdialect "C++17"
+
+        includedirs {raylib_dir .. "/src" }
+        includedirs {raylib_dir .."/src/external" }
+        includedirs { raylib_dir .."/src/external/glfw/include" }
+        flags { "ShadowedVariables"}
+        platform_defines()
+        simd_build_options()
+        raylib_app_links()
+
+    -- Headless batch renderer for camera path animations, the renderer sources without the app's main
+    project "batch"
+        kind "ConsoleApp"
+        location "build_files/"
+        targetdir "../bin/%{cfg.buildcfg}"
+
+        filter "action:vs*"
+            debugdir "$(SolutionDir)"
 
         filter{}
+
+        vpaths
+        {
+            ["Header Files/*"] = { "../src/**.h", "../src/**.hpp"},
+            ["Source Files/*"] = { "../batch/**.cpp", "../src/**.cpp"},
+        }
+        files {"../batch/**.cpp", "../src/**.c", "../src/**.cpp", "../src/**.h", "../src/**.hpp"}
+        removefiles {"../src/main.cpp"}
+
+        includedirs { "../src" }
+        includedirs { "../include" }
+
+        links {"raylib"}
+
+        cdialect "C17"
+        cppdialect "C++17"
+
+        includedirs {raylib_dir .. "/src" }
+        includedirs {raylib_dir .."/src/external" }
+        includedirs { raylib_dir .."/src/external/glfw/include" }
+        flags { "ShadowedVariables"}
+        platform_defines()
+        simd_build_options()
+        raylib_app_links()
 		
 
     project "raylib"
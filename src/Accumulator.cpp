@@ -0,0 +1,148 @@
+#include "Accumulator.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+RenderTexture2D loadFloatRenderTexture(int width, int height) {
+    RenderTexture2D target = {};
+
+    target.id = rlLoadFramebuffer();
+    target.texture.id = rlLoadTexture(nullptr, width, height, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 1);
+    target.texture.width = width;
+    target.texture.height = height;
+    target.texture.format = PIXELFORMAT_UNCOMPRESSED_R32G32B32A32;
+    target.texture.mipmaps = 1;
+
+    rlFramebufferAttach(target.id, target.texture.id, RL_ATTACHMENT_COLOR_CHANNEL0, RL_ATTACHMENT_TEXTURE2D, 0);
+    if (!rlFramebufferComplete(target.id)) {
+        TraceLog(LOG_WARNING, "Float render texture %dx%d is not complete", width, height);
+    }
+
+    return target;
+}
+
+std::vector<Vector3> readRadiance(const Texture2D& texture) {
+    int width = texture.width, height = texture.height;
+    std::vector<Vector3> radiance((size_t)width * height);
+    float* pixels = (float*)rlReadTexturePixels(texture.id, width, height, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32);
+    if (pixels == nullptr) {
+        TraceLog(LOG_WARNING, "Could not read back a %dx%d float texture", width, height);
+        return radiance;
+    }
+
+    // Textures are stored bottom up
+    for (int row = 0; row < height; row++) {
+        const float* source = pixels + (size_t)(height - 1 - row) * width * 4;
+        for (int x = 0; x < width; x++) {
+            radiance[(size_t)row * width + x] = { source[x * 4], source[x * 4 + 1], source[x * 4 + 2] };
+        }
+    }
+    RL_FREE(pixels);
+
+    return radiance;
+}
+
+Accumulator::Accumulator(int widthValue, int heightValue, Shader raytracingShader)
+    : width(widthValue), height(heightValue), frameShader(raytracingShader) {
+    targets[0] = loadFloatRenderTexture(width, height);
+    targets[1] = loadFloatRenderTexture(width, height);
+    displayShader = LoadShader(0, "src/display.frag");
+    displayGammaLoc = GetShaderLocation(displayShader, "gamma");
+
+    frameIndexLoc = GetShaderLocation(frameShader, "frameIndex");
+    frameWeightLoc = GetShaderLocation(frameShader, "frameWeight");
+    sampleOffsetLoc = GetShaderLocation(frameShader, "sampleOffset");
+    previousFrameLoc = GetShaderLocation(frameShader, "previousFrame");
+
+    // The shader renders directly until the first accumulated frame
+    int directFrame = -1;
+    SetShaderValue(frameShader, frameIndexLoc, &directFrame, SHADER_UNIFORM_INT);
+
+    lastView = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+}
+
+Accumulator::~Accumulator() {
+    UnloadRenderTexture(targets[0]);
+    UnloadRenderTexture(targets[1]);
+    UnloadShader(displayShader);
+}
+
+void Accumulator::reset() {
+    frameCount = 0;
+    sampleCount = 0;
+}
+
+void Accumulator::resize(int newWidth, int newHeight) {
+    if (newWidth == width && newHeight == height) return;
+    width = newWidth;
+    height = newHeight;
+    UnloadRenderTexture(targets[0]);
+    UnloadRenderTexture(targets[1]);
+    targets[0] = loadFloatRenderTexture(width, height);
+    targets[1] = loadFloatRenderTexture(width, height);
+    reset();
+}
+
+void Accumulator::resetIfChanged(const CameraView& view, const RenderSettings& settings) {
+    if (!sameCameraView(view, lastView) || !sameImageSettings(settings, lastSettings)) {
+        reset();
+    }
+    lastView = view;
+    lastSettings = settings;
+}
+
+void Accumulator::beginFrame(int frameSamples) {
+    // Share of the new frame in the mean, 1 / (frameCount + 1) when all frames have the same samples
+    float frameWeight = (float)frameSamples / (sampleCount + frameSamples);
+    int sampleOffset = sampleCount;
+    sampleCount += frameSamples;
+
+    // Every frame continues the sample sequence where the last one stopped, otherwise the mean never changes
+    SetShaderValue(frameShader, frameIndexLoc, &frameCount, SHADER_UNIFORM_INT);
+    SetShaderValue(frameShader, frameWeightLoc, &frameWeight, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(frameShader, sampleOffsetLoc, &sampleOffset, SHADER_UNIFORM_INT);
+
+    BeginTextureMode(targets[1 - current]);
+    // Alpha holds the mean squared luminance for adaptive sampling, it must be written as is
+    rlDisableColorBlend();
+}
+
+void Accumulator::bindPreviousFrame() {
+    SetShaderValueTexture(frameShader, previousFrameLoc, targets[current].texture);
+}
+
+void Accumulator::endFrame() {
+    EndTextureMode();
+    rlEnableColorBlend();
+    current = 1 - current;
+    frameCount++;
+
+    int directFrame = -1;
+    int sampleOffset = 0;
+    SetShaderValue(frameShader, frameIndexLoc, &directFrame, SHADER_UNIFORM_INT);
+    SetShaderValue(frameShader, sampleOffsetLoc, &sampleOffset, SHADER_UNIFORM_INT);
+}
+
+void Accumulator::draw(float gamma) {
+    SetShaderValue(displayShader, displayGammaLoc, &gamma, SHADER_UNIFORM_FLOAT);
+
+    // Render textures are stored bottom up, flip them with a negative source height
+    BeginShaderMode(displayShader);
+        DrawTextureRec(targets[current].texture, Rectangle{ 0, 0, (float)width, (float)-height }, Vector2{ 0, 0 }, WHITE);
+    EndShaderMode();
+}
+
+std::vector<Vector3> Accumulator::readMean() const {
+    return readRadiance(targets[current].texture);
+}
+
+int Accumulator::getFrameCount() const {
+    return frameCount;
+}
+
+int Accumulator::getSampleCount() const {
+    return sampleCount;
+}
+
+const RenderTexture2D& Accumulator::getTarget() const {
+    return targets[current];
+}
@@ -0,0 +1,70 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include "raylib.h"
+#include "CustomCamera.h"
+#include "CpuRenderer.h"
+#include <vector>
+
+// Float RGBA render target, raylib's LoadRenderTexture only makes 8-bit ones
+RenderTexture2D loadFloatRenderTexture(int width, int height);
+// Read a float texture back as linear radiance, top row first
+std::vector<Vector3> readRadiance(const Texture2D& texture);
+
+// Progressive rendering: every frame adds its samples to a float32 running mean
+// The mean is kept in linear space, gamma is applied only when it is drawn
+class Accumulator {
+private:
+    RenderTexture2D targets[2]; // Ping-pong, the shader reads one while writing the other
+    int current = 0; // Target holding the latest mean
+    int frameCount = 0; // Frames in the mean, 0 after a reset
+    int sampleCount = 0; // Samples per pixel in the mean, frames may have different counts
+    int width, height;
+    Shader displayShader;
+    int displayGammaLoc;
+
+    // Raytracing shader and the uniforms the accumulator drives, restored by endFrame()
+    Shader frameShader;
+    int frameIndexLoc;
+    int frameWeightLoc;
+    int sampleOffsetLoc;
+    int previousFrameLoc;
+
+    // What the mean was rendered with, any change resets it
+    CameraView lastView;
+    RenderSettings lastSettings;
+
+public:
+    Accumulator(int width, int height, Shader raytracingShader);
+    ~Accumulator();
+
+    Accumulator(const Accumulator&) = delete;
+    Accumulator& operator=(const Accumulator&) = delete;
+
+    void reset();
+    // Reallocate the targets for another render size, the mean starts over
+    void resize(int width, int height);
+    // Reset when the camera moved or a setting that changes the image changed (gamma does not)
+    void resetIfChanged(const CameraView& view, const RenderSettings& settings);
+
+    // Draw the raytracing shader between beginFrame() and endFrame() to add one frame to the mean
+    // frameIndex >= 0 makes the shader output linear colors blended with previousFrame
+    // frameSamples weights the frame, so passes with different sample counts average correctly
+    // It is also where the next frame continues the sample sequence, pass the samples the shader traces
+    void beginFrame(int frameSamples);
+    // Call inside BeginShaderMode(), render batches reset the texture bindings
+    void bindPreviousFrame();
+    // Sets frameIndex back to -1 so other passes get gamma corrected output again
+    void endFrame();
+    // Draw the mean to the current framebuffer with gamma correction
+    void draw(float gamma);
+
+    // Read the mean back as linear radiance, top row first
+    std::vector<Vector3> readMean() const;
+
+    int getFrameCount() const;
+    int getSampleCount() const;
+    const RenderTexture2D& getTarget() const;
+};
+
+#endif // ACCUMULATOR_H
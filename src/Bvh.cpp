@@ -0,0 +1,249 @@
+#include "Bvh.h"
+#include "raymath.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Surface area heuristic costs, relative to one item intersection
+static const float traversalCost = 1.0f;
+static const float intersectionCost = 1.0f;
+static const int binCount = 16;
+
+void Aabb::grow(Vector3 point) {
+    min = Vector3Min(min, point);
+    max = Vector3Max(max, point);
+}
+
+void Aabb::grow(const Aabb& other) {
+    min = Vector3Min(min, other.min);
+    max = Vector3Max(max, other.max);
+}
+
+Vector3 Aabb::centroid() const {
+    return Vector3Scale(Vector3Add(min, max), 0.5f);
+}
+
+float Aabb::surfaceArea() const {
+    if (!valid()) return 0.0f;
+    Vector3 extent = Vector3Subtract(max, min);
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool Aabb::valid() const {
+    return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+}
+
+static float axisValue(Vector3 v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+struct BvhBuilder {
+    const std::vector<Aabb>& itemBounds;
+    std::vector<Vector3> centroids;
+    int maxLeafSize;
+    std::vector<BvhNode>& nodes;
+    std::vector<int>& itemIndices;
+    BvhBuildStats& buildStats;
+
+    int buildNode(int first, int count, int depth);
+};
+
+int BvhBuilder::buildNode(int first, int count, int depth) {
+    int nodeIndex = (int)nodes.size();
+    nodes.push_back({});
+    buildStats.maxDepth = std::max(buildStats.maxDepth, depth);
+
+    Aabb bounds, centroidBounds;
+    for (int i = first; i < first + count; i++) {
+        int item = itemIndices[i];
+        bounds.grow(itemBounds[item]);
+        centroidBounds.grow(centroids[item]);
+    }
+    nodes[nodeIndex].boundsMin = bounds.min;
+    nodes[nodeIndex].boundsMax = bounds.max;
+
+    auto makeLeaf = [&]() {
+        nodes[nodeIndex].leftFirst = first;
+        nodes[nodeIndex].count = count;
+        buildStats.leafCount++;
+        return nodeIndex;
+    };
+
+    // The shader's traversal stack bounds the depth of the tree, it is the smaller one
+    if (count == 1) return makeLeaf();
+    if (depth >= BVH_GPU_STACK_SIZE - 2) {
+        buildStats.depthLimitedLeaves++;
+        return makeLeaf();
+    }
+
+    // Bin the centroids along every axis and find the cheapest split
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float axisMin = axisValue(centroidBounds.min, axis);
+        float axisMax = axisValue(centroidBounds.max, axis);
+        if (axisMax <= axisMin) continue;
+
+        Aabb binBounds[binCount];
+        int binCounts[binCount] = { 0 };
+        float scale = binCount / (axisMax - axisMin);
+        for (int i = first; i < first + count; i++) {
+            int item = itemIndices[i];
+            int bin = std::min(binCount - 1, (int)((axisValue(centroids[item], axis) - axisMin) * scale));
+            binCounts[bin]++;
+            binBounds[bin].grow(itemBounds[item]);
+        }
+
+        // Sweep from both sides to get the area and count on each side of every plane
+        float leftArea[binCount - 1], rightArea[binCount - 1];
+        int leftCount[binCount - 1], rightCount[binCount - 1];
+        Aabb leftBox, rightBox;
+        int leftSum = 0, rightSum = 0;
+        for (int i = 0; i < binCount - 1; i++) {
+            leftSum += binCounts[i];
+            leftCount[i] = leftSum;
+            leftBox.grow(binBounds[i]);
+            leftArea[i] = leftBox.surfaceArea();
+
+            rightSum += binCounts[binCount - 1 - i];
+            rightCount[binCount - 2 - i] = rightSum;
+            rightBox.grow(binBounds[binCount - 1 - i]);
+            rightArea[binCount - 2 - i] = rightBox.surfaceArea();
+        }
+
+        for (int i = 0; i < binCount - 1; i++) {
+            if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+            float cost = leftArea[i] * leftCount[i] + rightArea[i] * rightCount[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    // All centroids coincide, nothing to split on
+    if (bestAxis < 0) return makeLeaf();
+
+    float parentArea = bounds.surfaceArea();
+    float splitCost = traversalCost + intersectionCost * bestCost / (parentArea > 0.0f ? parentArea : 1.0f);
+    float leafCost = intersectionCost * count;
+    if (count <= maxLeafSize && splitCost >= leafCost) return makeLeaf();
+
+    // Partition the items around the chosen plane
+    float axisMin = axisValue(centroidBounds.min, bestAxis);
+    float scale = binCount / (axisValue(centroidBounds.max, bestAxis) - axisMin);
+    int* begin = itemIndices.data() + first;
+    int* middle = std::partition(begin, begin + count, [&](int item) {
+        int bin = std::min(binCount - 1, (int)((axisValue(centroids[item], bestAxis) - axisMin) * scale));
+        return bin <= bestSplit;
+    });
+    int leftCount = (int)(middle - begin);
+    if (leftCount == 0 || leftCount == count) leftCount = count / 2;
+
+    buildNode(first, leftCount, depth + 1);
+    int right = buildNode(first + leftCount, count - leftCount, depth + 1);
+    nodes[nodeIndex].leftFirst = right;
+    nodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+void Bvh::build(const std::vector<Aabb>& itemBounds, int maxLeafSize) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<BvhNode>& editNodes = nodes.edit();
+    std::vector<int>& editIndices = itemIndices.edit();
+    editNodes.clear();
+    editIndices.resize(itemBounds.size());
+    buildStats = BvhBuildStats();
+    buildStats.itemCount = (int)itemBounds.size();
+    for (int i = 0; i < (int)itemBounds.size(); i++) {
+        editIndices[i] = i;
+    }
+
+    if (!itemBounds.empty()) {
+        BvhBuilder builder = { itemBounds, {}, std::max(maxLeafSize, 1), editNodes, editIndices, buildStats };
+        builder.centroids.resize(itemBounds.size());
+        for (size_t i = 0; i < itemBounds.size(); i++) {
+            builder.centroids[i] = itemBounds[i].centroid();
+        }
+        editNodes.reserve(itemBounds.size() * 2);
+        builder.buildNode(0, (int)itemBounds.size(), 0);
+        editNodes.shrink_to_fit();
+
+        // Expected cost of a random ray that hits the root
+        Aabb root = { editNodes[0].boundsMin, editNodes[0].boundsMax };
+        float rootArea = root.surfaceArea() > 0.0f ? root.surfaceArea() : 1.0f;
+        for (const BvhNode& node : editNodes) {
+            Aabb box = { node.boundsMin, node.boundsMax };
+            float cost = node.count > 0 ? intersectionCost * node.count : traversalCost;
+            buildStats.sahCost += cost * box.surfaceArea() / rootArea;
+        }
+    }
+
+    buildStats.nodeCount = (int)editNodes.size();
+    buildStats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Bvh::refit(const std::vector<Aabb>& itemBounds) {
+    std::vector<BvhNode>& editNodes = nodes.edit();
+    // Children always come after their parent, so walking backwards fits them first
+    for (int i = (int)editNodes.size() - 1; i >= 0; i--) {
+        BvhNode& node = editNodes[i];
+        Aabb bounds;
+        if (node.count > 0) {
+            for (int j = 0; j < node.count; j++) {
+                bounds.grow(itemBounds[itemIndices[node.leftFirst + j]]);
+            }
+        } else {
+            bounds.grow(Aabb{ editNodes[i + 1].boundsMin, editNodes[i + 1].boundsMax });
+            bounds.grow(Aabb{ editNodes[node.leftFirst].boundsMin, editNodes[node.leftFirst].boundsMax });
+        }
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+    }
+}
+
+int Bvh::append(const Bvh& other, int itemOffset) {
+    if (other.nodes.empty()) return -1;
+
+    std::vector<BvhNode>& editNodes = nodes.edit();
+    std::vector<int>& editIndices = itemIndices.edit();
+    int nodeOffset = (int)editNodes.size();
+    int itemIndexOffset = (int)editIndices.size();
+    for (const BvhNode& node : other.nodes) {
+        BvhNode shifted = node;
+        shifted.leftFirst += node.count > 0 ? itemIndexOffset : nodeOffset;
+        editNodes.push_back(shifted);
+    }
+    for (int item : other.itemIndices) {
+        editIndices.push_back(item + itemOffset);
+    }
+
+    buildStats.buildSeconds += other.buildStats.buildSeconds;
+    buildStats.itemCount += other.buildStats.itemCount;
+    buildStats.nodeCount = (int)editNodes.size();
+    buildStats.leafCount += other.buildStats.leafCount;
+    buildStats.maxDepth = std::max(buildStats.maxDepth, other.buildStats.maxDepth);
+    buildStats.depthLimitedLeaves += other.buildStats.depthLimitedLeaves;
+    buildStats.sahCost += other.buildStats.sahCost;
+    return nodeOffset;
+}
+
+bool Bvh::empty() const {
+    return nodes.empty();
+}
+
+std::vector<Vector4> packBvhNodes(const Bvh& bvh) {
+    std::vector<Vector4> texels(bvh.nodes.size() * 2);
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        const BvhNode& node = bvh.nodes[i];
+        float leftFirst, count;
+        memcpy(&leftFirst, &node.leftFirst, sizeof(float));
+        memcpy(&count, &node.count, sizeof(float));
+        texels[i * 2] = { node.boundsMin.x, node.boundsMin.y, node.boundsMin.z, leftFirst };
+        texels[i * 2 + 1] = { node.boundsMax.x, node.boundsMax.y, node.boundsMax.z, count };
+    }
+    return texels;
+}
@@ -0,0 +1,189 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "raylib.h"
+#include "MappedArray.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Axis aligned bounding box
+struct Aabb {
+    Vector3 min = { INFINITY, INFINITY, INFINITY };
+    Vector3 max = { -INFINITY, -INFINITY, -INFINITY };
+
+    void grow(Vector3 point);
+    void grow(const Aabb& other);
+    Vector3 centroid() const;
+    float surfaceArea() const;
+    bool valid() const;
+};
+
+// Flattened node, 32 bytes
+// Interior nodes (count == 0): the left child directly follows the node, leftFirst is the right child
+// Leaf nodes (count > 0): items [leftFirst, leftFirst + count) of Bvh::itemIndices
+struct BvhNode {
+    Vector3 boundsMin;
+    int leftFirst;
+    Vector3 boundsMax;
+    int count;
+};
+
+// Traversal stack of raytracing.frag, keep it the same as BVH_STACK_SIZE there
+// The builder stops splitting two levels above it, so the GPU never drops a child the CPU would visit
+#define BVH_GPU_STACK_SIZE 32
+
+struct BvhBuildStats {
+    double buildSeconds = 0.0;
+    int itemCount = 0;
+    int nodeCount = 0;
+    int leafCount = 0;
+    int maxDepth = 0;
+    int depthLimitedLeaves = 0; // Leaves of several items made only because the depth limit was reached
+    float sahCost = 0.0f; // Expected traversal cost of the whole tree, lower is better
+};
+
+// Traversal counters, summed over many rays
+struct BvhTraversalStats {
+    uint64_t rays = 0;
+    uint64_t nodeVisits = 0;
+    uint64_t itemTests = 0;
+};
+
+// Bounding volume hierarchy built with the binned surface area heuristic
+class Bvh {
+public:
+    MappedArray<BvhNode> nodes;
+    MappedArray<int> itemIndices; // Leaf ranges index into this, values are the indices passed to build()
+    BvhBuildStats buildStats;
+
+    void build(const std::vector<Aabb>& itemBounds, int maxLeafSize = 4);
+    // Fit the node bounds to items that moved, the tree keeps its shape, so it gets slower the further they move
+    void refit(const std::vector<Aabb>& itemBounds);
+    // Add the nodes and items of another BVH after the ones of this one, its item values shifted by itemOffset
+    // Returns the index of its root node, or -1 when it is empty
+    int append(const Bvh& other, int itemOffset);
+    bool empty() const;
+
+    // Visit every leaf item whose node the ray enters, nearest child first
+    // intersectItem(itemIndex, tmax) tests one item and may shrink tmax
+    template <typename IntersectItem>
+    void traverse(Vector3 origin, Vector3 direction, float tmin, float& tmax, BvhTraversalStats& stats, IntersectItem&& intersectItem) const;
+
+    // Same traversal from another root node, the root of an appended BVH, without counting a ray
+    template <typename IntersectItem>
+    void traverseFrom(int rootNode, Vector3 origin, Vector3 direction, float tmin, float& tmax, BvhTraversalStats& stats, IntersectItem&& intersectItem) const;
+
+    // Same traversal, but stops as soon as anyItem(itemIndex, tmax) returns true
+    template <typename AnyItem>
+    bool occluded(Vector3 origin, Vector3 direction, float tmin, float tmax, BvhTraversalStats& stats, AnyItem&& anyItem) const;
+};
+
+// Pack nodes into RGBA32F texels for the shader, two texels per node
+// Texel 0 is (boundsMin, leftFirst), texel 1 is (boundsMax, count), the ints are stored bitwise (floatBitsToInt)
+std::vector<Vector4> packBvhNodes(const Bvh& bvh);
+
+// Branch-free min/max, fminf/fmaxf are library calls unless NaN handling is relaxed
+inline float bvhMin(float a, float b) { return a < b ? a : b; }
+inline float bvhMax(float a, float b) { return a > b ? a : b; }
+
+// Slab test, returns the entry distance or INFINITY on a miss
+inline float intersectAabb(const Vector3& boundsMin, const Vector3& boundsMax, Vector3 origin, Vector3 invDirection, float tmin, float tmax) {
+    float tx1 = (boundsMin.x - origin.x) * invDirection.x, tx2 = (boundsMax.x - origin.x) * invDirection.x;
+    float ty1 = (boundsMin.y - origin.y) * invDirection.y, ty2 = (boundsMax.y - origin.y) * invDirection.y;
+    float tz1 = (boundsMin.z - origin.z) * invDirection.z, tz2 = (boundsMax.z - origin.z) * invDirection.z;
+    float tNear = bvhMax(bvhMax(bvhMin(tx1, tx2), bvhMin(ty1, ty2)), bvhMax(bvhMin(tz1, tz2), tmin));
+    float tFar = bvhMin(bvhMin(bvhMax(tx1, tx2), bvhMax(ty1, ty2)), bvhMin(bvhMax(tz1, tz2), tmax));
+    return tNear <= tFar ? tNear : INFINITY;
+}
+
+inline Vector3 safeInverse(Vector3 direction) {
+    // Avoid NaNs from 0 * inf in the slab test by replacing zero components with a tiny value
+    const float tiny = 1e-20f;
+    return { 1.0f / (fabsf(direction.x) > tiny ? direction.x : tiny), 1.0f / (fabsf(direction.y) > tiny ? direction.y : tiny), 1.0f / (fabsf(direction.z) > tiny ? direction.z : tiny) };
+}
+
+#define BVH_STACK_SIZE 64
+
+template <typename IntersectItem>
+void Bvh::traverse(Vector3 origin, Vector3 direction, float tmin, float& tmax, BvhTraversalStats& stats, IntersectItem&& intersectItem) const {
+    stats.rays++;
+    if (nodes.empty()) return;
+    traverseFrom(0, origin, direction, tmin, tmax, stats, intersectItem);
+}
+
+template <typename IntersectItem>
+void Bvh::traverseFrom(int rootNode, Vector3 origin, Vector3 direction, float tmin, float& tmax, BvhTraversalStats& stats, IntersectItem&& intersectItem) const {
+    Vector3 invDirection = safeInverse(direction);
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIndex = rootNode;
+    if (intersectAabb(nodes[rootNode].boundsMin, nodes[rootNode].boundsMax, origin, invDirection, tmin, tmax) == INFINITY) return;
+
+    while (true) {
+        const BvhNode& node = nodes[nodeIndex];
+        stats.nodeVisits++;
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                stats.itemTests++;
+                intersectItem(itemIndices[node.leftFirst + i], tmax);
+            }
+        } else {
+            int left = nodeIndex + 1;
+            int right = node.leftFirst;
+            float tLeft = intersectAabb(nodes[left].boundsMin, nodes[left].boundsMax, origin, invDirection, tmin, tmax);
+            float tRight = intersectAabb(nodes[right].boundsMin, nodes[right].boundsMax, origin, invDirection, tmin, tmax);
+            if (tLeft > tRight) {
+                float t = tLeft; tLeft = tRight; tRight = t;
+                int n = left; left = right; right = n;
+            }
+            if (tLeft != INFINITY) {
+                if (tRight != INFINITY && stackSize < BVH_STACK_SIZE) stack[stackSize++] = right;
+                nodeIndex = left;
+                continue;
+            }
+        }
+
+        // Pop the next node that is still closer than the current hit
+        bool found = false;
+        while (stackSize > 0) {
+            nodeIndex = stack[--stackSize];
+            if (intersectAabb(nodes[nodeIndex].boundsMin, nodes[nodeIndex].boundsMax, origin, invDirection, tmin, tmax) != INFINITY) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return;
+    }
+}
+
+template <typename AnyItem>
+bool Bvh::occluded(Vector3 origin, Vector3 direction, float tmin, float tmax, BvhTraversalStats& stats, AnyItem&& anyItem) const {
+    stats.rays++;
+    if (nodes.empty()) return false;
+
+    Vector3 invDirection = safeInverse(direction);
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const BvhNode& node = nodes[stack[--stackSize]];
+        stats.nodeVisits++;
+        if (intersectAabb(node.boundsMin, node.boundsMax, origin, invDirection, tmin, tmax) == INFINITY) continue;
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                stats.itemTests++;
+                if (anyItem(itemIndices[node.leftFirst + i], tmax)) return true;
+            }
+        } else if (stackSize + 2 <= BVH_STACK_SIZE) {
+            stack[stackSize++] = node.leftFirst;
+            stack[stackSize++] = (int)(&node - nodes.data()) + 1;
+        }
+    }
+    return false;
+}
+
+#endif // BVH_H
@@ -0,0 +1,58 @@
+#include "CameraPath.h"
+#include "raymath.h"
+
+// Change per frame at keyframe i, from its neighbours, the first and last keyframe only have one
+static Vector3 velocity(const std::vector<CameraKeyframe>& keyframes, size_t i, Vector3 CameraKeyframe::*member) {
+    size_t before = i > 0 ? i - 1 : i;
+    size_t after = i + 1 < keyframes.size() ? i + 1 : i;
+    int frames = keyframes[after].frame - keyframes[before].frame;
+    if (frames <= 0) return Vector3Zero();
+    return Vector3Scale(Vector3Subtract(keyframes[after].*member, keyframes[before].*member), 1.0f / frames);
+}
+
+// Cubic Hermite between keyframes i and i + 1, t in [0, 1]
+static Vector3 spline(const std::vector<CameraKeyframe>& keyframes, size_t i, float t, Vector3 CameraKeyframe::*member) {
+    float frames = (float)(keyframes[i + 1].frame - keyframes[i].frame);
+    Vector3 start = keyframes[i].*member;
+    Vector3 end = keyframes[i + 1].*member;
+    Vector3 startTangent = Vector3Scale(velocity(keyframes, i, member), frames);
+    Vector3 endTangent = Vector3Scale(velocity(keyframes, i + 1, member), frames);
+
+    float t2 = t * t, t3 = t2 * t;
+    Vector3 result = Vector3Scale(start, 2.0f * t3 - 3.0f * t2 + 1.0f);
+    result = Vector3Add(result, Vector3Scale(startTangent, t3 - 2.0f * t2 + t));
+    result = Vector3Add(result, Vector3Scale(end, -2.0f * t3 + 3.0f * t2));
+    return Vector3Add(result, Vector3Scale(endTangent, t3 - t2));
+}
+
+CameraKeyframe sampleCameraPath(const std::vector<CameraKeyframe>& keyframes, int frame) {
+    if (keyframes.empty()) {
+        CameraKeyframe camera;
+        camera.frame = frame;
+        return camera;
+    }
+    if (frame <= keyframes.front().frame) {
+        CameraKeyframe camera = keyframes.front();
+        camera.frame = frame;
+        return camera;
+    }
+    if (frame >= keyframes.back().frame) {
+        CameraKeyframe camera = keyframes.back();
+        camera.frame = frame;
+        return camera;
+    }
+
+    size_t i = 0;
+    while (keyframes[i + 1].frame <= frame) i++;
+    const CameraKeyframe& from = keyframes[i];
+    const CameraKeyframe& to = keyframes[i + 1];
+    float t = (float)(frame - from.frame) / (to.frame - from.frame);
+
+    CameraKeyframe camera;
+    camera.frame = frame;
+    camera.position = spline(keyframes, i, t, &CameraKeyframe::position);
+    camera.target = spline(keyframes, i, t, &CameraKeyframe::target);
+    camera.fovy = Lerp(from.fovy, to.fovy, t);
+    camera.defocusAngle = Lerp(from.defocusAngle, to.defocusAngle, t);
+    return camera;
+}
@@ -0,0 +1,21 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "raylib.h"
+#include <vector>
+
+// Camera of one frame of an animation, position, target and fovy as CustomCamera takes them
+struct CameraKeyframe {
+    int frame = 0;
+    Vector3 position = { 0.0f, 0.0f, 1.0f };
+    Vector3 target = { 0.0f, 0.0f, 0.0f };
+    float fovy = 62.3458f;
+    float defocusAngle = 0.0f; // RenderSettings::defocusAngle
+};
+
+// Camera at any frame of keyframes sorted by frame
+// Position and target follow a Catmull-Rom spline through the keyframes, fovy and defocusAngle change linearly
+// Frames before the first or after the last keyframe hold it
+CameraKeyframe sampleCameraPath(const std::vector<CameraKeyframe>& keyframes, int frame);
+
+#endif // CAMERA_PATH_H
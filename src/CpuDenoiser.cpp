@@ -0,0 +1,142 @@
+#include "CpuDenoiser.h"
+#include "raymath.h"
+#include <cmath>
+
+// Every function here has a twin in denoise.frag, both denoisers filter the same way
+// (Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform", with the variance guided weights of SVGF, Schied et al.)
+
+// Demodulated color and the variance of its luminance
+struct DenoisePixel {
+    Vector3 illumination;
+    float variance;
+};
+
+// B3 spline, the a-trous kernel
+static const float kernelWeights[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+static float luminance(Vector3 color) {
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Depth change to a neighbour along the surface, the smaller side so silhouettes don't count
+static float depthGradient(const DenoiseFeatures& features, int width, int height, int x, int row) {
+    const float* depth = features.depth.data();
+    float center = depth[(size_t)row * width + x];
+    float gradient = 0.0f;
+    for (int axis = 0; axis < 2; axis++) {
+        float smallest = INFINITY;
+        for (int side = -1; side <= 1; side += 2) {
+            int nx = axis == 0 ? x + side : x;
+            int nrow = axis == 1 ? row + side : row;
+            if (nx < 0 || nx >= width || nrow < 0 || nrow >= height) continue;
+            smallest = fminf(smallest, fabsf(depth[(size_t)nrow * width + nx] - center));
+        }
+        if (smallest != INFINITY) gradient = fmaxf(gradient, smallest);
+    }
+    return gradient;
+}
+
+// How much pixel q belongs to the surface of pixel p, distance is in pixels
+static float edgeWeight(const DenoiseFeatures& features, size_t p, size_t q, float gradient, float distance) {
+    float normalWeight = powf(fmaxf(Vector3DotProduct(features.normal[p], features.normal[q]), 0.0f), DENOISE_SIGMA_NORMAL);
+    float depthP = features.depth[p];
+    float depthWeight = expf(-fabsf(depthP - features.depth[q]) / (DENOISE_SIGMA_DEPTH * gradient * distance + DENOISE_DEPTH_EPSILON * depthP));
+    return normalWeight * depthWeight;
+}
+
+static bool unfiltered(const DenoiseFeatures& features, size_t p) {
+    return Vector3Equals(features.normal[p], Vector3Zero());
+}
+
+// Divide the albedo out and estimate the variance from the neighbours on the same surface
+static DenoisePixel preparePixel(const std::vector<Vector3>& radiance, const DenoiseFeatures& features, const std::vector<float>& gradients, int width, int height, int x, int row) {
+    size_t p = (size_t)row * width + x;
+    Vector3 illumination = Vector3Divide(radiance[p], features.albedo[p]);
+    if (unfiltered(features, p)) return { illumination, 0.0f };
+
+    float weightSum = 0.0f, mean = 0.0f, meanSquared = 0.0f;
+    for (int dy = -DENOISE_VARIANCE_RADIUS; dy <= DENOISE_VARIANCE_RADIUS; dy++) {
+        for (int dx = -DENOISE_VARIANCE_RADIUS; dx <= DENOISE_VARIANCE_RADIUS; dx++) {
+            int qx = x + dx, qrow = row + dy;
+            if (qx < 0 || qx >= width || qrow < 0 || qrow >= height) continue;
+            size_t q = (size_t)qrow * width + qx;
+            float weight = edgeWeight(features, p, q, gradients[p], sqrtf((float)(dx * dx + dy * dy)));
+            float l = luminance(Vector3Divide(radiance[q], features.albedo[q]));
+            weightSum += weight;
+            mean += weight * l;
+            meanSquared += weight * l * l;
+        }
+    }
+    mean /= weightSum;
+    return { illumination, fmaxf(meanSquared / weightSum - mean * mean, 0.0f) };
+}
+
+// One a-trous pass with taps step pixels apart, the variance is filtered with the squared weights
+static DenoisePixel filterPixel(const std::vector<DenoisePixel>& input, const DenoiseFeatures& features, const std::vector<float>& gradients, int width, int height, int x, int row, int step) {
+    size_t p = (size_t)row * width + x;
+    const DenoisePixel& center = input[p];
+    if (unfiltered(features, p)) return center;
+
+    // The luminance stop uses the variance blurred over 3x3, a single pixel's estimate is noisy itself
+    float blurredVariance = 0.0f, blurWeightSum = 0.0f;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int qx = x + dx, qrow = row + dy;
+            if (qx < 0 || qx >= width || qrow < 0 || qrow >= height) continue;
+            float weight = 0.25f / (float)((1 << abs(dx)) * (1 << abs(dy)));
+            blurredVariance += weight * input[(size_t)qrow * width + qx].variance;
+            blurWeightSum += weight;
+        }
+    }
+    float luminanceScale = DENOISE_SIGMA_LUMINANCE * sqrtf(blurredVariance / blurWeightSum) + 1e-10f;
+    float centerLuminance = luminance(center.illumination);
+
+    Vector3 sum = Vector3Zero();
+    float variance = 0.0f, weightSum = 0.0f;
+    for (int j = -2; j <= 2; j++) {
+        for (int i = -2; i <= 2; i++) {
+            int qx = x + i * step, qrow = row + j * step;
+            if (qx < 0 || qx >= width || qrow < 0 || qrow >= height) continue;
+            size_t q = (size_t)qrow * width + qx;
+            const DenoisePixel& tap = input[q];
+            float weight = kernelWeights[abs(i)] * kernelWeights[abs(j)]
+                * edgeWeight(features, p, q, gradients[p], step * sqrtf((float)(i * i + j * j)))
+                * expf(-fabsf(centerLuminance - luminance(tap.illumination)) / luminanceScale);
+            sum = Vector3Add(sum, Vector3Scale(tap.illumination, weight));
+            variance += weight * weight * tap.variance;
+            weightSum += weight;
+        }
+    }
+    return { Vector3Scale(sum, 1.0f / weightSum), variance / (weightSum * weightSum) };
+}
+
+void denoiseImage(ThreadPool& threadPool, const std::vector<Vector3>& radiance, const DenoiseFeatures& features, int width, int height, std::vector<Vector3>& result) {
+    std::vector<float> gradients((size_t)width * height);
+    std::vector<DenoisePixel> current((size_t)width * height);
+    std::vector<DenoisePixel> next((size_t)width * height);
+
+    threadPool.parallelFor(height, [&](int row, int) {
+        for (int x = 0; x < width; x++) {
+            gradients[(size_t)row * width + x] = depthGradient(features, width, height, x, row);
+        }
+    });
+    threadPool.parallelFor(height, [&](int row, int) {
+        for (int x = 0; x < width; x++) {
+            current[(size_t)row * width + x] = preparePixel(radiance, features, gradients, width, height, x, row);
+        }
+    });
+    for (int iteration = 0; iteration < DENOISE_ITERATIONS; iteration++) {
+        threadPool.parallelFor(height, [&](int row, int) {
+            for (int x = 0; x < width; x++) {
+                next[(size_t)row * width + x] = filterPixel(current, features, gradients, width, height, x, row, 1 << iteration);
+            }
+        });
+        current.swap(next);
+    }
+
+    // Put the albedo back
+    result.resize((size_t)width * height);
+    for (size_t p = 0; p < result.size(); p++) {
+        result[p] = Vector3Multiply(current[p].illumination, features.albedo[p]);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef CPU_DENOISER_H
+#define CPU_DENOISER_H
+
+#include "raylib.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Edge-aware a-trous filter, the same numbers as denoise.frag
+#define DENOISE_ITERATIONS 5 // Passes with taps 1, 2, 4, 8 and 16 pixels apart, together a 125 pixel wide kernel
+#define DENOISE_VARIANCE_RADIUS 2 // The first variance estimate is taken over a 5x5 window
+#define DENOISE_SIGMA_LUMINANCE 4.0f // Luminance differences of this many standard deviations weigh 1/e
+#define DENOISE_SIGMA_NORMAL 128.0f // Exponent of the cosine between two normals
+#define DENOISE_SIGMA_DEPTH 1.0f // Depth differences this many times the one expected along the surface weigh 1/e
+#define DENOISE_DEPTH_EPSILON 0.001f // Relative depth difference always allowed, surfaces facing the camera have no gradient
+
+// First-hit guides of an image, top row first, what the raytracing shader renders with featureOutput
+struct DenoiseFeatures {
+    std::vector<Vector3> albedo; // Color to divide out, the first diffuse surface tinted by the mirrors and glass in front of it
+    std::vector<Vector3> normal; // Zero for the sky and lights, which are not filtered
+    std::vector<float> depth; // Length of the path to the surface
+};
+
+// Filter linear radiance (top row first) guided by the features, on the threads of the pool
+// Noise is estimated from the image itself, so converged images come out nearly unchanged
+void denoiseImage(ThreadPool& threadPool, const std::vector<Vector3>& radiance, const DenoiseFeatures& features, int width, int height, std::vector<Vector3>& result);
+
+#endif // CPU_DENOISER_H
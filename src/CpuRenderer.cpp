@@ -0,0 +1,1521 @@
+#include "CpuRenderer.h"
+#include "ImageStream.h"
+#include "Sampler.h"
+#include "raymath.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Constants, the same values raytracing.frag uses
+static const float infinity = 2147483648.0f; // pow(2.0, 31.0)
+static const float pi = 3.14159265359f;
+static const float smallValue = 1.0f / 4096.0f; // pow(2.0, -12.0)
+
+// Sun settings
+static const Vector3 sunDirection = { 1.0f, 0.6f, 0.5f };
+static const Vector3 sunColor = { 10.0f, 10.0f, 8.0f };
+static const float sunSize = 0.02f;
+// Next-event estimation samples the sun glow inside this cone, further out it is only found by scattered rays
+static const float sunSampleAngle = 0.25f;
+// Falloff of the exponential distribution of the sampled angle, fitted to the glow
+static const float sunSampleFalloff = 0.3f / sunSize;
+
+// Russian roulette, matches raytracing.frag
+static const float rouletteMaxSurvival = 0.95f; // Even bright paths end some time, glass does not absorb anything
+static const int rouletteMaxBounces = 64; // Safety net, paths that survive this many bounces past maxBounces are cut
+
+// Adaptive sampling, matches raytracing.frag
+static const int adaptiveMinSamples = 16; // Fewer samples say too little about the variance
+static const int adaptiveCheckInterval = 4; // Stopping after whole blocks of 4 Sobol points keeps the samples stratified
+static const float adaptiveMinLuminance = 0.01f; // Keeps the relative error finite for black pixels
+
+// Texture footprints of the ray cones
+static const float diffuseConeSpread = 0.2f; // Lambertian bounces scatter everywhere, what they hit next is seen through a wide cone
+static const float minFootprintCosine = 0.1f; // Footprints stretch by 1 / cos towards grazing angles, up to this
+
+// Denoiser guides, matches raytracing.frag
+static const int featureMaxSpecularBounces = 4; // Mirrors and glass followed before the surface is taken as it is
+static const float featureMinAlbedo = 0.01f; // Darker first hits are not divided out, their light would blow up
+
+struct Ray {
+    Vector3 origin;
+    Vector3 direction;
+};
+
+struct HitRecord {
+    float t;
+    Vector3 point;
+    Vector3 normal;
+    bool frontFace;
+    bool hit;
+    int materialIndex;
+    int item; // BVH item of the hit object
+    int triangle; // Triangle of the mesh when the item is an instance
+    Vector2 uv;
+};
+
+// Per-thread state for one render call
+struct TraceContext {
+    const Scene& scene;
+    const CameraView& view;
+    const RenderSettings& settings;
+    const SimdKernels& kernels;
+    const std::vector<PacketQuad>& packetQuads;
+    BvhTraversalStats traversal;
+    uint64_t samples = 0; // Camera samples traced
+};
+
+
+
+
+
+
+// ---------------------------
+// --- Sample Warping ---
+// ---------------------------
+
+// Map a 2D sample to the unit sphere
+static Vector3 sphereSample(Vector2 u) {
+    float z = u.x * 2.0f - 1.0f;
+    float t = u.y * 2.0f * pi;
+    float r = sqrtf(1.0f - z * z);
+    return { r * cosf(t), r * sinf(t), z };
+}
+
+// Map a 2D sample to the unit disk perpendicular to the viewing direction of the camera
+static Vector3 diskSample(const CameraView& view, Vector2 u) {
+    float r = sqrtf(u.x);
+    float t = 2.0f * pi * u.y;
+    Vector3 disk = Vector3Add(Vector3Scale(view.pixelU, cosf(t)), Vector3Scale(view.pixelV, sinf(t)));
+    float length = Vector3Length(disk);
+    return (length > smallValue && length < infinity) ? Vector3Scale(disk, r / length) : Vector3Zero();
+}
+
+// Map a 2D sample to the pixel square [-0.5, 0.5]
+static Vector3 pixelSample(const CameraView& view, Vector2 u) {
+    return Vector3Add(Vector3Scale(view.pixelU, u.x - 0.5f), Vector3Scale(view.pixelV, u.y - 0.5f));
+}
+
+
+
+
+
+
+// ---------------------------
+// --- Collision Detection ---
+// ---------------------------
+
+static bool hitQuad(float alpha, float beta) {
+    return alpha >= 0.0f && alpha <= 1.0f && beta >= 0.0f && beta <= 1.0f;
+}
+
+// Ray Quadrilateral intersection algorithm
+static void hit2DPrimitive(const Ray& ray, HitRecord& record, float tmin, float tmax, const Quad& quad) {
+    Vector3 n = Vector3CrossProduct(quad.edgeU, quad.edgeV);
+    Vector3 normal = Vector3Normalize(n);
+    float D = Vector3DotProduct(normal, quad.origin);
+    Vector3 w = Vector3Scale(n, 1.0f / Vector3DotProduct(n, n));
+
+    // Return if the ray is parallel to the plane of the quad
+    float denominator = Vector3DotProduct(normal, ray.direction);
+    if (fabsf(denominator) < smallValue) return;
+
+    float t = (D - Vector3DotProduct(normal, ray.origin)) / denominator;
+    if (t <= tmin || t >= tmax) return;
+
+    Vector3 intersection = Vector3Add(ray.origin, Vector3Scale(ray.direction, t));
+    Vector3 planarHitPoint = Vector3Subtract(intersection, quad.origin);
+    float alpha = Vector3DotProduct(w, Vector3CrossProduct(planarHitPoint, quad.edgeV));
+    float beta = Vector3DotProduct(w, Vector3CrossProduct(quad.edgeU, planarHitPoint));
+
+    if (hitQuad(alpha, beta)) {
+        record.hit = true;
+        record.t = t;
+        record.point = intersection;
+        record.normal = normal;
+        record.materialIndex = quad.materialIndex;
+        record.frontFace = true;
+        record.uv = { beta, 1.0f - alpha };
+    }
+}
+
+// Ray Sphere intersection algorithm
+static void hitSphere(const Ray& ray, HitRecord& record, float tmin, float tmax, const Sphere& sphere) {
+    Vector3 oc = Vector3Subtract(sphere.center, ray.origin);
+    float a = Vector3DotProduct(ray.direction, ray.direction);
+    float halfb = Vector3DotProduct(ray.direction, oc);
+    float c = Vector3DotProduct(oc, oc) - sphere.radius * sphere.radius;
+    float discriminant = halfb * halfb - a * c;
+    if (discriminant <= 0.0f) return;
+
+    // Find the nearest root
+    float sqrtd = sqrtf(discriminant);
+    float root = (halfb - sqrtd) / a;
+    if (root <= tmin || root >= tmax) {
+        root = (halfb + sqrtd) / a;
+        if (root <= tmin || root >= tmax) return;
+    }
+
+    record.hit = true;
+    record.t = root;
+    record.point = Vector3Add(ray.origin, Vector3Scale(ray.direction, root));
+    record.normal = Vector3Scale(Vector3Subtract(record.point, sphere.center), 1.0f / sphere.radius);
+    record.materialIndex = sphere.materialIndex;
+    record.frontFace = Vector3DotProduct(ray.direction, record.normal) < 0.0f;
+    if (!record.frontFace) {
+        record.normal = Vector3Negate(record.normal); // Flip the normal if the ray is inside the sphere
+    }
+    record.uv = { 0.5f + atan2f(record.normal.z, record.normal.x) / (2.0f * pi), 0.5f - asinf(Clamp(record.normal.y, -1.0f, 1.0f)) / pi };
+}
+
+static float axisValue(Vector3 v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// Per-ray constants of the watertight triangle test (Woop, Benthin and Wald 2013)
+// The ray is turned into +z by permuting the axes and shearing, so neighbouring triangles share exact edge tests
+struct TriangleRay {
+    int kx, ky, kz;
+    float shearX, shearY, shearZ;
+};
+
+static TriangleRay makeTriangleRay(Vector3 direction) {
+    TriangleRay result;
+    Vector3 absolute = { fabsf(direction.x), fabsf(direction.y), fabsf(direction.z) };
+    result.kz = absolute.x > absolute.y ? (absolute.x > absolute.z ? 0 : 2) : (absolute.y > absolute.z ? 1 : 2);
+    result.kx = (result.kz + 1) % 3;
+    result.ky = (result.kx + 1) % 3;
+    // Keep the winding so the sign of the edge functions stays meaningful
+    if (axisValue(direction, result.kz) < 0.0f) {
+        int swap = result.kx;
+        result.kx = result.ky;
+        result.ky = swap;
+    }
+    float dz = axisValue(direction, result.kz);
+    result.shearX = axisValue(direction, result.kx) / dz;
+    result.shearY = axisValue(direction, result.ky) / dz;
+    result.shearZ = 1.0f / dz;
+    return result;
+}
+
+// Watertight ray triangle test, on a hit t and the barycentric weights of the 3 vertices are set
+static bool intersectTriangle(Vector3 origin, const TriangleRay& ray, Vector3 p0, Vector3 p1, Vector3 p2, float tmin, float tmax, float& t, Vector3& weights) {
+    Vector3 a = Vector3Subtract(p0, origin);
+    Vector3 b = Vector3Subtract(p1, origin);
+    Vector3 c = Vector3Subtract(p2, origin);
+    float az = axisValue(a, ray.kz), bz = axisValue(b, ray.kz), cz = axisValue(c, ray.kz);
+    float ax = axisValue(a, ray.kx) - ray.shearX * az, ay = axisValue(a, ray.ky) - ray.shearY * az;
+    float bx = axisValue(b, ray.kx) - ray.shearX * bz, by = axisValue(b, ray.ky) - ray.shearY * bz;
+    float cx = axisValue(c, ray.kx) - ray.shearX * cz, cy = axisValue(c, ray.ky) - ray.shearY * cz;
+
+    // Scaled barycentric coordinates as edge functions
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    // Hits exactly on an edge are decided in double precision, so they are never missed by both triangles
+    if (u == 0.0f || v == 0.0f || w == 0.0f) {
+        u = (float)((double)cx * by - (double)cy * bx);
+        v = (float)((double)ax * cy - (double)ay * cx);
+        w = (float)((double)bx * ay - (double)by * ax);
+    }
+    if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) return false;
+
+    float determinant = u + v + w;
+    if (determinant == 0.0f) return false;
+
+    float scaledT = u * az * ray.shearZ + v * bz * ray.shearZ + w * cz * ray.shearZ;
+    float inverseDeterminant = 1.0f / determinant;
+    t = scaledT * inverseDeterminant;
+    if (t <= tmin || t >= tmax) return false;
+
+    weights = { u * inverseDeterminant, v * inverseDeterminant, w * inverseDeterminant };
+    return true;
+}
+
+// Ray Triangle intersection for mesh triangles
+static void hitTriangle(const Scene& scene, const Ray& ray, const TriangleRay& triangleRay, HitRecord& record, float tmin, float tmax, int triangleIndex) {
+    const Triangle& triangle = scene.triangles[triangleIndex];
+    const MeshVertex& v0 = scene.vertices[triangle.vertices[0]];
+    const MeshVertex& v1 = scene.vertices[triangle.vertices[1]];
+    const MeshVertex& v2 = scene.vertices[triangle.vertices[2]];
+    float t;
+    Vector3 weights;
+    if (!intersectTriangle(ray.origin, triangleRay, v0.position, v1.position, v2.position, tmin, tmax, t, weights)) return;
+
+    record.hit = true;
+    record.t = t;
+    record.point = Vector3Add(ray.origin, Vector3Scale(ray.direction, t));
+    record.normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(v1.position, v0.position), Vector3Subtract(v2.position, v0.position)));
+    record.materialIndex = triangle.materialIndex;
+    record.triangle = triangleIndex;
+    // Meshes are closed surfaces, so the side matters for dielectrics like it does for spheres
+    record.frontFace = Vector3DotProduct(ray.direction, record.normal) < 0.0f;
+    if (!record.frontFace) {
+        record.normal = Vector3Negate(record.normal);
+    }
+    record.uv = {
+        weights.x * v0.uv.x + weights.y * v1.uv.x + weights.z * v2.uv.x,
+        weights.x * v0.uv.y + weights.y * v1.uv.y + weights.z * v2.uv.y
+    };
+}
+
+// Ray mesh intersection through the BVH of the mesh, in the object space of the instance
+// Distances along the ray are the same in both spaces, the direction is scaled along with everything else
+static void hitInstance(const Scene& scene, const Ray& ray, HitRecord& record, float tmin, float tmax, const Instance& instance, BvhTraversalStats& stats) {
+    Quaternion inverseRotation = QuaternionInvert(instance.rotation);
+    float inverseScale = 1.0f / instance.scale;
+    Ray local = {
+        Vector3Scale(Vector3RotateByQuaternion(Vector3Subtract(ray.origin, instance.position), inverseRotation), inverseScale),
+        Vector3Scale(Vector3RotateByQuaternion(ray.direction, inverseRotation), inverseScale)
+    };
+    TriangleRay triangleRay = makeTriangleRay(local.direction);
+
+    bool found = false;
+    float closest = tmax;
+    scene.meshBvh.traverseFrom(scene.meshes[instance.mesh].rootNode, local.origin, local.direction, tmin, closest, stats, [&](int triangle, float& triangleTmax) {
+        hitTriangle(scene, local, triangleRay, record, tmin, triangleTmax, triangle);
+        if (record.hit && record.t < triangleTmax) {
+            found = true;
+            triangleTmax = record.t;
+        }
+    });
+    if (!found) return;
+
+    // Uniform scale keeps normals perpendicular, rotating them back is enough
+    record.point = Vector3Add(ray.origin, Vector3Scale(ray.direction, record.t));
+    record.normal = Vector3Normalize(Vector3RotateByQuaternion(record.normal, instance.rotation));
+}
+
+// Test one BVH item, spheres come first, then quads, then instances
+static void hitItem(const Scene& scene, const Ray& ray, HitRecord& record, float tmin, float tmax, int item, BvhTraversalStats& stats) {
+    int spheresAmount = (int)scene.spheres.size();
+    int quadsEnd = spheresAmount + (int)scene.quads.size();
+    if (item < spheresAmount) {
+        hitSphere(ray, record, tmin, tmax, scene.spheres[item]);
+    } else if (item < quadsEnd) {
+        hit2DPrimitive(ray, record, tmin, tmax, scene.quads[item - spheresAmount]);
+    } else {
+        hitInstance(scene, ray, record, tmin, tmax, scene.instances[item - quadsEnd], stats);
+    }
+    // Only a hit moves record.t below tmax
+    if (record.hit && record.t < tmax) record.item = item;
+}
+
+// Find the closest hit in the scene by walking the BVH
+static void hitScene(TraceContext& context, const Ray& ray, HitRecord& record, float tmin, float tmax) {
+    record.hit = false;
+    record.t = tmax;
+
+    context.scene.bvh.traverse(ray.origin, ray.direction, tmin, record.t, context.traversal, [&](int item, float& closest) {
+        hitItem(context.scene, ray, record, tmin, closest, item, context.traversal);
+        closest = record.t;
+    });
+}
+
+// Find the closest item for every ray of a coherent packet with the SIMD kernels
+// Only t and the item are known afterwards, the full HitRecord is rebuilt per ray
+static void hitScenePacket(TraceContext& context, RayPacket& packet, int activeRays) {
+    const Scene& scene = context.scene;
+    const Bvh& bvh = scene.bvh;
+    const SimdKernels& kernels = context.kernels;
+    int spheresAmount = (int)scene.spheres.size();
+    int quadsEnd = spheresAmount + (int)scene.quads.size();
+    context.traversal.rays += activeRays;
+    if (bvh.empty()) return;
+
+    // Children are ordered by the direction of the first ray, which is close enough for coherent rays
+    Vector3 origin = { packet.originX[0], packet.originY[0], packet.originZ[0] };
+    Vector3 direction = { packet.directionX[0], packet.directionY[0], packet.directionZ[0] };
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        int nodeIndex = stack[--stackSize];
+        const BvhNode& node = bvh.nodes[nodeIndex];
+        context.traversal.nodeVisits++;
+        if (kernels.intersectAabb(packet, node.boundsMin, node.boundsMax) == 0) continue;
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; i++) {
+                int item = bvh.itemIndices[node.leftFirst + i];
+                context.traversal.itemTests++;
+                if (item < spheresAmount) {
+                    kernels.intersectSphere(packet, scene.spheres[item].center, scene.spheres[item].radius, item);
+                } else if (item < quadsEnd) {
+                    kernels.intersectQuad(packet, context.packetQuads[item - spheresAmount], item);
+                } else {
+                    // Instances go one ray at a time through the BVH of their mesh
+                    const Instance& instance = scene.instances[item - quadsEnd];
+                    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                        if (packet.tmax[lane] <= packet.tmin) continue;
+                        Ray ray = { { packet.originX[lane], packet.originY[lane], packet.originZ[lane] }, { packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] } };
+                        HitRecord record;
+                        record.hit = false;
+                        hitInstance(scene, ray, record, packet.tmin, packet.tmax[lane], instance, context.traversal);
+                        if (record.hit) {
+                            packet.tmax[lane] = record.t;
+                            packet.hitItem[lane] = item;
+                        }
+                    }
+                }
+            }
+        } else if (stackSize + 2 <= BVH_STACK_SIZE) {
+            int left = nodeIndex + 1;
+            int right = node.leftFirst;
+            Vector3 leftCenter = Vector3Scale(Vector3Add(bvh.nodes[left].boundsMin, bvh.nodes[left].boundsMax), 0.5f);
+            Vector3 rightCenter = Vector3Scale(Vector3Add(bvh.nodes[right].boundsMin, bvh.nodes[right].boundsMax), 0.5f);
+            bool leftFirst = Vector3DotProduct(Vector3Subtract(leftCenter, origin), direction) <= Vector3DotProduct(Vector3Subtract(rightCenter, origin), direction);
+            stack[stackSize++] = leftFirst ? right : left;
+            stack[stackSize++] = leftFirst ? left : right;
+        }
+    }
+}
+
+
+
+
+
+
+// -----------------
+// --- Materials ---
+// -----------------
+
+// Ray cone of a path (Akenine-Moller et al. 2019), its width where a ray hits picks the texture MIP level there
+struct RayCone {
+    float width; // At the ray origin
+    float spread; // Growth of the width per unit of distance
+};
+
+// Camera rays start as a point and cover their pixel at the image plane, direction is the pixel target minus the origin
+static RayCone cameraCone(const CameraView& view, Vector3 direction) {
+    return { 0.0f, Vector3Length(view.pixelU) / Vector3Length(direction) };
+}
+
+// Widen the cone along the ray up to the hit
+static void coneToHit(RayCone& cone, const Ray& ray, const HitRecord& record) {
+    cone.width += cone.spread * record.t * Vector3Length(ray.direction);
+}
+
+// Rough surfaces widen the cone of the scattered ray, mirrors and glass keep it
+static void scatterCone(RayCone& cone, const Material& material) {
+    cone.spread += material.type == MATERIAL_LAMBERTIAN ? diffuseConeSpread : material.fuzz;
+}
+
+// Change of uv per unit of length on the surface of the hit item, along u and along v
+static Vector2 uvPerLength(const Scene& scene, const HitRecord& record) {
+    int item = record.item;
+    int spheresAmount = (int)scene.spheres.size();
+    int quadsEnd = spheresAmount + (int)scene.quads.size();
+    if (item < spheresAmount) {
+        // u goes around the equator, v from pole to pole
+        float radius = scene.spheres[item].radius;
+        return { 1.0f / (2.0f * pi * radius), 1.0f / (pi * radius) };
+    }
+    if (item < quadsEnd) {
+        // u runs along edgeV and v along edgeU, see hit2DPrimitive()
+        const Quad& quad = scene.quads[item - spheresAmount];
+        return { 1.0f / Vector3Length(quad.edgeV), 1.0f / Vector3Length(quad.edgeU) };
+    }
+    // Triangles map their area in uv to their area in space, taken as the same stretch in both directions
+    // The instance scales the area of its mesh by scale^2
+    float scale = scene.instances[item - quadsEnd].scale;
+    const Triangle& triangle = scene.triangles[record.triangle];
+    const MeshVertex& v0 = scene.vertices[triangle.vertices[0]];
+    const MeshVertex& v1 = scene.vertices[triangle.vertices[1]];
+    const MeshVertex& v2 = scene.vertices[triangle.vertices[2]];
+    float area = Vector3Length(Vector3CrossProduct(Vector3Subtract(v1.position, v0.position), Vector3Subtract(v2.position, v0.position))) * scale * scale;
+    float uvArea = fabsf((v1.uv.x - v0.uv.x) * (v2.uv.y - v0.uv.y) - (v2.uv.x - v0.uv.x) * (v1.uv.y - v0.uv.y));
+    float stretch = area > 0.0f ? sqrtf(uvArea / area) : 0.0f;
+    return { stretch, stretch };
+}
+
+// coneWidth is the width of the ray cone at the hit
+static Vector3 materialColor(const Scene& scene, const HitRecord& record, Vector3 direction, float coneWidth) {
+    const Material& material = scene.materials[record.materialIndex];
+    if (material.textureIndex >= 0) {
+        float cosine = fmaxf(fabsf(Vector3DotProduct(Vector3Normalize(direction), record.normal)), minFootprintCosine);
+        Vector2 perLength = uvPerLength(scene, record);
+        Vector2 footprint = { perLength.x * coneWidth / cosine, perLength.y * coneWidth / cosine };
+        Vector3 textureColor = scene.textureCache->sample(*scene.textures[material.textureIndex].tiles, record.uv, footprint);
+        // Only apply the texture if it isn't black, the same test the shader uses
+        if (Vector3Length(textureColor) > smallValue) return textureColor;
+    }
+    return material.albedo;
+}
+
+static Vector3 skyColor(Vector3 unitDirection) {
+    float t = 0.5f * (unitDirection.y + 1.0f);
+    return Vector3Add(Vector3Scale(Vector3One(), 1.0f - t), Vector3Scale({ 0.2f, 0.4f, 0.9f }, t));
+}
+
+// Angle between the direction and the sun, precise close to the sun unlike acos(dot())
+static float sunAngle(Vector3 unitDirection) {
+    return 2.0f * asinf(fminf(Vector3Length(Vector3Subtract(unitDirection, Vector3Normalize(sunDirection))) * 0.5f, 1.0f));
+}
+
+static float sunEffect(Vector3 unitDirection) {
+    return expf(-powf(sunAngle(unitDirection) / sunSize, 0.8f));
+}
+
+// Determine background color based on the ray direction
+static Vector3 background(Vector3 direction, float backgroundOpacity) {
+    Vector3 unitDirection = Vector3Normalize(direction);
+    Vector3 baseColor = skyColor(unitDirection);
+
+    // Add sun effect
+    Vector3 finalColor = Vector3Lerp(baseColor, sunColor, sunEffect(unitDirection));
+
+    return Vector3Scale(finalColor, backgroundOpacity);
+}
+
+// The share of background() the sun adds, mix(sky, sun, e) = sky + (sun - sky) * e
+static Vector3 sunRadiance(Vector3 unitDirection, float backgroundOpacity) {
+    return Vector3Scale(Vector3Subtract(sunColor, skyColor(unitDirection)), sunEffect(unitDirection) * backgroundOpacity);
+}
+
+// Schlick's approximation for reflectance
+static float reflectance(float cosine, float refractionIndex) {
+    float r0 = (1.0f - refractionIndex) / (1.0f + refractionIndex);
+    r0 = r0 * r0;
+    return r0 + (1.0f - r0) * powf(1.0f - cosine, 5.0f);
+}
+
+// GLSL reflect()
+static Vector3 reflect(Vector3 incident, Vector3 normal) {
+    return Vector3Subtract(incident, Vector3Scale(normal, 2.0f * Vector3DotProduct(normal, incident)));
+}
+
+// GLSL refract()
+static Vector3 refract(Vector3 incident, Vector3 normal, float eta) {
+    float cosI = Vector3DotProduct(normal, incident);
+    float k = 1.0f - eta * eta * (1.0f - cosI * cosI);
+    if (k < 0.0f) return Vector3Zero();
+    return Vector3Subtract(Vector3Scale(incident, eta), Vector3Scale(normal, eta * cosI + sqrtf(k)));
+}
+
+static void lambertian(Ray& ray, const HitRecord& record, Sampler& sampler, int bounce) {
+    ray.direction = Vector3Add(record.normal, sphereSample(sampler.get2D(bounceDimension(bounce, SAMPLER_BOUNCE_BSDF))));
+    // If normal and sphereSample, the vector will be zero and will result in weird behavior
+    if (Vector3Length(ray.direction) < smallValue) {
+        ray.direction = record.normal;
+    }
+}
+
+static void metal(Ray& ray, const HitRecord& record, const Material& material, Sampler& sampler, int bounce) {
+    Vector3 fuzz = sphereSample(sampler.get2D(bounceDimension(bounce, SAMPLER_BOUNCE_BSDF)));
+    ray.direction = Vector3Add(reflect(ray.direction, record.normal), Vector3Scale(fuzz, material.fuzz));
+}
+
+static void dialetric(Ray& ray, const HitRecord& record, const Material& material, Sampler& sampler, int bounce) {
+    float ri = record.frontFace ? (1.0f / material.refractionIndex) : material.refractionIndex;
+    Vector3 unitDirection = Vector3Normalize(ray.direction);
+
+    float cosTheta = fminf(Vector3DotProduct(Vector3Negate(unitDirection), record.normal), 1.0f);
+    float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+    bool cannotRefract = ri * sinTheta > 1.0f;
+
+    // If the ray cannot refract, reflect it
+    if (cannotRefract || reflectance(cosTheta, ri) > sampler.get1D(bounceDimension(bounce, SAMPLER_BOUNCE_CHOICE))) {
+        metal(ray, record, material, sampler, bounce);
+        return;
+    }
+    ray.direction = refract(unitDirection, record.normal, ri);
+}
+
+
+
+
+
+
+// --------------
+// --- Lights ---
+// --------------
+
+// Power heuristic weight of the strategy with pdf a when the other one has pdf b (Veach)
+static float powerHeuristic(float a, float b) {
+    return a * a / (a * a + b * b);
+}
+
+// Orthonormal basis around the unit vector n (Duff et al., "Building an Orthonormal Basis, Revisited")
+static void orthonormalBasis(Vector3 n, Vector3& b1, Vector3& b2) {
+    float s = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (s + n.z);
+    float b = n.x * n.y * a;
+    b1 = { 1.0f + s * n.x * n.x * a, s * b, -s * n.x };
+    b2 = { b, s + n.y * n.y * a, -n.y };
+}
+
+// Unit direction at angle acos(cosTheta) from the unit axis, turned by phi around it
+static Vector3 coneDirection(Vector3 axis, float cosTheta, float phi) {
+    Vector3 b1, b2;
+    orthonormalBasis(axis, b1, b2);
+    float sinTheta = sqrtf(fmaxf(1.0f - cosTheta * cosTheta, 0.0f));
+    Vector3 side = Vector3Add(Vector3Scale(b1, cosf(phi)), Vector3Scale(b2, sinf(phi)));
+    return Vector3Normalize(Vector3Add(Vector3Scale(axis, cosTheta), Vector3Scale(side, sinTheta)));
+}
+
+// Chance that next-event estimation picks the sun, the light list gets the rest
+static float sunPickProbability(const TraceContext& context) {
+    if (context.settings.backgroundOpacity <= 0.0f) return 0.0f;
+    return context.scene.lights.empty() ? 1.0f : 0.5f;
+}
+
+// Direction towards the sun glow, the angle is exponentially distributed inside sunSampleAngle
+static Vector3 sunSample(Vector2 u) {
+    float norm = 1.0f - expf(-sunSampleFalloff * sunSampleAngle);
+    float angle = -logf(1.0f - u.x * norm) / sunSampleFalloff;
+    return coneDirection(Vector3Normalize(sunDirection), cosf(angle), 2.0f * pi * u.y);
+}
+
+// Solid angle pdf of sunSample(), 0 outside the sampled cone
+static float sunPdf(Vector3 unitDirection) {
+    float angle = sunAngle(unitDirection);
+    if (angle >= sunSampleAngle) return 0.0f;
+    float norm = 1.0f - expf(-sunSampleFalloff * sunSampleAngle);
+    return sunSampleFalloff * expf(-sunSampleFalloff * angle) / (norm * 2.0f * pi * fmaxf(sinf(angle), 1e-7f));
+}
+
+// 1 - cos of the half angle of the cone a sphere covers seen from origin, 0 from inside
+static float sphereCone(const Sphere& sphere, Vector3 origin) {
+    Vector3 toCenter = Vector3Subtract(sphere.center, origin);
+    float sinSquared = sphere.radius * sphere.radius / Vector3DotProduct(toCenter, toCenter);
+    if (sinSquared >= 1.0f) return 0.0f;
+    // Written so small spheres far away do not cancel to 0
+    return sinSquared / (1.0f + sqrtf(1.0f - sinSquared));
+}
+
+// Solid angle pdf of next-event estimation reaching lightPoint on item from origin, 0 when it never samples it
+static float lightPdf(const TraceContext& context, int item, Vector3 origin, Vector3 lightPoint) {
+    const Scene& scene = context.scene;
+    int spheresAmount = (int)scene.spheres.size();
+    if (scene.lights.empty() || item >= spheresAmount + (int)scene.quads.size()) return 0.0f;
+    float power = sceneItemPower(scene, item);
+    if (power <= 0.0f) return 0.0f;
+    float pick = (1.0f - sunPickProbability(context)) * power / scene.lightPower;
+
+    if (item < spheresAmount) {
+        float cone = sphereCone(scene.spheres[item], origin);
+        return cone > 0.0f ? pick / (2.0f * pi * cone) : 0.0f;
+    }
+    const Quad& quad = scene.quads[item - spheresAmount];
+    Vector3 n = Vector3CrossProduct(quad.edgeU, quad.edgeV);
+    Vector3 toLight = Vector3Subtract(lightPoint, origin);
+    float distanceSquared = Vector3DotProduct(toLight, toLight);
+    float cosine = fabsf(Vector3DotProduct(n, toLight)) / (Vector3Length(n) * sqrtf(distanceSquared));
+    // Grazing points are skipped by the sampling too
+    return cosine > smallValue ? pick * distanceSquared / (Vector3Length(n) * cosine) : 0.0f;
+}
+
+// Light of the list for a uniform number, the first whose cdf is above it
+static int findLight(const Scene& scene, float u) {
+    auto light = std::upper_bound(scene.lights.begin(), scene.lights.end(), u, [](float value, const SceneLight& l) { return value < l.cdf; });
+    if (light == scene.lights.end()) --light;
+    return light->item;
+}
+
+// Shadow ray of next-event estimation and what it brings if it gets through
+struct ShadowSample {
+    Ray ray;
+    int item; // The light it has to hit first, -1 for the sun, which needs a free way out
+    float weight; // Multiplies the emission: the MIS weight over the pdf, times the cosine over pi of the Lambertian BRDF
+};
+
+// Sample the sun or a light from a Lambertian hit, false when there is nothing to trace
+static bool sampleDirectLight(const TraceContext& context, const HitRecord& record, Sampler& sampler, int bounce, ShadowSample& sample) {
+    const Scene& scene = context.scene;
+    float sunPick = sunPickProbability(context);
+    float pick = sampler.get1D(bounceDimension(bounce, SAMPLER_BOUNCE_LIGHT_CHOICE));
+    Vector2 u = sampler.get2D(bounceDimension(bounce, SAMPLER_BOUNCE_LIGHT));
+    if (!context.settings.nextEventEstimation || (sunPick <= 0.0f && scene.lights.empty())) return false;
+
+    Ray& shadowRay = sample.ray;
+    shadowRay.origin = record.point;
+    float pdf;
+    int item = -1; // The sun
+    if (pick < sunPick) {
+        shadowRay.direction = sunSample(u);
+        pdf = sunPick * sunPdf(shadowRay.direction);
+    } else {
+        item = findLight(scene, fminf((pick - sunPick) / (1.0f - sunPick), 1.0f));
+        Vector3 lightPoint = Vector3Zero(); // Only used for quads
+        int spheresAmount = (int)scene.spheres.size();
+        if (item < spheresAmount) {
+            const Sphere& sphere = scene.spheres[item];
+            float cosTheta = 1.0f - u.x * sphereCone(sphere, record.point);
+            shadowRay.direction = coneDirection(Vector3Normalize(Vector3Subtract(sphere.center, record.point)), cosTheta, 2.0f * pi * u.y);
+        } else {
+            const Quad& quad = scene.quads[item - spheresAmount];
+            lightPoint = Vector3Add(quad.origin, Vector3Add(Vector3Scale(quad.edgeU, u.x), Vector3Scale(quad.edgeV, u.y)));
+            shadowRay.direction = Vector3Subtract(lightPoint, record.point);
+        }
+        pdf = lightPdf(context, item, record.point, lightPoint);
+    }
+
+    float cosine = Vector3DotProduct(record.normal, Vector3Normalize(shadowRay.direction));
+    if (pdf <= 0.0f || cosine <= 0.0f) return false;
+
+    float scatterPdf = cosine / pi;
+    sample.item = item;
+    sample.weight = scatterPdf * powerHeuristic(pdf, scatterPdf) / pdf;
+    return true;
+}
+
+// Light a traced shadow ray brings, the sun needs a free way out and a light has to be the nearest hit
+static Vector3 shadowRadiance(const TraceContext& context, const ShadowSample& sample, const HitRecord& shadow) {
+    Vector3 emission;
+    if (sample.item < 0) {
+        if (shadow.hit) return Vector3Zero();
+        emission = sunRadiance(Vector3Normalize(sample.ray.direction), context.settings.backgroundOpacity);
+    } else {
+        if (!shadow.hit || shadow.item != sample.item) return Vector3Zero();
+        emission = context.scene.materials[shadow.materialIndex].emmisiveColor;
+    }
+    return Vector3Scale(emission, sample.weight);
+}
+
+// Next-event estimation at a Lambertian hit: the light of a sampled sun or light direction that is not blocked,
+// weighted against finding it by scattering and multiplied by the cosine over pi of the Lambertian BRDF
+static Vector3 directLight(TraceContext& context, const HitRecord& record, Sampler& sampler, int bounce) {
+    ShadowSample sample;
+    if (!sampleDirectLight(context, record, sampler, bounce, sample)) return Vector3Zero();
+    HitRecord shadow;
+    hitScene(context, sample.ray, shadow, smallValue, infinity);
+    return shadowRadiance(context, sample, shadow);
+}
+
+// Weight of emission a scattered ray hit, next-event estimation from the previous hit may have sampled it too
+// scatterPdf is 0 for camera rays and mirror-like bounces, which next-event estimation cannot stand in for
+static float emissionWeight(const TraceContext& context, const HitRecord& record, Vector3 previousPoint, float scatterPdf) {
+    if (scatterPdf <= 0.0f || !context.settings.nextEventEstimation) return 1.0f;
+    return powerHeuristic(scatterPdf, lightPdf(context, record.item, previousPoint, record.point));
+}
+
+// Background seen by a scattered ray, the sun glow weighted against next-event estimation
+static Vector3 missRadiance(const TraceContext& context, Vector3 direction, float scatterPdf) {
+    float backgroundOpacity = context.settings.backgroundOpacity;
+    if (scatterPdf <= 0.0f || !context.settings.nextEventEstimation) return background(direction, backgroundOpacity);
+    Vector3 unitDirection = Vector3Normalize(direction);
+    float weight = powerHeuristic(scatterPdf, sunPickProbability(context) * sunPdf(unitDirection));
+    return Vector3Add(Vector3Scale(skyColor(unitDirection), backgroundOpacity), Vector3Scale(sunRadiance(unitDirection, backgroundOpacity), weight));
+}
+
+
+
+
+
+
+// -------------------
+// --- Ray Tracing ---
+// -------------------
+
+// ray is a camera ray, primaryHit, when given, is its already known first hit
+static Vector3 rayColor(TraceContext& context, Ray ray, Sampler& sampler, const HitRecord* primaryHit = nullptr) {
+    Vector3 color = Vector3One(); // Product of the surface colors so far
+    Vector3 radiance = Vector3Zero();
+    float scatterPdf = 0.0f; // Solid angle pdf of the last Lambertian bounce, 0 for the camera ray and mirror-like bounces
+    RayCone cone = cameraCone(context.view, ray.direction);
+    HitRecord record;
+
+    // Every path gets maxBounces bounces, after that Russian roulette ends it
+    for (int bounce = 0; bounce <= context.settings.maxBounces + rouletteMaxBounces; bounce++) {
+        if (bounce == 0 && primaryHit) {
+            record = *primaryHit;
+        } else {
+            hitScene(context, ray, record, smallValue, infinity);
+        }
+
+        // If nothing was hit, add the background color
+        if (!record.hit) {
+            radiance = Vector3Add(radiance, Vector3Multiply(color, missRadiance(context, ray.direction, scatterPdf)));
+            break;
+        }
+
+        // Light emitted by the hit object, ray.origin is still the previous hit
+        const Material& material = context.scene.materials[record.materialIndex];
+        if (material.emmisiveColor.x != 0.0f || material.emmisiveColor.y != 0.0f || material.emmisiveColor.z != 0.0f) {
+            float weight = emissionWeight(context, record, ray.origin, scatterPdf);
+            radiance = Vector3Add(radiance, Vector3Multiply(color, Vector3Scale(material.emmisiveColor, weight)));
+        }
+
+        // Surface color, textures are sampled at the MIP level of the cone's footprint
+        coneToHit(cone, ray, record);
+        Vector3 surface = materialColor(context.scene, record, ray.direction, cone.width);
+
+        // Light reaching a Lambertian surface straight from the sun or a light
+        if (material.type == MATERIAL_LAMBERTIAN) {
+            radiance = Vector3Add(radiance, Vector3Multiply(Vector3Multiply(color, surface), directLight(context, record, sampler, bounce)));
+        }
+
+        // Move the ray to the hit point and update the color
+        ray.origin = record.point;
+        color = Vector3Multiply(color, surface);
+
+        scatterPdf = 0.0f;
+        scatterCone(cone, material);
+        if (material.type == MATERIAL_LAMBERTIAN) {
+            lambertian(ray, record, sampler, bounce);
+            scatterPdf = Vector3DotProduct(record.normal, Vector3Normalize(ray.direction)) / pi;
+        } else if (material.type == MATERIAL_METAL) {
+            metal(ray, record, material, sampler, bounce);
+        } else if (material.type == MATERIAL_DIELECTRIC) {
+            dialetric(ray, record, material, sampler, bounce);
+        }
+
+        // Russian roulette, surviving paths are weighted up so the mean stays the same
+        if (bounce >= context.settings.maxBounces) {
+            if (!context.settings.russianRoulette) break;
+            float survival = fminf(fmaxf(color.x, fmaxf(color.y, color.z)), rouletteMaxSurvival);
+            if (sampler.get1D(bounceDimension(bounce, SAMPLER_BOUNCE_ROULETTE)) >= survival) break;
+            color = Vector3Scale(color, 1.0f / survival);
+        }
+    }
+
+    return radiance;
+}
+
+static int sampleCountOf(const RenderSettings& settings) {
+    return settings.samples < 1 ? 1 : settings.samples;
+}
+
+// Generate the camera ray of the sampler's current sample for the pixel x, y (gl_FragCoord, origin bottom left)
+static Ray cameraRay(const TraceContext& context, int x, int y, Sampler& sampler) {
+    const CameraView& view = context.view;
+    Vector3 pixelCenter = Vector3Add(view.pixel00, Vector3Add(Vector3Scale(view.pixelU, x + 0.5f), Vector3Scale(view.pixelV, y + 0.5f)));
+
+    Ray ray;
+    ray.origin = view.cameraCenter;
+    if (context.settings.defocusAngle > 0.0f) {
+        ray.origin = Vector3Add(ray.origin, Vector3Scale(diskSample(view, sampler.get2D(SAMPLER_DIMENSION_LENS)), context.settings.defocusAngle));
+    }
+    // The pixel sample is used for antialiasing
+    Vector3 target = Vector3Add(pixelCenter, pixelSample(view, sampler.get2D(SAMPLER_DIMENSION_PIXEL)));
+    ray.direction = Vector3Subtract(target, ray.origin);
+    return ray;
+}
+
+// Running mean and variance of the luminance of one pixel (Welford)
+struct PixelVariance {
+    int count = 0;
+    float mean = 0.0f;
+    float m2 = 0.0f;
+
+    void add(Vector3 color) {
+        float luminance = 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+        count++;
+        float delta = luminance - mean;
+        mean += delta / count;
+        m2 += delta * (luminance - mean);
+    }
+
+    // Standard error of the mean below noiseTarget times the mean
+    bool converged(float noiseTarget) const {
+        if (count < adaptiveMinSamples) return false;
+        float meanVariance = m2 / ((float)count * (count - 1));
+        return sqrtf(meanVariance) <= noiseTarget * fmaxf(mean, adaptiveMinLuminance);
+    }
+};
+
+// Adaptive sampling only checks after complete blocks of adaptiveCheckInterval samples
+static bool canStopSampling(const RenderSettings& settings, int sampleCount, const PixelVariance& variance) {
+    return settings.noiseTarget > 0.0f && sampleCount % adaptiveCheckInterval == 0 && variance.converged(settings.noiseTarget);
+}
+
+// Trace the samples of one pixel, one ray at a time
+static Vector3 renderPixel(TraceContext& context, int x, int y) {
+    int sampleCount = sampleCountOf(context.settings);
+    Sampler sampler(context.settings.sampler, pixelSeed(x, y));
+    Vector3 color = Vector3Zero();
+    PixelVariance variance;
+
+    int k = 0;
+    while (k < sampleCount) {
+        sampler.startSample((uint32_t)(context.settings.sampleOffset + k));
+        Ray ray = cameraRay(context, x, y, sampler);
+        Vector3 sample = rayColor(context, ray, sampler);
+        color = Vector3Add(color, sample);
+        variance.add(sample);
+        k++;
+        if (canStopSampling(context.settings, k, variance)) break;
+    }
+    context.samples += k;
+
+    return Vector3Scale(color, 1.0f / k);
+}
+
+// Trace a PACKET_BLOCK_SIZE x PACKET_BLOCK_SIZE block of pixels whose top left image pixel is (blockX, blockRow)
+// The primary rays of each sample index form one packet, bounces are traced one ray at a time
+// Pixels that converge leave the packet, the block is done once all have
+static void renderPixelBlock(TraceContext& context, int blockX, int blockRow, int width, int height, std::vector<Vector3>& radiance) {
+    int sampleCount = sampleCountOf(context.settings);
+
+    Sampler samplers[RAY_PACKET_SIZE];
+    Vector3 color[RAY_PACKET_SIZE];
+    PixelVariance variance[RAY_PACKET_SIZE];
+    Ray rays[RAY_PACKET_SIZE];
+    bool active[RAY_PACKET_SIZE];
+    bool inside[RAY_PACKET_SIZE];
+    int activeRays = 0;
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        int x = blockX + lane % PACKET_BLOCK_SIZE;
+        int row = blockRow + lane / PACKET_BLOCK_SIZE;
+        inside[lane] = x < width && row < height;
+        active[lane] = inside[lane];
+        samplers[lane] = Sampler(context.settings.sampler, pixelSeed(x, height - 1 - row));
+        color[lane] = Vector3Zero();
+        if (active[lane]) activeRays++;
+    }
+
+    RayPacket packet;
+    packet.tmin = smallValue;
+    for (int k = 0; k < sampleCount && activeRays > 0; k++) {
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            int x = blockX + lane % PACKET_BLOCK_SIZE;
+            int y = height - 1 - (blockRow + lane / PACKET_BLOCK_SIZE);
+            samplers[lane].startSample((uint32_t)(context.settings.sampleOffset + k));
+            rays[lane] = active[lane] ? cameraRay(context, x, y, samplers[lane]) : Ray{ context.view.cameraCenter, { 0.0f, 0.0f, -1.0f } };
+            packet.originX[lane] = rays[lane].origin.x;
+            packet.originY[lane] = rays[lane].origin.y;
+            packet.originZ[lane] = rays[lane].origin.z;
+            packet.directionX[lane] = rays[lane].direction.x;
+            packet.directionY[lane] = rays[lane].direction.y;
+            packet.directionZ[lane] = rays[lane].direction.z;
+            packet.tmax[lane] = active[lane] ? infinity : -1.0f;
+            packet.hitItem[lane] = -1;
+        }
+        finishRayPacket(packet);
+        hitScenePacket(context, packet, activeRays);
+        context.samples += activeRays;
+
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            if (!active[lane]) continue;
+
+            HitRecord primaryHit;
+            primaryHit.hit = false;
+            primaryHit.t = infinity;
+            if (packet.hitItem[lane] >= 0) {
+                hitItem(context.scene, rays[lane], primaryHit, smallValue, infinity, packet.hitItem[lane], context.traversal);
+                // The scalar test disagreed by rounding, trace the ray again on its own
+                if (!primaryHit.hit) hitScene(context, rays[lane], primaryHit, smallValue, infinity);
+            }
+            Vector3 sample = rayColor(context, rays[lane], samplers[lane], &primaryHit);
+            color[lane] = Vector3Add(color[lane], sample);
+            variance[lane].add(sample);
+            if (canStopSampling(context.settings, k + 1, variance[lane])) {
+                active[lane] = false;
+                activeRays--;
+            }
+        }
+    }
+
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (inside[lane]) {
+            radiance[(size_t)(blockRow + lane / PACKET_BLOCK_SIZE) * width + blockX + lane % PACKET_BLOCK_SIZE] = Vector3Scale(color[lane], 1.0f / variance[lane].count);
+        }
+    }
+}
+
+
+
+
+
+
+// -----------------
+// --- Wavefront ---
+// -----------------
+
+// Instead of tracing one path to the end, a tile traces all its paths one bounce at a time in stages:
+// ray generation, intersection, shading per material and shadow rays, connected by queues of rays
+// Between bounces the queue is compacted and sorted by direction octant, so neighbouring rays go the same way,
+// and the hits are grouped by material, so each shading stage runs one branch-free loop
+// Every path draws the same sample values in the same order as rayColor(), so the image is the same
+
+// Rays in structure of arrays layout, entry i continues the path of pixel path[i]
+struct RayQueue {
+    std::vector<int> path;
+    std::vector<float> originX, originY, originZ;
+    std::vector<float> directionX, directionY, directionZ;
+
+    size_t size() const { return path.size(); }
+
+    void clear() {
+        path.clear();
+        originX.clear(); originY.clear(); originZ.clear();
+        directionX.clear(); directionY.clear(); directionZ.clear();
+    }
+
+    void push(int pathIndex, const Ray& ray) {
+        path.push_back(pathIndex);
+        originX.push_back(ray.origin.x); originY.push_back(ray.origin.y); originZ.push_back(ray.origin.z);
+        directionX.push_back(ray.direction.x); directionY.push_back(ray.direction.y); directionZ.push_back(ray.direction.z);
+    }
+
+    Ray ray(size_t i) const {
+        return { { originX[i], originY[i], originZ[i] }, { directionX[i], directionY[i], directionZ[i] } };
+    }
+};
+
+// Shadow rays of next-event estimation, with what they bring if they get through
+struct ShadowQueue {
+    RayQueue rays;
+    std::vector<int> item; // ShadowSample::item
+    std::vector<float> weight; // ShadowSample::weight
+    std::vector<Vector3> scale; // Path color times the surface color, what rayColor() multiplies directLight() with
+
+    void clear() {
+        rays.clear();
+        item.clear();
+        weight.clear();
+        scale.clear();
+    }
+};
+
+// Per-thread buffers of the wavefront, kept across tiles so they are only allocated once
+struct WavefrontState {
+    // Paths, one per pixel of the tile
+    std::vector<Sampler> samplers;
+    std::vector<Vector3> color; // Product of the surface colors so far, like rayColor()
+    std::vector<Vector3> pathRadiance; // Light the current sample gathered so far
+    std::vector<float> scatterPdf; // Solid angle pdf of the last Lambertian bounce
+    std::vector<RayCone> cone;
+    // Pixels
+    std::vector<Vector3> pixelSum;
+    std::vector<PixelVariance> variance;
+    std::vector<char> active;
+
+    RayQueue queue; // Rays of the current bounce, sorted by octant
+    RayQueue next; // Rays of the next bounce, unsorted
+    std::vector<HitRecord> hits; // Closest hit of every queue entry
+    std::vector<int> order; // Queue entries grouped by material
+    ShadowQueue shadows;
+    std::vector<HitRecord> shadowHits;
+};
+
+// Sign bits of the direction, rays of one octant traverse the BVH in the same child order
+static int directionOctant(float x, float y, float z) {
+    return (x < 0.0f ? 1 : 0) | (y < 0.0f ? 2 : 0) | (z < 0.0f ? 4 : 0);
+}
+
+// Closest hit of every ray in the queue
+// With packet tracing, runs of RAY_PACKET_SIZE rays go through the SIMD kernels together, sorted queues keep them coherent
+// Instances are tested one lane at a time, so packets of bounced rays only pay off in scenes without meshes
+static void intersectQueue(TraceContext& context, const RayQueue& queue, std::vector<HitRecord>& hits, bool cameraRays) {
+    hits.resize(queue.size());
+    if (!context.settings.packetTracing || !(cameraRays || context.scene.instances.empty())) {
+        for (size_t i = 0; i < queue.size(); i++) {
+            hitScene(context, queue.ray(i), hits[i], smallValue, infinity);
+        }
+        return;
+    }
+
+    RayPacket packet;
+    packet.tmin = smallValue;
+    for (size_t first = 0; first < queue.size(); first += RAY_PACKET_SIZE) {
+        int activeRays = (int)std::min((size_t)RAY_PACKET_SIZE, queue.size() - first);
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            // Lanes past the end of the queue are inactive copies of the first ray
+            size_t i = lane < activeRays ? first + lane : first;
+            packet.originX[lane] = queue.originX[i];
+            packet.originY[lane] = queue.originY[i];
+            packet.originZ[lane] = queue.originZ[i];
+            packet.directionX[lane] = queue.directionX[i];
+            packet.directionY[lane] = queue.directionY[i];
+            packet.directionZ[lane] = queue.directionZ[i];
+            packet.tmax[lane] = lane < activeRays ? infinity : -1.0f;
+            packet.hitItem[lane] = -1;
+        }
+        finishRayPacket(packet);
+        hitScenePacket(context, packet, activeRays);
+
+        for (int lane = 0; lane < activeRays; lane++) {
+            HitRecord& hit = hits[first + lane];
+            Ray ray = queue.ray(first + lane);
+            hit.hit = false;
+            hit.t = infinity;
+            if (packet.hitItem[lane] < 0) continue;
+            hitItem(context.scene, ray, hit, smallValue, infinity, packet.hitItem[lane], context.traversal);
+            // The scalar test disagreed by rounding, trace the ray again on its own
+            if (!hit.hit) hitScene(context, ray, hit, smallValue, infinity);
+        }
+    }
+}
+
+// Entries of the queue grouped by what was hit: misses first, then one group per material type
+// The counting sort is stable, so every group keeps the octant order of the queue
+static void groupByMaterial(const TraceContext& context, const std::vector<HitRecord>& hits, std::vector<int>& order, int groupStart[5]) {
+    static_assert(MATERIAL_TYPE_COUNT == 3, "One group per material type and one for misses");
+    int counts[4] = { 0, 0, 0, 0 };
+    std::vector<unsigned char> keys(hits.size());
+    for (size_t i = 0; i < hits.size(); i++) {
+        int type = hits[i].hit ? context.scene.materials[hits[i].materialIndex].type : -1;
+        // The loader rejects other types, one that gets through anyway is grouped with the misses instead of writing past counts
+        keys[i] = type >= 0 && type < MATERIAL_TYPE_COUNT ? (unsigned char)(1 + type) : 0;
+        counts[keys[i]]++;
+    }
+    groupStart[0] = 0;
+    for (int key = 0; key < 4; key++) {
+        groupStart[key + 1] = groupStart[key] + counts[key];
+    }
+    int position[4] = { groupStart[0], groupStart[1], groupStart[2], groupStart[3] };
+    order.resize(hits.size());
+    for (size_t i = 0; i < hits.size(); i++) {
+        order[position[keys[i]]++] = (int)i;
+    }
+}
+
+// Move the surviving rays of the next bounce into the queue, sorted by direction octant
+static void compactByOctant(const RayQueue& next, RayQueue& queue) {
+    int counts[8] = { 0 };
+    std::vector<unsigned char> octants(next.size());
+    for (size_t i = 0; i < next.size(); i++) {
+        octants[i] = (unsigned char)directionOctant(next.directionX[i], next.directionY[i], next.directionZ[i]);
+        counts[octants[i]]++;
+    }
+    int position[8];
+    int start = 0;
+    for (int octant = 0; octant < 8; octant++) {
+        position[octant] = start;
+        start += counts[octant];
+    }
+
+    size_t size = next.size();
+    queue.path.resize(size);
+    queue.originX.resize(size); queue.originY.resize(size); queue.originZ.resize(size);
+    queue.directionX.resize(size); queue.directionY.resize(size); queue.directionZ.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        int to = position[octants[i]]++;
+        queue.path[to] = next.path[i];
+        queue.originX[to] = next.originX[i];
+        queue.originY[to] = next.originY[i];
+        queue.originZ[to] = next.originZ[i];
+        queue.directionX[to] = next.directionX[i];
+        queue.directionY[to] = next.directionY[i];
+        queue.directionZ[to] = next.directionZ[i];
+    }
+}
+
+// Light emitted by the hit object, weighted against next-event estimation from the previous hit
+static void addEmission(const TraceContext& context, WavefrontState& state, int path, const Ray& ray, const HitRecord& hit) {
+    Vector3 emission = context.scene.materials[hit.materialIndex].emmisiveColor;
+    if (emission.x == 0.0f && emission.y == 0.0f && emission.z == 0.0f) return;
+    float weight = emissionWeight(context, hit, ray.origin, state.scatterPdf[path]);
+    state.pathRadiance[path] = Vector3Add(state.pathRadiance[path], Vector3Multiply(state.color[path], Vector3Scale(emission, weight)));
+}
+
+// Russian roulette past maxBounces, a surviving ray goes to the next bounce
+static void continuePath(const TraceContext& context, WavefrontState& state, int path, const Ray& ray, int bounce) {
+    if (bounce >= context.settings.maxBounces) {
+        if (!context.settings.russianRoulette) return;
+        Vector3& color = state.color[path];
+        float survival = fminf(fmaxf(color.x, fmaxf(color.y, color.z)), rouletteMaxSurvival);
+        if (state.samplers[path].get1D(bounceDimension(bounce, SAMPLER_BOUNCE_ROULETTE)) >= survival) return;
+        color = Vector3Scale(color, 1.0f / survival);
+    }
+    state.next.push(path, ray);
+}
+
+static void shadeMisses(const TraceContext& context, WavefrontState& state, int begin, int end) {
+    for (int k = begin; k < end; k++) {
+        int i = state.order[k];
+        int path = state.queue.path[i];
+        Vector3 direction = { state.queue.directionX[i], state.queue.directionY[i], state.queue.directionZ[i] };
+        Vector3 background = missRadiance(context, direction, state.scatterPdf[path]);
+        state.pathRadiance[path] = Vector3Add(state.pathRadiance[path], Vector3Multiply(state.color[path], background));
+    }
+}
+
+// Lambertian hits queue a shadow ray and scatter
+static void shadeLambertian(const TraceContext& context, WavefrontState& state, int begin, int end, int bounce) {
+    for (int k = begin; k < end; k++) {
+        int i = state.order[k];
+        int path = state.queue.path[i];
+        const HitRecord& hit = state.hits[i];
+        Ray ray = state.queue.ray(i);
+        Sampler& sampler = state.samplers[path];
+        addEmission(context, state, path, ray, hit);
+
+        coneToHit(state.cone[path], ray, hit);
+        Vector3 surface = materialColor(context.scene, hit, ray.direction, state.cone[path].width);
+        ShadowSample sample;
+        if (sampleDirectLight(context, hit, sampler, bounce, sample)) {
+            state.shadows.rays.push(path, sample.ray);
+            state.shadows.item.push_back(sample.item);
+            state.shadows.weight.push_back(sample.weight);
+            state.shadows.scale.push_back(Vector3Multiply(state.color[path], surface));
+        }
+
+        ray.origin = hit.point;
+        state.color[path] = Vector3Multiply(state.color[path], surface);
+        scatterCone(state.cone[path], context.scene.materials[hit.materialIndex]);
+        lambertian(ray, hit, sampler, bounce);
+        state.scatterPdf[path] = Vector3DotProduct(hit.normal, Vector3Normalize(ray.direction)) / pi;
+        continuePath(context, state, path, ray, bounce);
+    }
+}
+
+// Metal and glass scatter without next-event estimation
+static void shadeSpecular(const TraceContext& context, WavefrontState& state, int begin, int end, int bounce, int type) {
+    for (int k = begin; k < end; k++) {
+        int i = state.order[k];
+        int path = state.queue.path[i];
+        const HitRecord& hit = state.hits[i];
+        const Material& material = context.scene.materials[hit.materialIndex];
+        Ray ray = state.queue.ray(i);
+        Sampler& sampler = state.samplers[path];
+        addEmission(context, state, path, ray, hit);
+
+        coneToHit(state.cone[path], ray, hit);
+        Vector3 surface = materialColor(context.scene, hit, ray.direction, state.cone[path].width);
+        ray.origin = hit.point;
+        state.color[path] = Vector3Multiply(state.color[path], surface);
+        scatterCone(state.cone[path], material);
+        if (type == MATERIAL_METAL) {
+            metal(ray, hit, material, sampler, bounce);
+        } else {
+            dialetric(ray, hit, material, sampler, bounce);
+        }
+        state.scatterPdf[path] = 0.0f;
+        continuePath(context, state, path, ray, bounce);
+    }
+}
+
+// Trace the shadow rays of a bounce and add the light that got through
+static void traceShadows(TraceContext& context, WavefrontState& state) {
+    ShadowQueue& shadows = state.shadows;
+    intersectQueue(context, shadows.rays, state.shadowHits, false);
+    for (size_t i = 0; i < shadows.rays.size(); i++) {
+        ShadowSample sample = { shadows.rays.ray(i), shadows.item[i], shadows.weight[i] };
+        Vector3 light = shadowRadiance(context, sample, state.shadowHits[i]);
+        int path = shadows.rays.path[i];
+        state.pathRadiance[path] = Vector3Add(state.pathRadiance[path], Vector3Multiply(shadows.scale[i], light));
+    }
+}
+
+// Trace every sample of a tile as a wavefront, the result is what renderPixel() gives for each pixel
+static void renderTileWavefront(TraceContext& context, WavefrontState& state, const Tile& tile, int width, int height, std::vector<Vector3>& radiance) {
+    const RenderSettings& settings = context.settings;
+    int sampleCount = sampleCountOf(settings);
+    int pixels = tile.width * tile.height;
+    state.samplers.resize(pixels);
+    state.color.resize(pixels);
+    state.pathRadiance.resize(pixels);
+    state.scatterPdf.resize(pixels);
+    state.cone.resize(pixels);
+    state.pixelSum.assign(pixels, Vector3Zero());
+    state.variance.assign(pixels, PixelVariance());
+    state.active.assign(pixels, 1);
+    for (int path = 0; path < pixels; path++) {
+        int x = tile.x + path % tile.width;
+        int y = height - 1 - (tile.y + path / tile.width);
+        state.samplers[path] = Sampler(settings.sampler, pixelSeed(x, y));
+    }
+
+    int activePixels = pixels;
+    for (int k = 0; k < sampleCount && activePixels > 0; k++) {
+        // Ray generation, PACKET_BLOCK_SIZE^2 blocks of pixels after each other so packets of camera rays are compact
+        state.queue.clear();
+        for (int blockRow = 0; blockRow < tile.height; blockRow += PACKET_BLOCK_SIZE) {
+            for (int blockX = 0; blockX < tile.width; blockX += PACKET_BLOCK_SIZE) {
+                for (int lane = 0; lane < PACKET_BLOCK_SIZE * PACKET_BLOCK_SIZE; lane++) {
+                    int tileX = blockX + lane % PACKET_BLOCK_SIZE;
+                    int tileRow = blockRow + lane / PACKET_BLOCK_SIZE;
+                    if (tileX >= tile.width || tileRow >= tile.height) continue;
+                    int path = tileRow * tile.width + tileX;
+                    if (!state.active[path]) continue;
+                    state.samplers[path].startSample((uint32_t)(settings.sampleOffset + k));
+                    state.color[path] = Vector3One();
+                    state.pathRadiance[path] = Vector3Zero();
+                    state.scatterPdf[path] = 0.0f;
+                    Ray ray = cameraRay(context, tile.x + tileX, height - 1 - (tile.y + tileRow), state.samplers[path]);
+                    state.cone[path] = cameraCone(context.view, ray.direction);
+                    state.queue.push(path, ray);
+                }
+            }
+        }
+        context.samples += state.queue.size();
+
+        // Every path gets maxBounces bounces, after that Russian roulette ends it
+        for (int bounce = 0; bounce <= settings.maxBounces + rouletteMaxBounces && state.queue.size() > 0; bounce++) {
+            intersectQueue(context, state.queue, state.hits, bounce == 0);
+            int groupStart[5];
+            groupByMaterial(context, state.hits, state.order, groupStart);
+
+            state.next.clear();
+            state.shadows.clear();
+            shadeMisses(context, state, groupStart[0], groupStart[1]);
+            shadeLambertian(context, state, groupStart[1 + MATERIAL_LAMBERTIAN], groupStart[2 + MATERIAL_LAMBERTIAN], bounce);
+            shadeSpecular(context, state, groupStart[1 + MATERIAL_METAL], groupStart[2 + MATERIAL_METAL], bounce, MATERIAL_METAL);
+            shadeSpecular(context, state, groupStart[1 + MATERIAL_DIELECTRIC], groupStart[2 + MATERIAL_DIELECTRIC], bounce, MATERIAL_DIELECTRIC);
+            traceShadows(context, state);
+
+            compactByOctant(state.next, state.queue);
+        }
+
+        for (int path = 0; path < pixels; path++) {
+            if (!state.active[path]) continue;
+            state.pixelSum[path] = Vector3Add(state.pixelSum[path], state.pathRadiance[path]);
+            state.variance[path].add(state.pathRadiance[path]);
+            if (canStopSampling(settings, k + 1, state.variance[path])) {
+                state.active[path] = 0;
+                activePixels--;
+            }
+        }
+    }
+
+    for (int path = 0; path < pixels; path++) {
+        size_t pixel = (size_t)(tile.y + path / tile.width) * width + tile.x + path % tile.width;
+        radiance[pixel] = Vector3Scale(state.pixelSum[path], 1.0f / state.variance[path].count);
+    }
+}
+
+
+
+
+
+
+// -----------------------
+// --- Denoiser Guides ---
+// -----------------------
+
+// The first surface along the ray that is not a mirror or glass, seen through them and tinted by them
+// Glass is followed along the refracted ray unless it reflects totally, the twin of firstHitFeatures() in raytracing.frag
+static void firstHitFeatures(TraceContext& context, Ray ray, Vector3& albedo, Vector3& normal, float& depth) {
+    albedo = { 1.0f, 1.0f, 1.0f };
+    normal = Vector3Zero();
+    depth = 0.0f;
+    // Mirrors and glass keep the spread of the cone, its width is the spread times the distance so far
+    float coneSpread = cameraCone(context.view, ray.direction).spread;
+    for (int bounce = 0; bounce <= featureMaxSpecularBounces; bounce++) {
+        HitRecord record;
+        hitScene(context, ray, record, smallValue, infinity);
+        if (!record.hit) {
+            depth = infinity; // The sky, its normal stays zero
+            break;
+        }
+        depth += record.t * Vector3Length(ray.direction);
+        albedo = Vector3Multiply(albedo, materialColor(context.scene, record, ray.direction, coneSpread * depth));
+        const Material& material = context.scene.materials[record.materialIndex];
+        if (material.type == MATERIAL_LAMBERTIAN || bounce == featureMaxSpecularBounces) {
+            // Lights seen directly have no noise, they are kept out of the filter like the sky
+            normal = Vector3Equals(material.emmisiveColor, Vector3Zero()) ? record.normal : Vector3Zero();
+            break;
+        }
+        ray.origin = record.point;
+        if (material.type == MATERIAL_METAL) {
+            ray.direction = reflect(ray.direction, record.normal);
+            continue;
+        }
+        float ri = record.frontFace ? (1.0f / material.refractionIndex) : material.refractionIndex;
+        Vector3 refracted = refract(Vector3Normalize(ray.direction), record.normal, ri);
+        ray.direction = Vector3Equals(refracted, Vector3Zero()) ? reflect(ray.direction, record.normal) : refracted;
+    }
+
+    // The denoiser divides the albedo out, black surfaces (like lights) are left alone
+    float luminance = 0.2126f * albedo.x + 0.7152f * albedo.y + 0.0722f * albedo.z;
+    albedo = luminance < featureMinAlbedo ? Vector3{ 1.0f, 1.0f, 1.0f } : Vector3Max(albedo, { featureMinAlbedo, featureMinAlbedo, featureMinAlbedo });
+}
+
+
+
+
+
+
+// -------------------
+// --- CpuRenderer ---
+// -------------------
+
+CpuRenderer::CpuRenderer(const Scene& sceneRef, int threadCount)
+    : scene(sceneRef), threadPool(threadCount), kernels(&getBestSimdKernels()) {
+    updateQuads();
+    TraceLog(LOG_INFO, "CPU renderer: %d threads, %s packet kernels", threadPool.size(), kernels->name);
+}
+
+void CpuRenderer::updateQuads() {
+    packetQuads.clear();
+    for (const Quad& quad : scene.quads) {
+        packetQuads.push_back(makePacketQuad(quad.origin, quad.edgeU, quad.edgeV));
+    }
+}
+
+void CpuRenderer::setSimdLevel(SimdLevel level) {
+    kernels = &getSimdKernels(level);
+}
+
+void CpuRenderer::render(const CameraView& view, const RenderSettings& settings, int width, int height, std::vector<Vector3>& radiance) {
+    radiance.assign((size_t)width * height, Vector3Zero());
+    auto start = std::chrono::steady_clock::now();
+    TextureCacheStats textureStart = scene.textureCache ? scene.textureCache->getStats() : TextureCacheStats();
+
+    // Tiles along a space filling curve, spread over the threads by work stealing
+    int tileSize = settings.tileSize;
+    if (settings.packetTracing) tileSize = (tileSize + PACKET_BLOCK_SIZE - 1) / PACKET_BLOCK_SIZE * PACKET_BLOCK_SIZE;
+    tileSize = std::max(tileSize, settings.packetTracing ? PACKET_BLOCK_SIZE : 1);
+    std::vector<Tile> tiles = makeTiles(width, height, tileSize, settings.tileOrder);
+    TileScheduler scheduler((int)tiles.size(), threadPool.size());
+
+    // Each worker keeps its own counters
+    std::vector<BvhTraversalStats> workerTraversal(threadPool.size());
+    std::vector<uint64_t> workerSamples(threadPool.size());
+    std::vector<WorkerStats> workers(threadPool.size());
+    threadPool.run([&](int workerIndex) {
+        TraceContext context = { scene, view, settings, *kernels, packetQuads, {} };
+        WavefrontState wavefront;
+        WorkerStats worker;
+        bool stolen;
+        for (int tileIndex = scheduler.next(workerIndex, stolen); tileIndex >= 0; tileIndex = scheduler.next(workerIndex, stolen)) {
+            auto tileStart = std::chrono::steady_clock::now();
+            const Tile& tile = tiles[tileIndex];
+            if (settings.wavefront) {
+                renderTileWavefront(context, wavefront, tile, width, height, radiance);
+            } else if (settings.packetTracing) {
+                for (int row = tile.y; row < tile.y + tile.height; row += PACKET_BLOCK_SIZE) {
+                    for (int x = tile.x; x < tile.x + tile.width; x += PACKET_BLOCK_SIZE) {
+                        renderPixelBlock(context, x, row, width, height, radiance);
+                    }
+                }
+            } else {
+                for (int row = tile.y; row < tile.y + tile.height; row++) {
+                    // Image rows are stored top first, the shader's y axis points up
+                    int y = height - 1 - row;
+                    for (int x = tile.x; x < tile.x + tile.width; x++) {
+                        radiance[(size_t)row * width + x] = renderPixel(context, x, y);
+                    }
+                }
+            }
+            worker.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tileStart).count();
+            worker.tiles++;
+            if (stolen) worker.stolenTiles++;
+        }
+        workers[workerIndex] = worker;
+        workerTraversal[workerIndex] = context.traversal;
+        workerSamples[workerIndex] = context.samples;
+    });
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.rays = 0;
+    stats.nodeVisits = 0;
+    stats.primitiveTests = 0;
+    stats.samples = 0;
+    for (uint64_t samples : workerSamples) {
+        stats.samples += samples;
+    }
+    for (const BvhTraversalStats& traversal : workerTraversal) {
+        stats.rays += traversal.rays;
+        stats.nodeVisits += traversal.nodeVisits;
+        stats.primitiveTests += traversal.itemTests;
+    }
+    stats.tiles = (int)tiles.size();
+    stats.workers = workers;
+
+    double minUtilization = 1.0, maxUtilization = 0.0, sumUtilization = 0.0;
+    int stolenTiles = 0;
+    for (int i = 0; i < (int)workers.size(); i++) {
+        minUtilization = std::min(minUtilization, stats.utilization(i));
+        maxUtilization = std::max(maxUtilization, stats.utilization(i));
+        sumUtilization += stats.utilization(i);
+        stolenTiles += workers[i].stolenTiles;
+        TraceLog(LOG_DEBUG, "CPU render thread %d: %d tiles, %d stolen, %.0f%% busy", i, workers[i].tiles, workers[i].stolenTiles, stats.utilization(i) * 100.0);
+    }
+    TraceLog(LOG_INFO, "CPU render %d tiles of %d px (%s order), %d stolen, thread utilization min %.0f%% avg %.0f%% max %.0f%%",
+        stats.tiles, tileSize, getTileOrderName(settings.tileOrder), stolenTiles,
+        minUtilization * 100.0, sumUtilization / workers.size() * 100.0, maxUtilization * 100.0);
+    TraceLog(LOG_INFO, "CPU render %dx%d, %d spp on %d threads%s: %.2f s, %.2f Mrays/s, %.1f nodes and %.1f primitives per ray",
+        width, height, settings.samples, threadPool.size(), settings.wavefront ? " (wavefront)" : "", stats.seconds, stats.raysPerSecond() / 1e6,
+        stats.rays ? (double)stats.nodeVisits / stats.rays : 0.0, stats.rays ? (double)stats.primitiveTests / stats.rays : 0.0);
+    if (settings.noiseTarget > 0.0f) {
+        double fullSamples = (double)width * height * sampleCountOf(settings);
+        TraceLog(LOG_INFO, "CPU render adaptive sampling at %.1f%% noise: %.1f samples per pixel, %.0f%% of %d",
+            settings.noiseTarget * 100.0f, (double)stats.samples / ((double)width * height), stats.samples / fullSamples * 100.0, sampleCountOf(settings));
+    }
+    if (scene.textureCache) {
+        TextureCacheStats texture = scene.textureCache->getStats();
+        uint64_t lookups = (texture.hits - textureStart.hits) + (texture.misses - textureStart.misses);
+        TraceLog(LOG_INFO, "CPU render texture cache: %llu lookups, %.2f%% missed, %.1f of %.1f MB in use",
+            (unsigned long long)lookups, lookups ? (double)(texture.misses - textureStart.misses) / lookups * 100.0 : 0.0,
+            texture.residentTiles * TEXTURE_TILE_TEXELS * sizeof(Color) / 1e6, texture.capacityTiles * TEXTURE_TILE_TEXELS * sizeof(Color) / 1e6);
+    }
+}
+
+void CpuRenderer::renderFeatures(const CameraView& view, int width, int height, DenoiseFeatures& features) {
+    features.albedo.resize((size_t)width * height);
+    features.normal.resize((size_t)width * height);
+    features.depth.resize((size_t)width * height);
+
+    RenderSettings settings;
+    threadPool.parallelFor(height, [&](int row, int) {
+        TraceContext context = { scene, view, settings, *kernels, packetQuads, {} };
+        // Image rows are stored top first, the shader's y axis points up
+        int y = height - 1 - row;
+        for (int x = 0; x < width; x++) {
+            size_t pixel = (size_t)row * width + x;
+            Ray ray;
+            ray.origin = view.cameraCenter;
+            ray.direction = Vector3Subtract(Vector3Add(view.pixel00, Vector3Add(Vector3Scale(view.pixelU, x + 0.5f), Vector3Scale(view.pixelV, y + 0.5f))), ray.origin);
+            firstHitFeatures(context, ray, features.albedo[pixel], features.normal[pixel], features.depth[pixel]);
+        }
+    });
+}
+
+void CpuRenderer::denoise(const std::vector<Vector3>& radiance, const DenoiseFeatures& features, int width, int height, std::vector<Vector3>& result) {
+    auto start = std::chrono::steady_clock::now();
+    denoiseImage(threadPool, radiance, features, width, height, result);
+    TraceLog(LOG_INFO, "CPU denoise %dx%d on %d threads: %.2f s", width, height, threadPool.size(),
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+const RenderStats& CpuRenderer::getStats() const {
+    return stats;
+}
+
+int CpuRenderer::getThreadCount() const {
+    return threadPool.size();
+}
+
+bool sameImageSettings(const RenderSettings& a, const RenderSettings& b) {
+    return a.samples == b.samples && a.maxBounces == b.maxBounces && a.backgroundOpacity == b.backgroundOpacity && a.defocusAngle == b.defocusAngle && a.noiseTarget == b.noiseTarget && a.sampler == b.sampler;
+}
+
+// Gamma correct one linear channel to 8 bits, like the shader output
+static unsigned char displayByte(float value, float invGamma) {
+    return (unsigned char)(Clamp(powf(fmaxf(value, 0.0f), invGamma), 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+Image radianceToImage(const std::vector<Vector3>& radiance, int width, int height, float gamma) {
+    Image image = GenImageColor(width, height, BLACK);
+    Color* pixels = (Color*)image.data;
+    float invGamma = 1.0f / gamma;
+
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        Vector3 c = radiance[i];
+        pixels[i].r = displayByte(c.x, invGamma);
+        pixels[i].g = displayByte(c.y, invGamma);
+        pixels[i].b = displayByte(c.z, invGamma);
+        pixels[i].a = 255;
+    }
+
+    return image;
+}
+
+void radianceToRgb(const Vector3* radiance, size_t count, float gamma, unsigned char* rgb) {
+    float invGamma = 1.0f / gamma;
+    for (size_t i = 0; i < count; i++) {
+        rgb[i * 3] = displayByte(radiance[i].x, invGamma);
+        rgb[i * 3 + 1] = displayByte(radiance[i].y, invGamma);
+        rgb[i * 3 + 2] = displayByte(radiance[i].z, invGamma);
+    }
+}
+
+bool exportRadiancePfm(const std::vector<Vector3>& radiance, int width, int height, const char* fileName) {
+    PfmStreamWriter writer;
+    bool written = writer.open(fileName, width, height);
+    for (int row = 0; row < height && written; row++) {
+        written = writer.writeRowSpan(0, row, &radiance[(size_t)row * width], width);
+    }
+    written = writer.close() && written;
+
+    if (!written) {
+        TraceLog(LOG_WARNING, "Could not write %s", fileName);
+        return false;
+    }
+    TraceLog(LOG_INFO, "Float image saved to %s", fileName);
+    return true;
+}
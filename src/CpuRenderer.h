@@ -0,0 +1,97 @@
+#ifndef CPU_RENDERER_H
+#define CPU_RENDERER_H
+
+#include "raylib.h"
+#include "CpuDenoiser.h"
+#include "CustomCamera.h"
+#include "Sampler.h"
+#include "Scene.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
+#include <cstdint>
+#include <vector>
+
+// Same settings the shader receives as uniforms
+struct RenderSettings {
+    int samples = 8;
+    int maxBounces = 3; // Bounces every path gets, after that Russian roulette decides
+    float gamma = 1.6f;
+    float backgroundOpacity = 1.0f;
+    float defocusAngle = 0.0f;
+    int sampleOffset = 0; // Index of the first sample, frames of a running mean continue the sequence
+    SamplerType sampler = SAMPLER_SOBOL;
+    bool packetTracing = true; // Trace primary rays in SIMD packets of PACKET_BLOCK_SIZE^2 pixels
+    int tileSize = 32; // Tile edge in pixels, rounded up to a multiple of PACKET_BLOCK_SIZE for packets
+    TileOrder tileOrder = TILE_ORDER_HILBERT;
+    float noiseTarget = 0.0f; // Relative standard error at which a pixel stops sampling, 0 traces every sample
+    bool nextEventEstimation = true; // Sample the sun and the lights at Lambertian hits, off only finds them by scattering
+    bool russianRoulette = true; // Off ends every path after maxBounces, like the renderer did before
+    bool wavefront = false; // Trace each tile one bounce at a time through ray queues sorted by material and direction, instead of path by path
+};
+
+// Settings that change the rendered image, gamma is only applied when drawing
+bool sameImageSettings(const RenderSettings& a, const RenderSettings& b);
+
+// Pixel block edge covered by one ray packet
+#define PACKET_BLOCK_SIZE 4
+
+// What one thread did during a render
+struct WorkerStats {
+    double busySeconds = 0.0; // Time spent inside tiles
+    int tiles = 0;
+    int stolenTiles = 0; // Tiles taken from the range of another thread
+};
+
+struct RenderStats {
+    double seconds = 0.0;
+    uint64_t rays = 0; // Every traced ray, primary and bounces
+    uint64_t nodeVisits = 0; // BVH nodes visited by all rays
+    uint64_t primitiveTests = 0; // Ray-primitive tests done by all rays
+    uint64_t samples = 0; // Camera samples, less than pixels * spp with adaptive sampling
+    int tiles = 0;
+    std::vector<WorkerStats> workers; // One per thread
+    double raysPerSecond() const { return seconds > 0.0 ? rays / seconds : 0.0; }
+    // Share of the render time a thread spent rendering tiles
+    double utilization(int worker) const { return seconds > 0.0 ? workers[worker].busySeconds / seconds : 0.0; }
+};
+
+// Multithreaded path tracer that mirrors raytracing.frag on the CPU
+class CpuRenderer {
+private:
+    const Scene& scene;
+    ThreadPool threadPool;
+    RenderStats stats;
+    const SimdKernels* kernels;
+    std::vector<PacketQuad> packetQuads; // Scene::quads in the layout the packet kernels use
+
+public:
+    // threadCount <= 0 uses every hardware thread
+    CpuRenderer(const Scene& sceneRef, int threadCount = 0);
+
+    // Render linear radiance into a width * height buffer, top row first
+    void render(const CameraView& view, const RenderSettings& settings, int width, int height, std::vector<Vector3>& radiance);
+    // Render the denoiser's first-hit guides for the same image, one ray through each pixel center
+    void renderFeatures(const CameraView& view, int width, int height, DenoiseFeatures& features);
+    // Filter a rendered image with denoiseImage() on the renderer's threads
+    void denoise(const std::vector<Vector3>& radiance, const DenoiseFeatures& features, int width, int height, std::vector<Vector3>& result);
+
+    // Call after Scene::quads changed, the packet kernels use a copy of them
+    void updateQuads();
+
+    // Use a lower instruction set than the one detected, mostly for comparisons
+    void setSimdLevel(SimdLevel level);
+
+    const RenderStats& getStats() const;
+    int getThreadCount() const;
+};
+
+// Apply gamma correction and convert to an 8-bit image, like the shader output
+Image radianceToImage(const std::vector<Vector3>& radiance, int width, int height, float gamma);
+// Same for count pixels into packed 8-bit RGB
+void radianceToRgb(const Vector3* radiance, size_t count, float gamma, unsigned char* rgb);
+
+// Write linear radiance (top row first) as a little-endian PFM, keeps the full float range
+bool exportRadiancePfm(const std::vector<Vector3>& radiance, int width, int height, const char* fileName);
+
+#endif // CPU_RENDERER_H
@@ -1,6 +1,10 @@
 #include "CustomCamera.h"
 #include <cmath>
 
+bool sameCameraView(const CameraView& a, const CameraView& b) {
+    return Vector3Equals(a.pixel00, b.pixel00) && Vector3Equals(a.pixelU, b.pixelU) && Vector3Equals(a.pixelV, b.pixelV) && Vector3Equals(a.cameraCenter, b.cameraCenter);
+}
+
 CustomCamera::CustomCamera(int screenWidth, int screenHeight, float fovy) {
     camera.position = { 0.0f, 0.0f, 1.0f }; // Start slightly away from the origin
     camera.target = { 0.0f, 0.0f, 0.0f };
@@ -40,6 +44,17 @@ void CustomCamera::setShaderValues(Shader& shader, int pixel00Loc, int pixelULoc
     SetShaderValue(shader, cameraCenterLoc, &camera.position, SHADER_UNIFORM_VEC3);
 }
 
+CameraView CustomCamera::getView() const {
+    return { pixel00, pixelU, pixelV, camera.position };
+}
+
+CameraView CustomCamera::getView(int imageWidth, int imageHeight) const {
+    CustomCamera imageCamera = *this;
+    imageCamera.aspectRatio = (float)imageWidth / imageHeight;
+    imageCamera.update(imageWidth, imageHeight);
+    return imageCamera.getView();
+}
+
 void CustomCamera::handleInput(float deltaTime) {
     Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
     Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, camera.up));
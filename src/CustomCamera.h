@@ -4,6 +4,16 @@
 #include "raylib.h"
 #include "raymath.h"
 
+// Everything needed to generate primary rays, as the shader receives it
+struct CameraView {
+    Vector3 pixel00;
+    Vector3 pixelU;
+    Vector3 pixelV;
+    Vector3 cameraCenter;
+};
+
+bool sameCameraView(const CameraView& a, const CameraView& b);
+
 class CustomCamera {
 public:
     Camera3D camera;
@@ -18,6 +28,9 @@ public:
     void update(int screenWidth, int screenHeight);
     void setShaderValues(Shader& shader, int pixel00Loc, int pixelULoc, int pixelVLoc, int cameraCenterLoc);
     void handleInput(float deltaTime);
+    CameraView getView() const;
+    // View of an image with a different resolution and aspect ratio, same position and vertical FOV
+    CameraView getView(int imageWidth, int imageHeight) const;
 };
 
 #endif // CUSTOM_CAMERA_H
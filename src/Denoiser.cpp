@@ -0,0 +1,84 @@
+#include "Denoiser.h"
+#include "Accumulator.h"
+#include "rlgl.h"
+
+// denoisePass of denoise.frag
+#define DENOISE_PASS_PREPARE 0
+#define DENOISE_PASS_FILTER 1
+#define DENOISE_PASS_FINAL 2
+
+Denoiser::Denoiser(int widthValue, int heightValue, const FeatureTargets& featureTargets)
+    : features(featureTargets), width(widthValue), height(heightValue) {
+    targets[0] = loadFloatRenderTexture(width, height);
+    targets[1] = loadFloatRenderTexture(width, height);
+
+    denoiseShader = LoadShader(0, "src/denoise.frag");
+    inputImageLoc = GetShaderLocation(denoiseShader, "inputImage");
+    albedoDepthLoc = GetShaderLocation(denoiseShader, "albedoDepth");
+    normalsLoc = GetShaderLocation(denoiseShader, "normals");
+    denoisePassLoc = GetShaderLocation(denoiseShader, "denoisePass");
+    stepSizeLoc = GetShaderLocation(denoiseShader, "stepSize");
+    displayShader = LoadShader(0, "src/display.frag");
+    displayGammaLoc = GetShaderLocation(displayShader, "gamma");
+}
+
+Denoiser::~Denoiser() {
+    UnloadRenderTexture(targets[0]);
+    UnloadRenderTexture(targets[1]);
+    UnloadShader(denoiseShader);
+    UnloadShader(displayShader);
+}
+
+void Denoiser::resize(int newWidth, int newHeight) {
+    if (newWidth == width && newHeight == height) return;
+    width = newWidth;
+    height = newHeight;
+    UnloadRenderTexture(targets[0]);
+    UnloadRenderTexture(targets[1]);
+    targets[0] = loadFloatRenderTexture(width, height);
+    targets[1] = loadFloatRenderTexture(width, height);
+}
+
+void Denoiser::runPass(int pass, int stepSize, const Texture2D& input) {
+    SetShaderValue(denoiseShader, denoisePassLoc, &pass, SHADER_UNIFORM_INT);
+    SetShaderValue(denoiseShader, stepSizeLoc, &stepSize, SHADER_UNIFORM_INT);
+
+    BeginTextureMode(targets[1 - current]);
+        // Alpha holds the variance, it must be written as is
+        rlDisableColorBlend();
+        BeginShaderMode(denoiseShader);
+            // Render batches reset the texture bindings, they are bound inside the shader mode
+            SetShaderValueTexture(denoiseShader, inputImageLoc, input);
+            SetShaderValueTexture(denoiseShader, albedoDepthLoc, features.getAlbedoDepth());
+            SetShaderValueTexture(denoiseShader, normalsLoc, features.getNormals());
+            DrawRectangle(0, 0, width, height, WHITE);
+        EndShaderMode();
+    EndTextureMode();
+    rlEnableColorBlend();
+    current = 1 - current;
+}
+
+void Denoiser::denoise(const Texture2D& radiance) {
+    runPass(DENOISE_PASS_PREPARE, 1, radiance);
+    for (int iteration = 0; iteration < DENOISE_ITERATIONS; iteration++) {
+        int pass = iteration == DENOISE_ITERATIONS - 1 ? DENOISE_PASS_FINAL : DENOISE_PASS_FILTER;
+        runPass(pass, 1 << iteration, targets[current].texture);
+    }
+}
+
+void Denoiser::draw(float gamma) {
+    SetShaderValue(displayShader, displayGammaLoc, &gamma, SHADER_UNIFORM_FLOAT);
+
+    // Render textures are stored bottom up, flip them with a negative source height
+    BeginShaderMode(displayShader);
+        DrawTextureRec(targets[current].texture, Rectangle{ 0, 0, (float)width, (float)-height }, Vector2{ 0, 0 }, WHITE);
+    EndShaderMode();
+}
+
+std::vector<Vector3> Denoiser::readResult() const {
+    return readRadiance(targets[current].texture);
+}
+
+const Texture2D& Denoiser::getResult() const {
+    return targets[current].texture;
+}
@@ -0,0 +1,48 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "raylib.h"
+#include "CpuDenoiser.h"
+#include "FeatureTargets.h"
+#include <vector>
+
+// Edge-aware a-trous denoiser on the GPU, denoise.frag filters a linear image in DENOISE_ITERATIONS passes
+// guided by the first-hit features
+class Denoiser {
+private:
+    const FeatureTargets& features;
+    RenderTexture2D targets[2]; // Ping-pong of the filter passes
+    int current = 0; // Target holding the last pass
+    int width, height;
+
+    Shader denoiseShader;
+    int inputImageLoc;
+    int albedoDepthLoc;
+    int normalsLoc;
+    int denoisePassLoc;
+    int stepSizeLoc;
+    Shader displayShader;
+    int displayGammaLoc;
+
+    void runPass(int pass, int stepSize, const Texture2D& input);
+
+public:
+    Denoiser(int width, int height, const FeatureTargets& features);
+    ~Denoiser();
+
+    Denoiser(const Denoiser&) = delete;
+    Denoiser& operator=(const Denoiser&) = delete;
+
+    // Reallocate the targets for another render size
+    void resize(int width, int height);
+    // Filter a linear radiance texture of the denoiser's size, the features must show the same view
+    void denoise(const Texture2D& radiance);
+    // Draw the last result to the current framebuffer with gamma correction
+    void draw(float gamma);
+    // Read the last result back as linear radiance, top row first
+    std::vector<Vector3> readResult() const;
+
+    const Texture2D& getResult() const;
+};
+
+#endif // DENOISER_H
@@ -0,0 +1,331 @@
+#include "DistributedRender.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Messages are sent as they are in memory: only 32-bit fields, so there is no padding,
+// and every supported platform is little-endian
+#define DISTRIBUTED_MAGIC 0x44525452u // "RTRD"
+
+// Samples of a job when the coordinator picks them, aimed at this many jobs per frame
+#define DISTRIBUTED_JOBS_PER_FRAME 8
+
+// Both sides send one on connecting, the coordinator closes the connection when they do not match
+struct HelloMessage {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sceneHashLow;
+    uint32_t sceneHashHigh;
+    int32_t threads;
+};
+
+struct JobMessage {
+    uint32_t magic;
+    int32_t job;
+    int32_t width;
+    int32_t height;
+    float view[12]; // pixel00, pixelU, pixelV, cameraCenter
+    int32_t samples;
+    int32_t sampleOffset;
+    int32_t maxBounces;
+    float backgroundOpacity;
+    float defocusAngle;
+    int32_t sampler;
+    int32_t nextEventEstimation;
+    int32_t russianRoulette;
+    int32_t packetTracing;
+    int32_t wavefront;
+};
+
+// Followed by width * height mean radiances of the job's samples, top row first
+struct ResultMessage {
+    uint32_t magic;
+    int32_t job;
+    int32_t samples;
+    int32_t width;
+    int32_t height;
+};
+
+static_assert(sizeof(HelloMessage) == 5 * 4, "HelloMessage has padding");
+static_assert(sizeof(JobMessage) == 26 * 4, "JobMessage has padding");
+static_assert(sizeof(ResultMessage) == 5 * 4, "ResultMessage has padding");
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 has padding");
+static_assert(sizeof(CameraView) == 12 * sizeof(float), "CameraView has padding");
+
+static HelloMessage makeHello(uint64_t sceneHash, int threads) {
+    return { DISTRIBUTED_MAGIC, DISTRIBUTED_PROTOCOL_VERSION, (uint32_t)sceneHash, (uint32_t)(sceneHash >> 32), threads };
+}
+
+static bool sameWorld(const HelloMessage& a, const HelloMessage& b) {
+    return a.magic == b.magic && a.version == b.version && a.sceneHashLow == b.sceneHashLow && a.sceneHashHigh == b.sceneHashHigh;
+}
+
+// Largest power of two not above value
+static int floorPowerOfTwo(int value) {
+    int power = 1;
+    while (power <= value / 2) power *= 2;
+    return power;
+}
+
+RenderCoordinator::RenderCoordinator(uint64_t newSceneHash, int newWidth, int newHeight, int newJobSamples)
+    : sceneHash(newSceneHash), width(newWidth), height(newHeight), jobSamples(newJobSamples) {
+}
+
+bool RenderCoordinator::listen(int port) {
+    return listener.listen(port);
+}
+
+int RenderCoordinator::samplesPerJob(int samples) const {
+    if (jobSamples > 0) return floorPowerOfTwo(jobSamples);
+    return floorPowerOfTwo(std::max(1, samples / DISTRIBUTED_JOBS_PER_FRAME));
+}
+
+namespace {
+
+struct DistributedJob {
+    int frame; // Index into the frames passed to render()
+    int sampleOffset;
+    int samples;
+    int running = 0; // Workers rendering it right now
+    bool done = false;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Running sum of one frame, weighted by the samples of each job
+struct FrameMerge {
+    std::vector<Vector3> sum;
+    int samples = 0;
+};
+
+struct WorkerConnection {
+    Socket socket;
+    std::thread thread;
+};
+
+// Everything the threads serving the workers share, guarded by mutex
+struct CoordinatorState {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<DistributedJob> jobs;
+    std::deque<int> queue; // Jobs no worker has started, in frame order
+    std::vector<FrameMerge> merges;
+    int jobsLeft = 0;
+    int framesLeft = 0;
+    int failedFrames = 0;
+    int workers = 0; // Workers that passed the hello
+    std::mutex callbackMutex; // Frames are written one at a time
+};
+
+}
+
+// Next job for an idle worker: the front of the queue, otherwise another copy of the job running the longest
+static int takeJob(CoordinatorState& state) {
+    if (!state.queue.empty()) {
+        int job = state.queue.front();
+        state.queue.pop_front();
+        return job;
+    }
+    int oldest = -1;
+    for (int i = 0; i < (int)state.jobs.size(); i++) {
+        const DistributedJob& job = state.jobs[i];
+        if (job.done || job.running == 0 || job.running >= DISTRIBUTED_MAX_JOB_COPIES) continue;
+        if (oldest < 0 || job.started < state.jobs[oldest].started) oldest = i;
+    }
+    return oldest;
+}
+
+// Serve one worker until every frame is done or the connection breaks
+static void serveWorker(Socket& socket, int workerIndex, uint64_t sceneHash, int width, int height, const std::vector<DistributedFrame>& frames,
+                        const FrameCallback& onFrame, CoordinatorState& state) {
+    HelloMessage expected = makeHello(sceneHash, 0);
+    HelloMessage hello;
+    if (!socket.receiveAll(&hello, sizeof(hello)) || !socket.sendAll(&expected, sizeof(expected))) return;
+    if (!sameWorld(hello, expected)) {
+        TraceLog(LOG_WARNING, "Worker %d rejected: it has another world or protocol version", workerIndex);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.workers++;
+    }
+    TraceLog(LOG_INFO, "Worker %d connected with %d threads", workerIndex, hello.threads);
+
+    std::vector<Vector3> radiance((size_t)width * height);
+    while (true) {
+        int jobIndex = -1;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.changed.wait(lock, [&] {
+                return state.jobsLeft == 0 || (jobIndex = takeJob(state)) >= 0;
+            });
+            if (jobIndex < 0) break;
+            DistributedJob& job = state.jobs[jobIndex];
+            if (job.running == 0) job.started = std::chrono::steady_clock::now();
+            job.running++;
+        }
+
+        const DistributedJob& job = state.jobs[jobIndex];
+        const DistributedFrame& frame = frames[job.frame];
+        const RenderSettings& settings = frame.settings;
+        JobMessage message = { DISTRIBUTED_MAGIC, jobIndex, width, height, {}, job.samples, job.sampleOffset, settings.maxBounces,
+                               settings.backgroundOpacity, settings.defocusAngle, (int32_t)settings.sampler, settings.nextEventEstimation,
+                               settings.russianRoulette, settings.packetTracing, settings.wavefront };
+        memcpy(message.view, &frame.view, sizeof(message.view));
+
+        ResultMessage result;
+        bool received = socket.sendAll(&message, sizeof(message)) && socket.receiveAll(&result, sizeof(result))
+            && result.magic == DISTRIBUTED_MAGIC && result.job == jobIndex && result.samples == job.samples && result.width == width && result.height == height
+            && socket.receiveAll(radiance.data(), radiance.size() * sizeof(Vector3));
+
+        std::unique_lock<std::mutex> lock(state.mutex);
+        DistributedJob& finished = state.jobs[jobIndex];
+        finished.running--;
+        if (!received) {
+            // Cut off at the end while rendering a copy that lost
+            if (state.jobsLeft == 0) return;
+            // Back to the front, so the frame it belongs to is not held up behind later ones
+            if (!finished.done && finished.running == 0) state.queue.push_front(jobIndex);
+            int workersLeft = --state.workers;
+            state.changed.notify_all();
+            lock.unlock();
+            TraceLog(LOG_WARNING, "Worker %d disconnected while rendering job %d", workerIndex, jobIndex);
+            if (workersLeft == 0) TraceLog(LOG_WARNING, "No workers left, waiting for one to connect");
+            return;
+        }
+        // Another copy already returned the same samples
+        if (finished.done) continue;
+        finished.done = true;
+        state.jobsLeft--;
+
+        FrameMerge& merge = state.merges[finished.frame];
+        if (merge.sum.empty()) merge.sum.assign(radiance.size(), Vector3{ 0.0f, 0.0f, 0.0f });
+        float weight = (float)finished.samples;
+        for (size_t i = 0; i < radiance.size(); i++) {
+            merge.sum[i].x += radiance[i].x * weight;
+            merge.sum[i].y += radiance[i].y * weight;
+            merge.sum[i].z += radiance[i].z * weight;
+        }
+        merge.samples += finished.samples;
+        bool frameDone = merge.samples == frame.settings.samples;
+        std::vector<Vector3> merged;
+        if (frameDone) merged.swap(merge.sum);
+        if (state.jobsLeft == 0) state.changed.notify_all();
+        lock.unlock();
+
+        if (frameDone) {
+            float invSamples = 1.0f / (float)frame.settings.samples;
+            for (Vector3& pixel : merged) {
+                pixel.x *= invSamples;
+                pixel.y *= invSamples;
+                pixel.z *= invSamples;
+            }
+            std::lock_guard<std::mutex> callbackLock(state.callbackMutex);
+            bool written = onFrame(frame, merged);
+            lock.lock();
+            if (!written) state.failedFrames++;
+            state.framesLeft--;
+            state.changed.notify_all();
+        }
+    }
+}
+
+int RenderCoordinator::render(const std::vector<DistributedFrame>& frames, const FrameCallback& onFrame) {
+    CoordinatorState state;
+    for (int frame = 0; frame < (int)frames.size(); frame++) {
+        int samples = frames[frame].settings.samples;
+        int chunk = samplesPerJob(samples);
+        for (int offset = 0; offset < samples; offset += chunk) {
+            DistributedJob job;
+            job.frame = frame;
+            job.sampleOffset = frames[frame].settings.sampleOffset + offset;
+            job.samples = std::min(chunk, samples - offset);
+            state.queue.push_back((int)state.jobs.size());
+            state.jobs.push_back(job);
+        }
+    }
+    state.merges.resize(frames.size());
+    state.jobsLeft = (int)state.jobs.size();
+    state.framesLeft = (int)frames.size();
+
+    // Workers are accepted until the last frame is written, a worker that joins late still takes copies of running jobs
+    std::vector<std::unique_ptr<WorkerConnection>> connections;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.framesLeft == 0) break;
+        }
+        if (!listener.waitReadable(100)) continue;
+        Socket socket = listener.accept();
+        if (!socket.isOpen()) continue;
+
+        int workerIndex = (int)connections.size();
+        connections.push_back(std::make_unique<WorkerConnection>());
+        WorkerConnection& connection = *connections.back();
+        connection.socket = std::move(socket);
+        connection.thread = std::thread(serveWorker, std::ref(connection.socket), workerIndex, sceneHash, width, height, std::cref(frames), std::cref(onFrame), std::ref(state));
+    }
+
+    // Workers still rendering a copy that lost are cut off, and the rest see the end of the connection and exit
+    for (std::unique_ptr<WorkerConnection>& connection : connections) connection->socket.shutdown();
+    for (std::unique_ptr<WorkerConnection>& connection : connections) connection->thread.join();
+    return state.failedFrames;
+}
+
+bool runRenderWorker(const std::string& host, int port, const Scene& scene, uint64_t sceneHash, int threads) {
+    // Workers started next to the coordinator may be up before it listens
+    Socket socket;
+    auto start = std::chrono::steady_clock::now();
+    while (!socket.connect(host, port)) {
+        if (std::chrono::steady_clock::now() - start > std::chrono::seconds(DISTRIBUTED_CONNECT_SECONDS)) {
+            TraceLog(LOG_WARNING, "No coordinator at %s:%d", host.c_str(), port);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+
+    CpuRenderer renderer(scene, threads);
+    HelloMessage hello = makeHello(sceneHash, renderer.getThreadCount());
+    HelloMessage reply;
+    if (!socket.sendAll(&hello, sizeof(hello)) || !socket.receiveAll(&reply, sizeof(reply))) {
+        TraceLog(LOG_WARNING, "Coordinator at %s:%d closed the connection", host.c_str(), port);
+        return false;
+    }
+    if (!sameWorld(hello, reply)) {
+        TraceLog(LOG_WARNING, "Coordinator at %s:%d renders another world or speaks another protocol version", host.c_str(), port);
+        return false;
+    }
+
+    // The coordinator closes the connection once every frame is done
+    JobMessage job;
+    std::vector<Vector3> radiance;
+    int jobs = 0;
+    while (socket.receiveAll(&job, sizeof(job))) {
+        if (job.magic != DISTRIBUTED_MAGIC || job.width <= 0 || job.height <= 0 || job.samples <= 0) return false;
+        CameraView view;
+        memcpy(&view, job.view, sizeof(view));
+        RenderSettings settings;
+        settings.samples = job.samples;
+        settings.sampleOffset = job.sampleOffset;
+        settings.maxBounces = job.maxBounces;
+        settings.backgroundOpacity = job.backgroundOpacity;
+        settings.defocusAngle = job.defocusAngle;
+        settings.sampler = (SamplerType)job.sampler;
+        settings.nextEventEstimation = job.nextEventEstimation != 0;
+        settings.russianRoulette = job.russianRoulette != 0;
+        settings.packetTracing = job.packetTracing != 0;
+        settings.wavefront = job.wavefront != 0;
+        renderer.render(view, settings, job.width, job.height, radiance);
+
+        ResultMessage result = { DISTRIBUTED_MAGIC, job.job, job.samples, job.width, job.height };
+        if (!socket.sendAll(&result, sizeof(result)) || !socket.sendAll(radiance.data(), radiance.size() * sizeof(Vector3))) break;
+        jobs++;
+        TraceLog(LOG_INFO, "Job %d: %d samples from %d in %.2f s", job.job, job.samples, job.sampleOffset, renderer.getStats().seconds);
+    }
+    TraceLog(LOG_INFO, "Coordinator finished, %d jobs rendered", jobs);
+    return true;
+}
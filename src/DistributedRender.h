@@ -0,0 +1,72 @@
+#ifndef DISTRIBUTED_RENDER_H
+#define DISTRIBUTED_RENDER_H
+
+#include "raylib.h"
+#include "CpuRenderer.h"
+#include "CustomCamera.h"
+#include "Scene.h"
+#include "Socket.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Coordinator and workers of a render spread over processes and hosts
+// Every frame is split into jobs of consecutive samples of the whole image, jobs start at multiples of their size,
+// so each one covers aligned Sobol blocks and the merged frame uses the same samples as a single render would
+
+// Bump whenever a message or the meaning of one of its fields changes
+#define DISTRIBUTED_PROTOCOL_VERSION 1
+
+// Copies of one job that may run at the same time, extra copies go to idle workers once the queue is empty
+// The first result wins, so a slow worker no longer holds up the end of a frame
+#define DISTRIBUTED_MAX_JOB_COPIES 2
+
+// How long a worker keeps trying to reach a coordinator that is not listening yet
+#define DISTRIBUTED_CONNECT_SECONDS 30
+
+// A frame to render, view and settings as CpuRenderer::render() takes them, settings.samples for the whole frame
+struct DistributedFrame {
+    int frame = 0;
+    CameraView view;
+    RenderSettings settings;
+};
+
+// Receives every frame once all its samples are merged, returns false when it could not be written
+// Called from the threads serving the workers, one frame at a time, the radiance buffer is its to change
+typedef std::function<bool(const DistributedFrame& frame, std::vector<Vector3>& radiance)> FrameCallback;
+
+// Hands jobs to the workers that connect and merges what they return
+// A worker that disconnects has its jobs given to the others
+class RenderCoordinator {
+private:
+    Socket listener;
+    uint64_t sceneHash;
+    int width;
+    int height;
+    int jobSamples;
+
+public:
+    // newJobSamples is rounded down to a power of two, 0 picks one that gives every frame 8 jobs or more
+    RenderCoordinator(uint64_t newSceneHash, int newWidth, int newHeight, int newJobSamples = 0);
+
+    RenderCoordinator(const RenderCoordinator&) = delete;
+    RenderCoordinator& operator=(const RenderCoordinator&) = delete;
+
+    // Accept workers on port, false when it is taken
+    bool listen(int port);
+
+    // Render every frame on the workers, waits for workers to connect and returns when every frame went to onFrame
+    // Returns the number of frames onFrame failed to write
+    int render(const std::vector<DistributedFrame>& frames, const FrameCallback& onFrame);
+
+    // Size of the jobs a frame of samples is split into
+    int samplesPerJob(int samples) const;
+};
+
+// Connect to a coordinator, render its jobs on threads CPU threads until it disconnects
+// sceneHash has to match the coordinator's, so every worker renders the same world
+// Returns false when no coordinator could be reached or it rejected the worker
+bool runRenderWorker(const std::string& host, int port, const Scene& scene, uint64_t sceneHash, int threads);
+
+#endif // DISTRIBUTED_RENDER_H
@@ -0,0 +1,132 @@
+#include "DynamicResolution.h"
+#include "raylib.h"
+#include "rlgl.h"
+#include <cmath>
+
+// Timestamp queries are core since OpenGL 3.3, raylib's loader has them ready after InitWindow()
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_43)
+    #include "external/glad.h"
+    #define DYNAMIC_RESOLUTION_GPU_TIMERS
+#endif
+
+// Weight of a new measurement in the smoothed render time
+static const float measurementWeight = 0.2f;
+
+// A higher scale is only taken when its predicted time leaves this much of the budget free, so it does not bounce back
+static const float increaseHeadroom = 0.9f;
+
+DynamicResolution::DynamicResolution(float frameMs) : budgetMs(frameMs * DYNAMIC_RESOLUTION_BUDGET_SHARE) {
+#ifdef DYNAMIC_RESOLUTION_GPU_TIMERS
+    gpuTimers = rlGetVersion() == RL_OPENGL_33 || rlGetVersion() == RL_OPENGL_43;
+    if (gpuTimers) glGenQueries(DYNAMIC_RESOLUTION_LATENCY_FRAMES * 2, &queries[0][0]);
+#endif
+    if (!gpuTimers) TraceLog(LOG_WARNING, "DYNAMIC RESOLUTION: GPU timers unavailable, only the manual render scale is used");
+}
+
+void DynamicResolution::beginWork() {
+    if (!gpuTimers || working) return;
+#ifdef DYNAMIC_RESOLUTION_GPU_TIMERS
+    // Draw what was batched before, so it is not timed as part of the work
+    rlDrawRenderBatchActive();
+    glQueryCounter(queries[frameIndex % DYNAMIC_RESOLUTION_LATENCY_FRAMES][0], GL_TIMESTAMP);
+    working = true;
+#endif
+}
+
+void DynamicResolution::endWork() {
+    if (!working) return;
+#ifdef DYNAMIC_RESOLUTION_GPU_TIMERS
+    rlDrawRenderBatchActive();
+    int slot = frameIndex % DYNAMIC_RESOLUTION_LATENCY_FRAMES;
+    glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+    queryGeneration[slot] = generation;
+    queryPending[slot] = true;
+#endif
+    working = false;
+}
+
+// Read the frame measured DYNAMIC_RESOLUTION_LATENCY_FRAMES - 1 frames ago, its slot is the next one written
+void DynamicResolution::readMeasurement() {
+#ifdef DYNAMIC_RESOLUTION_GPU_TIMERS
+    int slot = (frameIndex + 1) % DYNAMIC_RESOLUTION_LATENCY_FRAMES;
+    if (!queryPending[slot]) return;
+    queryPending[slot] = false;
+    if (queryGeneration[slot] != generation) return; // Taken at another scale
+
+    GLint available = 0;
+    glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return; // Dropped rather than waited for
+
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+    float ms = end > begin ? (float)((end - begin) / 1e6) : 0.0f;
+    renderMs = measuredFrames == 0 ? ms : renderMs + measurementWeight * (ms - renderMs);
+    measuredFrames++;
+#endif
+}
+
+void DynamicResolution::change(float newScale, int newSampleDivisor) {
+    if (newScale == scale && newSampleDivisor == sampleDivisor) return;
+    scale = newScale;
+    sampleDivisor = newSampleDivisor;
+    renderMs = 0.0f;
+    measuredFrames = 0;
+    generation++;
+}
+
+void DynamicResolution::update(float manualScale, int requestedSamples, bool allowIncrease) {
+    readMeasurement();
+    frameIndex++;
+
+    if (manualScale > 0.0f) {
+        change(manualScale, 1);
+        return;
+    }
+    if (!gpuTimers) {
+        change(1.0f, 1);
+        return;
+    }
+    if (measuredFrames < DYNAMIC_RESOLUTION_SETTLE_FRAMES) return;
+
+    // The time grows with the traced pixels and samples, so the scale that fits is the square root of the time ratio
+    if (renderMs > budgetMs) {
+        float fitting = floorf(scale * sqrtf(budgetMs / renderMs) / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+        if (scale > DYNAMIC_RESOLUTION_MIN_SCALE) {
+            change(fmaxf(fminf(fitting, scale - DYNAMIC_RESOLUTION_STEP), DYNAMIC_RESOLUTION_MIN_SCALE), sampleDivisor);
+        } else if (requestedSamples / (sampleDivisor * 2) >= 1) {
+            change(scale, sampleDivisor * 2);
+        }
+    } else if (allowIncrease) {
+        // Samples come back first, then resolution, one step at a time
+        if (sampleDivisor > 1) {
+            if (renderMs * 2.0f < budgetMs * increaseHeadroom) change(scale, sampleDivisor / 2);
+        } else if (scale < 1.0f) {
+            float next = fminf(scale + DYNAMIC_RESOLUTION_STEP, 1.0f);
+            float predictedMs = renderMs * (next * next) / (scale * scale);
+            if (predictedMs < budgetMs * increaseHeadroom) change(next, sampleDivisor);
+        }
+    }
+}
+
+float DynamicResolution::getScale() const {
+    return scale;
+}
+
+int DynamicResolution::getRenderSize(int screenSize) const {
+    int size = (int)lroundf(screenSize * scale);
+    return size < 1 ? 1 : size;
+}
+
+int DynamicResolution::getFrameSamples(int requestedSamples) const {
+    int frameSamples = requestedSamples / sampleDivisor;
+    return frameSamples < 1 ? 1 : frameSamples;
+}
+
+float DynamicResolution::getRenderMs() const {
+    return renderMs;
+}
+
+float DynamicResolution::getBudgetMs() const {
+    return budgetMs;
+}
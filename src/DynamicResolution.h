@@ -0,0 +1,63 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Render scales are multiples of this, so the targets are only reallocated when the scale really changes
+#define DYNAMIC_RESOLUTION_STEP 0.125f
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.25f
+
+// Share of the frame time the render stages may take, the rest is left for the menu, the overlay and presenting
+#define DYNAMIC_RESOLUTION_BUDGET_SHARE 0.8f
+
+// Render times are read this many frames after they were measured, so reading them never stalls
+#define DYNAMIC_RESOLUTION_LATENCY_FRAMES 4
+
+// Frames measured at a scale before it may change again
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 8
+
+// Keeps the GPU time of the render stages within a budget by picking the render resolution,
+// once that is at its minimum frames trace fewer samples than the menu asks for
+// The time is measured with timestamp queries around the render stages, without them only a manual scale is used
+class DynamicResolution {
+private:
+    float budgetMs;
+    float scale = 1.0f;
+    int sampleDivisor = 1; // Frames trace the menu's samples divided by this
+    float renderMs = 0.0f; // Smoothed GPU time of the render stages at the current scale
+    int measuredFrames = 0; // Frames in renderMs
+    int generation = 0; // Counts the changes, measurements of an older one are dropped
+    bool gpuTimers = false;
+
+    // Timestamp pair of every frame in flight
+    unsigned int queries[DYNAMIC_RESOLUTION_LATENCY_FRAMES][2] = {};
+    int queryGeneration[DYNAMIC_RESOLUTION_LATENCY_FRAMES] = {};
+    bool queryPending[DYNAMIC_RESOLUTION_LATENCY_FRAMES] = {};
+    bool working = false; // Between beginWork() and endWork()
+    int frameIndex = 0;
+
+    void readMeasurement();
+    void change(float newScale, int newSampleDivisor);
+
+public:
+    // Needs the GL context, query objects are left to it
+    DynamicResolution(float frameMs);
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // Put around the GPU work that scales with the render resolution, at most once per frame
+    void beginWork();
+    void endWork();
+    // Call once at the end of every frame, picks the scale of the next one
+    // manualScale > 0 fixes the scale, allowIncrease false only lets it go down (a running mean would start over)
+    void update(float manualScale, int requestedSamples, bool allowIncrease);
+
+    float getScale() const;
+    // Render size for a window size, at least one pixel
+    int getRenderSize(int screenSize) const;
+    int getFrameSamples(int requestedSamples) const;
+    // Smoothed GPU time of the render stages, 0 until measured
+    float getRenderMs() const;
+    float getBudgetMs() const;
+};
+
+#endif // DYNAMIC_RESOLUTION_H
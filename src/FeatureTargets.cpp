@@ -0,0 +1,66 @@
+#include "FeatureTargets.h"
+#include "Accumulator.h"
+#include "rlgl.h"
+
+// featureOutput of raytracing.frag
+#define FEATURE_NONE 0
+#define FEATURE_ALBEDO_DEPTH 1
+#define FEATURE_NORMAL 2
+
+FeatureTargets::FeatureTargets(int width, int height, Shader raytracingShader) : featureShader(raytracingShader) {
+    albedoDepth = loadFloatRenderTexture(width, height);
+    normals = loadFloatRenderTexture(width, height);
+
+    featureOutputLoc = GetShaderLocation(featureShader, "featureOutput");
+    int radiance = FEATURE_NONE;
+    SetShaderValue(featureShader, featureOutputLoc, &radiance, SHADER_UNIFORM_INT);
+}
+
+FeatureTargets::~FeatureTargets() {
+    UnloadRenderTexture(albedoDepth);
+    UnloadRenderTexture(normals);
+}
+
+void FeatureTargets::update(const CameraView& view, const std::function<void()>& drawRaytracing) {
+    if (featuresValid && sameCameraView(view, featuresView)) return;
+
+    RenderTexture2D* targets[2] = { &albedoDepth, &normals };
+    int outputs[2] = { FEATURE_ALBEDO_DEPTH, FEATURE_NORMAL };
+    for (int i = 0; i < 2; i++) {
+        SetShaderValue(featureShader, featureOutputLoc, &outputs[i], SHADER_UNIFORM_INT);
+        BeginTextureMode(*targets[i]);
+            // Alpha holds the depth, it must be written as is
+            rlDisableColorBlend();
+            BeginShaderMode(featureShader);
+                drawRaytracing();
+            EndShaderMode();
+        EndTextureMode();
+        rlEnableColorBlend();
+    }
+    int radiance = FEATURE_NONE;
+    SetShaderValue(featureShader, featureOutputLoc, &radiance, SHADER_UNIFORM_INT);
+
+    featuresView = view;
+    featuresValid = true;
+}
+
+void FeatureTargets::invalidate() {
+    featuresValid = false;
+}
+
+void FeatureTargets::resize(int width, int height) {
+    if (width == albedoDepth.texture.width && height == albedoDepth.texture.height) return;
+    UnloadRenderTexture(albedoDepth);
+    UnloadRenderTexture(normals);
+    albedoDepth = loadFloatRenderTexture(width, height);
+    normals = loadFloatRenderTexture(width, height);
+    invalidate();
+}
+
+const Texture2D& FeatureTargets::getAlbedoDepth() const {
+    return albedoDepth.texture;
+}
+
+const Texture2D& FeatureTargets::getNormals() const {
+    return normals.texture;
+}
@@ -0,0 +1,42 @@
+#ifndef FEATURE_TARGETS_H
+#define FEATURE_TARGETS_H
+
+#include "raylib.h"
+#include "CustomCamera.h"
+#include <functional>
+
+// First-hit albedo, normal and depth of the view, rendered by the raytracing shader with featureOutput
+// They guide the denoiser and give the temporal filter the depth to reproject with
+class FeatureTargets {
+private:
+    RenderTexture2D albedoDepth; // Albedo to divide out in rgb, depth in alpha
+    RenderTexture2D normals; // First-hit normals, zero for the sky and lights
+
+    // Raytracing shader and its featureOutput uniform, reset to radiance after the features are drawn
+    Shader featureShader;
+    int featureOutputLoc;
+
+    // What the features were rendered for, they are only rendered again when the view changes
+    CameraView featuresView;
+    bool featuresValid = false;
+
+public:
+    FeatureTargets(int width, int height, Shader raytracingShader);
+    ~FeatureTargets();
+
+    FeatureTargets(const FeatureTargets&) = delete;
+    FeatureTargets& operator=(const FeatureTargets&) = delete;
+
+    // Render the features unless they are still valid for the view
+    // drawRaytracing draws the raytracing shader over the whole target, its camera uniforms must show the view
+    void update(const CameraView& view, const std::function<void()>& drawRaytracing);
+    // The scene changed, the next update() renders the features again
+    void invalidate();
+    // Reallocate the targets for another render size
+    void resize(int width, int height);
+
+    const Texture2D& getAlbedoDepth() const;
+    const Texture2D& getNormals() const;
+};
+
+#endif // FEATURE_TARGETS_H
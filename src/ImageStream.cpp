@@ -0,0 +1,198 @@
+#include "ImageStream.h"
+#include <algorithm>
+#include <cstring>
+
+// Largest stored deflate block
+static const size_t maxStoredBlock = 65535;
+
+static uint32_t crcTable[256];
+
+static void initCrcTable() {
+    if (crcTable[1] != 0) return;
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+}
+
+static uint32_t updateCrc(uint32_t crc, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t updateAdler(uint32_t adler, const unsigned char* data, size_t size) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        // 5552 bytes is the most that cannot overflow b before the modulo
+        size_t count = std::min(size, (size_t)5552);
+        for (size_t i = 0; i < count; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += count;
+        size -= count;
+    }
+    return (b << 16) | a;
+}
+
+static void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+// 64-bit offsets, a 32k x 32k PFM is 12 GB
+static bool seekFile(FILE* file, long long offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+
+
+
+
+
+// -----------------------
+// --- PngStreamWriter ---
+// -----------------------
+
+PngStreamWriter::~PngStreamWriter() {
+    if (file) fclose(file);
+}
+
+bool PngStreamWriter::writeChunk(const char* type, const unsigned char* data, size_t size) {
+    unsigned char header[8] = {
+        (unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size,
+        (unsigned char)type[0], (unsigned char)type[1], (unsigned char)type[2], (unsigned char)type[3]
+    };
+    uint32_t crc = updateCrc(0xFFFFFFFFu, header + 4, 4);
+    crc = updateCrc(crc, data, size) ^ 0xFFFFFFFFu;
+    unsigned char footer[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+
+    return fwrite(header, 1, 8, file) == 8 && (size == 0 || fwrite(data, 1, size, file) == size) && fwrite(footer, 1, 4, file) == 4;
+}
+
+bool PngStreamWriter::open(const char* fileName, int widthValue, int heightValue) {
+    initCrcTable();
+    width = widthValue;
+    height = heightValue;
+    rowsWritten = 0;
+    adler = 1;
+
+    file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        TraceLog(LOG_WARNING, "Could not open %s for writing", fileName);
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<unsigned char> header;
+    appendBigEndian(header, (uint32_t)width);
+    appendBigEndian(header, (uint32_t)height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8-bit RGB, deflate, adaptive filters, no interlacing
+
+    // zlib header: deflate with a 32k window, no dictionary, fastest level
+    static const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+    if (fwrite(signature, 1, 8, file) != 8 || !writeChunk("IHDR", header.data(), header.size()) || !writeChunk("IDAT", zlibHeader, 2)) {
+        TraceLog(LOG_WARNING, "Could not write %s", fileName);
+        return false;
+    }
+    return true;
+}
+
+bool PngStreamWriter::writeRows(const unsigned char* rgb, int rows) {
+    if (file == nullptr || rowsWritten + rows > height) return false;
+
+    // Every row starts with filter type 0 (none)
+    size_t rowBytes = (size_t)width * 3 + 1;
+    std::vector<unsigned char> raw(rowBytes * rows);
+    for (int row = 0; row < rows; row++) {
+        raw[row * rowBytes] = 0;
+        memcpy(&raw[row * rowBytes + 1], rgb + (size_t)row * width * 3, (size_t)width * 3);
+    }
+    adler = updateAdler(adler, raw.data(), raw.size());
+    rowsWritten += rows;
+
+    // Stored blocks, the last block of the image is marked final and followed by the Adler-32
+    chunk.clear();
+    for (size_t offset = 0; offset < raw.size(); offset += maxStoredBlock) {
+        size_t size = std::min(maxStoredBlock, raw.size() - offset);
+        bool lastBlock = rowsWritten == height && offset + size == raw.size();
+        chunk.push_back(lastBlock ? 1 : 0);
+        chunk.push_back((unsigned char)size);
+        chunk.push_back((unsigned char)(size >> 8));
+        chunk.push_back((unsigned char)~size);
+        chunk.push_back((unsigned char)(~size >> 8));
+        chunk.insert(chunk.end(), raw.begin() + offset, raw.begin() + offset + size);
+    }
+    if (rowsWritten == height) appendBigEndian(chunk, adler);
+
+    return writeChunk("IDAT", chunk.data(), chunk.size());
+}
+
+bool PngStreamWriter::close() {
+    if (file == nullptr) return false;
+    bool complete = rowsWritten == height && writeChunk("IEND", nullptr, 0);
+    complete = fclose(file) == 0 && complete;
+    file = nullptr;
+    return complete;
+}
+
+
+
+
+
+
+// -----------------------
+// --- PfmStreamWriter ---
+// -----------------------
+
+PfmStreamWriter::~PfmStreamWriter() {
+    if (file) fclose(file);
+}
+
+bool PfmStreamWriter::open(const char* fileName, int widthValue, int heightValue) {
+    width = widthValue;
+    height = heightValue;
+    failed = false;
+
+    file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        TraceLog(LOG_WARNING, "Could not open %s for writing", fileName);
+        return false;
+    }
+
+    // A negative scale marks little-endian floats
+    int written = fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+    failed = written <= 0;
+    headerSize = written;
+    return !failed;
+}
+
+bool PfmStreamWriter::writeRowSpan(int x, int row, const Vector3* pixels, int count) {
+    if (file == nullptr || failed) return false;
+
+    // PFM rows go from the bottom up
+    long long offset = headerSize + ((long long)(height - 1 - row) * width + x) * (long long)(sizeof(float) * 3);
+    failed = !seekFile(file, offset) || fwrite(pixels, sizeof(float) * 3, count, file) != (size_t)count;
+    return !failed;
+}
+
+bool PfmStreamWriter::close() {
+    if (file == nullptr) return false;
+    bool complete = fclose(file) == 0 && !failed;
+    file = nullptr;
+    return complete;
+}
@@ -0,0 +1,59 @@
+#ifndef IMAGE_STREAM_H
+#define IMAGE_STREAM_H
+
+#include "raylib.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// 8-bit RGB PNG written from the top down a few rows at a time, the image never has to be in memory
+// Rows go into stored (uncompressed) deflate blocks, so the file is about as large as the raw pixels
+class PngStreamWriter {
+private:
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    int rowsWritten = 0;
+    uint32_t adler = 1; // Adler-32 of the uncompressed data, ends the zlib stream
+    std::vector<unsigned char> chunk; // IDAT chunk being built
+
+    bool writeChunk(const char* type, const unsigned char* data, size_t size);
+
+public:
+    PngStreamWriter() = default;
+    ~PngStreamWriter();
+
+    PngStreamWriter(const PngStreamWriter&) = delete;
+    PngStreamWriter& operator=(const PngStreamWriter&) = delete;
+
+    bool open(const char* fileName, int width, int height);
+    // Append rows * width RGB pixels below the rows written so far
+    bool writeRows(const unsigned char* rgb, int rows);
+    // Fails if not every row was written
+    bool close();
+};
+
+// Little-endian PFM of linear radiance whose rows can be written in any order, for tiles
+class PfmStreamWriter {
+private:
+    FILE* file = nullptr;
+    int width = 0;
+    int height = 0;
+    long long headerSize = 0;
+    bool failed = false;
+
+public:
+    PfmStreamWriter() = default;
+    ~PfmStreamWriter();
+
+    PfmStreamWriter(const PfmStreamWriter&) = delete;
+    PfmStreamWriter& operator=(const PfmStreamWriter&) = delete;
+
+    bool open(const char* fileName, int width, int height);
+    // Write count pixels of one row starting at column x, rows are counted from the top
+    bool writeRowSpan(int x, int row, const Vector3* pixels, int count);
+    // Fails if any write failed
+    bool close();
+};
+
+#endif // IMAGE_STREAM_H
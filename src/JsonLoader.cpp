@@ -1,203 +1,486 @@
 #include "raylib.h"
 #include "JsonLoader.h"
-#include <sstream>
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "SceneCache.h"
+#include "raymath.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
-#define MAX_MATERIALS 32
-#define MAX_SPHERES 32
-#define MAX_QUADS 32
+// Powers of ten that are exact in a double
+static const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-// Helper function to read a file into a string using raylib
-std::string readFile(const std::string& filePath) {
-    char* fileData = LoadFileText(filePath.c_str());
-    if (!fileData) {
+// Numbers with at most 19 digits and a small exponent are exact without strtod (Clinger's fast path)
+const char* parseNumber(const char* p, const char* end, double& out) {
+    const char* start = p;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+
+    const char* integerStart = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+        } else {
+            exponent++;
+            truncated = true;
+        }
+        p++;
+    }
+    if (p == integerStart) return nullptr;
+
+    if (p < end && *p == '.') {
+        p++;
+        const char* fractionStart = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits++;
+                exponent--;
+            } else {
+                truncated = true;
+            }
+            p++;
+        }
+        if (p == fractionStart) return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exponentSign = 1;
+        if (p < end && (*p == '+' || *p == '-')) {
+            exponentSign = *p == '-' ? -1 : 1;
+            p++;
+        }
+        const char* exponentStart = p;
+        int value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value < 10000) value = value * 10 + (*p - '0');
+            p++;
+        }
+        if (p == exponentStart) return nullptr;
+        exponent += exponentSign * value;
+    }
+
+    if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / exactPowersOfTen[-exponent] : value * exactPowersOfTen[exponent];
+        out = negative ? -value : value;
+        return p;
+    }
+
+    // Rare long or huge numbers, strtod needs a terminated copy
+    std::string copy(start, p);
+    out = strtod(copy.c_str(), nullptr);
+    return p;
+}
+
+// Arrays and objects skipValue() descends into before it gives up, deeper files would overflow the stack
+static const int maxSkipDepth = 256;
+
+// Single-pass JSON reader over a file buffer
+// Keys and strings are views into the buffer and numbers are parsed in place, nothing is copied
+class JsonReader {
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+    const std::string& filePath;
+    bool hasFailed = false;
+    int skipDepth = 0; // Arrays and objects skipValue() is inside of
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    }
+
+public:
+    JsonReader(const char* data, size_t size, const std::string& filePathRef) : begin(data), p(data), end(data + size), filePath(filePathRef) {
+        // Skip a UTF-8 byte order mark
+        if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) p += 3;
+    }
+
+    // Log the message with the line and column of the current position, always returns false
+    bool error(const char* message) {
+        if (hasFailed) return false;
+        hasFailed = true;
+
+        int line = 1;
+        const char* lineStart = begin;
+        for (const char* c = begin; c < p; c++) {
+            if (*c == '\n') {
+                line++;
+                lineStart = c + 1;
+            }
+        }
+        TraceLog(LOG_ERROR, "%s:%d:%d: %s", filePath.c_str(), line, (int)(p - lineStart) + 1, message);
+        return false;
+    }
+
+    // Consume c if it is the next character
+    bool consume(char c) {
+        skipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(char c, const char* message) {
+        return consume(c) || error(message);
+    }
+
+    bool atEnd() {
+        skipWhitespace();
+        return p == end;
+    }
+
+    // Strings are returned without their quotes, escapes are kept as they are
+    bool readString(std::string_view& out) {
+        if (!expect('"', "Expected a string")) return false;
+        const char* start = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') p++;
+            p++;
+        }
+        if (p >= end) return error("Unterminated string");
+        out = std::string_view(start, p - start);
+        p++;
+        return true;
+    }
+
+    bool readFloat(float& out) {
+        skipWhitespace();
+        double value;
+        const char* next = parseNumber(p, end, value);
+        if (!next) return error("Expected a number");
+        out = (float)value;
+        p = next;
+        return true;
+    }
+
+    bool readInt(int& out) {
+        skipWhitespace();
+        std::from_chars_result result = std::from_chars(p, end, out);
+        if (result.ec != std::errc()) return error("Expected an integer");
+        if (result.ptr < end && (*result.ptr == '.' || *result.ptr == 'e' || *result.ptr == 'E')) return error("Expected an integer, not a fraction");
+        p = result.ptr;
+        return true;
+    }
+
+    // Integer in [0, count), anything else is reported at the number, so an index never points past its array
+    bool readIndex(int& out, int count, const char* what) {
+        skipWhitespace();
+        const char* start = p;
+        if (!readInt(out)) return false;
+        if (out >= 0 && out < count) return true;
+        p = start;
+        return error(TextFormat("%s %d is out of range, it has to be below %d", what, out, count));
+    }
+
+    // [x, y, z]
+    bool readVector3(Vector3& out) {
+        return expect('[', "Expected '[' to start a vector")
+            && readFloat(out.x) && expect(',', "Expected ',' in vector")
+            && readFloat(out.y) && expect(',', "Expected ',' in vector")
+            && readFloat(out.z) && expect(']', "Expected ']' after the 3 vector components");
+    }
+
+    // Skip any value, including nested arrays and objects
+    bool skipValue() {
+        skipWhitespace();
+        if (p >= end) return error("Expected a value");
+
+        if (*p == '"') {
+            std::string_view ignored;
+            return readString(ignored);
+        }
+        if (*p == '[' || *p == '{') {
+            if (skipDepth >= maxSkipDepth) return error("Values are nested too deeply");
+            skipDepth++;
+            bool ok = *p == '[' ? readArray([this]() { return skipValue(); }) : readObject([this](std::string_view) { return skipValue(); });
+            skipDepth--;
+            return ok;
+        }
+        const char* literals[] = { "true", "false", "null" };
+        for (const char* literal : literals) {
+            size_t length = strlen(literal);
+            if ((size_t)(end - p) >= length && memcmp(p, literal, length) == 0) {
+                p += length;
+                return true;
+            }
+        }
+        double ignored;
+        const char* next = parseNumber(p, end, ignored);
+        if (!next) return error("Unexpected character");
+        p = next;
+        return true;
+    }
+
+    // [element, element, ...], element() reads one value
+    template <typename Element>
+    bool readArray(Element&& element) {
+        if (!expect('[', "Expected '['")) return false;
+        if (consume(']')) return true;
+        do {
+            if (!element()) return false;
+        } while (consume(','));
+        return expect(']', "Expected ',' or ']'");
+    }
+
+    // {"key": value, ...}, member(key) reads the value of one member
+    template <typename Member>
+    bool readObject(Member&& member) {
+        if (!expect('{', "Expected '{'")) return false;
+        if (consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!readString(key) || !expect(':', "Expected ':' after key")) return false;
+            if (!member(key)) return false;
+        } while (consume(','));
+        return expect('}', "Expected ',' or '}'");
+    }
+};
+
+// Read a top-level array of objects into objects, every object starts as a copy of defaults
+// member(key, reader, object) parses the value of one member, the mapped file is read once
+template <typename T, typename Member>
+static bool loadObjectArray(const std::string& filePath, const char* what, size_t bytesPerObject, const T& defaults, std::vector<T>& objects, Member&& member) {
+    objects.clear();
+
+    MappedFile file;
+    if (!file.open(filePath)) {
         TraceLog(LOG_ERROR, "Failed to open file: %s", filePath.c_str());
-        return "";
+        return false;
     }
-    std::string fileContent(fileData);
-    UnloadFileText(fileData);
-    return fileContent;
+    size_t fileSize = file.size();
+
+    auto start = std::chrono::steady_clock::now();
+
+    // One allocation for typical files, the estimate only has to be close
+    objects.reserve(fileSize / bytesPerObject + 1);
+
+    JsonReader reader((const char*)file.data(), fileSize, filePath);
+    bool ok = reader.readArray([&]() {
+        objects.push_back(defaults);
+        return reader.readObject([&](std::string_view key) { return member(key, reader, objects.back()); });
+    });
+    if (ok && !reader.atEnd()) ok = reader.error("Unexpected data after the top-level array");
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!ok) {
+        objects.clear();
+        return false;
+    }
+    double megabytes = fileSize / (1024.0 * 1024.0);
+    TraceLog(LOG_INFO, "Loaded %d %s from %s: %.2f MB in %.2f ms (%.1f MB/s)", (int)objects.size(), what, filePath.c_str(), megabytes, seconds * 1000.0, seconds > 0.0 ? megabytes / seconds : 0.0);
+    return true;
 }
 
 // Function to parse materials from JSON
-void loadMaterials(const std::string& filePath, int* materialType, Vector3* materialAlbedo, Vector3* materialEmmisiveColor, float* materialFuzz, float* materialRefractionIndex, std::string* materialTextures) {
-    std::string json = readFile(filePath);
-    size_t start = 0, end = 0;
-    int index = 0;
-
-    while ((start = json.find("{", end)) != std::string::npos && index < MAX_MATERIALS) {
-        end = json.find("}", start);
-        std::string material = json.substr(start, end - start + 1);
-
-        // Parse material type
-        size_t typePos = material.find("\"type\":");
-        if (typePos != std::string::npos) {
-            materialType[index] = std::stoi(material.substr(typePos + 7));
-        }
-
-        // Parse albedo
-        size_t albedoPos = material.find("\"albedo\":");
-        if (albedoPos != std::string::npos) {
-            size_t albedoStart = material.find("[", albedoPos);
-            size_t albedoEnd = material.find("]", albedoStart);
-            std::string albedo = material.substr(albedoStart + 1, albedoEnd - albedoStart - 1);
-
-            std::stringstream albedoStream(albedo);
-            albedoStream >> materialAlbedo[index].x;
-            albedoStream.ignore(1); // Skip comma
-            albedoStream >> materialAlbedo[index].y;
-            albedoStream.ignore(1); // Skip comma
-            albedoStream >> materialAlbedo[index].z;
-        }
-
-        // Parse emmisiveColor
-        size_t emmisiveColorPos = material.find("\"emmisiveColor\":");
-        if (emmisiveColorPos != std::string::npos) {
-            size_t emmisiveColorStart = material.find("[", emmisiveColorPos);
-            size_t emmisiveColorEnd = material.find("]", emmisiveColorStart);
-            std::string emmisiveColor = material.substr(emmisiveColorStart + 1, emmisiveColorEnd - emmisiveColorStart - 1);
-
-            std::stringstream emmisiveColorStream(emmisiveColor);
-            emmisiveColorStream >> materialEmmisiveColor[index].x;
-            emmisiveColorStream.ignore(1); // Skip comma
-            emmisiveColorStream >> materialEmmisiveColor[index].y;
-            emmisiveColorStream.ignore(1); // Skip comma
-            emmisiveColorStream >> materialEmmisiveColor[index].z;
-        }
-
-        // Parse fuzz
-        size_t fuzzPos = material.find("\"fuzz\":");
-        if (fuzzPos != std::string::npos) {
-            materialFuzz[index] = std::stof(material.substr(fuzzPos + 7));
-        }
-
-        // Parse refraction index
-        size_t refractionPos = material.find("\"refractionIndex\":");
-        if (refractionPos != std::string::npos) {
-            materialRefractionIndex[index] = std::stof(material.substr(refractionPos + 18));
-        }
-
-        // Parse texture
-        size_t texturePos = material.find("\"texture\":");
-        if (texturePos != std::string::npos) {
-            size_t textureStart = material.find("\"", texturePos + 10) + 1;
-            size_t textureEnd = material.find("\"", textureStart);
-            if (textureStart != std::string::npos && textureEnd != std::string::npos) {
-                std::string textureFile = material.substr(textureStart, textureEnd - textureStart);
-                materialTextures[index] = "world/" + textureFile;
-            } else {
-                materialTextures[index] = "";
-            }
+bool loadMaterials(const std::string& filePath, std::vector<Material>& materials) {
+    std::string directory = GetDirectoryPath(filePath.c_str());
+
+    bool ok = loadObjectArray(filePath, "materials", 64, Material(), materials, [&](std::string_view key, JsonReader& reader, Material& result) {
+        if (key == "type") return reader.readIndex(result.type, MATERIAL_TYPE_COUNT, "Material type");
+        if (key == "albedo") return reader.readVector3(result.albedo);
+        if (key == "emmisiveColor") return reader.readVector3(result.emmisiveColor);
+        if (key == "fuzz") return reader.readFloat(result.fuzz);
+        if (key == "refractionIndex") return reader.readFloat(result.refractionIndex);
+        if (key == "texture") {
+            std::string_view textureFile;
+            if (!reader.readString(textureFile)) return false;
+            result.texturePath = directory + "/" + std::string(textureFile);
+            return true;
         }
+        return reader.skipValue();
+    });
 
-        index++;
+    // Objects use material 0 when they do not name one, so there always is one
+    if (ok && materials.empty()) {
+        TraceLog(LOG_WARNING, "%s has no materials, using a default one", filePath.c_str());
+        materials.push_back(Material());
     }
+    return ok;
 }
 
 // Function to parse spheres from JSON
-void loadSpheres(const std::string& filePath, Vector4* spheres, int* sphereMaterialIndices, int& spheresAmount) {
-    std::string json = readFile(filePath);
-    size_t start = 0, end = 0;
-    spheresAmount = 0;
-
-    while ((start = json.find("{", end)) != std::string::npos && spheresAmount < MAX_SPHERES) {
-        end = json.find("}", start);
-        std::string sphere = json.substr(start, end - start + 1);
-
-        // Parse position
-        size_t positionPos = sphere.find("\"position\":");
-        if (positionPos != std::string::npos) {
-            size_t positionStart = sphere.find("[", positionPos);
-            size_t positionEnd = sphere.find("]", positionStart);
-            std::string position = sphere.substr(positionStart + 1, positionEnd - positionStart - 1);
-
-            std::stringstream positionStream(position);
-            positionStream >> spheres[spheresAmount].x;
-            positionStream.ignore(1); // Skip comma
-            positionStream >> spheres[spheresAmount].y;
-            positionStream.ignore(1); // Skip comma
-            positionStream >> spheres[spheresAmount].z;
-        }
-
-        // Parse radius
-        size_t radiusPos = sphere.find("\"radius\":");
-        if (radiusPos != std::string::npos) {
-            spheres[spheresAmount].w = std::stof(sphere.substr(radiusPos + 9));
-        }
-
-        // Parse material index
-        size_t materialIndexPos = sphere.find("\"materialIndex\":");
-        if (materialIndexPos != std::string::npos) {
-            sphereMaterialIndices[spheresAmount] = std::stoi(sphere.substr(materialIndexPos + 16));
-        } else {
-            TraceLog(LOG_WARNING, "Sphere %d does not have a materialIndex field!", spheresAmount);
-        }
+bool loadSpheres(const std::string& filePath, int materialCount, std::vector<Sphere>& spheres) {
+    // materialIndex starts at -1 to find spheres without one
+    Sphere defaults = { { 0.0f, 0.0f, 0.0f }, 0.0f, -1 };
+
+    bool ok = loadObjectArray(filePath, "spheres", 64, defaults, spheres, [&](std::string_view key, JsonReader& reader, Sphere& result) {
+        if (key == "position") return reader.readVector3(result.center);
+        if (key == "radius") return reader.readFloat(result.radius);
+        if (key == "materialIndex") return reader.readIndex(result.materialIndex, materialCount, "materialIndex");
+        return reader.skipValue();
+    });
 
-        spheresAmount++;
+    for (size_t i = 0; i < spheres.size(); i++) {
+        if (spheres[i].materialIndex < 0) {
+            TraceLog(LOG_WARNING, "Sphere %d does not have a materialIndex field!", (int)i);
+            spheres[i].materialIndex = 0;
+        }
     }
+    return ok;
 }
 
 // Function to parse quads from JSON
-void loadQuads(const std::string& filePath, Vector3* quadOrigins, Vector3* quadEdgesU, Vector3* quadEdgesV, int* quadMaterialIndices, int& quadsAmount) {
-    std::string json = readFile(filePath);
-    size_t start = 0, end = 0;
-    quadsAmount = 0;
-
-    while ((start = json.find("{", end)) != std::string::npos && quadsAmount < MAX_QUADS) {
-        end = json.find("}", start);
-        std::string quad = json.substr(start, end - start + 1);
-
-        // Parse origin
-        size_t originPos = quad.find("\"origin\":");
-        if (originPos != std::string::npos) {
-            size_t originStart = quad.find("[", originPos);
-            size_t originEnd = quad.find("]", originStart);
-            std::string origin = quad.substr(originStart + 1, originEnd - originStart - 1);
-
-            std::stringstream originStream(origin);
-            originStream >> quadOrigins[quadsAmount].x;
-            originStream.ignore(1); // Skip comma
-            originStream >> quadOrigins[quadsAmount].y;
-            originStream.ignore(1); // Skip comma
-            originStream >> quadOrigins[quadsAmount].z;
-        }
-
-        // Parse edgeU
-        size_t edgeUPos = quad.find("\"edgeU\":");
-        if (edgeUPos != std::string::npos) {
-            size_t edgeUStart = quad.find("[", edgeUPos);
-            size_t edgeUEnd = quad.find("]", edgeUStart);
-            std::string edgeU = quad.substr(edgeUStart + 1, edgeUEnd - edgeUStart - 1);
-
-            std::stringstream edgeUStream(edgeU);
-            edgeUStream >> quadEdgesU[quadsAmount].x;
-            edgeUStream.ignore(1); // Skip comma
-            edgeUStream >> quadEdgesU[quadsAmount].y;
-            edgeUStream.ignore(1); // Skip comma
-            edgeUStream >> quadEdgesU[quadsAmount].z;
-        }
-
-        // Parse edgeV
-        size_t edgeVPos = quad.find("\"edgeV\":");
-        if (edgeVPos != std::string::npos) {
-            size_t edgeVStart = quad.find("[", edgeVPos);
-            size_t edgeVEnd = quad.find("]", edgeVStart);
-            std::string edgeV = quad.substr(edgeVStart + 1, edgeVEnd - edgeVStart - 1);
-
-            std::stringstream edgeVStream(edgeV);
-            edgeVStream >> quadEdgesV[quadsAmount].x;
-            edgeVStream.ignore(1); // Skip comma
-            edgeVStream >> quadEdgesV[quadsAmount].y;
-            edgeVStream.ignore(1); // Skip comma
-            edgeVStream >> quadEdgesV[quadsAmount].z;
-        }
-
-        // Parse material index
-        size_t materialIndexPos = quad.find("\"materialIndex\":");
-        if (materialIndexPos != std::string::npos) {
-            quadMaterialIndices[quadsAmount] = std::stoi(quad.substr(materialIndexPos + 16));
-        }
-
-        quadsAmount++;
+bool loadQuads(const std::string& filePath, int materialCount, std::vector<Quad>& quads) {
+    Quad defaults = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f }, 0 };
+
+    return loadObjectArray(filePath, "quads", 96, defaults, quads, [&](std::string_view key, JsonReader& reader, Quad& result) {
+        if (key == "origin") return reader.readVector3(result.origin);
+        if (key == "edgeU") return reader.readVector3(result.edgeU);
+        if (key == "edgeV") return reader.readVector3(result.edgeV);
+        if (key == "materialIndex") return reader.readIndex(result.materialIndex, materialCount, "materialIndex");
+        return reader.skipValue();
+    });
+}
+
+// Function to parse meshes from JSON and load their OBJ files, worlds without meshes.json have no meshes
+// Every OBJ file is loaded once per set of materials, its entries become instances of that mesh
+bool loadMeshes(const std::string& filePath, int materialCount, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles, std::vector<Mesh>& meshes, std::vector<Instance>& instances) {
+    vertices.clear();
+    triangles.clear();
+    meshes.clear();
+    instances.clear();
+    if (!FileExists(filePath.c_str())) return true;
+
+    std::string directory = GetDirectoryPath(filePath.c_str());
+    std::vector<MeshInstance> entries;
+    bool ok = loadObjectArray(filePath, "meshes", 96, MeshInstance(), entries, [&](std::string_view key, JsonReader& reader, MeshInstance& result) {
+        if (key == "file") {
+            std::string_view meshFile;
+            if (!reader.readString(meshFile)) return false;
+            result.filePath = directory + "/" + std::string(meshFile);
+            return true;
+        }
+        if (key == "position") return reader.readVector3(result.position);
+        if (key == "scale") return reader.readFloat(result.scale);
+        if (key == "rotation") return reader.readVector3(result.rotation);
+        if (key == "materialIndex") return reader.readIndex(result.materialIndex, materialCount, "materialIndex");
+        if (key == "materials") {
+            return reader.readObject([&](std::string_view name) {
+                int index;
+                if (!reader.readIndex(index, materialCount, "Material")) return false;
+                result.materialNames.emplace_back(std::string(name), index);
+                return true;
+            });
+        }
+        return reader.skipValue();
+    });
+    if (!ok) return false;
+
+    // Mesh of every file and material combination, -1 for files that failed to load or have no faces
+    std::unordered_map<std::string, int> meshIndices;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const MeshInstance& entry = entries[i];
+        if (entry.filePath.empty()) {
+            TraceLog(LOG_WARNING, "Mesh %d does not have a file field!", (int)i);
+            continue;
+        }
+        if (!(entry.scale > 0.0f)) {
+            TraceLog(LOG_WARNING, "Mesh %d has a scale of %g, it needs to be positive", (int)i, entry.scale);
+            continue;
+        }
+
+        std::string key = entry.filePath + '\n' + std::to_string(entry.materialIndex);
+        for (const std::pair<std::string, int>& name : entry.materialNames) {
+            key += '\n' + name.first + '=' + std::to_string(name.second);
+        }
+        auto found = meshIndices.find(key);
+        if (found == meshIndices.end()) {
+            Mesh mesh = { (int)triangles.size(), 0, -1 };
+            bool loaded = loadObj(entry, materialCount, vertices, triangles);
+            ok = loaded && ok;
+            mesh.triangleCount = (int)triangles.size() - mesh.firstTriangle;
+            int meshIndex = -1;
+            if (loaded && mesh.triangleCount > 0) {
+                meshIndex = (int)meshes.size();
+                meshes.push_back(mesh);
+            }
+            found = meshIndices.emplace(key, meshIndex).first;
+        }
+        if (found->second < 0) continue;
+
+        Vector3 angles = Vector3Scale(entry.rotation, DEG2RAD);
+        instances.push_back({ entry.position, entry.scale, QuaternionFromEuler(angles.x, angles.y, angles.z), found->second });
+    }
+    if (!instances.empty()) {
+        TraceLog(LOG_INFO, "Meshes: %d instances of %d meshes", (int)instances.size(), (int)meshes.size());
+    }
+    return ok;
+}
+
+// Function to load the whole world folder into a Scene
+bool loadScene(const std::string& worldPath, Scene& scene) {
+    // The binary cache skips parsing and the BVH build while the JSON files stay the same
+    std::string cachePath = worldPath + "/" + SCENE_CACHE_FILE_NAME;
+    uint64_t sourceHash = hashSceneSources(worldPath);
+    if (loadSceneCache(cachePath, sourceHash, scene)) {
+        buildSceneLights(scene);
+        return true;
     }
+
+    std::vector<Sphere> spheres;
+    std::vector<Quad> quads;
+    std::vector<MeshVertex> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+    bool ok = loadMaterials(worldPath + "/materials.json", scene.materials);
+    // A broken materials.json still leaves the default material for the objects
+    if (scene.materials.empty()) scene.materials.push_back(Material());
+    int materialCount = (int)scene.materials.size();
+    ok = loadSpheres(worldPath + "/spheres.json", materialCount, spheres) && ok;
+    ok = loadQuads(worldPath + "/quads.json", materialCount, quads) && ok;
+    ok = loadMeshes(worldPath + "/meshes.json", materialCount, vertices, triangles, meshes, instances) && ok;
+    scene.spheres.assign(std::move(spheres));
+    scene.quads.assign(std::move(quads));
+    scene.vertices.assign(std::move(vertices));
+    scene.triangles.assign(std::move(triangles));
+    scene.meshes.assign(std::move(meshes));
+    scene.instances.assign(std::move(instances));
+    scene.cacheFile.reset();
+    buildSceneBvh(scene);
+    buildSceneLights(scene);
+
+    // Broken files are not cached so their errors keep being reported
+    if (ok) writeSceneCache(cachePath, sourceHash, scene);
+    return ok;
+}
+
+// Function to parse a camera path from JSON
+bool loadCameraPath(const std::string& filePath, std::vector<CameraKeyframe>& keyframes) {
+    bool ok = loadObjectArray(filePath, "camera keyframes", 128, CameraKeyframe(), keyframes, [](std::string_view key, JsonReader& reader, CameraKeyframe& result) {
+        if (key == "frame") return reader.readInt(result.frame);
+        if (key == "position") return reader.readVector3(result.position);
+        if (key == "target") return reader.readVector3(result.target);
+        if (key == "fovy") return reader.readFloat(result.fovy);
+        if (key == "defocusAngle") return reader.readFloat(result.defocusAngle);
+        return reader.skipValue();
+    });
+
+    std::stable_sort(keyframes.begin(), keyframes.end(), [](const CameraKeyframe& a, const CameraKeyframe& b) { return a.frame < b.frame; });
+    return ok;
 }
@@ -2,11 +2,24 @@
 #define JSONLOADER_H
 
 #include "raylib.h"
+#include "CameraPath.h"
+#include "Scene.h"
 #include <string>
+#include <vector>
 
-// Function declarations
-void loadMaterials(const std::string& filePath, int* materialType, Vector3* materialAlbedo, Vector3* materialEmmisiveColor, float* materialFuzz, float* materialRefractionIndex, std::string* materialTextures);
-void loadSpheres(const std::string& filePath, Vector4* spheres, int* sphereMaterialIndices, int& spheresAmount);
-void loadQuads(const std::string& filePath, Vector3* quadOrigins, Vector3* quadEdgesU, Vector3* quadEdgesV, int* quadMaterialIndices, int& quadsAmount);
+// Parse a JSON number starting at p, returns the end of the number or nullptr if there is none
+const char* parseNumber(const char* p, const char* end, double& out);
+
+// Each loader parses its file in a single pass and logs the throughput in MB/s
+// Syntax errors are logged with line and column, the loader then returns false and leaves the vector empty
+// Material types and indices are checked the same way, indices have to be below materialCount
+// A materials.json without any materials loads one default material, so index 0 is always valid
+bool loadMaterials(const std::string& filePath, std::vector<Material>& materials);
+bool loadSpheres(const std::string& filePath, int materialCount, std::vector<Sphere>& spheres);
+bool loadQuads(const std::string& filePath, int materialCount, std::vector<Quad>& quads);
+bool loadMeshes(const std::string& filePath, int materialCount, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles, std::vector<Mesh>& meshes, std::vector<Instance>& instances);
+bool loadScene(const std::string& worldPath, Scene& scene);
+// Keyframes of a camera path, sorted by frame
+bool loadCameraPath(const std::string& filePath, std::vector<CameraKeyframe>& keyframes);
 
 #endif // JSONLOADER_H
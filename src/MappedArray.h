@@ -0,0 +1,56 @@
+#ifndef MAPPED_ARRAY_H
+#define MAPPED_ARRAY_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Read-only array that either owns its elements or views elements stored in a mapped file
+// Scenes loaded from the binary cache use views, so nothing is copied at startup
+template <typename T>
+class MappedArray {
+private:
+    std::vector<T> owned;
+    const T* mapped = nullptr; // nullptr while the elements are owned
+    size_t mappedCount = 0;
+
+public:
+    MappedArray() = default;
+    MappedArray(std::vector<T>&& values) : owned(std::move(values)) {}
+
+    // Take ownership of values
+    void assign(std::vector<T>&& values) {
+        owned = std::move(values);
+        mapped = nullptr;
+        mappedCount = 0;
+    }
+
+    // View count elements that live elsewhere, the caller keeps them alive
+    void assignMapped(const T* elements, size_t count) {
+        owned.clear();
+        owned.shrink_to_fit();
+        mapped = elements;
+        mappedCount = count;
+    }
+
+    // Owned storage for in-place changes, mapped elements are copied first
+    std::vector<T>& edit() {
+        if (mapped) {
+            owned.assign(mapped, mapped + mappedCount);
+            mapped = nullptr;
+            mappedCount = 0;
+        }
+        return owned;
+    }
+
+    bool isMapped() const { return mapped != nullptr; }
+
+    size_t size() const { return mapped ? mappedCount : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T* data() const { return mapped ? mapped : owned.data(); }
+    const T& operator[](size_t index) const { return data()[index]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+};
+
+#endif // MAPPED_ARRAY_H
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filePath) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    if (fileSize.QuadPart > 0) {
+        // The view keeps the mapping and the file alive, both handles can be closed right away
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            mappedData = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        if (!mappedData) {
+            CloseHandle(file);
+            return false;
+        }
+    }
+    CloseHandle(file);
+    mappedSize = (size_t)fileSize.QuadPart;
+#else
+    int file = ::open(filePath.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat fileInfo;
+    if (fstat(file, &fileInfo) != 0) {
+        ::close(file);
+        return false;
+    }
+
+    if (fileInfo.st_size > 0) {
+        void* data = mmap(nullptr, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            ::close(file);
+            return false;
+        }
+        mappedData = (const unsigned char*)data;
+    }
+    ::close(file);
+    mappedSize = (size_t)fileInfo.st_size;
+#endif
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData) {
+#ifdef _WIN32
+        UnmapViewOfFile(mappedData);
+#else
+        munmap((void*)mappedData, mappedSize);
+#endif
+    }
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+const unsigned char* MappedFile::data() const {
+    return mappedData;
+}
+
+size_t MappedFile::size() const {
+    return mappedSize;
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file, pages are loaded on demand by the operating system
+// Kept free of raylib.h because windows.h clashes with its names
+class MappedFile {
+private:
+    const unsigned char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    bool opened = false;
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file does not exist or cannot be mapped, empty files map to nullptr
+    bool open(const std::string& filePath);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    size_t size() const;
+};
+
+#endif // MAPPED_FILE_H
@@ -1,8 +1,9 @@
 #include "MenuSystem.h"
+#include "DynamicResolution.h"
 
 MenuSystem::MenuSystem(CustomCamera& cameraRef) 
     : isVisible(false), camera(cameraRef), samples(8), maxBounces(3), gamma(1.6f), backgroundOpacity(1.0f) {
-    menuRect = { 50, 50, 450, 500 };
+    menuRect = { 50, 50, 450, 990 };
 }
 
 void MenuSystem::toggleVisibility() {
@@ -35,6 +36,37 @@ void MenuSystem::update() {
     // Adjust defocusAngle using K/L keys
     if (IsKeyPressed(KEY_K)) defocusAngle = fmax(defocusAngle - 0.001f, 0.0f);
     if (IsKeyPressed(KEY_L)) defocusAngle = fmin(defocusAngle + 0.001f, 10.0f);
+
+    // Toggle progressive accumulation using M key
+    if (IsKeyPressed(KEY_M)) progressive = !progressive;
+
+    // Toggle the denoiser using D key
+    if (IsKeyPressed(KEY_D)) denoise = !denoise;
+
+    // Toggle temporal reprojection using A key
+    if (IsKeyPressed(KEY_A)) temporal = !temporal;
+
+    // Adjust the adaptive sampling noise target using U/I keys, halving it below 0.5% turns it off
+    if (IsKeyPressed(KEY_U)) noiseTarget = noiseTarget > 0.005f ? noiseTarget / 2.0f : 0.0f;
+    if (IsKeyPressed(KEY_I)) noiseTarget = noiseTarget > 0.0f ? fmin(noiseTarget * 2.0f, 0.64f) : 0.005f;
+
+    // Switch between the Sobol and PCG samplers using S key
+    if (IsKeyPressed(KEY_S)) sampler = sampler == SAMPLER_SOBOL ? SAMPLER_PCG : SAMPLER_SOBOL;
+
+    // Adjust the high-quality render samples using J/O keys
+    if (IsKeyPressed(KEY_J)) highQualitySamples = fmax(highQualitySamples / 2, 1);
+    if (IsKeyPressed(KEY_O)) highQualitySamples = highQualitySamples * 2;
+
+    // Toggle float image output using F key
+    if (IsKeyPressed(KEY_F)) floatOutput = !floatOutput;
+
+    // Adjust the tiled render resolution using R/V keys
+    if (IsKeyPressed(KEY_R)) tiledScale = fmax(tiledScale / 2, 1);
+    if (IsKeyPressed(KEY_V)) tiledScale = fmin(tiledScale * 2, 32);
+
+    // Adjust the render scale using COMMA/PERIOD keys, above 100% it is automatic again
+    if (IsKeyPressed(KEY_COMMA)) renderScale = fmax((renderScale > 0.0f ? renderScale : 1.0f + DYNAMIC_RESOLUTION_STEP) - DYNAMIC_RESOLUTION_STEP, DYNAMIC_RESOLUTION_MIN_SCALE);
+    if (IsKeyPressed(KEY_PERIOD) && renderScale > 0.0f) renderScale = renderScale + DYNAMIC_RESOLUTION_STEP > 1.0f ? 0.0f : renderScale + DYNAMIC_RESOLUTION_STEP;
 }
 
 void MenuSystem::draw() {
@@ -43,24 +75,46 @@ void MenuSystem::draw() {
     DrawRectangleRec(menuRect, GRAY); // Menu background
     DrawText("Menu", menuRect.x + 10, menuRect.y + 10, 20, BLACK);
 
-    int lineSpacing = 30; // Spacing between each line
+    int lineSpacing = 28; // Spacing between each line
     int baseY = menuRect.y + 50; // Starting Y position for the text
 
     DrawText(TextFormat("FOV: %.1f", camera.camera.fovy), menuRect.x + 10, baseY, 20, BLACK);
     DrawText(TextFormat("Samples: %d", samples), menuRect.x + 10, baseY + lineSpacing, 20, BLACK);
-    DrawText(TextFormat("Max Bounces: %d", maxBounces), menuRect.x + 10, baseY + 2 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Bounces before Roulette: %d", maxBounces), menuRect.x + 10, baseY + 2 * lineSpacing, 20, BLACK);
     DrawText(TextFormat("Gamma: %.1f", gamma), menuRect.x + 10, baseY + 3 * lineSpacing, 20, BLACK);
     DrawText(TextFormat("Background Opacity: %.1f", backgroundOpacity), menuRect.x + 10, baseY + 4 * lineSpacing, 20, BLACK);
     DrawText(TextFormat("Defocus Angle: %.2f", defocusAngle), menuRect.x + 10, baseY + 5 * lineSpacing, 20, BLACK);
-
-    int instructionsBaseY = baseY + 6 * lineSpacing + 10; // Add extra spacing before instructions
+    DrawText(TextFormat("Progressive: %s", progressive ? "On" : "Off"), menuRect.x + 10, baseY + 6 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Accumulated Frames: %d", accumulatedFrames), menuRect.x + 10, baseY + 7 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Denoise: %s", denoise ? "On" : "Off"), menuRect.x + 10, baseY + 8 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Temporal Reprojection: %s", temporal ? "On" : "Off"), menuRect.x + 10, baseY + 9 * lineSpacing, 20, BLACK);
+    DrawText(noiseTarget > 0.0f ? TextFormat("Noise Target: %.1f%%", noiseTarget * 100.0f) : "Noise Target: Off", menuRect.x + 10, baseY + 10 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Sampler: %s", sampler == SAMPLER_SOBOL ? "Sobol (Owen)" : "PCG"), menuRect.x + 10, baseY + 11 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("High-Quality Samples: %d", highQualitySamples), menuRect.x + 10, baseY + 12 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Float Output (PFM): %s", floatOutput ? "On" : "Off"), menuRect.x + 10, baseY + 13 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Tiled Render Scale: %dx", tiledScale), menuRect.x + 10, baseY + 14 * lineSpacing, 20, BLACK);
+    DrawText(TextFormat("Scene Upload: %llu B/frame", (unsigned long long)sceneUploadBytes), menuRect.x + 10, baseY + 15 * lineSpacing, 20, BLACK);
+    const char* scaleText = TextFormat("Render Scale: %s%.1f%%", renderScale > 0.0f ? "" : "Auto ", currentRenderScale * 100.0f);
+    if (frameSamples < samples) scaleText = TextFormat("%s, %d spp", scaleText, frameSamples);
+    DrawText(renderMs > 0.0f ? TextFormat("%s (%.1f ms)", scaleText, renderMs) : scaleText, menuRect.x + 10, baseY + 16 * lineSpacing, 20, BLACK);
+
+    int instructionsBaseY = baseY + 17 * lineSpacing + 10; // Add extra spacing before instructions
     DrawText("Use UP/DOWN to adjust FOV", menuRect.x + 10, instructionsBaseY, 20, DARKGRAY);
     DrawText("Use LEFT/RIGHT to adjust Samples", menuRect.x + 10, instructionsBaseY + lineSpacing, 20, DARKGRAY);
-    DrawText("Use Z/X to adjust Max Bounces", menuRect.x + 10, instructionsBaseY + 2 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use Z/X to adjust Bounces", menuRect.x + 10, instructionsBaseY + 2 * lineSpacing, 20, DARKGRAY);
     DrawText("Use G/H to adjust Gamma", menuRect.x + 10, instructionsBaseY + 3 * lineSpacing, 20, DARKGRAY);
     DrawText("Use B/N to adjust Background Opacity", menuRect.x + 10, instructionsBaseY + 4 * lineSpacing, 20, DARKGRAY);
     DrawText("Use K/L to adjust Defocus Angle", menuRect.x + 10, instructionsBaseY + 5 * lineSpacing, 20, DARKGRAY);
-    DrawText("Press P to close menu", menuRect.x + 10, instructionsBaseY + 6 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use M to toggle Progressive", menuRect.x + 10, instructionsBaseY + 6 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use D to toggle Denoise", menuRect.x + 10, instructionsBaseY + 7 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use A to toggle Temporal Reprojection", menuRect.x + 10, instructionsBaseY + 8 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use U/I to adjust Noise Target", menuRect.x + 10, instructionsBaseY + 9 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use S to switch Sampler", menuRect.x + 10, instructionsBaseY + 10 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use J/O to adjust High-Quality Samples", menuRect.x + 10, instructionsBaseY + 11 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use F to toggle Float Output", menuRect.x + 10, instructionsBaseY + 12 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use R/V to adjust Tiled Render Scale", menuRect.x + 10, instructionsBaseY + 13 * lineSpacing, 20, DARKGRAY);
+    DrawText("Use ,/. to adjust Render Scale", menuRect.x + 10, instructionsBaseY + 14 * lineSpacing, 20, DARKGRAY);
+    DrawText("Press P to close menu", menuRect.x + 10, instructionsBaseY + 15 * lineSpacing, 20, DARKGRAY);
 }
 
 bool MenuSystem::isMenuVisible() const {
@@ -86,3 +140,65 @@ float MenuSystem::getBackgroundOpacity() const {
 float MenuSystem::getDefocusAngle() const {
     return defocusAngle;
 }
+
+bool MenuSystem::isProgressive() const {
+    return progressive;
+}
+
+bool MenuSystem::isDenoising() const {
+    return denoise;
+}
+
+bool MenuSystem::isTemporal() const {
+    return temporal;
+}
+
+float MenuSystem::getNoiseTarget() const {
+    return noiseTarget;
+}
+
+SamplerType MenuSystem::getSampler() const {
+    return sampler;
+}
+
+int MenuSystem::getHighQualitySamples() const {
+    return highQualitySamples;
+}
+
+bool MenuSystem::isFloatOutput() const {
+    return floatOutput;
+}
+
+int MenuSystem::getTiledScale() const {
+    return tiledScale;
+}
+
+float MenuSystem::getRenderScale() const {
+    return renderScale;
+}
+
+RenderSettings MenuSystem::getRenderSettings() const {
+    RenderSettings settings;
+    settings.samples = samples;
+    settings.maxBounces = maxBounces;
+    settings.gamma = gamma;
+    settings.backgroundOpacity = backgroundOpacity;
+    settings.defocusAngle = defocusAngle;
+    settings.noiseTarget = noiseTarget;
+    settings.sampler = sampler;
+    return settings;
+}
+
+void MenuSystem::setAccumulatedFrames(int frames) {
+    accumulatedFrames = frames;
+}
+
+void MenuSystem::setSceneUploadBytes(uint64_t bytes) {
+    sceneUploadBytes = bytes;
+}
+
+void MenuSystem::setRenderScale(float scale, int tracedSamples, float ms) {
+    currentRenderScale = scale;
+    frameSamples = tracedSamples;
+    renderMs = ms;
+}
@@ -3,6 +3,8 @@
 
 #include "raylib.h"
 #include "CustomCamera.h"
+#include "CpuRenderer.h"
+#include <cstdint>
 
 class MenuSystem {
 private:
@@ -14,6 +16,20 @@ private:
     float gamma;
     float backgroundOpacity;
     float defocusAngle = 0.0f; // Default defocus angle
+    bool progressive = true; // Accumulate frames while the view is still
+    bool denoise = false; // Filter the displayed image and the renders with the edge-aware denoiser
+    bool temporal = true; // Reproject the last image while the camera moves instead of starting over
+    float noiseTarget = 0.0f; // Relative noise at which adaptive sampling stops, 0 is off
+    SamplerType sampler = SAMPLER_SOBOL;
+    int highQualitySamples = 512; // Samples per pixel of the high-quality render
+    bool floatOutput = false; // Renders also write a float PFM next to the PNG
+    int tiledScale = 4; // The tiled render is this many times the window resolution
+    float renderScale = 0.0f; // Render resolution as a share of the window's, 0 lets the dynamic resolution controller pick it
+    float currentRenderScale = 1.0f; // Shown in the menu only
+    int frameSamples = 8; // Shown in the menu only
+    float renderMs = 0.0f; // Shown in the menu only
+    int accumulatedFrames = 0; // Shown in the menu only
+    uint64_t sceneUploadBytes = 0; // Shown in the menu only
 
 public:
     MenuSystem(CustomCamera& cameraRef);
@@ -27,6 +43,23 @@ public:
     float getGamma() const;
     float getBackgroundOpacity() const;
     float getDefocusAngle() const;
+    bool isProgressive() const;
+    bool isDenoising() const;
+    bool isTemporal() const;
+    float getNoiseTarget() const;
+    SamplerType getSampler() const;
+    int getHighQualitySamples() const;
+    bool isFloatOutput() const;
+    int getTiledScale() const;
+    // Manual render scale, 0 when it is automatic
+    float getRenderScale() const;
+    // Every setting above in one struct, for the CPU renderer and change detection
+    RenderSettings getRenderSettings() const;
+
+    void setAccumulatedFrames(int frames);
+    void setSceneUploadBytes(uint64_t bytes);
+    // What the dynamic resolution controller picked: scale, samples per frame and the GPU time of the render stages
+    void setRenderScale(float scale, int tracedSamples, float ms);
 };
 
 #endif // MENU_SYSTEM_H
@@ -0,0 +1,192 @@
+#include "ObjLoader.h"
+#include "JsonLoader.h"
+#include "MappedFile.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+// Cursor over one line of the file
+struct ObjLine {
+    const char* p;
+    const char* end;
+
+    void skipSpaces() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    }
+
+    bool readFloat(float& out) {
+        skipSpaces();
+        if (p < end && *p == '+') p++;
+        double value;
+        const char* next = parseNumber(p, end, value);
+        if (!next) return false;
+        out = (float)value;
+        p = next;
+        return true;
+    }
+
+    // One vertex of a face: position[/uv[/normal]], indices are 1-based or negative for relative ones
+    bool readFaceVertex(int& position, int& uv) {
+        skipSpaces();
+        std::from_chars_result result = std::from_chars(p, end, position);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        uv = 0;
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/') {
+                result = std::from_chars(p, end, uv);
+                if (result.ec != std::errc()) return false;
+                p = result.ptr;
+            }
+            // Normals are not used, the renderer shades triangles flat
+            if (p < end && *p == '/') {
+                p++;
+                int normal;
+                result = std::from_chars(p, end, normal);
+                if (result.ec == std::errc()) p = result.ptr;
+            }
+        }
+        return true;
+    }
+
+    std::string_view rest() {
+        skipSpaces();
+        const char* last = end;
+        while (last > p && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r')) last--;
+        return std::string_view(p, last - p);
+    }
+
+    bool atEnd() {
+        skipSpaces();
+        return p >= end || *p == '#';
+    }
+};
+
+// Keyword at the start of the line, followed by a space or the end of the line
+static bool startsWithKeyword(ObjLine& line, const char* keyword) {
+    size_t length = strlen(keyword);
+    if ((size_t)(line.end - line.p) < length || memcmp(line.p, keyword, length) != 0) return false;
+    const char* next = line.p + length;
+    if (next < line.end && *next != ' ' && *next != '\t') return false;
+    line.p = next;
+    return true;
+}
+
+// Turn a 1-based or negative OBJ index into a 0-based one, -1 if it is out of range
+static int resolveIndex(int index, size_t count) {
+    if (index > 0) return (size_t)index <= count ? index - 1 : -1;
+    if (index < 0) return (size_t)(-(int64_t)index) <= count ? (int)count + index : -1;
+    return -1;
+}
+
+bool loadObj(const MeshInstance& instance, int materialCount, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles) {
+    MappedFile file;
+    if (!file.open(instance.filePath)) {
+        TraceLog(LOG_ERROR, "Failed to open mesh: %s", instance.filePath.c_str());
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const char* data = (const char*)file.data();
+    const char* end = data + file.size();
+
+    std::vector<Vector3> positions;
+    std::vector<Vector2> uvs;
+    // Vertices are found by position, then by uv: every position starts a short list of its vertices
+    std::vector<int> positionVertex; // First vertex of each position, -1 if none
+    std::vector<int> vertexUv; // Per vertex of this file, the uv index or -1
+    std::vector<int> nextVertex; // Next vertex with the same position, -1 at the end
+    std::vector<int> face;
+    std::vector<std::string> unknownMaterials;
+    int materialIndex = instance.materialIndex;
+    size_t firstVertex = vertices.size();
+    size_t firstTriangle = triangles.size();
+
+    int lineNumber = 1;
+    for (const char* lineStart = data; lineStart < end; lineNumber++) {
+        const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+        if (!lineEnd) lineEnd = end;
+        const char* lineBegin = lineStart;
+        ObjLine line = { lineStart, lineEnd };
+        lineStart = lineEnd + 1;
+        line.skipSpaces();
+
+        auto error = [&](const char* message) {
+            TraceLog(LOG_ERROR, "%s:%d:%d: %s", instance.filePath.c_str(), lineNumber, (int)(line.p - lineBegin) + 1, message);
+            vertices.resize(firstVertex);
+            triangles.resize(firstTriangle);
+            return false;
+        };
+
+        if (startsWithKeyword(line, "v")) {
+            Vector3 position;
+            if (!line.readFloat(position.x) || !line.readFloat(position.y) || !line.readFloat(position.z)) return error("Expected 3 vertex coordinates");
+            positions.push_back(position);
+            positionVertex.push_back(-1);
+        } else if (startsWithKeyword(line, "vt")) {
+            Vector2 uv;
+            if (!line.readFloat(uv.x) || !line.readFloat(uv.y)) return error("Expected 2 texture coordinates");
+            // OBJ has v = 0 at the bottom of the image, the renderers at the top
+            uvs.push_back({ uv.x, 1.0f - uv.y });
+        } else if (startsWithKeyword(line, "f")) {
+            face.clear();
+            while (!line.atEnd()) {
+                int positionIndex, uvIndex;
+                if (!line.readFaceVertex(positionIndex, uvIndex)) return error("Expected a face vertex");
+                int position = resolveIndex(positionIndex, positions.size());
+                int uv = uvIndex != 0 ? resolveIndex(uvIndex, uvs.size()) : -1;
+                if (position < 0 || (uvIndex != 0 && uv < 0)) return error("Face index out of range");
+
+                int vertex = positionVertex[position];
+                while (vertex >= 0 && vertexUv[vertex] != uv) vertex = nextVertex[vertex];
+                if (vertex < 0) {
+                    vertex = (int)vertexUv.size();
+                    vertexUv.push_back(uv);
+                    nextVertex.push_back(positionVertex[position]);
+                    positionVertex[position] = vertex;
+                    vertices.push_back({ positions[position], uv >= 0 ? uvs[uv] : Vector2{ 0.0f, 0.0f } });
+                }
+                face.push_back((int)firstVertex + vertex);
+            }
+            if (face.size() < 3) return error("Faces need at least 3 vertices");
+            for (size_t i = 1; i + 1 < face.size(); i++) {
+                triangles.push_back({ { face[0], face[i], face[i + 1] }, materialIndex });
+            }
+        } else if (startsWithKeyword(line, "usemtl")) {
+            std::string_view name = line.rest();
+            materialIndex = instance.materialIndex;
+            bool found = false;
+            for (const std::pair<std::string, int>& entry : instance.materialNames) {
+                if (entry.first == name) {
+                    materialIndex = entry.second;
+                    found = true;
+                    break;
+                }
+            }
+            // Plain numbers are material indices
+            if (!found && std::from_chars(name.data(), name.data() + name.size(), materialIndex).ptr == name.data() + name.size() && !name.empty()) {
+                if (materialIndex < 0 || materialIndex >= materialCount) return error(TextFormat("Material %d is out of range, it has to be below %d", materialIndex, materialCount));
+                found = true;
+            }
+            if (!found) {
+                materialIndex = instance.materialIndex;
+                std::string unknown(name);
+                bool warned = false;
+                for (const std::string& other : unknownMaterials) warned = warned || other == unknown;
+                if (!warned) {
+                    TraceLog(LOG_WARNING, "%s: usemtl %s is not in the materials of meshes.json, using material %d", instance.filePath.c_str(), unknown.c_str(), instance.materialIndex);
+                    unknownMaterials.push_back(unknown);
+                }
+            }
+        }
+        // Everything else (vn, o, g, s, mtllib, comments) does not affect the geometry
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    TraceLog(LOG_INFO, "Loaded mesh %s: %d vertices, %d triangles, %.2f MB in %.2f ms (%.1f MB/s)", instance.filePath.c_str(),
+        (int)(vertices.size() - firstVertex), (int)(triangles.size() - firstTriangle), megabytes, seconds * 1000.0, seconds > 0.0 ? megabytes / seconds : 0.0);
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "raylib.h"
+#include "Scene.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// One OBJ file placed in the world, an entry of meshes.json
+// Entries with the same file and materials share one Mesh, each becomes an Instance of it
+struct MeshInstance {
+    std::string filePath;
+    Vector3 position = { 0.0f, 0.0f, 0.0f };
+    float scale = 1.0f;
+    Vector3 rotation = { 0.0f, 0.0f, 0.0f }; // Euler angles in degrees around x, y and z
+    int materialIndex = 0; // For faces without a usemtl, or with one that is not in materialNames
+    std::vector<std::pair<std::string, int>> materialNames; // usemtl name to material index
+};
+
+// Append the mesh to the vertex and triangle arrays in the object space of the file, polygons are split into triangle fans
+// Faces that use the same position and texture coordinate share one vertex
+// Only the file and materials of the instance are used, its placement is up to the Instance
+// A usemtl with a material index at or past materialCount is an error
+bool loadObj(const MeshInstance& instance, int materialCount, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles);
+
+#endif // OBJ_LOADER_H
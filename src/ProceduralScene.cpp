@@ -0,0 +1,334 @@
+#include "ProceduralScene.h"
+#include "raymath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Small PCG generator, <random>'s distributions give different scenes on different standard libraries
+struct SceneRandom {
+    uint64_t state;
+
+    explicit SceneRandom(uint32_t seed) : state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorShifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rotation = (uint32_t)(old >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    // Uniform in [min, max)
+    float range(float min, float max) {
+        return min + (max - min) * ((next() >> 8) * (1.0f / 16777216.0f));
+    }
+};
+
+// Material palette shared by every generated scene
+enum PaletteMaterial {
+    PALETTE_GROUND,
+    PALETTE_RED,
+    PALETTE_GREEN,
+    PALETTE_BLUE,
+    PALETTE_WHITE,
+    PALETTE_MIRROR,
+    PALETTE_BRUSHED_METAL,
+    PALETTE_GLASS,
+    PALETTE_LIGHT,
+    PALETTE_SIZE
+};
+
+static void addPalette(Scene& scene) {
+    scene.materials.assign(PALETTE_SIZE, Material());
+    scene.materials[PALETTE_GROUND].albedo = { 0.5f, 0.5f, 0.5f };
+    scene.materials[PALETTE_RED].albedo = { 0.65f, 0.05f, 0.05f };
+    scene.materials[PALETTE_GREEN].albedo = { 0.12f, 0.45f, 0.15f };
+    scene.materials[PALETTE_BLUE].albedo = { 0.1f, 0.2f, 0.6f };
+    scene.materials[PALETTE_WHITE].albedo = { 0.73f, 0.73f, 0.73f };
+    scene.materials[PALETTE_MIRROR].type = MATERIAL_METAL;
+    scene.materials[PALETTE_MIRROR].albedo = { 0.9f, 0.9f, 0.9f };
+    scene.materials[PALETTE_BRUSHED_METAL].type = MATERIAL_METAL;
+    scene.materials[PALETTE_BRUSHED_METAL].albedo = { 0.8f, 0.6f, 0.4f };
+    scene.materials[PALETTE_BRUSHED_METAL].fuzz = 0.2f;
+    scene.materials[PALETTE_GLASS].type = MATERIAL_DIELECTRIC;
+    scene.materials[PALETTE_GLASS].albedo = { 1.0f, 1.0f, 1.0f };
+    scene.materials[PALETTE_GLASS].refractionIndex = 1.5f;
+    // Lights only emit, paths that reach them end there
+    scene.materials[PALETTE_LIGHT].albedo = { 0.0f, 0.0f, 0.0f };
+    scene.materials[PALETTE_LIGHT].emmisiveColor = { 15.0f, 15.0f, 15.0f };
+}
+
+static int randomMaterial(SceneRandom& random, float glassShare) {
+    float choice = random.range(0.0f, 1.0f);
+    if (choice < glassShare) return PALETTE_GLASS;
+    if (choice < glassShare + 0.15f) return choice < glassShare + 0.05f ? PALETTE_MIRROR : PALETTE_BRUSHED_METAL;
+    return PALETTE_RED + (int)(random.next() % 4);
+}
+
+// Spheres on a jittered grid so they rarely overlap, the grid grows with the count
+static ProceduralView randomSpheres(int count, float glassShare, SceneRandom& random, std::vector<Sphere>& spheres) {
+    int cells = (int)ceilf(sqrtf((float)count));
+    float extent = (float)cells;
+    spheres.push_back({ { 0.0f, -1000.0f, 0.0f }, 1000.0f, PALETTE_GROUND });
+    for (int i = 0; i < count; i++) {
+        float radius = random.range(0.2f, 0.45f);
+        float x = (i % cells) + 0.5f + random.range(-0.05f, 0.05f) - extent / 2.0f;
+        float z = (i / cells) + 0.5f + random.range(-0.05f, 0.05f) - extent / 2.0f;
+        spheres.push_back({ { x, radius, z }, radius, randomMaterial(random, glassShare) });
+    }
+    return { { 0.0f, 1.5f + extent * 0.15f, extent * 0.5f + 3.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f };
+}
+
+// Tiles face up, cross(edgeU, edgeV) is the normal the shader uses
+static ProceduralView quadGrid(int size, SceneRandom& random, std::vector<Quad>& quads) {
+    float extent = (float)size;
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            Vector3 origin = { x - extent / 2.0f, random.range(0.0f, 0.5f), z - extent / 2.0f };
+            quads.push_back({ origin, { 0.0f, 0.0f, 0.9f }, { 0.9f, 0.0f, 0.0f }, randomMaterial(random, 0.0f) });
+        }
+    }
+    return { { 0.0f, 2.0f + extent * 0.4f, extent * 0.6f + 2.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f };
+}
+
+// Box open towards the camera, every wall faces inwards and the ceiling light is the only light
+static ProceduralView emissiveRoom(int count, SceneRandom& random, std::vector<Sphere>& spheres, std::vector<Quad>& quads) {
+    quads.push_back({ { -5.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 10.0f }, { 10.0f, 0.0f, 0.0f }, PALETTE_WHITE }); // Floor
+    quads.push_back({ { -5.0f, 10.0f, -5.0f }, { 10.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 10.0f }, PALETTE_WHITE }); // Ceiling
+    quads.push_back({ { -5.0f, 0.0f, -5.0f }, { 10.0f, 0.0f, 0.0f }, { 0.0f, 10.0f, 0.0f }, PALETTE_WHITE }); // Back
+    quads.push_back({ { -5.0f, 0.0f, -5.0f }, { 0.0f, 10.0f, 0.0f }, { 0.0f, 0.0f, 10.0f }, PALETTE_RED }); // Left
+    quads.push_back({ { 5.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 10.0f }, { 0.0f, 10.0f, 0.0f }, PALETTE_GREEN }); // Right
+    quads.push_back({ { -1.5f, 9.99f, -1.5f }, { 3.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 3.0f }, PALETTE_LIGHT });
+
+    // Smaller spheres when there are many, so they still fit on the floor
+    float scale = fminf(1.0f, 4.0f / sqrtf((float)count));
+    for (int i = 0; i < count; i++) {
+        float radius = random.range(0.3f, 0.8f) * scale;
+        Vector3 center = { random.range(-4.0f, 4.0f), radius, random.range(-4.0f, 4.0f) };
+        spheres.push_back({ center, radius, randomMaterial(random, 0.2f) });
+    }
+    return { { 0.0f, 5.0f, 14.0f }, { 0.0f, 5.0f, 0.0f }, 0.0f };
+}
+
+// Rolling terrain, two triangles per cell, counter-clockwise seen from above
+static ProceduralView heightField(int size, SceneRandom& random, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles) {
+    const float extent = 20.0f;
+    float phaseX = random.range(0.0f, 2.0f * PI);
+    float phaseZ = random.range(0.0f, 2.0f * PI);
+    for (int j = 0; j <= size; j++) {
+        for (int i = 0; i <= size; i++) {
+            float u = (float)i / size;
+            float v = (float)j / size;
+            float x = (u - 0.5f) * extent;
+            float z = (v - 0.5f) * extent;
+            float y = sinf(x * 0.6f + phaseX) * cosf(z * 0.4f + phaseZ) + random.range(-0.05f, 0.05f);
+            vertices.push_back({ { x, y, z }, { u, v } });
+        }
+    }
+
+    int row = size + 1;
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            int v00 = j * row + i;
+            int v10 = v00 + 1;
+            int v01 = v00 + row;
+            int v11 = v01 + 1;
+            int material = (i / 8 + j / 8) % 2 ? PALETTE_GREEN : PALETTE_GROUND;
+            triangles.push_back({ { v00, v01, v11 }, material });
+            triangles.push_back({ { v00, v11, v10 }, material });
+        }
+    }
+    return { { 0.0f, 8.0f, 14.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f };
+}
+
+// Icosahedron with its corners pushed in and out, every rock is an instance of it
+static ProceduralView instancedRocks(int size, SceneRandom& random, std::vector<Quad>& quads, std::vector<MeshVertex>& vertices, std::vector<Triangle>& triangles,
+    std::vector<Mesh>& meshes, std::vector<Instance>& instances) {
+    const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    const Vector3 corners[12] = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+        { 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+    };
+    const int faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 }, { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 }, { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+    };
+    for (const Vector3& corner : corners) {
+        Vector3 direction = Vector3Normalize(corner);
+        vertices.push_back({ Vector3Scale(direction, random.range(0.75f, 1.1f)), { 0.5f + direction.x * 0.5f, 0.5f - direction.y * 0.5f } });
+    }
+    for (const int* face : faces) {
+        triangles.push_back({ { face[0], face[1], face[2] }, PALETTE_GROUND });
+    }
+    meshes.push_back({ 0, (int)triangles.size(), -1 });
+
+    float extent = size * 1.5f;
+    quads.push_back({ { -extent / 2.0f, 0.0f, -extent / 2.0f }, { 0.0f, 0.0f, extent }, { extent, 0.0f, 0.0f }, PALETTE_GREEN });
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            float scale = random.range(0.2f, 0.6f);
+            Vector3 position = { (x + 0.5f) * 1.5f - extent / 2.0f + random.range(-0.3f, 0.3f), scale * 0.5f, (z + 0.5f) * 1.5f - extent / 2.0f + random.range(-0.3f, 0.3f) };
+            Quaternion rotation = QuaternionFromEuler(random.range(0.0f, 2.0f * PI), random.range(0.0f, 2.0f * PI), random.range(0.0f, 2.0f * PI));
+            instances.push_back({ position, scale, rotation, 0 });
+        }
+    }
+    return { { 0.0f, 2.0f + extent * 0.3f, extent * 0.5f + 3.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f };
+}
+
+const char* getProceduralSceneName(ProceduralSceneType type) {
+    switch (type) {
+        case PROCEDURAL_RANDOM_SPHERES: return "random_spheres";
+        case PROCEDURAL_QUAD_GRID: return "quad_grid";
+        case PROCEDURAL_GLASS_SPHERES: return "glass_spheres";
+        case PROCEDURAL_EMISSIVE_ROOM: return "emissive_room";
+        case PROCEDURAL_HEIGHT_FIELD: return "height_field";
+        case PROCEDURAL_INSTANCED_ROCKS: return "instanced_rocks";
+        default: return "unknown";
+    }
+}
+
+ProceduralView generateProceduralScene(const ProceduralSceneParams& params, Scene& scene) {
+    SceneRandom random(params.seed);
+    int size = params.size > 0 ? params.size : 1;
+
+    std::vector<Sphere> spheres;
+    std::vector<Quad> quads;
+    std::vector<MeshVertex> vertices;
+    std::vector<Triangle> triangles;
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+    ProceduralView view = { { 0.0f, 1.0f, 5.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f };
+    switch (params.type) {
+        case PROCEDURAL_RANDOM_SPHERES: view = randomSpheres(size, 0.1f, random, spheres); break;
+        case PROCEDURAL_QUAD_GRID: view = quadGrid(size, random, quads); break;
+        case PROCEDURAL_GLASS_SPHERES: view = randomSpheres(size, 0.8f, random, spheres); break;
+        case PROCEDURAL_EMISSIVE_ROOM: view = emissiveRoom(size, random, spheres, quads); break;
+        case PROCEDURAL_HEIGHT_FIELD:
+            view = heightField(size, random, vertices, triangles);
+            // One mesh, placed once as it is
+            meshes.push_back({ 0, (int)triangles.size(), -1 });
+            instances.push_back({ { 0.0f, 0.0f, 0.0f }, 1.0f, { 0.0f, 0.0f, 0.0f, 1.0f }, 0 });
+            break;
+        case PROCEDURAL_INSTANCED_ROCKS: view = instancedRocks(size, random, quads, vertices, triangles, meshes, instances); break;
+        default: break;
+    }
+
+    addPalette(scene);
+    scene.textures.clear();
+    scene.spheres.assign(std::move(spheres));
+    scene.quads.assign(std::move(quads));
+    scene.vertices.assign(std::move(vertices));
+    scene.triangles.assign(std::move(triangles));
+    scene.meshes.assign(std::move(meshes));
+    scene.instances.assign(std::move(instances));
+    scene.cacheFile.reset();
+    buildSceneBvh(scene);
+    buildSceneLights(scene);
+    return view;
+}
+
+static void writeVector3(FILE* file, Vector3 v) {
+    fprintf(file, "[%.9g, %.9g, %.9g]", v.x, v.y, v.z);
+}
+
+bool writeSceneWorld(const Scene& scene, const std::string& worldPath) {
+    FILE* file = fopen((worldPath + "/materials.json").c_str(), "wb");
+    if (!file) {
+        TraceLog(LOG_WARNING, "Could not write the world to %s", worldPath.c_str());
+        return false;
+    }
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        const Material& material = scene.materials[i];
+        fprintf(file, "    {\n        \"type\": %d,\n        \"albedo\": ", material.type);
+        writeVector3(file, material.albedo);
+        fprintf(file, ",\n        \"emmisiveColor\": ");
+        writeVector3(file, material.emmisiveColor);
+        fprintf(file, ",\n        \"fuzz\": %.9g,\n        \"refractionIndex\": %.9g\n    }%s\n", material.fuzz, material.refractionIndex, i + 1 < scene.materials.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    bool ok = fclose(file) == 0;
+
+    file = fopen((worldPath + "/spheres.json").c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < scene.spheres.size(); i++) {
+        const Sphere& sphere = scene.spheres[i];
+        fprintf(file, "    {\n        \"position\": ");
+        writeVector3(file, sphere.center);
+        fprintf(file, ",\n        \"radius\": %.9g,\n        \"materialIndex\": %d\n    }%s\n", sphere.radius, sphere.materialIndex, i + 1 < scene.spheres.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    ok = fclose(file) == 0 && ok;
+
+    file = fopen((worldPath + "/quads.json").c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < scene.quads.size(); i++) {
+        const Quad& quad = scene.quads[i];
+        fprintf(file, "    {\n        \"origin\": ");
+        writeVector3(file, quad.origin);
+        fprintf(file, ",\n        \"edgeU\": ");
+        writeVector3(file, quad.edgeU);
+        fprintf(file, ",\n        \"edgeV\": ");
+        writeVector3(file, quad.edgeV);
+        fprintf(file, ",\n        \"type\": 1,\n        \"materialIndex\": %d\n    }%s\n", quad.materialIndex, i + 1 < scene.quads.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    ok = fclose(file) == 0 && ok;
+
+    // Every instance becomes an entry of meshes.json
+    std::string meshesPath = worldPath + "/meshes.json";
+    if (scene.instances.empty()) {
+        remove(meshesPath.c_str());
+        return ok;
+    }
+    file = fopen(meshesPath.c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "[\n");
+    for (size_t i = 0; i < scene.instances.size(); i++) {
+        const Instance& instance = scene.instances[i];
+        Vector3 rotation = Vector3Scale(QuaternionToEuler(instance.rotation), RAD2DEG);
+        fprintf(file, "    {\"file\": \"mesh%d.obj\", \"position\": ", instance.mesh);
+        writeVector3(file, instance.position);
+        fprintf(file, ", \"scale\": %.9g, \"rotation\": ", instance.scale);
+        writeVector3(file, rotation);
+        fprintf(file, ", \"materialIndex\": 0}%s\n", i + 1 < scene.instances.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    ok = fclose(file) == 0 && ok;
+
+    // Every mesh becomes an OBJ file in its object space, usemtl numbers are material indices
+    for (size_t i = 0; i < scene.meshes.size(); i++) {
+        const Mesh& mesh = scene.meshes[i];
+        file = fopen((worldPath + "/mesh" + std::to_string(i) + ".obj").c_str(), "wb");
+        if (!file) return false;
+        // Loaded meshes use a range of vertices of their own
+        int firstVertex = INT32_MAX, lastVertex = -1;
+        for (int j = 0; j < mesh.triangleCount; j++) {
+            for (int vertex : scene.triangles[mesh.firstTriangle + j].vertices) {
+                firstVertex = std::min(firstVertex, vertex);
+                lastVertex = std::max(lastVertex, vertex);
+            }
+        }
+        // OBJ has v = 0 at the bottom of the image, the loader flips it back
+        for (int j = firstVertex; j <= lastVertex; j++) {
+            const MeshVertex& vertex = scene.vertices[j];
+            fprintf(file, "v %.9g %.9g %.9g\nvt %.9g %.9g\n", vertex.position.x, vertex.position.y, vertex.position.z, vertex.uv.x, 1.0f - vertex.uv.y);
+        }
+        int material = -1;
+        for (int j = 0; j < mesh.triangleCount; j++) {
+            const Triangle& triangle = scene.triangles[mesh.firstTriangle + j];
+            if (triangle.materialIndex != material) {
+                material = triangle.materialIndex;
+                fprintf(file, "usemtl %d\n", material);
+            }
+            int a = triangle.vertices[0] - firstVertex + 1, b = triangle.vertices[1] - firstVertex + 1, c = triangle.vertices[2] - firstVertex + 1;
+            fprintf(file, "f %d/%d %d/%d %d/%d\n", a, a, b, b, c, c);
+        }
+        ok = fclose(file) == 0 && ok;
+    }
+    return ok;
+}
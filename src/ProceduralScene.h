@@ -0,0 +1,43 @@
+#ifndef PROCEDURAL_SCENE_H
+#define PROCEDURAL_SCENE_H
+
+#include "raylib.h"
+#include "Scene.h"
+#include <cstdint>
+#include <string>
+
+// Worlds generated from a size and a seed, for benchmarks that need more than the world folder
+enum ProceduralSceneType {
+    PROCEDURAL_RANDOM_SPHERES, // size spheres of mixed materials on a ground sphere
+    PROCEDURAL_QUAD_GRID, // size x size floor tiles at random heights
+    PROCEDURAL_GLASS_SPHERES, // Like PROCEDURAL_RANDOM_SPHERES, but most spheres are glass
+    PROCEDURAL_EMISSIVE_ROOM, // Room open towards the camera, lit only by an emissive ceiling, size spheres inside
+    PROCEDURAL_HEIGHT_FIELD, // Mesh of 2 * size * size triangles
+    PROCEDURAL_INSTANCED_ROCKS, // size x size rotated and scaled instances of one rock mesh on a floor quad
+    PROCEDURAL_SCENE_TYPE_COUNT
+};
+
+struct ProceduralSceneParams {
+    ProceduralSceneType type = PROCEDURAL_RANDOM_SPHERES;
+    int size = 100;
+    uint32_t seed = 1;
+};
+
+// Where to look from and how much of the sky to show, the room is lit only by its ceiling so its background is black
+struct ProceduralView {
+    Vector3 cameraPosition;
+    Vector3 cameraTarget;
+    float backgroundOpacity;
+};
+
+// Short lowercase name, used in benchmark output
+const char* getProceduralSceneName(ProceduralSceneType type);
+
+// Replace the scene with a generated one and build its BVH, the same params always give the same scene
+ProceduralView generateProceduralScene(const ProceduralSceneParams& params, Scene& scene);
+
+// Write the scene as a world folder (materials, spheres, quads and meshes.json with one OBJ file per mesh)
+// The folder must exist, textures are not written
+bool writeSceneWorld(const Scene& scene, const std::string& worldPath);
+
+#endif // PROCEDURAL_SCENE_H
@@ -0,0 +1,59 @@
+#include "Process.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <spawn.h>
+#include <sys/types.h>
+extern char** environ;
+#endif
+
+#ifdef _WIN32
+// CreateProcess takes one command line, arguments with spaces or quotes are quoted the way the C runtime splits them
+static std::string quoteArgument(const std::string& arg) {
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) return arg;
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        // Backslashes only escape when a quote follows
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(backslashes * 2, '\\');
+    return quoted + "\"";
+}
+#endif
+
+bool launchProcess(const std::vector<std::string>& args) {
+    if (args.empty()) return false;
+
+#ifdef _WIN32
+    std::string commandLine;
+    for (const std::string& arg : args) {
+        if (!commandLine.empty()) commandLine += ' ';
+        commandLine += quoteArgument(arg);
+    }
+    STARTUPINFOA startup;
+    ZeroMemory(&startup, sizeof(startup));
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process;
+    if (!CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup, &process)) return false;
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    return true;
+#else
+    std::vector<char*> argv;
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    // posix_spawnp so a bare program name is looked up in PATH like a shell would
+    pid_t pid;
+    return posix_spawnp(&pid, args[0].c_str(), nullptr, nullptr, argv.data(), environ) == 0;
+#endif
+}
@@ -0,0 +1,12 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <string>
+#include <vector>
+
+// Start args[0] with the other arguments and return without waiting for it, false when it could not be started
+// The child inherits the console and keeps running when this process exits
+// Kept free of raylib.h because windows.h clashes with its names
+bool launchProcess(const std::vector<std::string>& args);
+
+#endif // PROCESS_H
@@ -0,0 +1,297 @@
+#include "Profiler.h"
+#include "rlgl.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Timestamp queries are core since OpenGL 3.3, raylib's loader has them ready after InitWindow()
+#if defined(GRAPHICS_API_OPENGL_33) || defined(GRAPHICS_API_OPENGL_43)
+    #include "external/glad.h"
+    #define PROFILER_GPU_TIMERS
+#endif
+
+// Queries added to a frame's pool when it runs out, two per GPU stage
+static const int queryPoolGrowth = 32;
+
+Profiler::Profiler() : epoch(std::chrono::steady_clock::now()) {
+    // Stage 0 is the whole frame, from beginFrame() to endFrame()
+    Stage frame;
+    frame.name = "Frame";
+    frame.depth = 0;
+    stages.push_back(frame);
+}
+
+double Profiler::nowUs() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+int Profiler::findStage(const char* name, bool gpu) {
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (stages[i].name == name || strcmp(stages[i].name, name) == 0) {
+            stages[i].gpu = stages[i].gpu || gpu;
+            return (int)i;
+        }
+    }
+    Stage stage;
+    stage.name = name;
+    stage.depth = (int)openStages.size() + 1; // Inside the frame
+    stage.gpu = gpu;
+    stages.push_back(stage);
+    return (int)stages.size() - 1;
+}
+
+// Toggles take effect at the start of a frame, so stages never open and close in different states
+void Profiler::updateEnabled() {
+    bool wasEnabled = enabled;
+    enabled = overlayVisible || recording;
+    if (enabled && !wasEnabled) {
+        openStages.clear();
+#ifdef PROFILER_GPU_TIMERS
+        gpuTimers = rlGetVersion() == RL_OPENGL_33 || rlGetVersion() == RL_OPENGL_43;
+        if (gpuTimers) syncGpuClock();
+#endif
+    }
+    if (!enabled && wasEnabled) {
+        // Results of queries issued before disabling are not wanted anymore
+        for (GpuFrame& gpuFrame : gpuFrames) {
+            gpuFrame.pending.clear();
+            gpuFrame.used = 0;
+        }
+    }
+}
+
+// GPU timestamps count from an arbitrary point, the offset maps them onto nowUs()
+void Profiler::syncGpuClock() {
+#ifdef PROFILER_GPU_TIMERS
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    gpuOffsetUs = nowUs() - gpuNow / 1000.0;
+#endif
+}
+
+// Read the queries of a frame issued PROFILER_GPU_LATENCY_FRAMES ago and free its pool
+void Profiler::resolveGpuFrame(GpuFrame& gpuFrame) {
+#ifdef PROFILER_GPU_TIMERS
+    std::vector<double> frameMs(stages.size(), -1.0);
+    for (const PendingGpuStage& pending : gpuFrame.pending) {
+        GLuint beginQuery = gpuFrame.pool[pending.beginQuery];
+        GLuint endQuery = gpuFrame.pool[pending.beginQuery + 1];
+        GLint available = 0;
+        glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue; // Dropped rather than waited for
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &end);
+        double durationUs = end > begin ? (end - begin) / 1000.0 : 0.0;
+        frameMs[pending.stage] = std::max(frameMs[pending.stage], 0.0) + durationUs / 1000.0;
+        if (recording) addTraceEvent({ pending.stage, pending.depth, pending.frame, begin / 1000.0 + gpuOffsetUs, durationUs, true });
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (frameMs[i] < 0.0) continue;
+        Stage& stage = stages[i];
+        stage.gpuHistory[stage.gpuCount % PROFILER_HISTORY_FRAMES] = (float)frameMs[i];
+        stage.gpuCount++;
+    }
+#endif
+    gpuFrame.pending.clear();
+    gpuFrame.used = 0;
+}
+
+void Profiler::addTraceEvent(const TraceEvent& event) {
+    if (trace.size() >= PROFILER_MAX_TRACE_EVENTS) {
+        if (!traceFull) TraceLog(LOG_WARNING, "PROFILER: Trace is full (%d events), later events are dropped", PROFILER_MAX_TRACE_EVENTS);
+        traceFull = true;
+        return;
+    }
+    trace.push_back(event);
+}
+
+void Profiler::beginFrame() {
+    updateEnabled();
+    if (!enabled) return;
+
+    frameIndex++;
+    GpuFrame& gpuFrame = gpuFrames[frameIndex % PROFILER_GPU_LATENCY_FRAMES];
+    if (gpuTimers) resolveGpuFrame(gpuFrame);
+    frameStartUs = nowUs();
+}
+
+void Profiler::endFrame() {
+    if (!enabled) return;
+
+    double endUs = nowUs();
+    Stage& frame = stages[0];
+    frame.cpuFrameMs = (endUs - frameStartUs) / 1000.0;
+    frame.ranThisFrame = true;
+    if (recording) addTraceEvent({ 0, 0, frameIndex, frameStartUs, endUs - frameStartUs, false });
+
+    // Stages that did not run this frame keep their history, a rare stage is not averaged with zeros
+    for (Stage& stage : stages) {
+        if (!stage.ranThisFrame) continue;
+        stage.cpuHistory[stage.cpuCount % PROFILER_HISTORY_FRAMES] = (float)stage.cpuFrameMs;
+        stage.cpuCount++;
+        stage.cpuFrameMs = 0.0;
+        stage.ranThisFrame = false;
+    }
+}
+
+void Profiler::beginStage(const char* name, bool gpu) {
+    OpenStage open = { findStage(name, gpu), frameIndex, 0.0, -1 };
+#ifdef PROFILER_GPU_TIMERS
+    if (gpu && gpuTimers) {
+        // Draw what was batched before the stage, so it is not timed as part of it
+        rlDrawRenderBatchActive();
+        GpuFrame& gpuFrame = gpuFrames[frameIndex % PROFILER_GPU_LATENCY_FRAMES];
+        if (gpuFrame.used + 2 > (int)gpuFrame.pool.size()) {
+            size_t poolSize = gpuFrame.pool.size();
+            gpuFrame.pool.resize(poolSize + queryPoolGrowth);
+            glGenQueries(queryPoolGrowth, gpuFrame.pool.data() + poolSize);
+        }
+        open.gpuQuery = gpuFrame.used;
+        gpuFrame.used += 2;
+        glQueryCounter(gpuFrame.pool[open.gpuQuery], GL_TIMESTAMP);
+    }
+#endif
+    open.startUs = nowUs();
+    openStages.push_back(open);
+}
+
+void Profiler::endStage() {
+    if (openStages.empty()) return;
+    OpenStage open = openStages.back();
+    openStages.pop_back();
+    int depth = (int)openStages.size() + 1;
+
+#ifdef PROFILER_GPU_TIMERS
+    if (open.gpuQuery >= 0) {
+        rlDrawRenderBatchActive();
+        GpuFrame& gpuFrame = gpuFrames[open.frame % PROFILER_GPU_LATENCY_FRAMES];
+        glQueryCounter(gpuFrame.pool[open.gpuQuery + 1], GL_TIMESTAMP);
+        gpuFrame.pending.push_back({ open.stage, depth, open.frame, open.gpuQuery });
+    }
+#endif
+    double endUs = nowUs();
+    Stage& stage = stages[open.stage];
+    stage.cpuFrameMs += (endUs - open.startUs) / 1000.0;
+    stage.ranThisFrame = true;
+    if (recording) addTraceEvent({ open.stage, depth, open.frame, open.startUs, endUs - open.startUs, false });
+}
+
+void Profiler::toggleOverlay() {
+    overlayVisible = !overlayVisible;
+}
+
+bool Profiler::isOverlayVisible() const {
+    return overlayVisible;
+}
+
+// p-th percentile of the last count values of a ring buffer
+static float percentile(const float* history, int count, float p) {
+    int size = std::min(count, PROFILER_HISTORY_FRAMES);
+    if (size == 0) return 0.0f;
+    float sorted[PROFILER_HISTORY_FRAMES];
+    std::copy(history, history + size, sorted);
+    int index = std::min((int)(p * size), size - 1);
+    std::nth_element(sorted, sorted + index, sorted + size);
+    return sorted[index];
+}
+
+void Profiler::drawOverlay(int x, int y) const {
+    if (!overlayVisible) return;
+
+    int lineSpacing = 26;
+    int width = 720;
+    int height = 90 + (int)stages.size() * lineSpacing + 2 * lineSpacing;
+    int cpuX = x + 260; // Columns: name, CPU p50/p95/p99, GPU p50/p95/p99
+    int gpuX = x + 500;
+    DrawRectangle(x, y, width, height, Fade(BLACK, 0.75f));
+    DrawText(TextFormat("Profiler, last %d frames (ms)", PROFILER_HISTORY_FRAMES), x + 10, y + 10, 20, WHITE);
+    DrawText("CPU p50 / p95 / p99", cpuX, y + 40, 18, LIGHTGRAY);
+    DrawText(gpuTimers ? "GPU p50 / p95 / p99" : "GPU timers unavailable", gpuX, y + 40, 18, LIGHTGRAY);
+
+    int lineY = y + 70;
+    for (const Stage& stage : stages) {
+        DrawText(stage.name, x + 10 + stage.depth * 16, lineY, 20, WHITE);
+        if (stage.cpuCount > 0) {
+            DrawText(TextFormat("%6.2f %6.2f %6.2f", percentile(stage.cpuHistory, stage.cpuCount, 0.5f),
+                percentile(stage.cpuHistory, stage.cpuCount, 0.95f), percentile(stage.cpuHistory, stage.cpuCount, 0.99f)), cpuX, lineY, 20, WHITE);
+        }
+        if (stage.gpu && stage.gpuCount > 0) {
+            DrawText(TextFormat("%6.2f %6.2f %6.2f", percentile(stage.gpuHistory, stage.gpuCount, 0.5f),
+                percentile(stage.gpuHistory, stage.gpuCount, 0.95f), percentile(stage.gpuHistory, stage.gpuCount, 0.99f)), gpuX, lineY, 20, SKYBLUE);
+        }
+        lineY += lineSpacing;
+    }
+
+    lineY += 10;
+    if (recording) {
+        DrawText(TextFormat("Recording: %d events (F4 to stop and save)", (int)trace.size()), x + 10, lineY, 20, traceFull ? ORANGE : RED);
+    } else {
+        DrawText("F4 to record a trace, F3 to close", x + 10, lineY, 20, LIGHTGRAY);
+    }
+}
+
+void Profiler::startRecording() {
+    trace.clear();
+    traceFull = false;
+    recording = true;
+    if (enabled && gpuTimers) syncGpuClock();
+    TraceLog(LOG_INFO, "PROFILER: Recording started");
+}
+
+bool Profiler::stopRecording(const char* jsonFileName, const char* csvFileName) {
+    recording = false;
+    bool written = exportChromeTrace(jsonFileName) && exportCsv(csvFileName);
+    if (written) TraceLog(LOG_INFO, "PROFILER: %d events written to %s and %s", (int)trace.size(), jsonFileName, csvFileName);
+    trace.clear();
+    trace.shrink_to_fit();
+    return written;
+}
+
+bool Profiler::isRecording() const {
+    return recording;
+}
+
+// Complete ("X") events, CPU stages on thread 1 and GPU stages on thread 2
+bool Profiler::exportChromeTrace(const char* fileName) const {
+    FILE* file = fopen(fileName, "wb");
+    if (!file) {
+        TraceLog(LOG_WARNING, "PROFILER: Could not write %s", fileName);
+        return false;
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"Raytracer\"}},\n");
+    fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n");
+    fprintf(file, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU\"}}");
+    for (const TraceEvent& event : trace) {
+        fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %lld}}",
+            stages[event.stage].name, event.gpu ? "gpu" : "cpu", event.gpu ? 2 : 1, event.startUs, event.durationUs, (long long)event.frame);
+    }
+    fprintf(file, "\n]}\n");
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
+
+// One row per stage run, in the order they finished (GPU rows arrive a few frames late)
+bool Profiler::exportCsv(const char* fileName) const {
+    FILE* file = fopen(fileName, "wb");
+    if (!file) {
+        TraceLog(LOG_WARNING, "PROFILER: Could not write %s", fileName);
+        return false;
+    }
+    fprintf(file, "frame,stage,track,depth,start_ms,duration_ms\n");
+    for (const TraceEvent& event : trace) {
+        fprintf(file, "%lld,%s,%s,%d,%.4f,%.4f\n", (long long)event.frame, stages[event.stage].name, event.gpu ? "gpu" : "cpu",
+            event.depth, event.startUs / 1000.0, event.durationUs / 1000.0);
+    }
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
+
+Profiler& getProfiler() {
+    static Profiler profiler;
+    return profiler;
+}
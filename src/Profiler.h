@@ -0,0 +1,146 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "raylib.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Frames the overlay percentiles are taken over
+#define PROFILER_HISTORY_FRAMES 240
+
+// GPU timestamps are read this many frames after they were issued, so reading them never stalls
+#define PROFILER_GPU_LATENCY_FRAMES 4
+
+// Recorded events past this many are dropped (about 160 MB), a bit over an hour at 60 FPS
+#define PROFILER_MAX_TRACE_EVENTS 4000000
+
+// Per-stage CPU and GPU timings of the frame loop, shown as an overlay and recorded as a trace
+// Stages are named by string literals and may nest, GPU stages also put timestamp queries around their draws
+// Everything is skipped while neither the overlay nor a recording is on
+class Profiler {
+private:
+    struct Stage {
+        const char* name;
+        int depth; // Nesting level when it was first seen, for indenting the overlay
+        float cpuHistory[PROFILER_HISTORY_FRAMES] = { 0 }; // Milliseconds per frame, ring buffer
+        float gpuHistory[PROFILER_HISTORY_FRAMES] = { 0 };
+        int cpuCount = 0; // Frames in the history, up to PROFILER_HISTORY_FRAMES
+        int gpuCount = 0;
+        double cpuFrameMs = 0.0; // Summed over the current frame, a stage can run more than once
+        bool ranThisFrame = false;
+        bool gpu = false;
+    };
+
+    // One finished stage, in microseconds since the profiler started
+    struct TraceEvent {
+        int stage;
+        int depth;
+        int64_t frame;
+        double startUs;
+        double durationUs;
+        bool gpu;
+    };
+
+    struct OpenStage {
+        int stage;
+        int64_t frame;
+        double startUs;
+        int gpuQuery; // Index of the begin query in the frame's pool, -1 for CPU stages
+    };
+
+    // GPU stage waiting for its timestamps, the queries are pool[beginQuery] and pool[beginQuery + 1]
+    struct PendingGpuStage {
+        int stage;
+        int depth;
+        int64_t frame;
+        int beginQuery;
+    };
+
+    // Queries of one frame in flight
+    struct GpuFrame {
+        std::vector<unsigned int> pool;
+        int used = 0;
+        std::vector<PendingGpuStage> pending;
+    };
+
+    bool overlayVisible = false;
+    bool recording = false;
+    bool enabled = false; // overlayVisible || recording
+    bool gpuTimers = false; // Timestamp queries are available
+    bool traceFull = false; // PROFILER_MAX_TRACE_EVENTS reached, later events are dropped
+    std::chrono::steady_clock::time_point epoch;
+    double gpuOffsetUs = 0.0; // Added to GPU timestamps to put them on the CPU timeline
+
+    std::vector<Stage> stages;
+    std::vector<OpenStage> openStages;
+    int64_t frameIndex = 0;
+    double frameStartUs = 0.0;
+    GpuFrame gpuFrames[PROFILER_GPU_LATENCY_FRAMES];
+    std::vector<TraceEvent> trace;
+
+    double nowUs() const;
+    int findStage(const char* name, bool gpu);
+    void updateEnabled();
+    void syncGpuClock();
+    void resolveGpuFrame(GpuFrame& gpuFrame);
+    void addTraceEvent(const TraceEvent& event);
+
+public:
+    // Query objects are left to the GL context, the profiler outlives CloseWindow()
+    Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    bool isEnabled() const { return enabled; }
+
+    // Call once at the start and the end of every frame, both are cheap no-ops while disabled
+    void beginFrame();
+    void endFrame();
+
+    // Prefer PROFILE_SCOPE / PROFILE_GPU_SCOPE, name must outlive the profiler (a string literal)
+    // GPU stages flush raylib's render batch at both ends, so the batched draws land inside the stage
+    void beginStage(const char* name, bool gpu);
+    void endStage();
+
+    void toggleOverlay();
+    bool isOverlayVisible() const;
+    // Rolling p50/p95/p99 of every stage, drawn at x, y
+    void drawOverlay(int x, int y) const;
+
+    void startRecording();
+    // Stops and writes the recording as Chrome trace JSON (chrome://tracing, Perfetto) and as CSV
+    bool stopRecording(const char* jsonFileName, const char* csvFileName);
+    bool isRecording() const;
+
+    bool exportChromeTrace(const char* fileName) const;
+    bool exportCsv(const char* fileName) const;
+};
+
+// The profiler of the frame loop, created on first use
+Profiler& getProfiler();
+
+// Times the enclosing scope as a stage
+class ProfileScope {
+private:
+    bool active;
+
+public:
+    ProfileScope(const char* name, bool gpu = false) : active(getProfiler().isEnabled()) {
+        if (active) getProfiler().beginStage(name, gpu);
+    }
+    ~ProfileScope() {
+        if (active) getProfiler().endStage();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __COUNTER__)(name, true)
+
+#endif // PROFILER_H
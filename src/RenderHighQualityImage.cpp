@@ -1,59 +1,226 @@
 #include "RenderHighQualityImage.h"
 #include "raylib.h"
+#include "raymath.h"
+#include "ImageStream.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
 
-void renderHighQualityImage(Shader shader, int seedOffsetLoc, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem) {
-    RenderTexture2D renderTexture = LoadRenderTexture(screenWidth, screenHeight);
-    Image accumulatedImage = GenImageColor(screenWidth, screenHeight, BLACK);
+// Largest pass, bigger passes can trip the GPU driver's watchdog
+// A power of two, so every full pass is a stratified block of the Sobol sequence
+static const int maxPassSamples = 128;
 
-    int originalSamples = menuSystem.getSamples();
-    int totalSamples = 512;
-    int passSampleCount = 128;
-    int numPasses = round(totalSamples / passSampleCount);
-    SetShaderValue(shader, GetShaderLocation(shader, "samples"), &passSampleCount, SHADER_UNIFORM_INT);
+// Edge of the tiles renderTiledImage() renders one at a time
+static const int renderTileSize = 512;
 
+// Same name with a .pfm extension
+static std::string floatFileName(const char* fileName) {
+    std::string name = fileName;
+    size_t dot = name.find_last_of('.');
+    return (dot == std::string::npos ? name : name.substr(0, dot)) + ".pfm";
+}
+
+// Add one pass to the mean, false once it holds totalSamples samples per pixel
+static bool accumulatePass(Shader shader, int samplesLoc, Accumulator& accumulator, const std::function<void()>& drawRaytracing, int totalSamples) {
+    if (accumulator.getSampleCount() >= totalSamples) return false;
 
-    for (int pass = 0; pass < numPasses; pass++) {
-        int seedOffset = GetRandomValue(0, 10000);
-        SetShaderValue(shader, seedOffsetLoc, &seedOffset, SHADER_UNIFORM_INT);
+    int passSamples = std::min(totalSamples - accumulator.getSampleCount(), maxPassSamples);
+    SetShaderValue(shader, samplesLoc, &passSamples, SHADER_UNIFORM_INT);
 
-        BeginTextureMode(renderTexture);
-            BeginShaderMode(shader);
-                DrawRectangle(0, 0, screenWidth, screenHeight, PINK);
-            EndShaderMode();
-        EndTextureMode();
+    PROFILE_GPU_SCOPE("Render Pass");
+    accumulator.beginFrame(passSamples);
+        BeginShaderMode(shader);
+            accumulator.bindPreviousFrame();
+            drawRaytracing();
+        EndShaderMode();
+    accumulator.endFrame();
+    return true;
+}
+
+// Progress bar overlay, call between BeginDrawing() and EndDrawing()
+static void drawProgress(const char* text, float progress, int screenWidth, int screenHeight) {
+    DrawText(text, screenWidth / 2 - 150, screenHeight / 2 - 60, 20, WHITE);
+    DrawRectangle(screenWidth * 0.25, screenHeight * 0.5, screenWidth * 0.5, screenHeight * 0.04, GRAY);
+    DrawRectangle(screenWidth * 0.25, screenHeight * 0.5, (int)(screenWidth * 0.5 * progress), screenHeight * 0.04, GREEN);
+    DrawRectangleLines(screenWidth * 0.25, screenHeight * 0.5, screenWidth * 0.5, screenHeight * 0.04, WHITE);
+}
 
-        Image passImage = LoadImageFromTexture(renderTexture.texture);
-        ImageFlipVertical(&passImage);
-        ImageDraw(&accumulatedImage, passImage, Rectangle{0, 0, (float)screenWidth, (float)screenHeight}, Rectangle{0, 0, (float)screenWidth, (float)screenHeight}, WHITE);
-        UnloadImage(passImage);
+void renderHighQualityImage(Shader shader, Accumulator& accumulator, FeatureTargets& features, Denoiser& denoiser, const CameraView& view, const std::function<void()>& drawRaytracing, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem) {
+    PROFILE_SCOPE("High-Quality Render");
+    int samplesLoc = GetShaderLocation(shader, "samples");
+    int totalSamples = menuSystem.getHighQualitySamples();
+    float gamma = menuSystem.getGamma();
 
-        // Draw the accumulated image as a texture
-        Texture2D accumulatedTexture = LoadTextureFromImage(accumulatedImage);
+    // Passes add to the float mean on the GPU, the image only comes back once at the end
+    accumulator.reset();
+    while (accumulatePass(shader, samplesLoc, accumulator, drawRaytracing, totalSamples)) {
+        // Show the mean so far, drawn straight from the float target
         BeginDrawing();
             ClearBackground(BLACK);
-            DrawTexture(accumulatedTexture, 0, 0, WHITE);
-
-            // Draw progress bar as an overlay
-            DrawText("Rendering High-Quality Image...", screenWidth / 2 - 150, screenHeight / 2 - 60, 20, WHITE);
-            DrawRectangle(screenWidth * 0.25, screenHeight * 0.5, screenWidth * 0.5, screenHeight * 0.04, GRAY);
-            DrawRectangle(screenWidth * 0.25, screenHeight * 0.5, (int)(screenWidth * 0.5 * (float)(pass + 1) / numPasses), screenHeight * 0.04, GREEN);
-            DrawRectangleLines(screenWidth * 0.25, screenHeight * 0.5, screenWidth * 0.5, screenHeight * 0.04, WHITE);
+            accumulator.draw(gamma);
+            drawProgress(TextFormat("Rendering High-Quality Image... %d / %d samples", accumulator.getSampleCount(), totalSamples),
+                (float)accumulator.getSampleCount() / totalSamples, screenWidth, screenHeight);
         EndDrawing();
-        UnloadTexture(accumulatedTexture);
     }
 
-    // Export the accumulated image to a file
-    ExportImage(accumulatedImage, outputFileName);
+    // The denoiser filters the final mean, as one last pass
+    bool denoise = menuSystem.isDenoising();
+    if (denoise) {
+        PROFILE_GPU_SCOPE("Denoise");
+        features.update(view, drawRaytracing);
+        denoiser.denoise(accumulator.getTarget().texture);
+    }
 
-    // Clean up
-    UnloadImage(accumulatedImage);
-    UnloadRenderTexture(renderTexture);
+    // Gamma is applied once, to the final mean
+    std::vector<Vector3> radiance;
+    {
+        PROFILE_GPU_SCOPE("Readback");
+        radiance = denoise ? denoiser.readResult() : accumulator.readMean();
+    }
+    {
+        PROFILE_SCOPE("Image Export");
+        Image image = radianceToImage(radiance, screenWidth, screenHeight, gamma);
+        ExportImage(image, outputFileName);
+        UnloadImage(image);
+        if (menuSystem.isFloatOutput()) {
+            exportRadiancePfm(radiance, screenWidth, screenHeight, floatFileName(outputFileName).c_str());
+        }
+    }
 
     // Reset the sample count to the original value
-    int defaultSampleCount = originalSamples;
-    SetShaderValue(shader, GetShaderLocation(shader, "samples"), &defaultSampleCount, SHADER_UNIFORM_INT);
-    int seedOffset = 0;
-    SetShaderValue(shader, seedOffsetLoc, &seedOffset, SHADER_UNIFORM_INT);
+    int defaultSampleCount = menuSystem.getSamples();
+    SetShaderValue(shader, samplesLoc, &defaultSampleCount, SHADER_UNIFORM_INT);
+
+    // The shader keeps the menu's noise target, converged pixels stop early in every pass
+    if (menuSystem.getNoiseTarget() > 0.0f) {
+        TraceLog(LOG_INFO, "High-quality image saved to %s, %d samples in %d passes (adaptive sampling at %.1f%% noise)%s", outputFileName, totalSamples, accumulator.getFrameCount(), menuSystem.getNoiseTarget() * 100.0f, denoise ? ", denoised" : "");
+    } else {
+        TraceLog(LOG_INFO, "High-quality image saved to %s, %d samples in %d passes%s", outputFileName, totalSamples, accumulator.getFrameCount(), denoise ? ", denoised" : "");
+    }
+}
+
+void renderTiledImage(Shader shader, const CustomCamera& camera, int imageWidth, int imageHeight, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem) {
+    PROFILE_SCOPE("Tiled Render");
+    int samplesLoc = GetShaderLocation(shader, "samples");
+    int pixel00Loc = GetShaderLocation(shader, "pixel00");
+    int pixelULoc = GetShaderLocation(shader, "pixelU");
+    int pixelVLoc = GetShaderLocation(shader, "pixelV");
+    int cameraCenterLoc = GetShaderLocation(shader, "cameraCenter");
+    int tileOffsetLoc = GetShaderLocation(shader, "tileOffset");
+    int totalSamples = menuSystem.getHighQualitySamples();
+    float gamma = menuSystem.getGamma();
+
+    PngStreamWriter png;
+    if (!png.open(outputFileName, imageWidth, imageHeight)) return;
+    PfmStreamWriter pfm;
+    bool floatOutput = menuSystem.isFloatOutput() && pfm.open(floatFileName(outputFileName).c_str(), imageWidth, imageHeight);
+
+    // Memory is one tile on the GPU and one band of 8-bit tile rows, whatever the image size
+    Accumulator tileAccumulator(renderTileSize, renderTileSize, shader);
+    std::vector<unsigned char> band((size_t)imageWidth * renderTileSize * 3);
+    CameraView view = camera.getView(imageWidth, imageHeight);
+    SetShaderValue(shader, pixelULoc, &view.pixelU, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, pixelVLoc, &view.pixelV, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, cameraCenterLoc, &view.cameraCenter, SHADER_UNIFORM_VEC3);
+
+    // The shader over the whole tile, the window's render size has nothing to do with it
+    auto drawTile = []() {
+        DrawRectangle(0, 0, renderTileSize, renderTileSize, PINK); // Fallback color
+    };
+
+    int tilesX = (imageWidth + renderTileSize - 1) / renderTileSize;
+    int tilesY = (imageHeight + renderTileSize - 1) / renderTileSize;
+    bool written = true;
+    for (int tileY = 0; tileY < tilesY && written; tileY++) {
+        int tileRow = tileY * renderTileSize;
+        int rows = std::min(renderTileSize, imageHeight - tileRow);
+
+        for (int tileX = 0; tileX < tilesX; tileX++) {
+            int tileColumn = tileX * renderTileSize;
+            int columns = std::min(renderTileSize, imageWidth - tileColumn);
+
+            // The shader's y axis points up, the tile's bottom row sits imageHeight - tileRow - renderTileSize rows above the image bottom
+            Vector2 tileOffset = { (float)tileColumn, (float)(imageHeight - tileRow - renderTileSize) };
+            Vector3 tilePixel00 = Vector3Add(view.pixel00, Vector3Add(Vector3Scale(view.pixelU, tileOffset.x), Vector3Scale(view.pixelV, tileOffset.y)));
+            SetShaderValue(shader, pixel00Loc, &tilePixel00, SHADER_UNIFORM_VEC3);
+            SetShaderValue(shader, tileOffsetLoc, &tileOffset, SHADER_UNIFORM_VEC2);
+
+            tileAccumulator.reset();
+            while (accumulatePass(shader, samplesLoc, tileAccumulator, drawTile, totalSamples)) {}
+
+            // Edge tiles are rendered whole, only the part inside the image is kept
+            std::vector<Vector3> radiance;
+            {
+                PROFILE_GPU_SCOPE("Readback");
+                radiance = tileAccumulator.readMean();
+            }
+            for (int row = 0; row < rows; row++) {
+                radianceToRgb(&radiance[(size_t)row * renderTileSize], columns, gamma, &band[((size_t)row * imageWidth + tileColumn) * 3]);
+                if (floatOutput) floatOutput = pfm.writeRowSpan(tileColumn, tileRow + row, &radiance[(size_t)row * renderTileSize], columns);
+            }
+
+            int tilesDone = tileY * tilesX + tileX + 1;
+            BeginDrawing();
+                ClearBackground(BLACK);
+                tileAccumulator.draw(gamma);
+                drawProgress(TextFormat("Rendering %dx%d Image... tile %d / %d", imageWidth, imageHeight, tilesDone, tilesX * tilesY),
+                    (float)tilesDone / (tilesX * tilesY), screenWidth, screenHeight);
+            EndDrawing();
+        }
+
+        // The finished band goes to disk before the next one starts
+        PROFILE_SCOPE("Image Export");
+        written = png.writeRows(band.data(), rows);
+    }
+    written = png.close() && written;
+    if (menuSystem.isFloatOutput() && !(pfm.close() && floatOutput)) {
+        TraceLog(LOG_WARNING, "Could not write %s", floatFileName(outputFileName).c_str());
+    }
+
+    // Back to the window's resolution, the caller has the camera uniforms sent again
+    Vector2 noOffset = { 0.0f, 0.0f };
+    SetShaderValue(shader, tileOffsetLoc, &noOffset, SHADER_UNIFORM_VEC2);
+    int defaultSampleCount = menuSystem.getSamples();
+    SetShaderValue(shader, samplesLoc, &defaultSampleCount, SHADER_UNIFORM_INT);
+
+    if (!written) {
+        TraceLog(LOG_WARNING, "Could not write %s", outputFileName);
+        return;
+    }
+    TraceLog(LOG_INFO, "Tiled image saved to %s, %dx%d in %d tiles of %d px, %d samples", outputFileName, imageWidth, imageHeight, tilesX * tilesY, renderTileSize, totalSamples);
+}
+
+void renderCpuImage(CpuRenderer& renderer, const CustomCamera& camera, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem) {
+    PROFILE_SCOPE("CPU Render");
+    BeginDrawing();
+        DrawText(TextFormat("Rendering on %d CPU threads...", renderer.getThreadCount()), screenWidth / 2 - 150, screenHeight / 2 - 60, 20, WHITE);
+    EndDrawing();
+
+    RenderSettings settings = menuSystem.getRenderSettings();
+
+    std::vector<Vector3> radiance;
+    {
+        PROFILE_SCOPE("CPU Trace");
+        renderer.render(camera.getView(), settings, screenWidth, screenHeight, radiance);
+    }
+    if (menuSystem.isDenoising()) {
+        PROFILE_SCOPE("CPU Denoise");
+        DenoiseFeatures features;
+        renderer.renderFeatures(camera.getView(), screenWidth, screenHeight, features);
+        std::vector<Vector3> denoised;
+        renderer.denoise(radiance, features, screenWidth, screenHeight, denoised);
+        radiance.swap(denoised);
+    }
+
+    PROFILE_SCOPE("Image Export");
+    Image image = radianceToImage(radiance, screenWidth, screenHeight, settings.gamma);
+    ExportImage(image, outputFileName);
+    UnloadImage(image);
+    if (menuSystem.isFloatOutput()) {
+        exportRadiancePfm(radiance, screenWidth, screenHeight, floatFileName(outputFileName).c_str());
+    }
 
-    TraceLog(LOG_INFO, "High-quality image saved to %s", outputFileName);
+    const RenderStats& stats = renderer.getStats();
+    TraceLog(LOG_INFO, "CPU image saved to %s (%.2f s, %.2f Mrays/s)", outputFileName, stats.seconds, stats.raysPerSecond() / 1e6);
 }
@@ -3,8 +3,20 @@
 
 #include "raylib.h"
 #include "MenuSystem.h"
+#include "CpuRenderer.h"
+#include "Accumulator.h"
+#include "Denoiser.h"
+#include <functional>
 
-// Function declaration
-void renderHighQualityImage(Shader shader, int seedOffsetLoc, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem);
+// Function declarations
+// Accumulate the menu's high-quality sample count in float passes, drawRaytracing draws one pass
+// Writes a PNG and, with float output on, a PFM of the linear radiance, both denoised when the menu's denoiser is on
+// view is what the shader's camera uniforms show, the denoiser's features are rendered for it
+void renderHighQualityImage(Shader shader, Accumulator& accumulator, FeatureTargets& features, Denoiser& denoiser, const CameraView& view, const std::function<void()>& drawRaytracing, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem);
+// Same for images of any size, rendered in tiles whose rows are streamed to a PNG (and a PFM with float output)
+// Every tile is drawn whole, whatever render size the window uses
+void renderTiledImage(Shader shader, const CustomCamera& camera, int imageWidth, int imageHeight, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem);
+// The CPU renderer's image of the same view, its denoiser runs on the CPU too
+void renderCpuImage(CpuRenderer& renderer, const CustomCamera& camera, int screenWidth, int screenHeight, const char* outputFileName, MenuSystem& menuSystem);
 
 #endif // RENDER_HIGH_QUALITY_IMAGE_H
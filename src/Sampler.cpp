@@ -0,0 +1,86 @@
+#include "Sampler.h"
+
+// Every function here has a twin in raytracing.frag, both renderers draw the same values
+
+uint32_t pcgHash(uint32_t input) {
+    uint32_t state = input * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint32_t pixelSeed(int x, int y) {
+    return pcgHash(pcgHash((uint32_t)x) ^ (uint32_t)y);
+}
+
+static uint32_t reverseBits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine-Karras style hash, every bit only depends on itself and the bits below it
+// (constants from Vegdahl, "Building a Better LK Hash")
+static uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+// Owen scrambling of a 0.32 fixed point number, every bit is flipped by a hash of the bits above it
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// Second Sobol dimension, the first is reverseBits(index)
+static uint32_t sobol1(uint32_t index) {
+    uint32_t direction = 0x80000000u;
+    uint32_t result = 0;
+    for (; index != 0; index >>= 1) {
+        if (index & 1u) result ^= direction;
+        direction ^= direction >> 1;
+    }
+    return result;
+}
+
+// 24 bits so the float stays below 1
+static float toUnitFloat(uint32_t x) {
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+Sampler::Sampler(SamplerType samplerType, uint32_t pixel) : type(samplerType), seed(pixel) {
+    pcgIncrement = (pixel << 1) | 1u; // Odd increments select independent streams
+}
+
+void Sampler::startSample(uint32_t index) {
+    sampleIndex = index;
+    pcgState = pcgHash(seed + pcgHash(index));
+}
+
+float Sampler::nextPcg() {
+    pcgState = pcgState * 747796405u + pcgIncrement;
+    uint32_t word = ((pcgState >> ((pcgState >> 28u) + 4u)) ^ pcgState) * 277803737u;
+    return toUnitFloat((word >> 22u) ^ word);
+}
+
+// Burley, "Practical Hash-based Owen Scrambling": the index is shuffled with a per-dimension seed,
+// which decorrelates the dimensions, then both Sobol values are Owen-scrambled
+Vector2 Sampler::get2D(int dimension) {
+    if (type == SAMPLER_PCG) {
+        float x = nextPcg();
+        return { x, nextPcg() };
+    }
+    uint32_t dimensionSeed = pcgHash(seed ^ pcgHash((uint32_t)dimension));
+    uint32_t index = nestedUniformScramble(sampleIndex, dimensionSeed);
+    uint32_t x = nestedUniformScramble(reverseBits(index), pcgHash(dimensionSeed));
+    uint32_t y = nestedUniformScramble(sobol1(index), pcgHash(dimensionSeed + 1u));
+    return { toUnitFloat(x), toUnitFloat(y) };
+}
+
+float Sampler::get1D(int dimension) {
+    return get2D(dimension).x;
+}
@@ -0,0 +1,60 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "raylib.h"
+#include <cstdint>
+
+// Sample sequences, the values are samplerType in raytracing.frag
+enum SamplerType {
+    SAMPLER_SOBOL = 0, // Owen-scrambled Sobol points, shuffled per pixel and dimension
+    SAMPLER_PCG // Independent PCG stream per pixel and sample, for comparison
+};
+
+// 2D dimensions a path draws from, the same numbers as raytracing.frag
+#define SAMPLER_DIMENSION_PIXEL 0 // Position inside the pixel
+#define SAMPLER_DIMENSION_LENS 1 // Point on the lens for defocus blur
+#define SAMPLER_DIMENSION_BOUNCE 2 // First dimension of bounce 0
+#define SAMPLER_DIMENSIONS_PER_BOUNCE 5
+#define SAMPLER_BOUNCE_BSDF 0 // Scattered direction
+#define SAMPLER_BOUNCE_CHOICE 1 // x picks reflection or refraction
+#define SAMPLER_BOUNCE_LIGHT 2 // Direction or point on the light of next-event estimation
+#define SAMPLER_BOUNCE_LIGHT_CHOICE 3 // x picks the sun or a light of the list
+#define SAMPLER_BOUNCE_ROULETTE 4 // x decides whether the path survives Russian roulette
+
+// PCG hash (https://www.pcg-random.org)
+uint32_t pcgHash(uint32_t input);
+
+// Seed of pixel x, y (gl_FragCoord, origin bottom left), decorrelates the sequences of neighbouring pixels
+uint32_t pixelSeed(int x, int y);
+
+// Dimension of one decision at a bounce, which is SAMPLER_BOUNCE_*
+inline int bounceDimension(int bounce, int which) {
+    return SAMPLER_DIMENSION_BOUNCE + bounce * SAMPLER_DIMENSIONS_PER_BOUNCE + which;
+}
+
+// Sample values of one pixel, indexed by sample and dimension
+// With SAMPLER_SOBOL every dimension is its own Owen-scrambled (0,2)-sequence, so every aligned block of
+// a power of two samples is stratified in each dimension, whatever the other dimensions do
+class Sampler {
+private:
+    SamplerType type = SAMPLER_SOBOL;
+    uint32_t seed = 0;
+    uint32_t sampleIndex = 0;
+    uint32_t pcgState = 0;
+    uint32_t pcgIncrement = 1;
+
+    float nextPcg();
+
+public:
+    Sampler() = default;
+    Sampler(SamplerType samplerType, uint32_t pixel);
+
+    // Samples of a pixel need distinct indices, progressive frames continue where the last frame stopped
+    void startSample(uint32_t index);
+
+    // Point in [0, 1)^2, SAMPLER_PCG ignores the dimension and takes the next two stream values
+    Vector2 get2D(int dimension);
+    float get1D(int dimension);
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,204 @@
+#include "Scene.h"
+#include "raymath.h"
+#include <algorithm>
+
+Vector3 instancePoint(const Instance& instance, Vector3 point) {
+    return Vector3Add(Vector3RotateByQuaternion(Vector3Scale(point, instance.scale), instance.rotation), instance.position);
+}
+
+static Aabb triangleBounds(const Scene& scene, const Triangle& triangle) {
+    Aabb box;
+    for (int i = 0; i < 3; i++) {
+        box.grow(scene.vertices[triangle.vertices[i]].position);
+    }
+    // Axis aligned triangles are flat
+    box.min = Vector3AddValue(box.min, -1e-4f);
+    box.max = Vector3AddValue(box.max, 1e-4f);
+    return box;
+}
+
+// Bounds of the items of the top level
+static std::vector<Aabb> sceneItemBounds(const Scene& scene) {
+    std::vector<Aabb> bounds;
+    bounds.reserve(scene.spheres.size() + scene.quads.size() + scene.instances.size());
+
+    for (const Sphere& sphere : scene.spheres) {
+        Vector3 radius = { fabsf(sphere.radius), fabsf(sphere.radius), fabsf(sphere.radius) };
+        bounds.push_back({ Vector3Subtract(sphere.center, radius), Vector3Add(sphere.center, radius) });
+    }
+    for (const Quad& quad : scene.quads) {
+        Aabb box;
+        box.grow(quad.origin);
+        box.grow(Vector3Add(quad.origin, quad.edgeU));
+        box.grow(Vector3Add(quad.origin, quad.edgeV));
+        box.grow(Vector3Add(quad.origin, Vector3Add(quad.edgeU, quad.edgeV)));
+        // Pad flat quads so the box never has zero thickness
+        box.min = Vector3AddValue(box.min, -1e-4f);
+        box.max = Vector3AddValue(box.max, 1e-4f);
+        bounds.push_back(box);
+    }
+    // The mesh bounds placed in the world, the rotated half extents along each axis add up to the box of the 8 rotated corners
+    for (const Instance& instance : scene.instances) {
+        const BvhNode& root = scene.meshBvh.nodes[scene.meshes[instance.mesh].rootNode];
+        Matrix rotation = QuaternionToMatrix(instance.rotation);
+        Vector3 center = instancePoint(instance, Vector3Scale(Vector3Add(root.boundsMin, root.boundsMax), 0.5f));
+        Vector3 half = Vector3Scale(Vector3Subtract(root.boundsMax, root.boundsMin), 0.5f * instance.scale);
+        Vector3 extent = {
+            fabsf(rotation.m0) * half.x + fabsf(rotation.m4) * half.y + fabsf(rotation.m8) * half.z,
+            fabsf(rotation.m1) * half.x + fabsf(rotation.m5) * half.y + fabsf(rotation.m9) * half.z,
+            fabsf(rotation.m2) * half.x + fabsf(rotation.m6) * half.y + fabsf(rotation.m10) * half.z
+        };
+        bounds.push_back({ Vector3Subtract(center, extent), Vector3Add(center, extent) });
+    }
+    return bounds;
+}
+
+void rebuildSceneBvh(Scene& scene) {
+    scene.bvh.build(sceneItemBounds(scene));
+    const BvhBuildStats& stats = scene.bvh.buildStats;
+    TraceLog(LOG_INFO, "BVH: %d items, %d nodes, %d leaves, depth %d, SAH cost %.2f, built in %.2f ms",
+        stats.itemCount, stats.nodeCount, stats.leafCount, stats.maxDepth, stats.sahCost, stats.buildSeconds * 1000.0);
+    if (stats.depthLimitedLeaves > 0) {
+        TraceLog(LOG_WARNING, "BVH: %d leaves reached the depth limit of %d and keep several items, traversal gets slower there", stats.depthLimitedLeaves, BVH_GPU_STACK_SIZE - 2);
+    }
+}
+
+void buildSceneBvh(Scene& scene) {
+    // One BVH per mesh, the instances of a mesh share it
+    Bvh& meshBvh = scene.meshBvh;
+    meshBvh.nodes.assign({});
+    meshBvh.itemIndices.assign({});
+    meshBvh.buildStats = BvhBuildStats();
+    std::vector<Mesh>& meshes = scene.meshes.edit();
+    for (Mesh& mesh : meshes) {
+        std::vector<Aabb> bounds;
+        bounds.reserve(mesh.triangleCount);
+        for (int i = 0; i < mesh.triangleCount; i++) {
+            bounds.push_back(triangleBounds(scene, scene.triangles[mesh.firstTriangle + i]));
+        }
+        Bvh bvh;
+        bvh.build(bounds);
+        mesh.rootNode = meshBvh.append(bvh, mesh.firstTriangle);
+    }
+
+    rebuildSceneBvh(scene);
+    const BvhBuildStats& meshStats = meshBvh.buildStats;
+    if (!meshes.empty()) {
+        TraceLog(LOG_INFO, "Mesh BVHs: %d meshes, %d instances, %d triangles, %d nodes, built in %.2f ms",
+            (int)meshes.size(), (int)scene.instances.size(), meshStats.itemCount, meshStats.nodeCount, meshStats.buildSeconds * 1000.0);
+    }
+    if (meshStats.depthLimitedLeaves > 0) {
+        TraceLog(LOG_WARNING, "Mesh BVHs: %d leaves reached the depth limit of %d and keep several triangles, traversal gets slower there", meshStats.depthLimitedLeaves, BVH_GPU_STACK_SIZE - 2);
+    }
+}
+
+void refitSceneBvh(Scene& scene) {
+    scene.bvh.refit(sceneItemBounds(scene));
+}
+
+static float luminance(Vector3 color) {
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+float sceneItemPower(const Scene& scene, int item) {
+    int spheresAmount = (int)scene.spheres.size();
+    if (item < spheresAmount) {
+        const Sphere& sphere = scene.spheres[item];
+        return luminance(scene.materials[sphere.materialIndex].emmisiveColor) * 4.0f * PI * sphere.radius * sphere.radius;
+    }
+    if (item < spheresAmount + (int)scene.quads.size()) {
+        const Quad& quad = scene.quads[item - spheresAmount];
+        return luminance(scene.materials[quad.materialIndex].emmisiveColor) * Vector3Length(Vector3CrossProduct(quad.edgeU, quad.edgeV));
+    }
+    return 0.0f;
+}
+
+void buildSceneLights(Scene& scene) {
+    scene.lights.clear();
+    scene.lightPower = 0.0f;
+
+    int itemCount = (int)(scene.spheres.size() + scene.quads.size());
+    for (int item = 0; item < itemCount; item++) {
+        float power = sceneItemPower(scene, item);
+        if (power <= 0.0f) continue;
+        scene.lightPower += power;
+        scene.lights.push_back({ item, power, scene.lightPower });
+    }
+    for (SceneLight& light : scene.lights) {
+        light.cdf /= scene.lightPower;
+    }
+    // Rounding must not leave a gap at the end for the pick to fall into
+    if (!scene.lights.empty()) scene.lights.back().cdf = 1.0f;
+
+    if (!scene.lights.empty()) {
+        TraceLog(LOG_INFO, "Lights: %d emissive spheres and quads", (int)scene.lights.size());
+    }
+}
+
+static bool openSceneTexture(const std::string& path, SceneTexture& texture) {
+    auto tiles = std::make_shared<TiledTexture>();
+    if (!tiles->open(path)) {
+        TraceLog(LOG_WARNING, "Failed to load texture for the CPU renderer: %s", path.c_str());
+        return false;
+    }
+    texture.path = path;
+    texture.width = tiles->getWidth();
+    texture.height = tiles->getHeight();
+    texture.tiles = std::move(tiles);
+    return true;
+}
+
+void loadSceneTextures(Scene& scene) {
+    scene.textures.clear();
+
+    for (Material& material : scene.materials) {
+        material.textureIndex = -1;
+        if (material.texturePath.empty()) continue;
+
+        SceneTexture texture;
+        if (!openSceneTexture(material.texturePath, texture)) continue;
+        material.textureIndex = (int)scene.textures.size();
+        scene.textures.push_back(std::move(texture));
+    }
+
+    if (!scene.textures.empty() && !scene.textureCache) scene.textureCache = createTextureCache();
+}
+
+bool reloadSceneTextures(Scene& scene, const std::vector<std::string>& changedFiles) {
+    std::vector<SceneTexture> previous = std::move(scene.textures);
+    scene.textures.clear();
+    bool changed = false;
+
+    for (Material& material : scene.materials) {
+        material.textureIndex = -1;
+        if (material.texturePath.empty()) continue;
+
+        // Textures whose image stayed the same keep their tiles, and with them their tiles in the cache
+        size_t index = scene.textures.size();
+        const SceneTexture* reused = nullptr;
+        if (std::find(changedFiles.begin(), changedFiles.end(), material.texturePath) == changedFiles.end()) {
+            if (index < previous.size() && previous[index].path == material.texturePath) {
+                reused = &previous[index];
+            } else {
+                auto found = std::find_if(previous.begin(), previous.end(), [&](const SceneTexture& old) { return old.path == material.texturePath; });
+                if (found != previous.end()) reused = &*found;
+            }
+        }
+
+        SceneTexture texture;
+        if (reused) {
+            texture = *reused;
+        } else if (!openSceneTexture(material.texturePath, texture)) {
+            changed = true;
+            continue;
+        }
+        // The atlas is packed in index order, so a texture that moved to another index is a change too
+        if (index >= previous.size() || previous[index].tiles != texture.tiles) changed = true;
+        material.textureIndex = (int)index;
+        scene.textures.push_back(std::move(texture));
+    }
+    if (scene.textures.size() != previous.size()) changed = true;
+
+    if (!scene.textures.empty() && !scene.textureCache) scene.textureCache = createTextureCache();
+    return changed;
+}
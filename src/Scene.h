@@ -0,0 +1,136 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "raylib.h"
+#include "Bvh.h"
+#include "MappedArray.h"
+#include "MappedFile.h"
+#include "TextureCache.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Material types, matching materialType in raytracing.frag
+#define MATERIAL_LAMBERTIAN 0
+#define MATERIAL_METAL 1
+#define MATERIAL_DIELECTRIC 2
+#define MATERIAL_TYPE_COUNT 3
+
+struct Material {
+    int type = MATERIAL_LAMBERTIAN;
+    Vector3 albedo = { 0.0f, 0.0f, 0.0f };
+    Vector3 emmisiveColor = { 0.0f, 0.0f, 0.0f };
+    float fuzz = 0.0f;
+    float refractionIndex = 0.0f;
+    std::string texturePath; // Empty when the material has no texture
+    int textureIndex = -1; // Index into Scene::textures, -1 when there is none
+};
+
+struct Sphere {
+    Vector3 center;
+    float radius;
+    int materialIndex;
+};
+
+struct Quad {
+    Vector3 origin;
+    Vector3 edgeU;
+    Vector3 edgeV;
+    int materialIndex;
+};
+
+// Vertex shared by the triangles of a mesh
+struct MeshVertex {
+    Vector3 position;
+    Vector2 uv;
+};
+
+// Three indices into Scene::vertices, counter-clockwise when seen from the front
+struct Triangle {
+    int vertices[3];
+    int materialIndex;
+};
+
+// Triangles [firstTriangle, firstTriangle + triangleCount) of Scene::triangles, in the object space of the mesh
+// Every mesh has its own BVH in Scene::meshBvh, however many instances place it in the world
+struct Mesh {
+    int firstTriangle;
+    int triangleCount;
+    int rootNode; // Node of Scene::meshBvh
+};
+
+// A mesh placed in the world: scaled, then rotated, then moved to position
+struct Instance {
+    Vector3 position;
+    float scale; // Uniform, so normals and distances along rays need no extra care
+    Quaternion rotation; // Unit length
+    int mesh;
+};
+
+// Emissive sphere or quad, next-event estimation picks lights in proportion to their power
+struct SceneLight {
+    int item; // BVH item index, spheres first, then quads
+    float power; // Luminance of the emission times the surface area
+    float cdf; // Summed power of this and every earlier light over Scene::lightPower, the last is 1
+};
+
+// Material texture, the CPU renderer reads its MIP pyramid tile by tile through Scene::textureCache
+struct SceneTexture {
+    std::string path; // Image file, Material::texturePath
+    int width = 0;
+    int height = 0;
+    std::shared_ptr<TiledTexture> tiles;
+};
+
+// CPU side copy of the world, shared by the CPU renderer and the shader upload
+struct Scene {
+    std::vector<Material> materials;
+    MappedArray<Sphere> spheres;
+    MappedArray<Quad> quads;
+    MappedArray<MeshVertex> vertices; // Every mesh, each in its own object space
+    MappedArray<Triangle> triangles;
+    MappedArray<Mesh> meshes;
+    MappedArray<Instance> instances;
+    std::vector<SceneTexture> textures;
+    std::shared_ptr<TextureCache> textureCache; // Created with the first texture, shared by every copy of the scene
+
+    // Every emissive sphere and quad, emissive mesh triangles are only found by scattered rays
+    std::vector<SceneLight> lights;
+    float lightPower = 0.0f;
+
+    // Two-level acceleration structure: the items of the top level are the spheres, then the quads, then the instances
+    // An instance hit continues in the BVH of its mesh, whose items are triangle indices
+    Bvh bvh;
+    Bvh meshBvh; // BVH of every mesh, one after another
+
+    // Binary scene cache the arrays above may point into, kept open as long as any copy of the scene
+    std::shared_ptr<MappedFile> cacheFile;
+};
+
+// Build the BVH of every mesh into Scene::meshBvh, then Scene::bvh over every sphere, quad and instance
+void buildSceneBvh(Scene& scene);
+
+// Build Scene::bvh again after spheres, quads or instances were added or removed, the mesh BVHs stay as they are
+void rebuildSceneBvh(Scene& scene);
+
+// Fit Scene::bvh to spheres, quads and instances that moved, the mesh BVHs stay as they are
+// Much faster than buildSceneBvh(), but the tree gets slower the further things move from where it was built
+void refitSceneBvh(Scene& scene);
+
+// World position of a point in the object space of an instance
+Vector3 instancePoint(const Instance& instance, Vector3 point);
+
+// Build Scene::lights from the spheres, quads and their materials, again whenever emission changes
+void buildSceneLights(Scene& scene);
+
+// Emission luminance times surface area of a sphere or quad item, raytracing.frag computes the same
+float sceneItemPower(const Scene& scene, int item);
+
+// Open the tiled texture of every material into Scene::textures, tile files are built for new or changed images
+void loadSceneTextures(Scene& scene);
+
+// Same after the materials changed, textures already open are kept unless their image is one of changedFiles
+// Returns true when Scene::textures changed
+bool reloadSceneTextures(Scene& scene, const std::vector<std::string>& changedFiles);
+
+#endif // SCENE_H
@@ -0,0 +1,360 @@
+#include "SceneCache.h"
+#include "raylib.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// The cache is only valid for the exact layout it was written with
+static const char cacheMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+
+// Sections start on cache line boundaries
+static const uint64_t sectionAlignment = 64;
+
+struct SceneCacheSection {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct SceneCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t sourceHash;
+    uint64_t fileSize;
+
+    // Element sizes, a build with a different layout rejects the file
+    uint32_t materialSize;
+    uint32_t sphereSize;
+    uint32_t quadSize;
+    uint32_t nodeSize;
+    uint32_t vertexSize;
+    uint32_t triangleSize;
+    uint32_t meshSize;
+    uint32_t instanceSize;
+
+    SceneCacheSection materials;
+    SceneCacheSection strings; // Texture paths of all materials, not terminated
+    SceneCacheSection spheres;
+    SceneCacheSection quads;
+    SceneCacheSection vertices;
+    SceneCacheSection triangles;
+    SceneCacheSection meshes;
+    SceneCacheSection instances;
+    SceneCacheSection bvhNodes;
+    SceneCacheSection bvhItems;
+    SceneCacheSection meshBvhNodes;
+    SceneCacheSection meshBvhItems;
+
+    int32_t bvhLeafCount;
+    int32_t bvhMaxDepth;
+    float bvhSahCost;
+};
+
+// Material without the std::string, the texture path lives in the strings section
+struct SceneCacheMaterial {
+    int32_t type;
+    Vector3 albedo;
+    Vector3 emmisiveColor;
+    float fuzz;
+    float refractionIndex;
+    uint32_t texturePathOffset;
+    uint32_t texturePathLength;
+};
+
+
+
+
+
+
+// ---------------
+// --- Hashing ---
+// ---------------
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Multiply-rotate hash over four independent 64-bit lanes, runs at several GB/s
+static uint64_t hashBytes(const unsigned char* data, size_t size, uint64_t seed) {
+    const uint64_t prime1 = 0x9E3779B97F4A7C15ull;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t lanes[4] = { seed + prime1, seed + prime2, seed, seed - prime1 };
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, 8);
+            lanes[lane] = rotateLeft(lanes[lane] + word * prime2, 31) * prime1;
+        }
+    }
+
+    uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+    hash ^= size * prime1;
+    for (; i < size; i++) {
+        hash = rotateLeft(hash ^ (data[i] * prime2), 11) * prime1;
+    }
+
+    // Final avalanche so every input bit affects every output bit
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+uint64_t hashSceneSources(const std::string& worldPath) {
+    // Meshes can live in subfolders, so every JSON and OBJ file below the world folder counts
+    FilePathList files = LoadDirectoryFilesEx(worldPath.c_str(), ".json;.obj", true);
+    std::vector<std::string> paths(files.paths, files.paths + files.count);
+    UnloadDirectoryFiles(files);
+    std::sort(paths.begin(), paths.end());
+
+    uint64_t hash = SCENE_CACHE_VERSION;
+    for (const std::string& path : paths) {
+        // The name inside the world counts too, renaming a file changes which one is loaded
+        // The folder does not, so a world copied elsewhere or to another host hashes the same
+        std::string name = path.substr(std::min(path.size(), worldPath.size()));
+        hash = hashBytes((const unsigned char*)name.data(), name.size(), hash);
+        MappedFile file;
+        if (file.open(path)) hash = hashBytes(file.data(), file.size(), hash);
+    }
+    return hash;
+}
+
+
+
+
+
+
+// ---------------
+// --- Loading ---
+// ---------------
+
+static bool validSection(const SceneCacheSection& section, uint64_t elementSize, uint64_t fileSize) {
+    if (section.offset % sectionAlignment != 0 || section.offset > fileSize) return false;
+    return section.count <= (fileSize - section.offset) / elementSize;
+}
+
+bool loadSceneCache(const std::string& cachePath, uint64_t sourceHash, Scene& scene) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(cachePath)) return false;
+
+    SceneCacheHeader header;
+    if (file->size() < sizeof(header)) {
+        TraceLog(LOG_WARNING, "Scene cache %s is truncated, rebuilding it", cachePath.c_str());
+        return false;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+
+    bool compatible = memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+        && header.version == SCENE_CACHE_VERSION
+        && header.headerSize == sizeof(SceneCacheHeader)
+        && header.materialSize == sizeof(SceneCacheMaterial)
+        && header.sphereSize == sizeof(Sphere)
+        && header.quadSize == sizeof(Quad)
+        && header.nodeSize == sizeof(BvhNode)
+        && header.vertexSize == sizeof(MeshVertex)
+        && header.triangleSize == sizeof(Triangle)
+        && header.meshSize == sizeof(Mesh)
+        && header.instanceSize == sizeof(Instance);
+    if (!compatible) {
+        TraceLog(LOG_INFO, "Scene cache %s is from another version, rebuilding it", cachePath.c_str());
+        return false;
+    }
+    if (header.sourceHash != sourceHash) {
+        TraceLog(LOG_INFO, "Scene cache %s is out of date, rebuilding it", cachePath.c_str());
+        return false;
+    }
+
+    uint64_t fileSize = file->size();
+    bool valid = header.fileSize == fileSize
+        && validSection(header.materials, sizeof(SceneCacheMaterial), fileSize)
+        && validSection(header.strings, 1, fileSize)
+        && validSection(header.spheres, sizeof(Sphere), fileSize)
+        && validSection(header.quads, sizeof(Quad), fileSize)
+        && validSection(header.vertices, sizeof(MeshVertex), fileSize)
+        && validSection(header.triangles, sizeof(Triangle), fileSize)
+        && validSection(header.meshes, sizeof(Mesh), fileSize)
+        && validSection(header.instances, sizeof(Instance), fileSize)
+        && validSection(header.bvhNodes, sizeof(BvhNode), fileSize)
+        && validSection(header.bvhItems, sizeof(int), fileSize)
+        && validSection(header.meshBvhNodes, sizeof(BvhNode), fileSize)
+        && validSection(header.meshBvhItems, sizeof(int), fileSize)
+        && header.bvhItems.count == header.spheres.count + header.quads.count + header.instances.count
+        && header.meshBvhItems.count == header.triangles.count;
+    if (!valid) {
+        TraceLog(LOG_WARNING, "Scene cache %s is damaged, rebuilding it", cachePath.c_str());
+        return false;
+    }
+
+    const unsigned char* data = file->data();
+    const char* strings = (const char*)(data + header.strings.offset);
+
+    // Materials hold strings and are few, they are the only part that gets copied
+    const SceneCacheMaterial* materials = (const SceneCacheMaterial*)(data + header.materials.offset);
+    scene.materials.resize(header.materials.count);
+    for (uint64_t i = 0; i < header.materials.count; i++) {
+        const SceneCacheMaterial& cached = materials[i];
+        Material& material = scene.materials[i];
+        material = Material();
+        material.type = cached.type;
+        material.albedo = cached.albedo;
+        material.emmisiveColor = cached.emmisiveColor;
+        material.fuzz = cached.fuzz;
+        material.refractionIndex = cached.refractionIndex;
+        if ((uint64_t)cached.texturePathOffset + cached.texturePathLength <= header.strings.count) {
+            material.texturePath.assign(strings + cached.texturePathOffset, cached.texturePathLength);
+        }
+    }
+
+    scene.spheres.assignMapped((const Sphere*)(data + header.spheres.offset), header.spheres.count);
+    scene.quads.assignMapped((const Quad*)(data + header.quads.offset), header.quads.count);
+    scene.vertices.assignMapped((const MeshVertex*)(data + header.vertices.offset), header.vertices.count);
+    scene.triangles.assignMapped((const Triangle*)(data + header.triangles.offset), header.triangles.count);
+    scene.meshes.assignMapped((const Mesh*)(data + header.meshes.offset), header.meshes.count);
+    scene.instances.assignMapped((const Instance*)(data + header.instances.offset), header.instances.count);
+    scene.bvh.nodes.assignMapped((const BvhNode*)(data + header.bvhNodes.offset), header.bvhNodes.count);
+    scene.bvh.itemIndices.assignMapped((const int*)(data + header.bvhItems.offset), header.bvhItems.count);
+    scene.meshBvh.nodes.assignMapped((const BvhNode*)(data + header.meshBvhNodes.offset), header.meshBvhNodes.count);
+    scene.meshBvh.itemIndices.assignMapped((const int*)(data + header.meshBvhItems.offset), header.meshBvhItems.count);
+
+    BvhBuildStats& stats = scene.bvh.buildStats;
+    stats = BvhBuildStats();
+    stats.itemCount = (int)header.bvhItems.count;
+    stats.nodeCount = (int)header.bvhNodes.count;
+    stats.leafCount = header.bvhLeafCount;
+    stats.maxDepth = header.bvhMaxDepth;
+    stats.sahCost = header.bvhSahCost;
+    scene.meshBvh.buildStats = BvhBuildStats();
+    scene.meshBvh.buildStats.itemCount = (int)header.meshBvhItems.count;
+    scene.meshBvh.buildStats.nodeCount = (int)header.meshBvhNodes.count;
+    scene.cacheFile = file;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TraceLog(LOG_INFO, "Mapped scene cache %s: %d materials, %d spheres, %d quads, %d instances of %d meshes (%d triangles), %d BVH nodes in %.2f ms",
+        cachePath.c_str(), (int)scene.materials.size(), (int)scene.spheres.size(), (int)scene.quads.size(), (int)scene.instances.size(), (int)scene.meshes.size(),
+        (int)scene.triangles.size(), stats.nodeCount + (int)header.meshBvhNodes.count, seconds * 1000.0);
+    return true;
+}
+
+
+
+
+
+
+// ---------------
+// --- Writing ---
+// ---------------
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+// Reserve space for count elements after the previous sections
+static SceneCacheSection placeSection(uint64_t& offset, uint64_t count, uint64_t elementSize) {
+    SceneCacheSection section = { alignOffset(offset), count };
+    offset = section.offset + count * elementSize;
+    return section;
+}
+
+// Sections are written in order, the gaps before them are filled with zeros
+static bool writeSection(FILE* file, uint64_t& position, const SceneCacheSection& section, const void* data, uint64_t elementSize) {
+    static const unsigned char zeros[sectionAlignment] = {};
+    uint64_t padding = section.offset - position;
+    if (padding > 0 && fwrite(zeros, 1, (size_t)padding, file) != padding) return false;
+    if (section.count > 0 && fwrite(data, (size_t)elementSize, (size_t)section.count, file) != section.count) return false;
+    position = section.offset + section.count * elementSize;
+    return true;
+}
+
+bool writeSceneCache(const std::string& cachePath, uint64_t sourceHash, const Scene& scene) {
+    std::vector<SceneCacheMaterial> materials(scene.materials.size());
+    std::string strings;
+    for (size_t i = 0; i < scene.materials.size(); i++) {
+        const Material& material = scene.materials[i];
+        SceneCacheMaterial& cached = materials[i];
+        memset(&cached, 0, sizeof(cached));
+        cached.type = material.type;
+        cached.albedo = material.albedo;
+        cached.emmisiveColor = material.emmisiveColor;
+        cached.fuzz = material.fuzz;
+        cached.refractionIndex = material.refractionIndex;
+        cached.texturePathOffset = (uint32_t)strings.size();
+        cached.texturePathLength = (uint32_t)material.texturePath.size();
+        strings += material.texturePath;
+    }
+
+    SceneCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = SCENE_CACHE_VERSION;
+    header.headerSize = sizeof(SceneCacheHeader);
+    header.sourceHash = sourceHash;
+    header.materialSize = sizeof(SceneCacheMaterial);
+    header.sphereSize = sizeof(Sphere);
+    header.quadSize = sizeof(Quad);
+    header.nodeSize = sizeof(BvhNode);
+    header.vertexSize = sizeof(MeshVertex);
+    header.triangleSize = sizeof(Triangle);
+    header.meshSize = sizeof(Mesh);
+    header.instanceSize = sizeof(Instance);
+
+    uint64_t offset = sizeof(SceneCacheHeader);
+    header.materials = placeSection(offset, materials.size(), sizeof(SceneCacheMaterial));
+    header.strings = placeSection(offset, strings.size(), 1);
+    header.spheres = placeSection(offset, scene.spheres.size(), sizeof(Sphere));
+    header.quads = placeSection(offset, scene.quads.size(), sizeof(Quad));
+    header.vertices = placeSection(offset, scene.vertices.size(), sizeof(MeshVertex));
+    header.triangles = placeSection(offset, scene.triangles.size(), sizeof(Triangle));
+    header.meshes = placeSection(offset, scene.meshes.size(), sizeof(Mesh));
+    header.instances = placeSection(offset, scene.instances.size(), sizeof(Instance));
+    header.bvhNodes = placeSection(offset, scene.bvh.nodes.size(), sizeof(BvhNode));
+    header.bvhItems = placeSection(offset, scene.bvh.itemIndices.size(), sizeof(int));
+    header.meshBvhNodes = placeSection(offset, scene.meshBvh.nodes.size(), sizeof(BvhNode));
+    header.meshBvhItems = placeSection(offset, scene.meshBvh.itemIndices.size(), sizeof(int));
+    header.fileSize = offset;
+    header.bvhLeafCount = scene.bvh.buildStats.leafCount;
+    header.bvhMaxDepth = scene.bvh.buildStats.maxDepth;
+    header.bvhSahCost = scene.bvh.buildStats.sahCost;
+
+    // Write a temporary file and rename it, so a crash never leaves a half-written cache behind
+    std::string temporaryPath = cachePath + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        TraceLog(LOG_WARNING, "Failed to write scene cache %s", temporaryPath.c_str());
+        return false;
+    }
+
+    uint64_t position = sizeof(header);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && writeSection(file, position, header.materials, materials.data(), sizeof(SceneCacheMaterial))
+        && writeSection(file, position, header.strings, strings.data(), 1)
+        && writeSection(file, position, header.spheres, scene.spheres.data(), sizeof(Sphere))
+        && writeSection(file, position, header.quads, scene.quads.data(), sizeof(Quad))
+        && writeSection(file, position, header.vertices, scene.vertices.data(), sizeof(MeshVertex))
+        && writeSection(file, position, header.triangles, scene.triangles.data(), sizeof(Triangle))
+        && writeSection(file, position, header.meshes, scene.meshes.data(), sizeof(Mesh))
+        && writeSection(file, position, header.instances, scene.instances.data(), sizeof(Instance))
+        && writeSection(file, position, header.bvhNodes, scene.bvh.nodes.data(), sizeof(BvhNode))
+        && writeSection(file, position, header.bvhItems, scene.bvh.itemIndices.data(), sizeof(int))
+        && writeSection(file, position, header.meshBvhNodes, scene.meshBvh.nodes.data(), sizeof(BvhNode))
+        && writeSection(file, position, header.meshBvhItems, scene.meshBvh.itemIndices.data(), sizeof(int));
+    ok = fclose(file) == 0 && ok;
+
+    if (ok) {
+        // rename does not replace existing files on every platform
+        remove(cachePath.c_str());
+        ok = rename(temporaryPath.c_str(), cachePath.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(temporaryPath.c_str());
+        TraceLog(LOG_WARNING, "Failed to write scene cache %s", cachePath.c_str());
+        return false;
+    }
+
+    TraceLog(LOG_INFO, "Wrote scene cache %s (%.2f MB)", cachePath.c_str(), header.fileSize / (1024.0 * 1024.0));
+    return true;
+}
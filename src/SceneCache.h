@@ -0,0 +1,24 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include "Scene.h"
+#include <cstdint>
+#include <string>
+
+// Binary scene cache, written next to the JSON files of a world folder
+// Spheres, quads, meshes, instances and both BVH levels are stored in their in-memory layout and used straight from the mapped file
+#define SCENE_CACHE_FILE_NAME "scene.cache"
+
+// Bump whenever the file layout or the meaning of a stored field changes
+#define SCENE_CACHE_VERSION 4
+
+// Hash of the contents of every JSON and OBJ file of the world, the cache is only used when it matches
+uint64_t hashSceneSources(const std::string& worldPath);
+
+// Map the cache into the scene, false when it is missing, out of date or from an incompatible build
+bool loadSceneCache(const std::string& cachePath, uint64_t sourceHash, Scene& scene);
+
+// Write the scene and its BVH, the file is replaced atomically
+bool writeSceneCache(const std::string& cachePath, uint64_t sourceHash, const Scene& scene);
+
+#endif // SCENE_CACHE_H
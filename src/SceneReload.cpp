@@ -0,0 +1,158 @@
+#include "SceneReload.h"
+#include "raylib.h"
+#include "JsonLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+bool SceneUpdate::changed() const {
+    return materials.changed() || spheres.changed() || quads.changed() || instances.changed() || geometry || bvh || lights || textures;
+}
+
+// The scene structs have no padding, so equal items have equal bytes
+template <typename T>
+static bool sameBytes(const T& a, const T& b) {
+    return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+template <typename T>
+static bool sameArray(const MappedArray<T>& current, const std::vector<T>& loaded) {
+    return current.size() == loaded.size() && (loaded.empty() || memcmp(current.data(), loaded.data(), loaded.size() * sizeof(T)) == 0);
+}
+
+// textureIndex is left out, reloadSceneTextures() assigns it
+static bool sameMaterial(const Material& a, const Material& b) {
+    return a.type == b.type && sameBytes(a.albedo, b.albedo) && sameBytes(a.emmisiveColor, b.emmisiveColor)
+        && a.fuzz == b.fuzz && a.refractionIndex == b.refractionIndex && a.texturePath == b.texturePath;
+}
+
+// Highest material index any sphere, quad or triangle of the scene uses, -1 when there are none
+static int highestMaterialIndex(const Scene& scene) {
+    int highest = -1;
+    for (const Sphere& sphere : scene.spheres) highest = std::max(highest, sphere.materialIndex);
+    for (const Quad& quad : scene.quads) highest = std::max(highest, quad.materialIndex);
+    for (const Triangle& triangle : scene.triangles) highest = std::max(highest, triangle.materialIndex);
+    return highest;
+}
+
+// Range from the first to the last loaded item that differs from the current one
+template <typename T, typename Equal>
+static ItemRange changedItems(const T* current, size_t currentCount, const std::vector<T>& loaded, Equal&& equal) {
+    ItemRange range;
+    if (currentCount != loaded.size()) {
+        range.count = (int)loaded.size();
+        range.resized = true;
+        return range;
+    }
+    int last = -1;
+    for (size_t i = 0; i < loaded.size(); i++) {
+        if (equal(current[i], loaded[i])) continue;
+        if (last < 0) range.first = (int)i;
+        last = (int)i;
+    }
+    range.count = last < 0 ? 0 : last - range.first + 1;
+    return range;
+}
+
+// Take the loaded items if any of them differ
+template <typename T>
+static ItemRange replaceItems(MappedArray<T>& current, std::vector<T>&& loaded) {
+    ItemRange range = changedItems(current.data(), current.size(), loaded, sameBytes<T>);
+    if (range.changed()) current.assign(std::move(loaded));
+    return range;
+}
+
+SceneUpdate reloadSceneFiles(const std::string& worldPath, const std::vector<std::string>& changedFiles, Scene& scene) {
+    auto start = std::chrono::steady_clock::now();
+    SceneUpdate update;
+
+    auto fileChanged = [&](const std::string& path) {
+        return std::find(changedFiles.begin(), changedFiles.end(), path) != changedFiles.end();
+    };
+
+    // The other files are checked against the new material count, the materials are applied once they are loaded
+    std::vector<Material> materials;
+    bool materialsLoaded = fileChanged(worldPath + "/materials.json") && loadMaterials(worldPath + "/materials.json", materials);
+    int materialCount = (int)(materialsLoaded ? materials.size() : scene.materials.size());
+
+    if (fileChanged(worldPath + "/spheres.json")) {
+        std::vector<Sphere> spheres;
+        if (loadSpheres(worldPath + "/spheres.json", materialCount, spheres)) update.spheres = replaceItems(scene.spheres, std::move(spheres));
+    }
+    if (fileChanged(worldPath + "/quads.json")) {
+        std::vector<Quad> quads;
+        if (loadQuads(worldPath + "/quads.json", materialCount, quads)) update.quads = replaceItems(scene.quads, std::move(quads));
+    }
+
+    // meshes.json names the OBJ files, so a changed OBJ file loads it again too
+    bool meshesChanged = fileChanged(worldPath + "/meshes.json") || std::any_of(changedFiles.begin(), changedFiles.end(), [](const std::string& path) {
+        return IsFileExtension(path.c_str(), ".obj");
+    });
+    if (meshesChanged) {
+        std::vector<MeshVertex> vertices;
+        std::vector<Triangle> triangles;
+        std::vector<Mesh> meshes;
+        std::vector<Instance> instances;
+        if (loadMeshes(worldPath + "/meshes.json", materialCount, vertices, triangles, meshes, instances)) {
+            // Loaded meshes have no root node yet, the triangle ranges tell whether they are the same
+            bool sameMeshes = meshes.size() == scene.meshes.size() && std::equal(meshes.begin(), meshes.end(), scene.meshes.begin(), [](const Mesh& a, const Mesh& b) {
+                return a.firstTriangle == b.firstTriangle && a.triangleCount == b.triangleCount;
+            });
+            if (sameMeshes && sameArray(scene.vertices, vertices) && sameArray(scene.triangles, triangles)) {
+                update.instances = replaceItems(scene.instances, std::move(instances));
+            } else {
+                update.instances = { 0, (int)instances.size(), true };
+                scene.vertices.assign(std::move(vertices));
+                scene.triangles.assign(std::move(triangles));
+                scene.meshes.assign(std::move(meshes));
+                scene.instances.assign(std::move(instances));
+                update.geometry = true;
+            }
+        }
+    }
+
+    // Objects whose files did not change, or failed to load, keep their material indices
+    if (materialsLoaded && materialCount < (int)scene.materials.size() && highestMaterialIndex(scene) >= materialCount) {
+        TraceLog(LOG_WARNING, "%s/materials.json has %d materials but the world still uses more, keeping the old ones", worldPath.c_str(), materialCount);
+        materialsLoaded = false;
+    }
+    if (materialsLoaded) {
+        update.materials = changedItems(scene.materials.data(), scene.materials.size(), materials, sameMaterial);
+        if (update.materials.changed()) scene.materials = std::move(materials);
+    }
+    bool imageChanged = std::any_of(scene.materials.begin(), scene.materials.end(), [&](const Material& material) {
+        return !material.texturePath.empty() && fileChanged(material.texturePath);
+    });
+    if (update.materials.changed() || imageChanged) {
+        update.textures = reloadSceneTextures(scene, changedFiles);
+        // Every material holds a texture index, and they may have moved
+        if (update.textures) update.materials = { 0, (int)scene.materials.size(), update.materials.resized };
+    }
+
+    const char* bvhAction = "kept";
+    if (update.geometry) {
+        buildSceneBvh(scene);
+        bvhAction = "built";
+    } else if (update.spheres.resized || update.quads.resized || update.instances.resized) {
+        rebuildSceneBvh(scene);
+        bvhAction = "built";
+    } else if (update.spheres.changed() || update.quads.changed() || update.instances.changed()) {
+        refitSceneBvh(scene);
+        bvhAction = "refitted";
+    }
+    update.bvh = update.geometry || update.spheres.changed() || update.quads.changed() || update.instances.changed();
+
+    // Emission and the size of emitters decide the light powers
+    if (update.materials.changed() || update.spheres.changed() || update.quads.changed()) {
+        buildSceneLights(scene);
+        update.lights = true;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (update.changed()) {
+        TraceLog(LOG_INFO, "Reloaded world: %d materials, %d spheres, %d quads, %d instances changed%s%s, BVH %s, in %.2f ms",
+            update.materials.count, update.spheres.count, update.quads.count, update.instances.count,
+            update.geometry ? ", new meshes" : "", update.textures ? ", new textures" : "", bvhAction, seconds * 1000.0);
+    }
+    return update;
+}
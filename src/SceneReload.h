@@ -0,0 +1,38 @@
+#ifndef SCENE_RELOAD_H
+#define SCENE_RELOAD_H
+
+#include "Scene.h"
+#include <string>
+#include <vector>
+
+// Items of one array that differ from before, everything when the count changed
+struct ItemRange {
+    int first = 0;
+    int count = 0;
+    bool resized = false;
+
+    bool changed() const { return count > 0 || resized; }
+};
+
+// What reloadSceneFiles() changed in the scene, so only that is uploaded and rebuilt
+struct SceneUpdate {
+    ItemRange materials;
+    ItemRange spheres;
+    ItemRange quads;
+    ItemRange instances;
+    bool geometry = false; // Vertices, triangles and meshes were replaced and the mesh BVHs built again
+    bool bvh = false; // Scene::bvh was refitted or built again
+    bool lights = false; // Scene::lights was built again
+    bool textures = false; // Scene::textures changed, material texture indices may have moved
+
+    bool changed() const;
+};
+
+// Load the world files among changedFiles (paths as SceneWatcher reports them) again and apply what differs to the scene
+// Spheres, quads and instances that only moved refit the BVH, added or removed ones build it again
+// A mesh file or meshes.json that changes more than the placement of instances builds every mesh BVH again
+// Files that fail to parse leave their part of the scene as it was, so a half-saved file does no harm
+// The same goes for a materials.json without materials that objects which were not reloaded still use
+SceneUpdate reloadSceneFiles(const std::string& worldPath, const std::vector<std::string>& changedFiles, Scene& scene);
+
+#endif // SCENE_RELOAD_H
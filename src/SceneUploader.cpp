@@ -0,0 +1,408 @@
+#include "SceneUploader.h"
+#include "rlgl.h"
+#include <algorithm>
+#include <cstring>
+
+// Texture atlas width, wider textures get an atlas of their own width
+#define SCENE_ATLAS_WIDTH 4096
+
+// Texture edge most GPUs support, bigger scene textures are logged
+#define COMMON_MAX_TEXTURE_SIZE 16384
+
+static float intBits(int value) {
+    float bits;
+    memcpy(&bits, &value, sizeof(float));
+    return bits;
+}
+
+static int uniformSize(int uniformType) {
+    switch (uniformType) {
+        case SHADER_UNIFORM_VEC2: case SHADER_UNIFORM_IVEC2: return 8;
+        case SHADER_UNIFORM_VEC3: case SHADER_UNIFORM_IVEC3: return 12;
+        case SHADER_UNIFORM_VEC4: case SHADER_UNIFORM_IVEC4: return 16;
+        default: return 4;
+    }
+}
+
+// Bind to a unit the render batch never touches, the binding lasts until the texture is unloaded
+static void bindToUnit(unsigned int textureId, int unit) {
+    rlActiveTextureSlot(unit);
+    rlEnableTexture(textureId);
+    rlActiveTextureSlot(0);
+}
+
+void DirtyRange::add(int firstItem, int count) {
+    if (count <= 0) return;
+    if (empty()) {
+        first = firstItem;
+        last = firstItem + count - 1;
+        return;
+    }
+    first = std::min(first, firstItem);
+    last = std::max(last, firstItem + count - 1);
+}
+
+void DirtyRange::clear() {
+    first = 0;
+    last = -1;
+}
+
+bool DirtyRange::empty() const {
+    return last < first;
+}
+
+SceneUploader::SceneUploader(Shader raytracingShader, const Scene& sceneRef)
+    : scene(sceneRef), shader(raytracingShader) {
+    const int texelsPerItem[SCENE_DATA_SECTION_COUNT] = { 3, 1, 2, 3, 2, 1, 3, 2, 1, 2, 1, 1 };
+    const char* offsetNames[SCENE_DATA_SECTION_COUNT] = { "materialsOffset", "texturesOffset", "spheresOffset", "quadsOffset", "verticesOffset", "trianglesOffset",
+        "instancesOffset", "bvhNodesOffset", "bvhItemsOffset", "meshBvhNodesOffset", "meshBvhItemsOffset", "lightsOffset" };
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        sections[i].texelsPerItem = texelsPerItem[i];
+        sectionUniforms[i].location = GetShaderLocation(shader, offsetNames[i]);
+    }
+    spheresAmountUniform.location = GetShaderLocation(shader, "spheresAmount");
+    quadsAmountUniform.location = GetShaderLocation(shader, "quadsAmount");
+    bvhNodesAmountUniform.location = GetShaderLocation(shader, "bvhNodesAmount");
+    lightsAmountUniform.location = GetShaderLocation(shader, "lightsAmount");
+    lightPowerUniform.location = GetShaderLocation(shader, "lightPower");
+
+    const char* cameraNames[4] = { "pixel00", "pixelU", "pixelV", "cameraCenter" };
+    for (int i = 0; i < 4; i++) cameraUniforms[i].location = GetShaderLocation(shader, cameraNames[i]);
+    const char* settingNames[7] = { "samples", "maxBounces", "gamma", "backgroundOpacity", "defocusAngle", "noiseTarget", "samplerType" };
+    for (int i = 0; i < 7; i++) settingUniforms[i].location = GetShaderLocation(shader, settingNames[i]);
+
+    // The samplers always read the same units, so they are set once
+    int dataUnit = SCENE_DATA_TEXTURE_UNIT;
+    int atlasUnit = SCENE_ATLAS_TEXTURE_UNIT;
+    SetShaderValue(shader, GetShaderLocation(shader, "sceneData"), &dataUnit, SHADER_UNIFORM_INT);
+    SetShaderValue(shader, GetShaderLocation(shader, "textureAtlas"), &atlasUnit, SHADER_UNIFORM_INT);
+}
+
+SceneUploader::~SceneUploader() {
+    if (dataTextureId != 0) rlUnloadTexture(dataTextureId);
+    if (atlasTextureId != 0) rlUnloadTexture(atlasTextureId);
+}
+
+int SceneUploader::sectionItemCount(int section) const {
+    switch (section) {
+        case SCENE_DATA_MATERIALS: return (int)scene.materials.size();
+        case SCENE_DATA_TEXTURES: return (int)scene.textures.size();
+        case SCENE_DATA_SPHERES: return (int)scene.spheres.size();
+        case SCENE_DATA_QUADS: return (int)scene.quads.size();
+        case SCENE_DATA_VERTICES: return (int)scene.vertices.size();
+        case SCENE_DATA_TRIANGLES: return (int)scene.triangles.size();
+        case SCENE_DATA_INSTANCES: return (int)scene.instances.size();
+        case SCENE_DATA_BVH_NODES: return (int)scene.bvh.nodes.size();
+        case SCENE_DATA_BVH_ITEMS: return ((int)scene.bvh.itemIndices.size() + 3) / 4;
+        case SCENE_DATA_MESH_BVH_NODES: return (int)scene.meshBvh.nodes.size();
+        case SCENE_DATA_MESH_BVH_ITEMS: return ((int)scene.meshBvh.itemIndices.size() + 3) / 4;
+        case SCENE_DATA_LIGHTS: return (int)scene.lights.size();
+        default: return 0;
+    }
+}
+
+// Pack items [first, last] of a section into the CPU copy of the data texture
+void SceneUploader::packItems(int section, int first, int last) {
+    Vector4* out = &texels[sections[section].offset + (size_t)first * sections[section].texelsPerItem];
+
+    switch (section) {
+        case SCENE_DATA_MATERIALS:
+            for (int i = first; i <= last; i++, out += 3) {
+                const Material& material = scene.materials[i];
+                out[0] = { material.albedo.x, material.albedo.y, material.albedo.z, intBits(material.type) };
+                out[1] = { material.emmisiveColor.x, material.emmisiveColor.y, material.emmisiveColor.z, material.fuzz };
+                out[2] = { material.refractionIndex, intBits(material.textureIndex), 0.0f, 0.0f };
+            }
+            break;
+        case SCENE_DATA_TEXTURES:
+            for (int i = first; i <= last; i++, out++) {
+                const Rectangle& rect = atlasRects[i];
+                *out = { intBits((int)rect.x), intBits((int)rect.y), intBits((int)rect.width), intBits((int)rect.height) };
+            }
+            break;
+        case SCENE_DATA_SPHERES:
+            for (int i = first; i <= last; i++, out += 2) {
+                const Sphere& sphere = scene.spheres[i];
+                out[0] = { sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius };
+                out[1] = { intBits(sphere.materialIndex), 0.0f, 0.0f, 0.0f };
+            }
+            break;
+        case SCENE_DATA_QUADS:
+            for (int i = first; i <= last; i++, out += 3) {
+                const Quad& quad = scene.quads[i];
+                out[0] = { quad.origin.x, quad.origin.y, quad.origin.z, intBits(quad.materialIndex) };
+                out[1] = { quad.edgeU.x, quad.edgeU.y, quad.edgeU.z, 0.0f };
+                out[2] = { quad.edgeV.x, quad.edgeV.y, quad.edgeV.z, 0.0f };
+            }
+            break;
+        case SCENE_DATA_VERTICES:
+            for (int i = first; i <= last; i++, out += 2) {
+                const MeshVertex& vertex = scene.vertices[i];
+                out[0] = { vertex.position.x, vertex.position.y, vertex.position.z, 0.0f };
+                out[1] = { vertex.uv.x, vertex.uv.y, 0.0f, 0.0f };
+            }
+            break;
+        case SCENE_DATA_TRIANGLES:
+            for (int i = first; i <= last; i++, out++) {
+                const Triangle& triangle = scene.triangles[i];
+                *out = { intBits(triangle.vertices[0]), intBits(triangle.vertices[1]), intBits(triangle.vertices[2]), intBits(triangle.materialIndex) };
+            }
+            break;
+        case SCENE_DATA_INSTANCES:
+            for (int i = first; i <= last; i++, out += 3) {
+                const Instance& instance = scene.instances[i];
+                out[0] = { instance.position.x, instance.position.y, instance.position.z, instance.scale };
+                out[1] = instance.rotation;
+                out[2] = { intBits(scene.meshes[instance.mesh].rootNode), 0.0f, 0.0f, 0.0f };
+            }
+            break;
+        case SCENE_DATA_BVH_NODES:
+        case SCENE_DATA_MESH_BVH_NODES: {
+            std::vector<Vector4> nodeTexels = packBvhNodes(section == SCENE_DATA_BVH_NODES ? scene.bvh : scene.meshBvh);
+            std::copy(nodeTexels.begin() + (size_t)first * 2, nodeTexels.begin() + (size_t)(last + 1) * 2, out);
+            break;
+        }
+        case SCENE_DATA_BVH_ITEMS:
+        case SCENE_DATA_MESH_BVH_ITEMS: {
+            const MappedArray<int>& itemIndices = section == SCENE_DATA_BVH_ITEMS ? scene.bvh.itemIndices : scene.meshBvh.itemIndices;
+            for (int i = first; i <= last; i++, out++) {
+                int items[4] = { 0, 0, 0, 0 };
+                for (int j = 0; j < 4 && (size_t)i * 4 + j < itemIndices.size(); j++) {
+                    items[j] = itemIndices[(size_t)i * 4 + j];
+                }
+                *out = { intBits(items[0]), intBits(items[1]), intBits(items[2]), intBits(items[3]) };
+            }
+            break;
+        }
+        case SCENE_DATA_LIGHTS:
+            for (int i = first; i <= last; i++, out++) {
+                *out = { intBits(scene.lights[i].item), scene.lights[i].cdf, 0.0f, 0.0f };
+            }
+            break;
+    }
+}
+
+// Place the sections one after another and size the data texture to fit them
+void SceneUploader::updateLayout() {
+    int offset = 0;
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        sections[i].itemCount = sectionItemCount(i);
+        sections[i].offset = offset;
+        sections[i].dirty.clear();
+        offset += sections[i].itemCount * sections[i].texelsPerItem;
+    }
+
+    int rows = std::max((offset + SCENE_DATA_WIDTH - 1) / SCENE_DATA_WIDTH, 1);
+    texels.assign((size_t)rows * SCENE_DATA_WIDTH, { 0.0f, 0.0f, 0.0f, 0.0f });
+    if (rows != dataTextureRows) {
+        if (dataTextureId != 0) rlUnloadTexture(dataTextureId);
+        dataTextureId = rlLoadTexture(nullptr, SCENE_DATA_WIDTH, rows, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 1);
+        dataTextureRows = rows;
+        bindToUnit(dataTextureId, SCENE_DATA_TEXTURE_UNIT);
+        if (rows > COMMON_MAX_TEXTURE_SIZE) {
+            TraceLog(LOG_WARNING, "Scene data needs a %dx%d texture, more than many GPUs support", SCENE_DATA_WIDTH, rows);
+        }
+    }
+
+    // Everything moved, so all of it goes up in one call
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        if (sections[i].itemCount > 0) packItems(i, 0, sections[i].itemCount - 1);
+    }
+    uploadTexels(0, rows * SCENE_DATA_WIDTH - 1);
+    TraceLog(LOG_INFO, "Scene data uploaded: %d texels (%.1f MB) in a %dx%d texture", offset, offset * sizeof(Vector4) / 1e6, SCENE_DATA_WIDTH, rows);
+}
+
+// Send texels [firstTexel, lastTexel] of the CPU copy, a span inside one row or whole rows
+void SceneUploader::uploadTexels(int firstTexel, int lastTexel) {
+    int firstRow = firstTexel / SCENE_DATA_WIDTH;
+    int lastRow = lastTexel / SCENE_DATA_WIDTH;
+    int x = 0;
+    int width = SCENE_DATA_WIDTH;
+    if (firstRow == lastRow) {
+        x = firstTexel % SCENE_DATA_WIDTH;
+        width = lastTexel - firstTexel + 1;
+    }
+    int rows = lastRow - firstRow + 1;
+    rlUpdateTexture(dataTextureId, x, firstRow, width, rows, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, &texels[(size_t)firstRow * SCENE_DATA_WIDTH + x]);
+
+    uint64_t bytes = (uint64_t)width * rows * sizeof(Vector4);
+    stats.frameBytes += bytes;
+    stats.totalBytes += bytes;
+    stats.frameTextureUpdates++;
+}
+
+// Shelf-pack every scene texture into one 8-bit atlas, tallest first so the shelves waste little height
+void SceneUploader::uploadAtlas() {
+    const std::vector<SceneTexture>& textures = scene.textures;
+    std::vector<int> order(textures.size());
+    int atlasWidth = SCENE_ATLAS_WIDTH;
+    for (size_t i = 0; i < textures.size(); i++) {
+        order[i] = (int)i;
+        atlasWidth = std::max(atlasWidth, textures[i].width);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return textures[a].height > textures[b].height; });
+
+    atlasRects.assign(textures.size(), { 0.0f, 0.0f, 0.0f, 0.0f });
+    int x = 0, y = 0, shelfHeight = 0;
+    for (int index : order) {
+        const SceneTexture& texture = textures[index];
+        if (x + texture.width > atlasWidth) {
+            y += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+        atlasRects[index] = { (float)x, (float)y, (float)texture.width, (float)texture.height };
+        x += texture.width;
+        shelfHeight = std::max(shelfHeight, texture.height);
+    }
+    int atlasHeight = std::max(y + shelfHeight, 1);
+    if (textures.empty()) atlasWidth = 1;
+
+    // The shader samples the full-size level, read straight from the tiles so the CPU cache is left alone
+    std::vector<Color> pixels((size_t)atlasWidth * atlasHeight, BLACK);
+    for (size_t i = 0; i < textures.size(); i++) {
+        const SceneTexture& texture = textures[i];
+        std::vector<Color> level = texture.tiles->readLevel(0);
+        for (int row = 0; row < texture.height; row++) {
+            Color* out = &pixels[((size_t)atlasRects[i].y + row) * atlasWidth + (size_t)atlasRects[i].x];
+            const Color* in = &level[(size_t)row * texture.width];
+            for (int column = 0; column < texture.width; column++) {
+                out[column] = { in[column].r, in[column].g, in[column].b, 255 };
+            }
+        }
+    }
+
+    if (atlasTextureId != 0) rlUnloadTexture(atlasTextureId);
+    atlasTextureId = rlLoadTexture(pixels.data(), atlasWidth, atlasHeight, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, 1);
+    bindToUnit(atlasTextureId, SCENE_ATLAS_TEXTURE_UNIT);
+
+    uint64_t bytes = (uint64_t)pixels.size() * sizeof(Color);
+    stats.frameBytes += bytes;
+    stats.totalBytes += bytes;
+    stats.frameTextureUpdates++;
+    if (!textures.empty()) {
+        TraceLog(LOG_INFO, "Texture atlas %dx%d holds %d textures", atlasWidth, atlasHeight, (int)textures.size());
+    }
+    if (atlasHeight > COMMON_MAX_TEXTURE_SIZE) {
+        TraceLog(LOG_WARNING, "Texture atlas is %dx%d, more than many GPUs support", atlasWidth, atlasHeight);
+    }
+}
+
+void SceneUploader::setUniform(CachedUniform& uniform, const void* value, int uniformType) {
+    int size = uniformSize(uniformType);
+    if (uniform.valid && memcmp(uniform.value, value, size) == 0) return;
+
+    memcpy(uniform.value, value, size);
+    uniform.valid = true;
+    SetShaderValue(shader, uniform.location, value, uniformType);
+    stats.frameBytes += size;
+    stats.totalBytes += size;
+    stats.frameUniformUpdates++;
+}
+
+void SceneUploader::markMaterialsDirty(int first, int count) {
+    sections[SCENE_DATA_MATERIALS].dirty.add(first, count);
+}
+
+void SceneUploader::markSpheresDirty(int first, int count) {
+    sections[SCENE_DATA_SPHERES].dirty.add(first, count);
+}
+
+void SceneUploader::markQuadsDirty(int first, int count) {
+    sections[SCENE_DATA_QUADS].dirty.add(first, count);
+}
+
+void SceneUploader::markVerticesDirty(int first, int count) {
+    sections[SCENE_DATA_VERTICES].dirty.add(first, count);
+}
+
+void SceneUploader::markTrianglesDirty(int first, int count) {
+    sections[SCENE_DATA_TRIANGLES].dirty.add(first, count);
+}
+
+void SceneUploader::markInstancesDirty(int first, int count) {
+    sections[SCENE_DATA_INSTANCES].dirty.add(first, count);
+}
+
+void SceneUploader::markBvhDirty() {
+    sections[SCENE_DATA_BVH_NODES].dirty.add(0, sections[SCENE_DATA_BVH_NODES].itemCount);
+    sections[SCENE_DATA_BVH_ITEMS].dirty.add(0, sections[SCENE_DATA_BVH_ITEMS].itemCount);
+}
+
+void SceneUploader::markMeshBvhDirty() {
+    sections[SCENE_DATA_MESH_BVH_NODES].dirty.add(0, sections[SCENE_DATA_MESH_BVH_NODES].itemCount);
+    sections[SCENE_DATA_MESH_BVH_ITEMS].dirty.add(0, sections[SCENE_DATA_MESH_BVH_ITEMS].itemCount);
+    // The instances hold the root nodes
+    sections[SCENE_DATA_INSTANCES].dirty.add(0, sections[SCENE_DATA_INSTANCES].itemCount);
+}
+
+void SceneUploader::markLightsDirty() {
+    sections[SCENE_DATA_LIGHTS].dirty.add(0, sections[SCENE_DATA_LIGHTS].itemCount);
+}
+
+void SceneUploader::markTexturesDirty() {
+    texturesChanged = true;
+}
+
+void SceneUploader::upload(const CameraView& view, const RenderSettings& settings) {
+    stats.frameBytes = 0;
+    stats.frameTextureUpdates = 0;
+    stats.frameUniformUpdates = 0;
+
+    if (texturesChanged || atlasRects.size() != scene.textures.size()) {
+        uploadAtlas();
+        sections[SCENE_DATA_TEXTURES].dirty.add(0, (int)scene.textures.size());
+        texturesChanged = false;
+    }
+
+    // A section that grew or shrank moves every section after it
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        if (sectionItemCount(i) != sections[i].itemCount) layoutChanged = true;
+    }
+    if (layoutChanged) {
+        updateLayout();
+        layoutChanged = false;
+    }
+
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        Section& section = sections[i];
+        int last = std::min(section.dirty.last, section.itemCount - 1);
+        if (section.dirty.first <= last) {
+            packItems(i, section.dirty.first, last);
+            uploadTexels(section.offset + section.dirty.first * section.texelsPerItem, section.offset + (last + 1) * section.texelsPerItem - 1);
+        }
+        section.dirty.clear();
+    }
+
+    for (int i = 0; i < SCENE_DATA_SECTION_COUNT; i++) {
+        setUniform(sectionUniforms[i], &sections[i].offset, SHADER_UNIFORM_INT);
+    }
+    setUniform(spheresAmountUniform, &sections[SCENE_DATA_SPHERES].itemCount, SHADER_UNIFORM_INT);
+    setUniform(quadsAmountUniform, &sections[SCENE_DATA_QUADS].itemCount, SHADER_UNIFORM_INT);
+    setUniform(bvhNodesAmountUniform, &sections[SCENE_DATA_BVH_NODES].itemCount, SHADER_UNIFORM_INT);
+    setUniform(lightsAmountUniform, &sections[SCENE_DATA_LIGHTS].itemCount, SHADER_UNIFORM_INT);
+    setUniform(lightPowerUniform, &scene.lightPower, SHADER_UNIFORM_FLOAT);
+
+    setUniform(cameraUniforms[0], &view.pixel00, SHADER_UNIFORM_VEC3);
+    setUniform(cameraUniforms[1], &view.pixelU, SHADER_UNIFORM_VEC3);
+    setUniform(cameraUniforms[2], &view.pixelV, SHADER_UNIFORM_VEC3);
+    setUniform(cameraUniforms[3], &view.cameraCenter, SHADER_UNIFORM_VEC3);
+
+    setUniform(settingUniforms[0], &settings.samples, SHADER_UNIFORM_INT);
+    setUniform(settingUniforms[1], &settings.maxBounces, SHADER_UNIFORM_INT);
+    setUniform(settingUniforms[2], &settings.gamma, SHADER_UNIFORM_FLOAT);
+    setUniform(settingUniforms[3], &settings.backgroundOpacity, SHADER_UNIFORM_FLOAT);
+    setUniform(settingUniforms[4], &settings.defocusAngle, SHADER_UNIFORM_FLOAT);
+    setUniform(settingUniforms[5], &settings.noiseTarget, SHADER_UNIFORM_FLOAT);
+    int samplerType = settings.sampler;
+    setUniform(settingUniforms[6], &samplerType, SHADER_UNIFORM_INT);
+}
+
+void SceneUploader::invalidateUniforms() {
+    for (CachedUniform& uniform : cameraUniforms) uniform.valid = false;
+    for (CachedUniform& uniform : settingUniforms) uniform.valid = false;
+}
+
+const SceneUploadStats& SceneUploader::getStats() const {
+    return stats;
+}
@@ -0,0 +1,130 @@
+#ifndef SCENE_UPLOADER_H
+#define SCENE_UPLOADER_H
+
+#include "raylib.h"
+#include "Scene.h"
+#include "CustomCamera.h"
+#include "CpuRenderer.h"
+#include <cstdint>
+#include <vector>
+
+// Width in texels of the scene data texture, SCENE_DATA_WIDTH in raytracing.frag
+#define SCENE_DATA_WIDTH 4096
+
+// Texture units the scene textures stay bound to, above the units raylib's render batch uses
+#define SCENE_DATA_TEXTURE_UNIT 5
+#define SCENE_ATLAS_TEXTURE_UNIT 6
+
+// Sections of the scene data texture, each starts at a texel offset the shader receives as a uniform
+// Every texel is RGBA32F, ints are stored bitwise (floatBitsToInt)
+enum SceneDataSection {
+    SCENE_DATA_MATERIALS, // 3 texels: (albedo, type), (emmisiveColor, fuzz), (refractionIndex, textureIndex, 0, 0)
+    SCENE_DATA_TEXTURES, // 1 texel: atlas rectangle (x, y, width, height)
+    SCENE_DATA_SPHERES, // 2 texels: (center, radius), (materialIndex, 0, 0, 0)
+    SCENE_DATA_QUADS, // 3 texels: (origin, materialIndex), (edgeU, 0), (edgeV, 0)
+    SCENE_DATA_VERTICES, // 2 texels: (position, 0), (uv, 0, 0)
+    SCENE_DATA_TRIANGLES, // 1 texel: (vertex 0, vertex 1, vertex 2, materialIndex)
+    SCENE_DATA_INSTANCES, // 3 texels: (position, scale), rotation, (root node of the mesh BVH, 0, 0, 0)
+    SCENE_DATA_BVH_NODES, // 2 texels, see packBvhNodes()
+    SCENE_DATA_BVH_ITEMS, // 4 item indices per texel
+    SCENE_DATA_MESH_BVH_NODES, // 2 texels, see packBvhNodes()
+    SCENE_DATA_MESH_BVH_ITEMS, // 4 triangle indices per texel
+    SCENE_DATA_LIGHTS, // 1 texel: (item, cdf, 0, 0)
+    SCENE_DATA_SECTION_COUNT
+};
+
+// Items changed since the last upload, a single range so the upload stays one row span
+struct DirtyRange {
+    int first = 0;
+    int last = -1; // Inclusive, empty when last < first
+
+    void add(int firstItem, int count);
+    void clear();
+    bool empty() const;
+};
+
+struct SceneUploadStats {
+    uint64_t frameBytes = 0; // Texture and uniform bytes sent by the last upload()
+    uint64_t totalBytes = 0;
+    int frameTextureUpdates = 0; // Row spans sent by the last upload()
+    int frameUniformUpdates = 0;
+};
+
+// Keeps the scene in textures the shader reads with texelFetch, and only sends what changed
+// Materials, primitives and the BVH are re-uploaded per dirty range, camera and settings uniforms only when their value changes
+class SceneUploader {
+private:
+    // Uniform with the value last sent to the shader
+    struct CachedUniform {
+        int location = -1;
+        unsigned char value[16] = { 0 };
+        bool valid = false;
+    };
+
+    struct Section {
+        int offset = 0; // First texel
+        int itemCount = 0;
+        int texelsPerItem = 1;
+        DirtyRange dirty;
+    };
+
+    const Scene& scene;
+    Shader shader;
+
+    Section sections[SCENE_DATA_SECTION_COUNT];
+    std::vector<Vector4> texels; // CPU copy of the data texture, dirty items are packed here first
+    unsigned int dataTextureId = 0;
+    int dataTextureRows = 0;
+    bool layoutChanged = true;
+
+    unsigned int atlasTextureId = 0;
+    std::vector<Rectangle> atlasRects; // Per texture, in atlas texels
+    bool texturesChanged = true;
+
+    CachedUniform cameraUniforms[4]; // pixel00, pixelU, pixelV, cameraCenter
+    CachedUniform settingUniforms[7]; // samples, maxBounces, gamma, backgroundOpacity, defocusAngle, noiseTarget, samplerType
+    CachedUniform sectionUniforms[SCENE_DATA_SECTION_COUNT];
+    CachedUniform spheresAmountUniform, quadsAmountUniform, bvhNodesAmountUniform, lightsAmountUniform, lightPowerUniform;
+
+    SceneUploadStats stats;
+
+    int sectionItemCount(int section) const;
+    void packItems(int section, int first, int last);
+    void updateLayout();
+    void uploadTexels(int firstTexel, int lastTexel);
+    void uploadAtlas();
+    void setUniform(CachedUniform& uniform, const void* value, int uniformType);
+
+public:
+    SceneUploader(Shader raytracingShader, const Scene& scene);
+    ~SceneUploader();
+
+    SceneUploader(const SceneUploader&) = delete;
+    SceneUploader& operator=(const SceneUploader&) = delete;
+
+    // Mark changed items, the next upload() sends them
+    void markMaterialsDirty(int first, int count);
+    void markSpheresDirty(int first, int count);
+    void markQuadsDirty(int first, int count);
+    void markVerticesDirty(int first, int count);
+    void markTrianglesDirty(int first, int count);
+    void markInstancesDirty(int first, int count);
+    // After the top-level BVH was rebuilt or refitted
+    void markBvhDirty();
+    // After the mesh BVHs were rebuilt, which only buildSceneBvh() does
+    void markMeshBvhDirty();
+    // After buildSceneLights()
+    void markLightsDirty();
+    // After Scene::textures changed, rebuilds the atlas
+    void markTexturesDirty();
+
+    // Send dirty scene data, and the camera and settings uniforms that differ from what the shader has
+    // Item counts that differ from the last upload lay the data texture out again
+    void upload(const CameraView& view, const RenderSettings& settings);
+    // Call after setting camera or settings uniforms directly, the next upload() sends all of them again
+    void invalidateUniforms();
+
+    const SceneUploadStats& getStats() const;
+};
+
+#endif // SCENE_UPLOADER_H
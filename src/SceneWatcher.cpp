@@ -0,0 +1,116 @@
+#include "SceneWatcher.h"
+#include "raylib.h"
+#include "SceneCache.h"
+#include "TextureCache.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The scene cache, tile files and their temporary files are written by the renderer
+static bool isOwnFile(const std::string& fileName) {
+    return fileName == SCENE_CACHE_FILE_NAME || endsWith(fileName, ".tmp") || endsWith(fileName, TEXTURE_TILE_FILE_EXTENSION);
+}
+
+void SceneWatcher::addPending(const std::string& fileName) {
+    if (isOwnFile(fileName)) return;
+    std::string path = directory + "/" + fileName;
+    if (std::find(pending.begin(), pending.end(), path) == pending.end()) pending.push_back(path);
+    lastChange = std::chrono::steady_clock::now();
+}
+
+#ifdef __linux__
+
+SceneWatcher::SceneWatcher(const std::string& directoryPath) : directory(directoryPath) {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Saves that replace the file (write a copy, then rename it over the original) arrive as IN_MOVED_TO
+    if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+        TraceLog(LOG_WARNING, "Failed to watch %s, changed world files are not reloaded", directory.c_str());
+        return;
+    }
+    TraceLog(LOG_INFO, "Watching %s for changes", directory.c_str());
+}
+
+SceneWatcher::~SceneWatcher() {
+    if (inotifyFd >= 0) close(inotifyFd);
+}
+
+std::vector<std::string> SceneWatcher::poll() {
+    if (inotifyFd < 0) return {};
+
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost, so every file may have changed
+                FilePathList files = LoadDirectoryFiles(directory.c_str());
+                for (unsigned int i = 0; i < files.count; i++) addPending(GetFileName(files.paths[i]));
+                UnloadDirectoryFiles(files);
+            } else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                addPending(event->name);
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    if (pending.empty() || std::chrono::steady_clock::now() - lastChange < std::chrono::milliseconds(SCENE_WATCH_SETTLE_MS)) return {};
+    std::vector<std::string> changed;
+    changed.swap(pending);
+    return changed;
+}
+
+#else
+
+SceneWatcher::SceneWatcher(const std::string& directoryPath) : directory(directoryPath) {
+    scan(false);
+    lastScan = std::chrono::steady_clock::now();
+    TraceLog(LOG_INFO, "Watching %s for changes every %d ms", directory.c_str(), SCENE_WATCH_SCAN_MS);
+}
+
+SceneWatcher::~SceneWatcher() {}
+
+// Note the modification time of every file, with report the ones that are new or differ are pending
+// Deleted files are found because they are missing from the scan
+void SceneWatcher::scan(bool report) {
+    std::unordered_map<std::string, long> current;
+    FilePathList files = LoadDirectoryFiles(directory.c_str());
+    for (unsigned int i = 0; i < files.count; i++) {
+        if (!IsPathFile(files.paths[i])) continue;
+        std::string fileName = GetFileName(files.paths[i]);
+        long modTime = GetFileModTime(files.paths[i]);
+        auto found = modTimes.find(fileName);
+        if (report && (found == modTimes.end() || found->second != modTime)) addPending(fileName);
+        current.emplace(fileName, modTime);
+    }
+    UnloadDirectoryFiles(files);
+
+    if (report) {
+        for (const std::pair<const std::string, long>& file : modTimes) {
+            if (current.find(file.first) == current.end()) addPending(file.first);
+        }
+    }
+    modTimes.swap(current);
+}
+
+std::vector<std::string> SceneWatcher::poll() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastScan >= std::chrono::milliseconds(SCENE_WATCH_SCAN_MS)) {
+        scan(true);
+        lastScan = now;
+    }
+
+    if (pending.empty() || now - lastChange < std::chrono::milliseconds(SCENE_WATCH_SETTLE_MS)) return {};
+    std::vector<std::string> changed;
+    changed.swap(pending);
+    return changed;
+}
+
+#endif
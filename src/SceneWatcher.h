@@ -0,0 +1,46 @@
+#ifndef SCENE_WATCHER_H
+#define SCENE_WATCHER_H
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Quiet time after the last change before it is reported, editors often save a file in several writes
+#define SCENE_WATCH_SETTLE_MS 100
+
+// Interval between modification time scans, on platforms without inotify
+#define SCENE_WATCH_SCAN_MS 500
+
+// Reports the files of a world folder that were saved, through inotify on Linux and by scanning modification times elsewhere
+// Files the renderer writes itself, the scene cache and texture tile files, are left out
+// Subfolders are not watched
+class SceneWatcher {
+private:
+    std::string directory;
+    std::vector<std::string> pending; // Changed files not reported yet
+    std::chrono::steady_clock::time_point lastChange;
+
+#ifdef __linux__
+    int inotifyFd = -1;
+#else
+    std::unordered_map<std::string, long> modTimes; // Last seen modification time of every file
+    std::chrono::steady_clock::time_point lastScan;
+    void scan(bool report);
+#endif
+
+    void addPending(const std::string& fileName);
+
+public:
+    SceneWatcher(const std::string& directory);
+    ~SceneWatcher();
+
+    SceneWatcher(const SceneWatcher&) = delete;
+    SceneWatcher& operator=(const SceneWatcher&) = delete;
+
+    // Paths (directory/file) of the files saved since the last report, empty while changes are still coming in
+    // Never blocks, call it once per frame
+    std::vector<std::string> poll();
+};
+
+#endif // SCENE_WATCHER_H
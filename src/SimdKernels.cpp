@@ -0,0 +1,165 @@
+#include "SimdKernels.h"
+#include "raymath.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define SIMD_X86 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+// Filled by SimdKernelsSse.cpp, SimdKernelsAvx2.cpp and SimdKernelsAvx512.cpp, false when not compiled in
+bool getSse41Kernels(SimdKernels& kernels);
+bool getAvx2Kernels(SimdKernels& kernels);
+bool getAvx512Kernels(SimdKernels& kernels);
+
+namespace {
+
+// Scalar fallback, one lane
+struct Lanes {
+    typedef float F;
+    typedef bool M;
+    static const int width = 1;
+
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F a) { *p = a; }
+    static F set1(float a) { return a; }
+    static F add(F a, F b) { return a + b; }
+    static F sub(F a, F b) { return a - b; }
+    static F mul(F a, F b) { return a * b; }
+    static F div(F a, F b) { return a / b; }
+    static F min(F a, F b) { return a < b ? a : b; }
+    static F max(F a, F b) { return a > b ? a : b; }
+    static F sqrt(F a) { return sqrtf(a); }
+    static F abs(F a) { return fabsf(a); }
+    static M lt(F a, F b) { return a < b; }
+    static M le(F a, F b) { return a <= b; }
+    static M gt(F a, F b) { return a > b; }
+    static M ge(F a, F b) { return a >= b; }
+    static M andMask(M a, M b) { return a && b; }
+    static M orMask(M a, M b) { return a || b; }
+    static F select(M m, F a, F b) { return m ? a : b; }
+    static unsigned int bits(M m) { return m ? 1u : 0u; }
+};
+
+} // namespace
+
+#include "SimdKernelsImpl.h"
+
+#ifdef SIMD_X86
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int result[4];
+    __cpuidex(result, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; i++) regs[i] = (unsigned int)result[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+static unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel detectSimdLevel() {
+    SimdLevel level = SIMD_SCALAR;
+#ifdef SIMD_X86
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    bool sse41 = (regs[2] & (1u << 19)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    bool fma = (regs[2] & (1u << 12)) != 0;
+    unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    bool avxState = (xcr0 & 0x6) == 0x6; // XMM and YMM
+    bool avx512State = (xcr0 & 0xE6) == 0xE6; // Plus opmask and ZMM
+
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7) {
+        cpuid(7, 0, regs);
+        avx2 = (regs[1] & (1u << 5)) != 0;
+        avx512 = (regs[1] & (1u << 16)) != 0;
+    }
+
+    if (sse41) level = SIMD_SSE41;
+    if (avx && avx2 && fma && avxState) level = SIMD_AVX2;
+    if (level == SIMD_AVX2 && avx512 && avx512State) level = SIMD_AVX512;
+#endif
+
+    // RAYTRACER_SIMD=scalar|sse4.1|avx2|avx512 caps the level, handy for comparing kernels
+    const char* forced = getenv("RAYTRACER_SIMD");
+    if (forced) {
+        SimdLevel cap = SIMD_AVX512;
+        if (strcmp(forced, "scalar") == 0) cap = SIMD_SCALAR;
+        else if (strcmp(forced, "sse4.1") == 0) cap = SIMD_SSE41;
+        else if (strcmp(forced, "avx2") == 0) cap = SIMD_AVX2;
+        if (cap < level) level = cap;
+    }
+    return level;
+}
+
+struct KernelTable {
+    SimdKernels kernels[4];
+    bool available[4];
+};
+
+static KernelTable loadKernelTable() {
+    KernelTable table = {};
+    table.kernels[SIMD_SCALAR] = { SIMD_SCALAR, "scalar", 1, kernelIntersectAabb, kernelIntersectSphere, kernelIntersectQuad };
+    table.available[SIMD_SCALAR] = true;
+    table.available[SIMD_SSE41] = getSse41Kernels(table.kernels[SIMD_SSE41]);
+    table.available[SIMD_AVX2] = getAvx2Kernels(table.kernels[SIMD_AVX2]);
+    table.available[SIMD_AVX512] = getAvx512Kernels(table.kernels[SIMD_AVX512]);
+    return table;
+}
+
+const SimdKernels& getSimdKernels(SimdLevel level) {
+    static const KernelTable table = loadKernelTable();
+
+    int index = (int)level;
+    while (index > 0 && !table.available[index]) index--;
+    return table.kernels[index];
+}
+
+const SimdKernels& getBestSimdKernels() {
+    static const SimdKernels& best = getSimdKernels(detectSimdLevel());
+    return best;
+}
+
+void finishRayPacket(RayPacket& packet) {
+    const float tiny = 1e-20f;
+    for (int i = 0; i < RAY_PACKET_SIZE; i++) {
+        packet.invDirectionX[i] = 1.0f / (fabsf(packet.directionX[i]) > tiny ? packet.directionX[i] : tiny);
+        packet.invDirectionY[i] = 1.0f / (fabsf(packet.directionY[i]) > tiny ? packet.directionY[i] : tiny);
+        packet.invDirectionZ[i] = 1.0f / (fabsf(packet.directionZ[i]) > tiny ? packet.directionZ[i] : tiny);
+    }
+}
+
+PacketQuad makePacketQuad(Vector3 origin, Vector3 edgeU, Vector3 edgeV) {
+    Vector3 n = Vector3CrossProduct(edgeU, edgeV);
+    Vector3 w = Vector3Scale(n, 1.0f / Vector3DotProduct(n, n));
+
+    PacketQuad quad;
+    quad.origin = origin;
+    quad.normal = Vector3Normalize(n);
+    quad.D = Vector3DotProduct(quad.normal, origin);
+    quad.alphaAxis = Vector3CrossProduct(edgeV, w);
+    quad.betaAxis = Vector3CrossProduct(w, edgeU);
+    return quad;
+}
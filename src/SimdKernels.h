@@ -0,0 +1,63 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "raylib.h"
+
+// Rays per packet, a multiple of every SIMD width (4, 8 and 16 lanes)
+#define RAY_PACKET_SIZE 16
+
+// Coherent rays in structure of arrays layout
+// Lanes with tmax <= tmin are inactive and never report hits
+struct alignas(64) RayPacket {
+    float originX[RAY_PACKET_SIZE], originY[RAY_PACKET_SIZE], originZ[RAY_PACKET_SIZE];
+    float directionX[RAY_PACKET_SIZE], directionY[RAY_PACKET_SIZE], directionZ[RAY_PACKET_SIZE];
+    float invDirectionX[RAY_PACKET_SIZE], invDirectionY[RAY_PACKET_SIZE], invDirectionZ[RAY_PACKET_SIZE];
+    float tmax[RAY_PACKET_SIZE]; // Closest hit so far
+    int hitItem[RAY_PACKET_SIZE]; // Item that produced tmax, -1 if none
+    float tmin;
+};
+
+// Quad with the per-primitive terms of hit2DPrimitive precomputed
+struct PacketQuad {
+    Vector3 origin;
+    Vector3 normal; // Unit plane normal
+    float D; // Plane offset, dot(normal, origin)
+    Vector3 alphaAxis; // alpha = dot(p, alphaAxis) is dot(w, cross(p, edgeV)) as a triple product
+    Vector3 betaAxis; // beta = dot(p, betaAxis) is dot(w, cross(edgeU, p))
+};
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE41,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+// One implementation of the packet kernels for a given instruction set
+struct SimdKernels {
+    SimdLevel level;
+    const char* name;
+    int width; // Lanes per instruction
+
+    // Bit i is set when ray i enters the box before its tmax
+    unsigned int (*intersectAabb)(const RayPacket& packet, Vector3 boundsMin, Vector3 boundsMax);
+    // Shrink tmax and set hitItem for every ray that hits the primitive closer
+    void (*intersectSphere)(RayPacket& packet, Vector3 center, float radius, int item);
+    void (*intersectQuad)(RayPacket& packet, const PacketQuad& quad, int item);
+};
+
+// Highest level supported by the CPU (CPUID) and compiled into this build
+SimdLevel detectSimdLevel();
+
+// Kernels for the given level, falling back to lower levels if it is unavailable
+const SimdKernels& getSimdKernels(SimdLevel level);
+
+// Kernels for detectSimdLevel()
+const SimdKernels& getBestSimdKernels();
+
+// Fill the inverse directions once the directions are set
+void finishRayPacket(RayPacket& packet);
+
+PacketQuad makePacketQuad(Vector3 origin, Vector3 edgeU, Vector3 edgeV);
+
+#endif // SIMD_KERNELS_H
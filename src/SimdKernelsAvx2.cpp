@@ -0,0 +1,51 @@
+// AVX2 packet kernels, 8 lanes
+// Built with -mavx2 -mfma or /arch:AVX2 (see build/premake5.lua), only called when CPUID reports AVX2
+#include "SimdKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes {
+    typedef __m256 F;
+    typedef __m256 M;
+    static const int width = 8;
+
+    static F load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, F a) { _mm256_store_ps(p, a); }
+    static F set1(float a) { return _mm256_set1_ps(a); }
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M andMask(M a, M b) { return _mm256_and_ps(a, b); }
+    static M orMask(M a, M b) { return _mm256_or_ps(a, b); }
+    static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+    static unsigned int bits(M m) { return (unsigned int)_mm256_movemask_ps(m); }
+};
+
+} // namespace
+
+#include "SimdKernelsImpl.h"
+
+bool getAvx2Kernels(SimdKernels& kernels) {
+    kernels = { SIMD_AVX2, "AVX2", Lanes::width, kernelIntersectAabb, kernelIntersectSphere, kernelIntersectQuad };
+    return true;
+}
+
+#else
+
+bool getAvx2Kernels(SimdKernels&) {
+    return false;
+}
+
+#endif
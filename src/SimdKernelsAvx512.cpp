@@ -0,0 +1,51 @@
+// AVX-512 packet kernels, 16 lanes (the whole packet at once)
+// Built with -mavx512f or /arch:AVX512 (see build/premake5.lua), only called when CPUID reports AVX-512F
+#include "SimdKernels.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes {
+    typedef __m512 F;
+    typedef __mmask16 M;
+    static const int width = 16;
+
+    static F load(const float* p) { return _mm512_load_ps(p); }
+    static void store(float* p, F a) { _mm512_store_ps(p, a); }
+    static F set1(float a) { return _mm512_set1_ps(a); }
+    static F add(F a, F b) { return _mm512_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm512_div_ps(a, b); }
+    static F min(F a, F b) { return _mm512_min_ps(a, b); }
+    static F max(F a, F b) { return _mm512_max_ps(a, b); }
+    static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+    static F abs(F a) { return _mm512_abs_ps(a); }
+    static M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static M gt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static M ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M andMask(M a, M b) { return (M)(a & b); }
+    static M orMask(M a, M b) { return (M)(a | b); }
+    static F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+    static unsigned int bits(M m) { return (unsigned int)m; }
+};
+
+} // namespace
+
+#include "SimdKernelsImpl.h"
+
+bool getAvx512Kernels(SimdKernels& kernels) {
+    kernels = { SIMD_AVX512, "AVX-512", Lanes::width, kernelIntersectAabb, kernelIntersectSphere, kernelIntersectQuad };
+    return true;
+}
+
+#else
+
+bool getAvx512Kernels(SimdKernels&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Packet kernels written once against a lane abstraction
+// Every SimdKernels*.cpp defines "Lanes" for its instruction set and then includes this file
+// Lanes provides F (float lanes), M (lane mask), width and the operations used below
+
+#include "SimdKernels.h"
+
+namespace {
+
+typedef Lanes::F F;
+typedef Lanes::M M;
+
+// Write item to hitItem for every lane set in mask
+inline void setHitItems(RayPacket& packet, int offset, unsigned int mask, int item) {
+    for (int lane = 0; mask; lane++, mask >>= 1) {
+        if (mask & 1u) packet.hitItem[offset + lane] = item;
+    }
+}
+
+inline F dot3(F ax, F ay, F az, F bx, F by, F bz) {
+    return Lanes::add(Lanes::add(Lanes::mul(ax, bx), Lanes::mul(ay, by)), Lanes::mul(az, bz));
+}
+
+unsigned int kernelIntersectAabb(const RayPacket& packet, Vector3 boundsMin, Vector3 boundsMax) {
+    const F minX = Lanes::set1(boundsMin.x), minY = Lanes::set1(boundsMin.y), minZ = Lanes::set1(boundsMin.z);
+    const F maxX = Lanes::set1(boundsMax.x), maxY = Lanes::set1(boundsMax.y), maxZ = Lanes::set1(boundsMax.z);
+    const F tmin = Lanes::set1(packet.tmin);
+    unsigned int result = 0;
+
+    for (int i = 0; i < RAY_PACKET_SIZE; i += Lanes::width) {
+        F ox = Lanes::load(packet.originX + i), oy = Lanes::load(packet.originY + i), oz = Lanes::load(packet.originZ + i);
+        F ix = Lanes::load(packet.invDirectionX + i), iy = Lanes::load(packet.invDirectionY + i), iz = Lanes::load(packet.invDirectionZ + i);
+
+        F tx1 = Lanes::mul(Lanes::sub(minX, ox), ix), tx2 = Lanes::mul(Lanes::sub(maxX, ox), ix);
+        F ty1 = Lanes::mul(Lanes::sub(minY, oy), iy), ty2 = Lanes::mul(Lanes::sub(maxY, oy), iy);
+        F tz1 = Lanes::mul(Lanes::sub(minZ, oz), iz), tz2 = Lanes::mul(Lanes::sub(maxZ, oz), iz);
+
+        F tNear = Lanes::max(Lanes::max(Lanes::min(tx1, tx2), Lanes::min(ty1, ty2)), Lanes::max(Lanes::min(tz1, tz2), tmin));
+        F tFar = Lanes::min(Lanes::min(Lanes::max(tx1, tx2), Lanes::max(ty1, ty2)), Lanes::min(Lanes::max(tz1, tz2), Lanes::load(packet.tmax + i)));
+        result |= Lanes::bits(Lanes::le(tNear, tFar)) << i;
+    }
+    return result;
+}
+
+void kernelIntersectSphere(RayPacket& packet, Vector3 center, float radius, int item) {
+    const F cx = Lanes::set1(center.x), cy = Lanes::set1(center.y), cz = Lanes::set1(center.z);
+    const F radiusSquared = Lanes::set1(radius * radius);
+    const F tmin = Lanes::set1(packet.tmin);
+    const F zero = Lanes::set1(0.0f);
+
+    for (int i = 0; i < RAY_PACKET_SIZE; i += Lanes::width) {
+        F dx = Lanes::load(packet.directionX + i), dy = Lanes::load(packet.directionY + i), dz = Lanes::load(packet.directionZ + i);
+        F ocx = Lanes::sub(cx, Lanes::load(packet.originX + i));
+        F ocy = Lanes::sub(cy, Lanes::load(packet.originY + i));
+        F ocz = Lanes::sub(cz, Lanes::load(packet.originZ + i));
+
+        // Same quadratic as hitSphere
+        F a = dot3(dx, dy, dz, dx, dy, dz);
+        F halfb = dot3(dx, dy, dz, ocx, ocy, ocz);
+        F c = Lanes::sub(dot3(ocx, ocy, ocz, ocx, ocy, ocz), radiusSquared);
+        F discriminant = Lanes::sub(Lanes::mul(halfb, halfb), Lanes::mul(a, c));
+        M hasRoots = Lanes::gt(discriminant, zero);
+        F sqrtd = Lanes::sqrt(Lanes::max(discriminant, zero));
+
+        F tmax = Lanes::load(packet.tmax + i);
+        F nearRoot = Lanes::div(Lanes::sub(halfb, sqrtd), a);
+        F farRoot = Lanes::div(Lanes::add(halfb, sqrtd), a);
+        M nearValid = Lanes::andMask(Lanes::gt(nearRoot, tmin), Lanes::lt(nearRoot, tmax));
+        M farValid = Lanes::andMask(Lanes::gt(farRoot, tmin), Lanes::lt(farRoot, tmax));
+        M hit = Lanes::andMask(hasRoots, Lanes::orMask(nearValid, farValid));
+
+        F root = Lanes::select(nearValid, nearRoot, farRoot);
+        Lanes::store(packet.tmax + i, Lanes::select(hit, root, tmax));
+        setHitItems(packet, i, Lanes::bits(hit), item);
+    }
+}
+
+void kernelIntersectQuad(RayPacket& packet, const PacketQuad& quad, int item) {
+    const F nx = Lanes::set1(quad.normal.x), ny = Lanes::set1(quad.normal.y), nz = Lanes::set1(quad.normal.z);
+    const F qx = Lanes::set1(quad.origin.x), qy = Lanes::set1(quad.origin.y), qz = Lanes::set1(quad.origin.z);
+    const F ax = Lanes::set1(quad.alphaAxis.x), ay = Lanes::set1(quad.alphaAxis.y), az = Lanes::set1(quad.alphaAxis.z);
+    const F bx = Lanes::set1(quad.betaAxis.x), by = Lanes::set1(quad.betaAxis.y), bz = Lanes::set1(quad.betaAxis.z);
+    const F D = Lanes::set1(quad.D);
+    const F tmin = Lanes::set1(packet.tmin);
+    const F zero = Lanes::set1(0.0f), one = Lanes::set1(1.0f);
+    const F smallValue = Lanes::set1(1.0f / 4096.0f);
+
+    for (int i = 0; i < RAY_PACKET_SIZE; i += Lanes::width) {
+        F ox = Lanes::load(packet.originX + i), oy = Lanes::load(packet.originY + i), oz = Lanes::load(packet.originZ + i);
+        F dx = Lanes::load(packet.directionX + i), dy = Lanes::load(packet.directionY + i), dz = Lanes::load(packet.directionZ + i);
+
+        // Distance to the plane, rays parallel to it are rejected like in hit2DPrimitive
+        F denominator = dot3(nx, ny, nz, dx, dy, dz);
+        M notParallel = Lanes::ge(Lanes::abs(denominator), smallValue);
+        F t = Lanes::div(Lanes::sub(D, dot3(nx, ny, nz, ox, oy, oz)), denominator);
+        F tmax = Lanes::load(packet.tmax + i);
+        M inRange = Lanes::andMask(Lanes::gt(t, tmin), Lanes::lt(t, tmax));
+
+        // Planar coordinates of the hit point
+        F px = Lanes::sub(Lanes::add(ox, Lanes::mul(t, dx)), qx);
+        F py = Lanes::sub(Lanes::add(oy, Lanes::mul(t, dy)), qy);
+        F pz = Lanes::sub(Lanes::add(oz, Lanes::mul(t, dz)), qz);
+        F alpha = dot3(px, py, pz, ax, ay, az);
+        F beta = dot3(px, py, pz, bx, by, bz);
+        M inside = Lanes::andMask(Lanes::andMask(Lanes::ge(alpha, zero), Lanes::le(alpha, one)), Lanes::andMask(Lanes::ge(beta, zero), Lanes::le(beta, one)));
+
+        M hit = Lanes::andMask(Lanes::andMask(notParallel, inRange), inside);
+        Lanes::store(packet.tmax + i, Lanes::select(hit, t, tmax));
+        setHitItems(packet, i, Lanes::bits(hit), item);
+    }
+}
+
+} // namespace
@@ -0,0 +1,51 @@
+// SSE4.1 packet kernels, 4 lanes
+// Built with -msse4.1 (see build/premake5.lua), only called when CPUID reports SSE4.1
+#include "SimdKernels.h"
+
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#include <smmintrin.h>
+
+namespace {
+
+struct Lanes {
+    typedef __m128 F;
+    typedef __m128 M;
+    static const int width = 4;
+
+    static F load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, F a) { _mm_store_ps(p, a); }
+    static F set1(float a) { return _mm_set1_ps(a); }
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static M ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+    static M andMask(M a, M b) { return _mm_and_ps(a, b); }
+    static M orMask(M a, M b) { return _mm_or_ps(a, b); }
+    static F select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+    static unsigned int bits(M m) { return (unsigned int)_mm_movemask_ps(m); }
+};
+
+} // namespace
+
+#include "SimdKernelsImpl.h"
+
+bool getSse41Kernels(SimdKernels& kernels) {
+    kernels = { SIMD_SSE41, "SSE4.1", Lanes::width, kernelIntersectAabb, kernelIntersectSphere, kernelIntersectQuad };
+    return true;
+}
+
+#else
+
+bool getSse41Kernels(SimdKernels&) {
+    return false;
+}
+
+#endif
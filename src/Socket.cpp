@@ -0,0 +1,205 @@
+#include "Socket.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET NativeSocket;
+typedef int SocketLength;
+#define NATIVE_INVALID_SOCKET INVALID_SOCKET
+#define closeNative closesocket
+#define pollNative WSAPoll
+#define SHUTDOWN_BOTH SD_BOTH
+#define SEND_FLAGS 0
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NativeSocket;
+typedef ssize_t SocketLength;
+#define NATIVE_INVALID_SOCKET -1
+#define closeNative ::close
+#define pollNative ::poll
+#define SHUTDOWN_BOTH SHUT_RDWR
+// A peer that went away must fail the send, not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+// A call a signal cut short did not fail, it is made again
+static bool interrupted() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEINTR;
+#else
+    return errno == EINTR;
+#endif
+}
+
+// Winsock has to be started once per process
+static bool startNetworking() {
+#ifdef _WIN32
+    static bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+#else
+    return true;
+#endif
+}
+
+static NativeSocket native(intptr_t handle) {
+    return handle == -1 ? NATIVE_INVALID_SOCKET : (NativeSocket)handle;
+}
+
+// Small messages are not held back to fill packets, and a broken pipe is an error
+static void configure(NativeSocket socketHandle) {
+    int enable = 1;
+    setsockopt(socketHandle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+#ifdef SO_NOSIGPIPE
+    setsockopt(socketHandle, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&enable, sizeof(enable));
+#endif
+}
+
+Socket::~Socket() {
+    close();
+}
+
+Socket::Socket(Socket&& other) noexcept : handle(other.handle) {
+    other.handle = -1;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    if (this != &other) {
+        close();
+        handle = other.handle;
+        other.handle = -1;
+    }
+    return *this;
+}
+
+bool Socket::connect(const std::string& host, int port) {
+    close();
+    if (!startNetworking()) return false;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) return false;
+
+    for (addrinfo* address = addresses; address; address = address->ai_next) {
+        NativeSocket socketHandle = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socketHandle == NATIVE_INVALID_SOCKET) continue;
+        if (::connect(socketHandle, address->ai_addr, (int)address->ai_addrlen) == 0) {
+            configure(socketHandle);
+            handle = (intptr_t)socketHandle;
+            break;
+        }
+        closeNative(socketHandle);
+    }
+    freeaddrinfo(addresses);
+    return isOpen();
+}
+
+bool Socket::listen(int port) {
+    close();
+    if (!startNetworking()) return false;
+
+    NativeSocket socketHandle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socketHandle == NATIVE_INVALID_SOCKET) return false;
+    // A coordinator started again right away can take the port back
+    int enable = 1;
+    setsockopt(socketHandle, SOL_SOCKET, SO_REUSEADDR, (const char*)&enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((unsigned short)port);
+    if (bind(socketHandle, (const sockaddr*)&address, sizeof(address)) != 0 || ::listen(socketHandle, SOMAXCONN) != 0) {
+        closeNative(socketHandle);
+        return false;
+    }
+    handle = (intptr_t)socketHandle;
+    return true;
+}
+
+Socket Socket::accept() {
+    Socket connection;
+    NativeSocket socketHandle = ::accept(native(handle), nullptr, nullptr);
+    if (socketHandle != NATIVE_INVALID_SOCKET) {
+        configure(socketHandle);
+        connection.handle = (intptr_t)socketHandle;
+    }
+    return connection;
+}
+
+bool Socket::waitReadable(int milliseconds) {
+    if (!isOpen()) return false;
+    pollfd request;
+    request.fd = native(handle);
+    request.events = POLLIN;
+    request.revents = 0;
+    return pollNative(&request, 1, milliseconds) > 0;
+}
+
+bool Socket::sendAll(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        // Windows takes int lengths
+        int chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+        SocketLength sent = ::send(native(handle), bytes, chunk, SEND_FLAGS);
+        if (sent < 0 && interrupted()) continue;
+        if (sent <= 0) return false;
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+bool Socket::receiveAll(void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        int chunk = (int)(size < (1u << 30) ? size : (1u << 30));
+        SocketLength received = ::recv(native(handle), bytes, chunk, 0);
+        if (received < 0 && interrupted()) continue;
+        // 0 is the end of the connection
+        if (received <= 0) return false;
+        bytes += received;
+        size -= (size_t)received;
+    }
+    return true;
+}
+
+void Socket::shutdown() {
+    if (isOpen()) ::shutdown(native(handle), SHUTDOWN_BOTH);
+}
+
+void Socket::close() {
+    if (isOpen()) closeNative(native(handle));
+    handle = -1;
+}
+
+bool Socket::isOpen() const {
+    return handle != -1;
+}
+
+bool parseAddress(const std::string& address, std::string& host, int& port) {
+    size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos || colon + 1 >= address.size()) return false;
+    host = address.substr(0, colon);
+    port = atoi(address.c_str() + colon + 1);
+    return !host.empty() && port > 0 && port < 65536;
+}
@@ -0,0 +1,45 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Blocking TCP socket, closed when destroyed
+// Kept free of raylib.h because winsock2.h clashes with its names
+class Socket {
+private:
+    intptr_t handle = -1; // SOCKET on Windows, a file descriptor elsewhere
+
+public:
+    Socket() = default;
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+
+    // Connect to host:port, false when nothing accepts there
+    bool connect(const std::string& host, int port);
+    // Accept connections on port of every interface
+    bool listen(int port);
+    // Next connection of a listening socket, a closed socket when it failed
+    Socket accept();
+    // True when data or a connection arrived within milliseconds
+    bool waitReadable(int milliseconds);
+
+    // Both return false when the connection broke, receiveAll() also when it was closed before size bytes arrived
+    bool sendAll(const void* data, size_t size);
+    bool receiveAll(void* data, size_t size);
+
+    // End the connection in both directions, a thread blocked in receiveAll() returns, the handle stays valid
+    void shutdown();
+    void close();
+    bool isOpen() const;
+};
+
+// Split "host:port", false when there is no port
+bool parseAddress(const std::string& address, std::string& host, int& port);
+
+#endif // SOCKET_H
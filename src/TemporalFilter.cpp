@@ -0,0 +1,115 @@
+#include "TemporalFilter.h"
+#include "Accumulator.h"
+#include "rlgl.h"
+
+TemporalFilter::TemporalFilter(int widthValue, int heightValue, const FeatureTargets& featureTargets)
+    : features(featureTargets), width(widthValue), height(heightValue) {
+    history[0] = loadFloatRenderTexture(width, height);
+    history[1] = loadFloatRenderTexture(width, height);
+    still = loadFloatRenderTexture(width, height);
+    result = &history[current];
+
+    temporalShader = LoadShader(0, "src/temporal.frag");
+    currentImageLoc = GetShaderLocation(temporalShader, "currentImage");
+    historyLoc = GetShaderLocation(temporalShader, "history");
+    albedoDepthLoc = GetShaderLocation(temporalShader, "albedoDepth");
+    historyValidLoc = GetShaderLocation(temporalShader, "historyValid");
+    currentSamplesLoc = GetShaderLocation(temporalShader, "currentSamples");
+    maxHistorySamplesLoc = GetShaderLocation(temporalShader, "maxHistorySamples");
+    const char* viewNames[4] = { "pixel00", "pixelU", "pixelV", "cameraCenter" };
+    const char* previousViewNames[4] = { "previousPixel00", "previousPixelU", "previousPixelV", "previousCameraCenter" };
+    for (int i = 0; i < 4; i++) {
+        viewLocs[i] = GetShaderLocation(temporalShader, viewNames[i]);
+        previousViewLocs[i] = GetShaderLocation(temporalShader, previousViewNames[i]);
+    }
+    displayShader = LoadShader(0, "src/display.frag");
+    displayGammaLoc = GetShaderLocation(displayShader, "gamma");
+}
+
+TemporalFilter::~TemporalFilter() {
+    UnloadRenderTexture(history[0]);
+    UnloadRenderTexture(history[1]);
+    UnloadRenderTexture(still);
+    UnloadShader(temporalShader);
+    UnloadShader(displayShader);
+}
+
+void TemporalFilter::reset() {
+    hasHistory = false;
+}
+
+void TemporalFilter::resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+}
+
+// Reallocate a target left at an older render size, it is never the one being read
+void TemporalFilter::fitTarget(RenderTexture2D& target) {
+    if (target.texture.width == width && target.texture.height == height) return;
+    UnloadRenderTexture(target);
+    target = loadFloatRenderTexture(width, height);
+}
+
+// Send a view to the four vec3 uniforms
+static void setViewUniforms(Shader shader, const int locs[4], const CameraView& view) {
+    SetShaderValue(shader, locs[0], &view.pixel00, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, locs[1], &view.pixelU, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, locs[2], &view.pixelV, SHADER_UNIFORM_VEC3);
+    SetShaderValue(shader, locs[3], &view.cameraCenter, SHADER_UNIFORM_VEC3);
+}
+
+void TemporalFilter::apply(const Texture2D& currentImage, int currentSamples, const CameraView& view, const RenderSettings& settings, bool progressive) {
+    if (hasHistory && !sameImageSettings(settings, lastSettings)) reset();
+
+    // A new view reprojects the latest result and becomes the base of the next still phase
+    // Without progressive rendering every image is a single frame, so every frame is blended into the history
+    bool moved = !hasHistory || !progressive || !sameCameraView(view, lastView);
+    const RenderTexture2D& source = moved ? *result : history[current];
+    RenderTexture2D& target = moved ? history[1 - current] : still;
+
+    int historyValid = hasHistory ? 1 : 0;
+    float samples = (float)currentSamples;
+    float maxHistorySamples = (float)(TEMPORAL_MAX_HISTORY_FRAMES * settings.samples);
+    SetShaderValue(temporalShader, historyValidLoc, &historyValid, SHADER_UNIFORM_INT);
+    SetShaderValue(temporalShader, currentSamplesLoc, &samples, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(temporalShader, maxHistorySamplesLoc, &maxHistorySamples, SHADER_UNIFORM_FLOAT);
+    setViewUniforms(temporalShader, viewLocs, view);
+    setViewUniforms(temporalShader, previousViewLocs, hasHistory ? lastView : view);
+
+    fitTarget(target);
+    BeginTextureMode(target);
+        // Alpha holds the history samples, it must be written as is
+        rlDisableColorBlend();
+        BeginShaderMode(temporalShader);
+            // Render batches reset the texture bindings, they are bound inside the shader mode
+            SetShaderValueTexture(temporalShader, currentImageLoc, currentImage);
+            SetShaderValueTexture(temporalShader, historyLoc, source.texture);
+            SetShaderValueTexture(temporalShader, albedoDepthLoc, features.getAlbedoDepth());
+            DrawRectangle(0, 0, width, height, WHITE);
+        EndShaderMode();
+    EndTextureMode();
+    rlEnableColorBlend();
+
+    if (moved) {
+        current = 1 - current;
+        result = &history[current];
+    } else {
+        result = &still;
+    }
+    lastView = view;
+    lastSettings = settings;
+    hasHistory = true;
+}
+
+void TemporalFilter::draw(float gamma) {
+    SetShaderValue(displayShader, displayGammaLoc, &gamma, SHADER_UNIFORM_FLOAT);
+
+    // Render textures are stored bottom up, flip them with a negative source height
+    BeginShaderMode(displayShader);
+        DrawTextureRec(result->texture, Rectangle{ 0, 0, (float)result->texture.width, (float)-result->texture.height }, Vector2{ 0, 0 }, WHITE);
+    EndShaderMode();
+}
+
+const Texture2D& TemporalFilter::getResult() const {
+    return result->texture;
+}
@@ -0,0 +1,64 @@
+#ifndef TEMPORAL_FILTER_H
+#define TEMPORAL_FILTER_H
+
+#include "raylib.h"
+#include "CpuRenderer.h"
+#include "CustomCamera.h"
+#include "FeatureTargets.h"
+
+// History is worth at most this many frames of samples, light that moved fades out within about as many frames
+#define TEMPORAL_MAX_HISTORY_FRAMES 16
+
+// Temporal accumulation for a moving camera: the last result is reprojected into the new view with the first-hit depth
+// and blended with the new samples, history that does not fit the new image (disocclusions) is clamped away
+// While the view is still the history of the last move stays fixed and the running mean takes over as it converges
+class TemporalFilter {
+private:
+    const FeatureTargets& features;
+    RenderTexture2D history[2]; // Results while moving, ping-pong
+    int current = 0; // History holding the latest result while moving
+    RenderTexture2D still; // Result while the view is still, history[current] is its fixed base
+    const RenderTexture2D* result; // Latest result
+    int width, height;
+
+    Shader temporalShader;
+    int currentImageLoc;
+    int historyLoc;
+    int albedoDepthLoc;
+    int historyValidLoc;
+    int currentSamplesLoc;
+    int maxHistorySamplesLoc;
+    int viewLocs[4]; // pixel00, pixelU, pixelV, cameraCenter
+    int previousViewLocs[4];
+    Shader displayShader;
+    int displayGammaLoc;
+
+    void fitTarget(RenderTexture2D& target);
+
+    // What the latest result shows, and what it was rendered with
+    CameraView lastView;
+    RenderSettings lastSettings;
+    bool hasHistory = false;
+
+public:
+    TemporalFilter(int width, int height, const FeatureTargets& features);
+    ~TemporalFilter();
+
+    TemporalFilter(const TemporalFilter&) = delete;
+    TemporalFilter& operator=(const TemporalFilter&) = delete;
+
+    // Forget the history, the next image is taken as it is
+    void reset();
+    // Change the render size, the latest result is reprojected from its old size and the targets are reallocated as they are written
+    void resize(int width, int height);
+    // Blend a linear image of the view into the history, currentSamples is the samples per pixel it holds
+    // With progressive on, an unchanged view means the image is a running mean that continues the last one
+    // The features must show the same view
+    void apply(const Texture2D& currentImage, int currentSamples, const CameraView& view, const RenderSettings& settings, bool progressive);
+    // Draw the latest result to the current framebuffer with gamma correction
+    void draw(float gamma);
+
+    const Texture2D& getResult() const;
+};
+
+#endif // TEMPORAL_FILTER_H
@@ -0,0 +1,415 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+
+// The tile file is only valid for the exact layout it was written with
+static const char tileFileMagic[8] = { 'R', 'T', 'T', 'I', 'L', 'E', 'S', '\0' };
+
+// Bytes of one tile, the header takes as much so every tile starts on a page
+static const uint64_t tileBytes = TEXTURE_TILE_TEXELS * sizeof(Color);
+
+struct TileFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileSize;
+    // The image the tiles were made from, a newer image replaces the file
+    int64_t sourceSize;
+    int64_t sourceModTime;
+    int32_t width;
+    int32_t height;
+};
+
+static std::atomic<uint32_t> nextTextureId{ 0 };
+
+
+
+
+
+
+// --------------------
+// --- Morton Order ---
+// --------------------
+
+// Spread the low 32 bits of value to the even bits
+static uint64_t spreadBits(uint64_t value) {
+    value &= 0xFFFFFFFFull;
+    value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+    value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+    value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    value = (value | (value << 2)) & 0x3333333333333333ull;
+    value = (value | (value << 1)) & 0x5555555555555555ull;
+    return value;
+}
+
+static uint64_t mortonCode(int x, int y) {
+    return spreadBits((uint64_t)x) | (spreadBits((uint64_t)y) << 1);
+}
+
+// Index of a texel of a tile along the Morton curve
+static int mortonTexel(int x, int y) {
+    return (int)mortonCode(x, y);
+}
+
+
+
+
+
+
+// ------------------
+// --- Tile Files ---
+// ------------------
+
+// 64-bit offsets, tile files of big textures are larger than what long reaches on every platform
+static bool seekFile(FILE* file, uint64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, origin) == 0;
+#else
+    return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+}
+
+static uint64_t fileLength(FILE* file) {
+    if (!seekFile(file, 0, SEEK_END)) return 0;
+#ifdef _WIN32
+    long long length = _ftelli64(file);
+#else
+    off_t length = ftello(file);
+#endif
+    return length < 0 ? 0 : (uint64_t)length;
+}
+
+static uint64_t tileOffset(uint64_t tile) {
+    return tileBytes + tile * tileBytes;
+}
+
+// Next MIP level, each texel is the rounded mean of the 2x2 texels it covers, edges of one texel repeat it
+static std::vector<Color> downsample(const std::vector<Color>& texels, int width, int height, int newWidth, int newHeight) {
+    std::vector<Color> result((size_t)newWidth * newHeight);
+    for (int y = 0; y < newHeight; y++) {
+        for (int x = 0; x < newWidth; x++) {
+            int sum[4] = { 0, 0, 0, 0 };
+            for (int i = 0; i < 4; i++) {
+                int sourceX = std::min(2 * x + (i & 1), width - 1);
+                int sourceY = std::min(2 * y + (i >> 1), height - 1);
+                const Color& texel = texels[(size_t)sourceY * width + sourceX];
+                sum[0] += texel.r;
+                sum[1] += texel.g;
+                sum[2] += texel.b;
+                sum[3] += texel.a;
+            }
+            result[(size_t)y * newWidth + x] = { (unsigned char)((sum[0] + 2) / 4), (unsigned char)((sum[1] + 2) / 4), (unsigned char)((sum[2] + 2) / 4), (unsigned char)((sum[3] + 2) / 4) };
+        }
+    }
+    return result;
+}
+
+TiledTexture::TiledTexture() : id(nextTextureId++) {
+}
+
+TiledTexture::~TiledTexture() {
+    if (file) fclose(file);
+}
+
+// Levels halve down to 1x1, the tiles of every level are laid out along a Morton curve over the tile grid
+void TiledTexture::setLevels(int width, int height) {
+    levels.clear();
+    uint64_t firstTile = 0;
+    while (true) {
+        TextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.tilesX = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        level.tilesY = (height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        level.firstTile = firstTile;
+
+        size_t tileCount = (size_t)level.tilesX * level.tilesY;
+        std::vector<uint32_t> alongCurve(tileCount);
+        std::iota(alongCurve.begin(), alongCurve.end(), 0u);
+        std::sort(alongCurve.begin(), alongCurve.end(), [&](uint32_t a, uint32_t b) {
+            return mortonCode(a % level.tilesX, a / level.tilesX) < mortonCode(b % level.tilesX, b / level.tilesX);
+        });
+        level.tileOrder.resize(tileCount);
+        for (size_t position = 0; position < tileCount; position++) {
+            level.tileOrder[alongCurve[position]] = (uint32_t)position;
+        }
+
+        firstTile += tileCount;
+        levels.push_back(std::move(level));
+        if (width == 1 && height == 1) break;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+bool TiledTexture::openTileFile(const std::string& imagePath) {
+    FILE* candidate = fopen(tilePath.c_str(), "rb");
+    if (!candidate) return false;
+
+    TileFileHeader header;
+    bool valid = fread(&header, sizeof(header), 1, candidate) == 1
+        && memcmp(header.magic, tileFileMagic, sizeof(tileFileMagic)) == 0
+        && header.version == TEXTURE_TILE_FILE_VERSION
+        && header.tileSize == TEXTURE_TILE_SIZE
+        && header.sourceSize == GetFileLength(imagePath.c_str())
+        && header.sourceModTime == GetFileModTime(imagePath.c_str())
+        && header.width > 0 && header.height > 0;
+    if (valid) {
+        setLevels(header.width, header.height);
+        const TextureLevel& last = levels.back();
+        valid = fileLength(candidate) == tileOffset(last.firstTile + (uint64_t)last.tilesX * last.tilesY);
+    }
+    if (!valid) {
+        fclose(candidate);
+        levels.clear();
+        return false;
+    }
+
+    file = candidate;
+    return true;
+}
+
+bool TiledTexture::buildTiles(const std::string& imagePath) {
+    Image image = LoadImage(imagePath.c_str());
+    if (image.data == nullptr) return false;
+    int width = image.width;
+    int height = image.height;
+    Color* colors = LoadImageColors(image);
+    std::vector<Color> texels(colors, colors + (size_t)width * height);
+    UnloadImageColors(colors);
+    UnloadImage(image);
+
+    setLevels(width, height);
+    const TextureLevel& last = levels.back();
+    memoryTiles.assign((size_t)(last.firstTile + (uint64_t)last.tilesX * last.tilesY) * TEXTURE_TILE_TEXELS, Color{ 0, 0, 0, 0 });
+    for (size_t index = 0; index < levels.size(); index++) {
+        const TextureLevel& level = levels[index];
+        if (index > 0) texels = downsample(texels, levels[index - 1].width, levels[index - 1].height, level.width, level.height);
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++) {
+                uint64_t tile = level.firstTile + level.tileOrder[(size_t)(y / TEXTURE_TILE_SIZE) * level.tilesX + x / TEXTURE_TILE_SIZE];
+                memoryTiles[(size_t)tile * TEXTURE_TILE_TEXELS + mortonTexel(x % TEXTURE_TILE_SIZE, y % TEXTURE_TILE_SIZE)] = texels[(size_t)y * level.width + x];
+            }
+        }
+    }
+
+    // Write a temporary file and rename it, so a crash never leaves a half-written tile file behind
+    std::string temporaryPath = tilePath + ".tmp";
+    FILE* output = fopen(temporaryPath.c_str(), "wb");
+    bool written = false;
+    if (output) {
+        TileFileHeader header = {};
+        memcpy(header.magic, tileFileMagic, sizeof(tileFileMagic));
+        header.version = TEXTURE_TILE_FILE_VERSION;
+        header.tileSize = TEXTURE_TILE_SIZE;
+        header.sourceSize = GetFileLength(imagePath.c_str());
+        header.sourceModTime = GetFileModTime(imagePath.c_str());
+        header.width = width;
+        header.height = height;
+        std::vector<unsigned char> headerBytes(tileBytes, 0);
+        memcpy(headerBytes.data(), &header, sizeof(header));
+        written = fwrite(headerBytes.data(), 1, headerBytes.size(), output) == headerBytes.size()
+            && fwrite(memoryTiles.data(), sizeof(Color), memoryTiles.size(), output) == memoryTiles.size();
+        written = fclose(output) == 0 && written;
+        if (written) {
+            // rename does not replace existing files on every platform
+            remove(tilePath.c_str());
+            written = rename(temporaryPath.c_str(), tilePath.c_str()) == 0;
+        }
+        if (!written) remove(temporaryPath.c_str());
+    }
+
+    double megabytes = memoryTiles.size() * sizeof(Color) / 1e6;
+    if (written && openTileFile(imagePath)) {
+        memoryTiles.clear();
+        memoryTiles.shrink_to_fit();
+        TraceLog(LOG_INFO, "Texture tiles written: %s (%dx%d, %d levels, %.1f MB)", tilePath.c_str(), width, height, (int)levels.size(), megabytes);
+    } else {
+        setLevels(width, height);
+        TraceLog(LOG_WARNING, "Failed to write %s, its %.1f MB of tiles stay in memory", tilePath.c_str(), megabytes);
+    }
+    return true;
+}
+
+bool TiledTexture::open(const std::string& imagePath) {
+    tilePath = imagePath + TEXTURE_TILE_FILE_EXTENSION;
+    if (openTileFile(imagePath)) return true;
+    return buildTiles(imagePath);
+}
+
+uint32_t TiledTexture::getId() const {
+    return id;
+}
+
+int TiledTexture::getWidth() const {
+    return levels[0].width;
+}
+
+int TiledTexture::getHeight() const {
+    return levels[0].height;
+}
+
+int TiledTexture::getLevelCount() const {
+    return (int)levels.size();
+}
+
+const TextureLevel& TiledTexture::getLevel(int level) const {
+    return levels[level];
+}
+
+void TiledTexture::readTile(int level, int tileX, int tileY, Color* texels) const {
+    const TextureLevel& info = levels[level];
+    uint64_t tile = info.firstTile + info.tileOrder[(size_t)tileY * info.tilesX + tileX];
+    if (!memoryTiles.empty()) {
+        memcpy(texels, &memoryTiles[(size_t)tile * TEXTURE_TILE_TEXELS], tileBytes);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    if (file && seekFile(file, tileOffset(tile), SEEK_SET) && fread(texels, sizeof(Color), TEXTURE_TILE_TEXELS, file) == TEXTURE_TILE_TEXELS) return;
+    memset(texels, 0, tileBytes);
+    if (!readFailed) {
+        readFailed = true;
+        TraceLog(LOG_WARNING, "Failed to read texture tiles from %s", tilePath.c_str());
+    }
+}
+
+std::vector<Color> TiledTexture::readLevel(int level) const {
+    const TextureLevel& info = levels[level];
+    std::vector<Color> result((size_t)info.width * info.height);
+    Color tile[TEXTURE_TILE_TEXELS];
+    for (int tileY = 0; tileY < info.tilesY; tileY++) {
+        for (int tileX = 0; tileX < info.tilesX; tileX++) {
+            readTile(level, tileX, tileY, tile);
+            int endX = std::min(TEXTURE_TILE_SIZE, info.width - tileX * TEXTURE_TILE_SIZE);
+            int endY = std::min(TEXTURE_TILE_SIZE, info.height - tileY * TEXTURE_TILE_SIZE);
+            for (int y = 0; y < endY; y++) {
+                for (int x = 0; x < endX; x++) {
+                    result[(size_t)(tileY * TEXTURE_TILE_SIZE + y) * info.width + tileX * TEXTURE_TILE_SIZE + x] = tile[mortonTexel(x, y)];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+
+
+
+
+
+// ------------------
+// --- Tile Cache ---
+// ------------------
+
+void TextureCache::Shard::unlink(int slot) {
+    if (previous[slot] >= 0) next[previous[slot]] = next[slot];
+    else head = next[slot];
+    if (next[slot] >= 0) previous[next[slot]] = previous[slot];
+    else tail = previous[slot];
+}
+
+void TextureCache::Shard::pushFront(int slot) {
+    previous[slot] = -1;
+    next[slot] = head;
+    if (head >= 0) previous[head] = slot;
+    head = slot;
+    if (tail < 0) tail = slot;
+}
+
+TextureCache::TextureCache(size_t capacityBytes) : shards(new Shard[TEXTURE_CACHE_SHARDS]) {
+    slotsPerShard = (int)std::max(capacityBytes / tileBytes / TEXTURE_CACHE_SHARDS, (size_t)1);
+    for (int i = 0; i < TEXTURE_CACHE_SHARDS; i++) {
+        Shard& shard = shards[i];
+        shard.tiles.resize(slotsPerShard);
+        shard.keys.resize(slotsPerShard);
+        shard.previous.resize(slotsPerShard);
+        shard.next.resize(slotsPerShard);
+        shard.slots.reserve(slotsPerShard);
+    }
+}
+
+// One texel of a tile, the tile is read and replaces the least recently used one of its shard when it is not cached
+Color TextureCache::fetch(const TiledTexture& texture, int level, int tileX, int tileY, int texel) {
+    uint64_t tile = (uint64_t)tileY * texture.getLevel(level).tilesX + tileX;
+    uint64_t key = ((uint64_t)texture.getId() << 40) | ((uint64_t)level << 35) | tile;
+    Shard& shard = shards[((key * 0x9E3779B97F4A7C15ull) >> 32) % TEXTURE_CACHE_SHARDS];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.slots.find(key);
+        if (found != shard.slots.end()) {
+            shard.hits++;
+            shard.unlink(found->second);
+            shard.pushFront(found->second);
+            return shard.tiles[found->second][texel];
+        }
+        shard.misses++;
+    }
+
+    // Read outside the lock, other threads keep sampling the shard meanwhile
+    Color texels[TEXTURE_TILE_TEXELS];
+    texture.readTile(level, tileX, tileY, texels);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Another thread may have brought the same tile in while this one was reading
+    if (shard.slots.find(key) == shard.slots.end()) {
+        int slot;
+        if (shard.used < slotsPerShard) {
+            slot = shard.used++;
+            shard.tiles[slot].reset(new Color[TEXTURE_TILE_TEXELS]);
+        } else {
+            slot = shard.tail;
+            shard.unlink(slot);
+            shard.slots.erase(shard.keys[slot]);
+        }
+        memcpy(shard.tiles[slot].get(), texels, tileBytes);
+        shard.keys[slot] = key;
+        shard.slots[key] = slot;
+        shard.pushFront(slot);
+    }
+    return texels[texel];
+}
+
+Vector3 TextureCache::sample(const TiledTexture& texture, Vector2 uv, Vector2 footprint) {
+    // The level where the footprint covers 1 to 2 texels, footprints under a texel keep the full-size level
+    float texels = fmaxf(footprint.x * texture.getWidth(), footprint.y * texture.getHeight());
+    int level = texels > 1.0f ? std::min((int)log2f(fminf(texels, 1e9f)), texture.getLevelCount() - 1) : 0;
+
+    const TextureLevel& info = texture.getLevel(level);
+    int x = (int)floorf(uv.x * info.width) % info.width;
+    int y = (int)floorf(uv.y * info.height) % info.height;
+    if (x < 0) x += info.width;
+    if (y < 0) y += info.height;
+
+    Color color = fetch(texture, level, x / TEXTURE_TILE_SIZE, y / TEXTURE_TILE_SIZE, mortonTexel(x % TEXTURE_TILE_SIZE, y % TEXTURE_TILE_SIZE));
+    // Same 0-1 range the shader sees when sampling an 8-bit texture
+    return { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f };
+}
+
+TextureCacheStats TextureCache::getStats() {
+    TextureCacheStats stats;
+    for (int i = 0; i < TEXTURE_CACHE_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        stats.hits += shards[i].hits;
+        stats.misses += shards[i].misses;
+        stats.residentTiles += shards[i].used;
+    }
+    stats.capacityTiles = (size_t)slotsPerShard * TEXTURE_CACHE_SHARDS;
+    return stats;
+}
+
+std::shared_ptr<TextureCache> createTextureCache() {
+    int megabytes = TEXTURE_CACHE_DEFAULT_MB;
+    const char* configured = getenv("RAYTRACER_TEXTURE_CACHE_MB");
+    if (configured) {
+        int value = atoi(configured);
+        if (value > 0) megabytes = value;
+        else TraceLog(LOG_WARNING, "RAYTRACER_TEXTURE_CACHE_MB must be a positive number of megabytes, got %s", configured);
+    }
+    auto cache = std::make_shared<TextureCache>((size_t)megabytes * 1024 * 1024);
+    TraceLog(LOG_INFO, "Texture cache: %d MB, %d tiles of %dx%d texels", megabytes, (int)cache->getStats().capacityTiles, TEXTURE_TILE_SIZE, TEXTURE_TILE_SIZE);
+    return cache;
+}
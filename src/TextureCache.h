@@ -0,0 +1,129 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "raylib.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Texel edge of a tile, 32x32 RGBA8 texels fill one 4 KB page
+#define TEXTURE_TILE_SIZE 32
+#define TEXTURE_TILE_TEXELS (TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE)
+
+// Tile files are written next to their image, with this appended to the name
+#define TEXTURE_TILE_FILE_EXTENSION ".tiles"
+
+// Bump whenever the tile file layout changes
+#define TEXTURE_TILE_FILE_VERSION 1
+
+// Memory the tile cache may fill, RAYTRACER_TEXTURE_CACHE_MB overrides it
+#define TEXTURE_CACHE_DEFAULT_MB 256
+
+// Independent LRU lists of the cache, threads only wait for each other when they sample the same one
+#define TEXTURE_CACHE_SHARDS 64
+
+// One level of a MIP pyramid
+struct TextureLevel {
+    int width;
+    int height;
+    int tilesX;
+    int tilesY;
+    uint64_t firstTile; // Tiles of the coarser levels come after this one
+    std::vector<uint32_t> tileOrder; // Position of every tile (row-major index) along the Morton curve of the level
+};
+
+// MIP pyramid of an image in tiles of TEXTURE_TILE_SIZE^2 texels, both the tiles of a level and the texels
+// of a tile are stored along a Morton curve, so texels close in the image are close in memory
+// The tiles come from a tile file written next to the image the first time it is used, they are read one at a time
+// When the file cannot be written they are kept in memory instead
+class TiledTexture {
+private:
+    uint32_t id; // Unique among all textures ever opened, part of the cache keys
+    std::vector<TextureLevel> levels;
+    std::string tilePath;
+    mutable FILE* file = nullptr;
+    mutable std::mutex fileMutex;
+    mutable bool readFailed = false; // Logged once
+    std::vector<Color> memoryTiles; // Every tile when there is no tile file
+
+    void setLevels(int width, int height);
+    bool openTileFile(const std::string& imagePath);
+    bool buildTiles(const std::string& imagePath);
+
+public:
+    TiledTexture();
+    ~TiledTexture();
+
+    TiledTexture(const TiledTexture&) = delete;
+    TiledTexture& operator=(const TiledTexture&) = delete;
+
+    // Open the tile file of an image, or build it from the image when it is missing or older than the image
+    // Returns false when the image cannot be loaded
+    bool open(const std::string& imagePath);
+
+    uint32_t getId() const;
+    int getWidth() const;
+    int getHeight() const;
+    int getLevelCount() const;
+    const TextureLevel& getLevel(int level) const;
+
+    // Copy one tile, texels along the Morton curve, thread safe
+    // A tile that cannot be read is black, so the material falls back to its albedo
+    void readTile(int level, int tileX, int tileY, Color* texels) const;
+    // A whole level in row-major order, top row first, for uploading to the GPU
+    std::vector<Color> readLevel(int level) const;
+};
+
+struct TextureCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t residentTiles = 0;
+    size_t capacityTiles = 0;
+};
+
+// Fixed-size LRU cache of texture tiles, shared by all threads of the CPU renderer
+// Memory use stays at the capacity no matter how big the textures are, tiles are only read when a lookup misses
+class TextureCache {
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, int> slots; // Tile key to slot
+        std::vector<std::unique_ptr<Color[]>> tiles; // Allocated when a slot is first used
+        std::vector<uint64_t> keys; // Tile key of every slot
+        std::vector<int> previous, next; // LRU list through the slots, most recently used first
+        int head = -1;
+        int tail = -1;
+        int used = 0; // Slots holding a tile
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        void unlink(int slot);
+        void pushFront(int slot);
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    int slotsPerShard;
+
+    Color fetch(const TiledTexture& texture, int level, int tileX, int tileY, int texel);
+
+public:
+    TextureCache(size_t capacityBytes);
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Nearest texel with repeat wrapping, like the default raylib sampler, from the MIP level that fits the footprint
+    // footprint is the extent in uv of what the ray covers along u and v, 0 samples the full-size level
+    Vector3 sample(const TiledTexture& texture, Vector2 uv, Vector2 footprint);
+
+    TextureCacheStats getStats();
+};
+
+// Cache of TEXTURE_CACHE_DEFAULT_MB, or of RAYTRACER_TEXTURE_CACHE_MB when it is set
+std::shared_ptr<TextureCache> createTextureCache();
+
+#endif // TEXTURE_CACHE_H
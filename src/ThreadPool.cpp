@@ -0,0 +1,72 @@
+#include "ThreadPool.h"
+#include <atomic>
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+    }
+    if (threadCount <= 0) {
+        threadCount = 1;
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return (int)workers.size();
+}
+
+void ThreadPool::workerLoop(int workerIndex) {
+    int seenGeneration = 0;
+
+    while (true) {
+        std::function<void(int)> currentJob;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) return;
+            seenGeneration = generation;
+            currentJob = job;
+        }
+
+        currentJob(workerIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeWorkers--;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+void ThreadPool::run(const std::function<void(int)>& workerJob) {
+    std::unique_lock<std::mutex> lock(mutex);
+    job = workerJob;
+    activeWorkers = (int)workers.size();
+    generation++;
+    wakeCondition.notify_all();
+    doneCondition.wait(lock, [&] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& body) {
+    std::atomic<int> nextIndex(0);
+    run([&](int workerIndex) {
+        for (int index = nextIndex++; index < count; index = nextIndex++) {
+            body(index, workerIndex);
+        }
+    });
+}
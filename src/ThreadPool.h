@@ -0,0 +1,41 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run parallel loops
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    std::function<void(int)> job; // Called once per worker with the worker index
+    int generation = 0; // Bumped for every job so workers can tell jobs apart
+    int activeWorkers = 0;
+    bool stopping = false;
+
+    void workerLoop(int workerIndex);
+
+public:
+    // threadCount <= 0 uses every hardware thread
+    ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const;
+
+    // Run job(workerIndex) once on every worker and wait until all have returned
+    void run(const std::function<void(int)>& workerJob);
+
+    // Run body(index, workerIndex) for every index in [0, count), distributed dynamically
+    void parallelFor(int count, const std::function<void(int, int)>& body);
+};
+
+#endif // THREAD_POOL_H
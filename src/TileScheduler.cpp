@@ -0,0 +1,129 @@
+#include "TileScheduler.h"
+#include <algorithm>
+
+static uint64_t packRange(uint32_t front, uint32_t back) {
+    return ((uint64_t)back << 32) | front;
+}
+
+static uint32_t rangeFront(uint64_t range) {
+    return (uint32_t)range;
+}
+
+static uint32_t rangeBack(uint64_t range) {
+    return (uint32_t)(range >> 32);
+}
+
+// Interleave the bits of x and y
+static uint64_t mortonIndex(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        index |= (uint64_t)((x >> bit) & 1) << (2 * bit);
+        index |= (uint64_t)((y >> bit) & 1) << (2 * bit + 1);
+    }
+    return index;
+}
+
+// Distance along the Hilbert curve that fills a size * size grid, size is a power of two
+static uint64_t hilbertIndex(uint32_t size, uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t s = size / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+std::vector<Tile> makeTiles(int width, int height, int tileSize, TileOrder order) {
+    tileSize = std::max(tileSize, 1);
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+
+    uint32_t curveSize = 1;
+    while (curveSize < (uint32_t)std::max(tilesX, tilesY)) curveSize *= 2;
+
+    std::vector<std::pair<uint64_t, Tile>> keyed;
+    keyed.reserve((size_t)tilesX * tilesY);
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            Tile tile = { tx * tileSize, ty * tileSize, std::min(tileSize, width - tx * tileSize), std::min(tileSize, height - ty * tileSize) };
+            uint64_t key = (uint64_t)ty * tilesX + tx;
+            if (order == TILE_ORDER_MORTON) key = mortonIndex(tx, ty);
+            if (order == TILE_ORDER_HILBERT) key = hilbertIndex(curveSize, tx, ty);
+            keyed.push_back({ key, tile });
+        }
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const std::pair<uint64_t, Tile>& a, const std::pair<uint64_t, Tile>& b) { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    tiles.reserve(keyed.size());
+    for (const std::pair<uint64_t, Tile>& entry : keyed) {
+        tiles.push_back(entry.second);
+    }
+    return tiles;
+}
+
+const char* getTileOrderName(TileOrder order) {
+    switch (order) {
+        case TILE_ORDER_MORTON: return "Morton";
+        case TILE_ORDER_HILBERT: return "Hilbert";
+        default: return "scanline";
+    }
+}
+
+TileScheduler::TileScheduler(int tileCount, int workerCountValue) : workerCount(std::max(workerCountValue, 1)) {
+    ranges.reset(new WorkerRange[workerCount]);
+    for (int i = 0; i < workerCount; i++) {
+        uint32_t front = (uint32_t)((int64_t)tileCount * i / workerCount);
+        uint32_t back = (uint32_t)((int64_t)tileCount * (i + 1) / workerCount);
+        ranges[i].range.store(packRange(front, back), std::memory_order_relaxed);
+    }
+}
+
+int TileScheduler::next(int workerIndex, bool& stolen) {
+    std::atomic<uint64_t>& own = ranges[workerIndex].range;
+
+    while (true) {
+        // Take from the front of the own range, thieves only ever shrink its back
+        uint64_t range = own.load(std::memory_order_acquire);
+        while (rangeFront(range) < rangeBack(range)) {
+            if (own.compare_exchange_weak(range, packRange(rangeFront(range) + 1, rangeBack(range)), std::memory_order_acq_rel)) {
+                stolen = false;
+                return (int)rangeFront(range);
+            }
+        }
+
+        // Find the largest range left, stealing half of it keeps the number of steals logarithmic
+        int victim = -1;
+        uint32_t mostLeft = 0;
+        for (int i = 0; i < workerCount; i++) {
+            uint64_t other = ranges[i].range.load(std::memory_order_relaxed);
+            uint32_t left = rangeBack(other) - rangeFront(other);
+            if (rangeFront(other) < rangeBack(other) && left > mostLeft) {
+                mostLeft = left;
+                victim = i;
+            }
+        }
+        if (victim < 0) return -1;
+
+        uint64_t victimRange = ranges[victim].range.load(std::memory_order_acquire);
+        uint32_t front = rangeFront(victimRange);
+        uint32_t back = rangeBack(victimRange);
+        if (front >= back) continue;
+        uint32_t middle = front + (back - front) / 2;
+        if (!ranges[victim].range.compare_exchange_strong(victimRange, packRange(front, middle), std::memory_order_acq_rel)) continue;
+
+        // [middle, back) is ours now, the own range is empty so nobody else touches it meanwhile
+        own.store(packRange(middle + 1, back), std::memory_order_release);
+        stolen = true;
+        return (int)middle;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Order tiles are handed out in, space filling curves keep neighbouring tiles on the same thread
+enum TileOrder {
+    TILE_ORDER_SCANLINE = 0,
+    TILE_ORDER_MORTON,
+    TILE_ORDER_HILBERT
+};
+
+struct Tile {
+    int x, y; // Top left pixel, rows counted from the top
+    int width, height;
+};
+
+// Cut the image into tiles of at most tileSize pixels squared, sorted along the curve
+std::vector<Tile> makeTiles(int width, int height, int tileSize, TileOrder order);
+
+const char* getTileOrderName(TileOrder order);
+
+// Work-stealing distribution of tile indices [0, tileCount)
+// Every worker owns a contiguous range of the curve and takes tiles from its front
+// A worker whose range is empty steals the back half of the largest remaining range
+class TileScheduler {
+private:
+    // Front in the low 32 bits, back (exclusive) in the high 32 bits, so both change in one compare and swap
+    struct alignas(64) WorkerRange {
+        std::atomic<uint64_t> range;
+    };
+    std::unique_ptr<WorkerRange[]> ranges;
+    int workerCount;
+
+public:
+    TileScheduler(int tileCount, int workerCount);
+
+    // Next tile for the worker, -1 when no tiles are left anywhere
+    // stolen is set when the tile came from the range of another worker
+    int next(int workerIndex, bool& stolen);
+};
+
+#endif // TILE_SCHEDULER_H
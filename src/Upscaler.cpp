@@ -0,0 +1,20 @@
+#include "Upscaler.h"
+
+Upscaler::Upscaler() {
+    upscaleShader = LoadShader(0, "src/upscale.frag");
+    gammaLoc = GetShaderLocation(upscaleShader, "gamma");
+}
+
+Upscaler::~Upscaler() {
+    UnloadShader(upscaleShader);
+}
+
+void Upscaler::draw(const Texture2D& image, float gamma, int width, int height) {
+    SetShaderValue(upscaleShader, gammaLoc, &gamma, SHADER_UNIFORM_FLOAT);
+
+    // Render textures are stored bottom up, flip them with a negative source height
+    BeginShaderMode(upscaleShader);
+        DrawTexturePro(image, Rectangle{ 0, 0, (float)image.width, (float)-image.height },
+            Rectangle{ 0, 0, (float)width, (float)height }, Vector2{ 0, 0 }, 0.0f, WHITE);
+    EndShaderMode();
+}
@@ -0,0 +1,23 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include "raylib.h"
+
+// Draws a linear image rendered below the window resolution over the window, edge-aware (upscale.frag)
+class Upscaler {
+private:
+    Shader upscaleShader;
+    int gammaLoc;
+
+public:
+    Upscaler();
+    ~Upscaler();
+
+    Upscaler(const Upscaler&) = delete;
+    Upscaler& operator=(const Upscaler&) = delete;
+
+    // Draw the image stretched to width x height of the current framebuffer with gamma correction
+    void draw(const Texture2D& image, float gamma, int width, int height);
+};
+
+#endif // UPSCALER_H
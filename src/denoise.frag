@@ -0,0 +1,150 @@
+// Uses OpenGL version 330 core
+#version 330 core
+
+// Edge-aware a-trous denoiser, the twin of CpuDenoiser.cpp
+// Every pass is a rectangle drawn over the whole target, inputs are read with texelFetch
+
+// Fragment shader output color
+out vec4 finalColor;
+
+uniform sampler2D inputImage; // DENOISE_PASS_PREPARE: linear radiance, later: illumination in rgb, its luminance variance in alpha
+uniform sampler2D albedoDepth; // Albedo to divide out in rgb, depth in alpha
+uniform sampler2D normals; // First-hit normals, zero for the sky and lights, which are not filtered
+uniform int denoisePass; // DENOISE_PASS_*
+uniform int stepSize; // Pixels between the taps of an a-trous pass
+
+#define DENOISE_PASS_PREPARE 0 // Divide the albedo out and estimate the variance
+#define DENOISE_PASS_FILTER 1 // One a-trous pass
+#define DENOISE_PASS_FINAL 2 // The last a-trous pass, puts the albedo back
+
+// Same numbers as CpuDenoiser.h
+#define DENOISE_VARIANCE_RADIUS 2 // The first variance estimate is taken over a 5x5 window
+#define DENOISE_SIGMA_LUMINANCE 4.0 // Luminance differences of this many standard deviations weigh 1/e
+#define DENOISE_SIGMA_NORMAL 128.0 // Exponent of the cosine between two normals
+#define DENOISE_SIGMA_DEPTH 1.0 // Depth differences this many times the one expected along the surface weigh 1/e
+#define DENOISE_DEPTH_EPSILON 0.001 // Relative depth difference always allowed, surfaces facing the camera have no gradient
+
+// B3 spline, the a-trous kernel
+const float kernelWeights[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+bool inside(ivec2 pixel) {
+    ivec2 size = textureSize(normals, 0);
+    return pixel.x >= 0 && pixel.y >= 0 && pixel.x < size.x && pixel.y < size.y;
+}
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+float depthAt(ivec2 pixel) {
+    return texelFetch(albedoDepth, pixel, 0).a;
+}
+
+// Depth change to a neighbour along the surface, the smaller side so silhouettes don't count
+float depthGradient(ivec2 pixel) {
+    float center = depthAt(pixel);
+    float gradient = 0.0;
+    for (int axis = 0; axis < 2; axis++) {
+        float smallest = -1.0;
+        for (int side = -1; side <= 1; side += 2) {
+            ivec2 neighbour = pixel;
+            neighbour[axis] += side;
+            if (!inside(neighbour)) continue;
+            float difference = abs(depthAt(neighbour) - center);
+            smallest = smallest < 0.0 ? difference : min(smallest, difference);
+        }
+        gradient = max(gradient, smallest);
+    }
+    return gradient;
+}
+
+// How much pixel q belongs to the surface of pixel p, distance is in pixels
+float edgeWeight(ivec2 p, ivec2 q, float gradient, float distance) {
+    float normalWeight = pow(max(dot(texelFetch(normals, p, 0).xyz, texelFetch(normals, q, 0).xyz), 0.0), DENOISE_SIGMA_NORMAL);
+    float depthP = depthAt(p);
+    float depthWeight = exp(-abs(depthP - depthAt(q)) / (DENOISE_SIGMA_DEPTH * gradient * distance + DENOISE_DEPTH_EPSILON * depthP));
+    return normalWeight * depthWeight;
+}
+
+bool unfiltered(ivec2 pixel) {
+    return texelFetch(normals, pixel, 0).xyz == vec3(0.0);
+}
+
+vec3 illuminationAt(ivec2 pixel) {
+    return texelFetch(inputImage, pixel, 0).rgb / texelFetch(albedoDepth, pixel, 0).rgb;
+}
+
+// Divide the albedo out and estimate the variance from the neighbours on the same surface
+vec4 preparePixel(ivec2 p) {
+    vec3 illumination = illuminationAt(p);
+    if (unfiltered(p)) return vec4(illumination, 0.0);
+
+    float gradient = depthGradient(p);
+    float weightSum = 0.0, mean = 0.0, meanSquared = 0.0;
+    for (int dy = -DENOISE_VARIANCE_RADIUS; dy <= DENOISE_VARIANCE_RADIUS; dy++) {
+        for (int dx = -DENOISE_VARIANCE_RADIUS; dx <= DENOISE_VARIANCE_RADIUS; dx++) {
+            ivec2 q = p + ivec2(dx, dy);
+            if (!inside(q)) continue;
+            float weight = edgeWeight(p, q, gradient, length(vec2(dx, dy)));
+            float l = luminance(illuminationAt(q));
+            weightSum += weight;
+            mean += weight * l;
+            meanSquared += weight * l * l;
+        }
+    }
+    mean /= weightSum;
+    return vec4(illumination, max(meanSquared / weightSum - mean * mean, 0.0));
+}
+
+// One a-trous pass with taps stepSize pixels apart, the variance is filtered with the squared weights
+vec4 filterPixel(ivec2 p) {
+    vec4 center = texelFetch(inputImage, p, 0);
+    if (unfiltered(p)) return center;
+
+    // The luminance stop uses the variance blurred over 3x3, a single pixel's estimate is noisy itself
+    float blurredVariance = 0.0, blurWeightSum = 0.0;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            ivec2 q = p + ivec2(dx, dy);
+            if (!inside(q)) continue;
+            float weight = 0.25 / float((1 << abs(dx)) * (1 << abs(dy)));
+            blurredVariance += weight * texelFetch(inputImage, q, 0).a;
+            blurWeightSum += weight;
+        }
+    }
+    float luminanceScale = DENOISE_SIGMA_LUMINANCE * sqrt(blurredVariance / blurWeightSum) + 1e-10;
+    float centerLuminance = luminance(center.rgb);
+    float gradient = depthGradient(p);
+
+    vec3 sum = vec3(0.0);
+    float variance = 0.0, weightSum = 0.0;
+    for (int j = -2; j <= 2; j++) {
+        for (int i = -2; i <= 2; i++) {
+            ivec2 q = p + ivec2(i, j) * stepSize;
+            if (!inside(q)) continue;
+            vec4 tap = texelFetch(inputImage, q, 0);
+            float weight = kernelWeights[abs(i)] * kernelWeights[abs(j)]
+                * edgeWeight(p, q, gradient, float(stepSize) * length(vec2(i, j)))
+                * exp(-abs(centerLuminance - luminance(tap.rgb)) / luminanceScale);
+            sum += weight * tap.rgb;
+            variance += weight * weight * tap.a;
+            weightSum += weight;
+        }
+    }
+    return vec4(sum / weightSum, variance / (weightSum * weightSum));
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    if (denoisePass == DENOISE_PASS_PREPARE) {
+        finalColor = preparePixel(pixel);
+        return;
+    }
+    vec4 filtered = filterPixel(pixel);
+    if (denoisePass == DENOISE_PASS_FINAL) {
+        // Put the albedo back
+        filtered = vec4(filtered.rgb * texelFetch(albedoDepth, pixel, 0).rgb, 1.0);
+    }
+    finalColor = filtered;
+}
@@ -0,0 +1,19 @@
+// Uses OpenGL version 330 core
+#version 330 core
+
+// Draws the accumulated linear radiance with gamma correction
+
+// Input from the default raylib vertex shader
+in vec2 fragTexCoord;
+
+// Fragment shader output color
+out vec4 finalColor;
+
+// Accumulated mean, drawn with DrawTextureRec
+uniform sampler2D texture0;
+uniform float gamma;
+
+void main() {
+    vec3 color = texture(texture0, fragTexCoord).rgb;
+    finalColor = vec4(pow(max(color, vec3(0.0)), vec3(1.0 / gamma)), 1.0);
+}
@@ -4,13 +4,21 @@
 #include "CustomCamera.h"
 #include "MenuSystem.h"
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include "RenderHighQualityImage.h"
 #include "JsonLoader.h"
-
-// Define maximum number of materials, spheres, and quads
-#define MAX_MATERIALS 32
-#define MAX_SPHERES 32
-#define MAX_QUADS 32
+#include "CpuRenderer.h"
+#include "Accumulator.h"
+#include "Denoiser.h"
+#include "FeatureTargets.h"
+#include "TemporalFilter.h"
+#include "DynamicResolution.h"
+#include "Upscaler.h"
+#include "SceneUploader.h"
+#include "SceneReload.h"
+#include "SceneWatcher.h"
+#include "Profiler.h"
 
 // Entry point
 int main(void) {
@@ -38,176 +46,267 @@ int main(void) {
     
     // Menu System Initialization
     MenuSystem menuSystem(customCamera);
+
+    // Frame stage timings, F3 shows them next to the menu and F4 records a trace
+    Profiler& profiler = getProfiler();
     
     // Shader Initialization
     Shader shader = LoadShader(0, TextFormat("src/raytracing.frag", 330));
 
 
 
-    // ----------------------------
-    // --- Set shader locations ---
-    // ----------------------------
-    
-    // Camera
-    int pixel00Loc = GetShaderLocation(shader, "pixel00");
-    int pixelULoc = GetShaderLocation(shader, "pixelU");
-    int pixelVLoc = GetShaderLocation(shader, "pixelV");
-    int cameraCenterLoc = GetShaderLocation(shader, "cameraCenter");
-    int defocusAngleLoc = GetShaderLocation(shader, "defocusAngle");
-    
-    //Settings
-    int samplesLoc = GetShaderLocation(shader, "samples");
-    int maxBouncesLoc = GetShaderLocation(shader, "maxBounces");
-    int gammaLoc = GetShaderLocation(shader, "gamma");
-    int backgroundOpacityLoc = GetShaderLocation(shader, "backgroundOpacity");
-    int seedOffsetLoc = GetShaderLocation(shader, "seedOffset");
-    
-    // Materials
-    int materialTypeLoc = GetShaderLocation(shader, "materialType");
-    int materialAlbedoLoc = GetShaderLocation(shader, "materialAlbedo");
-    int materialEmmisiveColorLoc = GetShaderLocation(shader, "materialEmmisiveColor");
-    int materialFuzzLoc = GetShaderLocation(shader, "materialFuzz");
-    int materialRefractionIndexLoc = GetShaderLocation(shader, "materialRefractionIndex");
-    
-    // Spheres
-	int spheresAmountLoc = GetShaderLocation(shader, "spheresAmount");
-	int spheresLoc = GetShaderLocation(shader, "spheres");
-    int spheresMaterialIndiciesLoc = GetShaderLocation(shader, "sphereMaterialIndicies");
-    
-    // Quad
-    int quadsAmountLoc = GetShaderLocation(shader, "quadsAmount");
-    int quadOriginsLoc = GetShaderLocation(shader, "quadOrigins");
-    int quadEdgesULoc = GetShaderLocation(shader, "quadEdgesU");
-    int quadEdgesVLoc = GetShaderLocation(shader, "quadEdgesV");
-    int quadMaterialIndiciesLoc = GetShaderLocation(shader, "quadMaterialIndicies");
+    // Everything that holds GPU resources lives in this block, so it is released before CloseWindow() destroys the context
+    {
+        // ----------------------------
+        // --- World Initialization ---
+        // ----------------------------
     
+        // Load world data from JSON files
+        Scene scene;
+        loadScene("world", scene);
 
+        // Tile the material textures, the shader samples their full size and the CPU renderer the MIP level of each ray's footprint
+        loadSceneTextures(scene);
 
-    // ----------------------------
-    // --- World Initialization ---
-    // ----------------------------
-    
-    // Setup materials variables
-    int materialType[MAX_MATERIALS] = { 0 };
-    Vector3 materialAlbedo[MAX_MATERIALS] = { { 0.0f, 0.0f, 0.0f } };
-    Vector3 materialEmmisiveColor[MAX_MATERIALS] = { { 0.0f, 0.0f, 0.0f } };
-    float materialFuzz[MAX_MATERIALS] = { 0.0f };
-    float materialRefractionIndex[MAX_MATERIALS] = { 0.0f };
-    std::string materialTexturePaths[MAX_MATERIALS];
-
-    // Setup spheres variables
-    int spheresAmount = 0;
-    Vector4 spheres[MAX_SPHERES] = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-    int sphereMaterialIndicies[MAX_SPHERES] = { 0 };
-    
-    // Setup quads variables
-    int quadsAmount = 0;
-    Vector3 quadOrigins[MAX_QUADS] = { { 0.0f, 0.0f, 0.0f } };
-    Vector3 quadEdgesU[MAX_QUADS] = { { 0.0f, 0.0f, 0.0f } };
-    Vector3 quadEdgesV[MAX_QUADS] = { { 0.0f, 0.0f, 0.0f } };
-    int quadMaterialIndicies[MAX_QUADS] = { 0 };
-    
-    // Load world data from JSON files
-    loadMaterials("world/materials.json", materialType, materialAlbedo, materialEmmisiveColor, materialFuzz, materialRefractionIndex, materialTexturePaths);
-    loadSpheres("world/spheres.json", spheres, sphereMaterialIndicies, spheresAmount);
-    loadQuads("world/quads.json", quadOrigins, quadEdgesU, quadEdgesV, quadMaterialIndicies, quadsAmount);
-
-    // Load textures
-    Texture materialTextures[MAX_MATERIALS];
-    int materialTexturesLoc = GetShaderLocation(shader, "materialTextures");
-    for (int i = 0; i < MAX_MATERIALS; i++) {
-        if (!materialTexturePaths[i].empty()) {
-            materialTextures[i] = LoadTexture(materialTexturePaths[i].c_str());
-        }  
-    }
+        // CPU renderer over the same scene
+        CpuRenderer cpuRenderer(scene);
 
-    // Send world data to the shader
-    // Materials
-    SetShaderValueV(shader, materialTypeLoc, materialType, SHADER_UNIFORM_INT, MAX_MATERIALS);
-    SetShaderValueV(shader, materialAlbedoLoc, materialAlbedo, SHADER_UNIFORM_VEC3, MAX_MATERIALS);
-    SetShaderValueV(shader, materialEmmisiveColorLoc, materialEmmisiveColor, SHADER_UNIFORM_VEC3, MAX_MATERIALS);
-    SetShaderValueV(shader, materialFuzzLoc, materialFuzz, SHADER_UNIFORM_FLOAT, MAX_MATERIALS);
-    SetShaderValueV(shader, materialRefractionIndexLoc, materialRefractionIndex, SHADER_UNIFORM_FLOAT, MAX_MATERIALS);
-    
-    // Spheres
-	SetShaderValue(shader, spheresAmountLoc, &spheresAmount, SHADER_UNIFORM_INT);
-	SetShaderValueV(shader, spheresLoc, spheres, SHADER_UNIFORM_VEC4, spheresAmount);
-    SetShaderValueV(shader, spheresMaterialIndiciesLoc, sphereMaterialIndicies, SHADER_UNIFORM_INT, spheresAmount);
-    
-    // Quads
-    SetShaderValue(shader, quadsAmountLoc, &quadsAmount, SHADER_UNIFORM_INT);
-    SetShaderValueV(shader, quadOriginsLoc, quadOrigins, SHADER_UNIFORM_VEC3, quadsAmount);
-    SetShaderValueV(shader, quadEdgesULoc, quadEdgesU, SHADER_UNIFORM_VEC3, quadsAmount);
-    SetShaderValueV(shader, quadEdgesVLoc, quadEdgesV, SHADER_UNIFORM_VEC3, quadsAmount);
-    SetShaderValueV(shader, quadMaterialIndiciesLoc, quadMaterialIndicies, SHADER_UNIFORM_INT, quadsAmount);
+        // Scene data textures for the shader, after this only changes are uploaded
+        SceneUploader sceneUploader(shader, scene);
+
+        // Progressive rendering and high-quality renders, the accumulator sets the frame uniforms itself
+        Accumulator accumulator(screenWidth, screenHeight, shader);
+
+        // First-hit albedo, normal and depth, rendered by the raytracing shader for the denoiser and the temporal filter
+        FeatureTargets features(screenWidth, screenHeight, shader);
+
+        // Edge-aware denoiser and the temporal filter that keeps the image while the camera moves
+        Denoiser denoiser(screenWidth, screenHeight, features);
+        TemporalFilter temporalFilter(screenWidth, screenHeight, features);
+
+        // Render resolution, scaled down when the frames take longer than SetTargetFPS allows and upscaled to the window
+        DynamicResolution dynamicResolution(1000.0f / 60.0f);
+        Upscaler upscaler;
+        int renderWidth = screenWidth;
+        int renderHeight = screenHeight;
+        auto setRenderSize = [&](int width, int height) {
+            renderWidth = width;
+            renderHeight = height;
+            accumulator.resize(width, height);
+            features.resize(width, height);
+            denoiser.resize(width, height);
+            temporalFilter.resize(width, height);
+        };
+
+        // World files are reloaded as they are saved, only the parts that changed are uploaded and rebuilt
+        SceneWatcher sceneWatcher("world");
+        auto applySceneUpdate = [&](const SceneUpdate& update) {
+            if (update.textures) sceneUploader.markTexturesDirty();
+            sceneUploader.markMaterialsDirty(update.materials.first, update.materials.count);
+            sceneUploader.markSpheresDirty(update.spheres.first, update.spheres.count);
+            sceneUploader.markQuadsDirty(update.quads.first, update.quads.count);
+            sceneUploader.markInstancesDirty(update.instances.first, update.instances.count);
+            if (update.geometry) {
+                sceneUploader.markVerticesDirty(0, (int)scene.vertices.size());
+                sceneUploader.markTrianglesDirty(0, (int)scene.triangles.size());
+                sceneUploader.markMeshBvhDirty();
+            }
+            if (update.bvh) sceneUploader.markBvhDirty();
+            if (update.lights) sceneUploader.markLightsDirty();
+            if (update.quads.changed()) cpuRenderer.updateQuads();
+            // The running mean, the history and the features all show the old scene
+            accumulator.reset();
+            temporalFilter.reset();
+            features.invalidate();
+        };
 
+        // Draw the raytracing shader over the whole target
+        auto drawRaytracing = [&]() {
+            DrawRectangle(0, 0, renderWidth, renderHeight, PINK); // Fallback color
+        };
     
 
-    // -----------------
-    // --- Main Loop ---
-    // -----------------
+        // -----------------
+        // --- Main Loop ---
+        // -----------------
     
-    // Stop when the window is closed
-    while (!WindowShouldClose()) {
-        // Update menu system
-        menuSystem.update();
-        if (IsKeyPressed(KEY_P)) {
-            menuSystem.toggleVisibility();
-        }
+        // Stop when the window is closed
+        while (!WindowShouldClose()) {
+            profiler.beginFrame();
+
+            {
+                PROFILE_SCOPE("Input");
+                // Update menu system
+                menuSystem.update();
+                if (IsKeyPressed(KEY_P)) {
+                    menuSystem.toggleVisibility();
+                }
+                // Profiler overlay and trace recording, the trace is written when recording stops
+                if (IsKeyPressed(KEY_F3)) {
+                    profiler.toggleOverlay();
+                }
+                if (IsKeyPressed(KEY_F4)) {
+                    if (profiler.isRecording()) profiler.stopRecording("profile_trace.json", "profile_trace.csv");
+                    else profiler.startRecording();
+                }
+                // Update camera movement, only when the menu is not visible
+                if (!menuSystem.isMenuVisible()) {
+                    customCamera.handleInput(GetFrameTime());
+                }
+            }
+
+            {
+                PROFILE_SCOPE("Hot Reload");
+                std::vector<std::string> changedFiles = sceneWatcher.poll();
+                if (!changedFiles.empty()) {
+                    SceneUpdate update = reloadSceneFiles("world", changedFiles, scene);
+                    if (update.changed()) applySceneUpdate(update);
+                }
+            }
 
-        // Only when the menu is not visible
-        if (!menuSystem.isMenuVisible()) {
-            // Update camera movement
-            customCamera.handleInput(GetFrameTime());
-            // Render a high-quality render
-            if (IsKeyPressed(KEY_H)) {
-                renderHighQualityImage(shader, seedOffsetLoc, screenWidth, screenHeight, "render.png", menuSystem);
+            // Only when the menu is not visible
+            if (!menuSystem.isMenuVisible()) {
+                // Render a high-quality render, always at the window resolution
+                if (IsKeyPressed(KEY_H)) {
+                    setRenderSize(screenWidth, screenHeight);
+                    customCamera.update(screenWidth, screenHeight);
+                    sceneUploader.upload(customCamera.getView(), menuSystem.getRenderSettings());
+                    renderHighQualityImage(shader, accumulator, features, denoiser, customCamera.getView(), drawRaytracing, screenWidth, screenHeight, "render.png", menuSystem);
+                    accumulator.reset();
+                    sceneUploader.invalidateUniforms();
+                }
+                // Render a large image in tiles, RAYTRACER_TILED_SIZE=WIDTHxHEIGHT overrides the menu's window multiple
+                if (IsKeyPressed(KEY_Y)) {
+                    int imageWidth = screenWidth * menuSystem.getTiledScale();
+                    int imageHeight = screenHeight * menuSystem.getTiledScale();
+                    const char* tiledSize = getenv("RAYTRACER_TILED_SIZE");
+                    if (tiledSize && (sscanf(tiledSize, "%dx%d", &imageWidth, &imageHeight) != 2 || imageWidth <= 0 || imageHeight <= 0)) {
+                        TraceLog(LOG_WARNING, "RAYTRACER_TILED_SIZE must look like 32768x32768, got %s", tiledSize);
+                        imageWidth = screenWidth * menuSystem.getTiledScale();
+                        imageHeight = screenHeight * menuSystem.getTiledScale();
+                    }
+                    renderTiledImage(shader, customCamera, imageWidth, imageHeight, screenWidth, screenHeight, "render_tiled.png", menuSystem);
+                    accumulator.reset();
+                    sceneUploader.invalidateUniforms();
+                }
+                // Render the same view with the CPU renderer
+                if (IsKeyPressed(KEY_C)) {
+                    customCamera.update(screenWidth, screenHeight);
+                    renderCpuImage(cpuRenderer, customCamera, screenWidth, screenHeight, "render_cpu.png", menuSystem);
+                }
+                // Toggle fullscreen
+                if (IsKeyPressed(KEY_T)) {
+                    ToggleBorderlessWindowed();
+                    SetWindowPosition(0, 0);
+                }
             }
-            // Toggle fullscreen
-            if (IsKeyPressed(KEY_T)) {
-                ToggleBorderlessWindowed();
-                SetWindowPosition(0, 0);
+
+            // Render size and samples of this frame, picked by the dynamic resolution controller at the end of the last one
+            setRenderSize(dynamicResolution.getRenderSize(screenWidth), dynamicResolution.getRenderSize(screenHeight));
+            bool scaled = renderWidth != screenWidth || renderHeight != screenHeight;
+            RenderSettings settings = menuSystem.getRenderSettings();
+            settings.samples = dynamicResolution.getFrameSamples(settings.samples);
+
+            //Update camera and send the shader values that changed
+            {
+                PROFILE_SCOPE("Camera Update");
+                customCamera.update(renderWidth, renderHeight);
             }
-        }
+            {
+                PROFILE_SCOPE("Scene Upload");
+                sceneUploader.upload(customCamera.getView(), settings);
+                menuSystem.setSceneUploadBytes(sceneUploader.getStats().frameBytes);
+            }
+            float gamma = menuSystem.getGamma();
+
+            // Add this frame to the running mean, any camera or setting change starts a new one
+            // The temporal filter, the denoiser and the upscaler work on the float mean, without progressive rendering it holds only this frame
+            bool progressive = menuSystem.isProgressive();
+            bool denoise = menuSystem.isDenoising();
+            bool temporal = menuSystem.isTemporal();
+            bool offscreen = progressive || denoise || temporal || scaled;
+            if (offscreen) {
+                dynamicResolution.beginWork();
+                PROFILE_GPU_SCOPE("Accumulate");
+                accumulator.resetIfChanged(customCamera.getView(), settings);
+                if (!progressive) accumulator.reset();
+                accumulator.beginFrame(settings.samples);
+                    BeginShaderMode(shader);
+                        // Bound first so it always gets a texture unit
+                        accumulator.bindPreviousFrame();
+                        drawRaytracing();
+                    EndShaderMode();
+                accumulator.endFrame();
+            } else {
+                accumulator.reset();
+            }
+            menuSystem.setAccumulatedFrames(accumulator.getFrameCount());
+            if (denoise || temporal) {
+                PROFILE_GPU_SCOPE("Features");
+                features.update(customCamera.getView(), drawRaytracing);
+            }
+            // Blend the mean into the history reprojected from the last frame
+            const Texture2D* image = &accumulator.getTarget().texture;
+            if (temporal) {
+                PROFILE_GPU_SCOPE("Temporal");
+                temporalFilter.apply(*image, accumulator.getSampleCount(), customCamera.getView(), settings, progressive);
+                image = &temporalFilter.getResult();
+            } else {
+                temporalFilter.reset();
+            }
+            if (denoise) {
+                PROFILE_GPU_SCOPE("Denoise");
+                denoiser.denoise(*image);
+                image = &denoiser.getResult();
+            }
+            if (offscreen) dynamicResolution.endWork();
 
-        //Update camera and set according shader values
-        customCamera.update(screenWidth, screenHeight);
-        customCamera.setShaderValues(shader, pixel00Loc, pixelULoc, pixelVLoc, cameraCenterLoc);
-
-        // Update shader values from menuSystem
-        int samples = menuSystem.getSamples();
-        int maxBounces = menuSystem.getMaxBounces();
-        float gamma = menuSystem.getGamma();
-        float backgroundOpacity = menuSystem.getBackgroundOpacity();
-        float defocusAngle = menuSystem.getDefocusAngle();
-        SetShaderValue(shader, samplesLoc, &samples, SHADER_UNIFORM_INT);
-        SetShaderValue(shader, maxBouncesLoc, &maxBounces, SHADER_UNIFORM_INT);
-        SetShaderValue(shader, gammaLoc, &gamma, SHADER_UNIFORM_FLOAT);
-        SetShaderValue(shader, backgroundOpacityLoc, &backgroundOpacity, SHADER_UNIFORM_FLOAT);
-        SetShaderValue(shader, defocusAngleLoc, &defocusAngle, SHADER_UNIFORM_FLOAT);
-
-        // Drawing
-        BeginDrawing();
-            // Begin the shader mode
-        	BeginShaderMode(shader);
-                // Set the texture uniform
-                for (int i = 0; i < MAX_MATERIALS; i++) {
-                    SetShaderValueTexture(shader, materialTexturesLoc + i, materialTextures[i]);
+            // Drawing
+            BeginDrawing();
+                {
+                    PROFILE_GPU_SCOPE("Draw");
+                    if (scaled) {
+                        upscaler.draw(*image, gamma, screenWidth, screenHeight);
+                    } else if (denoise) {
+                        denoiser.draw(gamma);
+                    } else if (temporal) {
+                        temporalFilter.draw(gamma);
+                    } else if (progressive) {
+                        accumulator.draw(gamma);
+                    } else {
+                        dynamicResolution.beginWork();
+                        // Begin the shader mode
+                        BeginShaderMode(shader);
+                            // Draw to the screen
+                            drawRaytracing();
+                        EndShaderMode();
+                        dynamicResolution.endWork();
+                    }
                 }
-                // Draw to the screen
-        		DrawRectangle(0, 0, screenWidth, screenHeight, PINK); // Fallback color
-        	EndShaderMode();
-            // Draw the menu
-        	menuSystem.draw();
-        EndDrawing();
+                {
+                    PROFILE_GPU_SCOPE("Menu");
+                    // Draw the menu
+                    menuSystem.draw();
+                }
+                // Profiler overlay next to the menu
+                profiler.drawOverlay(520, 50);
+            {
+                // Swaps buffers and waits for the target FPS
+                PROFILE_SCOPE("Present");
+                EndDrawing();
+            }
+
+            // Pick the render size of the next frame, a larger one waits until the running mean starts over anyway
+            dynamicResolution.update(menuSystem.getRenderScale(), menuSystem.getSamples(), accumulator.getFrameCount() <= 1);
+            menuSystem.setRenderScale(dynamicResolution.getScale(), dynamicResolution.getFrameSamples(menuSystem.getSamples()), dynamicResolution.getRenderMs());
+
+            profiler.endFrame();
+        }
     }
 
     // De-Initialization
     EnableCursor(); // Reenable the cursor
     UnloadShader(shader); // Unload the shader
-    for (int i = 0; i < MAX_MATERIALS; i++) {
-        UnloadTexture(materialTextures[i]); // Unload the textures
-    }
     CloseWindow(); // Close the window and OpenGL context
 
     return 0; // Exit the program
@@ -13,33 +13,50 @@ uniform vec3 cameraCenter;
 // Settings uniforms
 uniform int samples;
 uniform int maxBounces;
-uniform int seedOffset;
+uniform int sampleOffset; // Index of the first sample, frames of a running mean continue the sequence
+uniform int samplerType; // SAMPLER_SOBOL or SAMPLER_PCG
 uniform float backgroundOpacity;
 uniform float gamma;
 uniform float defocusAngle;
-
-// Material uniforms
-#define MAX_MATERIALS 32
-uniform int materialType[MAX_MATERIALS];
-uniform vec3 materialAlbedo[MAX_MATERIALS];
-uniform vec3 materialEmmisiveColor[MAX_MATERIALS];
-uniform float materialFuzz[MAX_MATERIALS];
-uniform float materialRefractionIndex[MAX_MATERIALS];
-uniform sampler2D materialTextures[MAX_MATERIALS];
-
-// Sphere uniforms
-#define MAX_SPHERES 32
+uniform vec2 tileOffset; // Image position of the tile being rendered, keeps the samples of tiles apart
+uniform float noiseTarget; // Relative standard error at which a pixel stops sampling, 0 disables adaptive sampling
+
+// Progressive accumulation uniforms
+uniform sampler2D previousFrame; // Linear running mean of the previous frames, alpha is the mean of their squared luminance
+uniform int frameIndex; // Frames already in previousFrame, -1 when not accumulating
+uniform float frameWeight; // Share of this frame in the new mean
+
+// Denoiser uniforms
+uniform int featureOutput; // FEATURE_*, the denoiser's guides instead of radiance
+
+// Scene data, packed by SceneUploader (see SceneUploader.h for the texels of each item)
+#define SCENE_DATA_WIDTH 4096
+uniform sampler2D sceneData; // RGBA32F, ints are stored bitwise
+uniform sampler2D textureAtlas; // Every material texture, placed by the rectangles in the textures section
+
+// First texel of each section of sceneData
+uniform int materialsOffset;
+uniform int texturesOffset;
+uniform int spheresOffset;
+uniform int quadsOffset;
+uniform int verticesOffset;
+uniform int trianglesOffset;
+uniform int instancesOffset;
+uniform int bvhNodesOffset;
+uniform int bvhItemsOffset;
+uniform int meshBvhNodesOffset;
+uniform int meshBvhItemsOffset;
+uniform int lightsOffset;
+
+// Items of the top-level BVH are the spheres, then the quads, then the instances
+// An instance continues in the BVH of its mesh, whose items are triangles
 uniform int spheresAmount;
-uniform vec4 spheres[MAX_SPHERES];
-uniform int sphereMaterialIndicies[MAX_SPHERES];
-
-// Quad uniforms
-#define MAX_QUADS 32
 uniform int quadsAmount;
-uniform vec3 quadOrigins[MAX_QUADS];
-uniform vec3 quadEdgesU[MAX_QUADS];
-uniform vec3 quadEdgesV[MAX_QUADS];
-uniform int quadMaterialIndicies[MAX_QUADS];
+uniform int bvhNodesAmount;
+
+// Emissive spheres and quads next-event estimation picks from, in proportion to their power
+uniform int lightsAmount;
+uniform float lightPower; // Summed power of the lights
 
 // Constants
 const float infinity = pow(2.0, 31.0);
@@ -50,6 +67,14 @@ const float smallValue = pow(2.0, -12.0);
 const vec3 sunDirection = vec3(1.0, 0.6, 0.5);
 const vec3 sunColor = vec3(10.0, 10.0, 8.0);
 const float sunSize = 0.02;
+// Next-event estimation samples the sun glow inside this cone, further out it is only found by scattered rays
+const float sunSampleAngle = 0.25;
+// Falloff of the exponential distribution of the sampled angle, fitted to the glow
+const float sunSampleFalloff = 0.3 / sunSize;
+
+// Russian roulette
+#define ROULETTE_MAX_SURVIVAL 0.95 // Even bright paths end some time, glass does not absorb anything
+#define ROULETTE_MAX_BOUNCES 64 // Safety net, paths that survive this many bounces past maxBounces are cut
 
 
 // Ray structure
@@ -65,9 +90,9 @@ struct HitRecord {
     vec3 normal; // normal at the hit point
     bool frontFace; // true if the ray hit the front face of the object
     bool hit; // true if the ray hit something
-    vec3 color; // current color of the ray
-    vec3 emmisiveColor; // emmisive color of the hit object
+    vec3 color; // current color of the ray, the product of the surface colors so far
     int materialIndex; // index of the material of the hit object
+    int item; // BVH item of the hit object
     vec2 uv; // texture coordinates of the hit point
 };
 
@@ -76,58 +101,192 @@ struct HitRecord {
 
 
 
-// ------------------------
-// --- Random Functions ---
-// ------------------------
+// ----------------
+// --- Sampling ---
+// ----------------
+
+// Same sequences as Sampler.cpp, both renderers draw the same values
+#define SAMPLER_SOBOL 0 // Owen-scrambled Sobol points, shuffled per pixel and dimension
+#define SAMPLER_PCG 1 // Independent PCG stream per pixel and sample
+
+// 2D dimensions a path draws from
+#define DIMENSION_PIXEL 0 // Position inside the pixel
+#define DIMENSION_LENS 1 // Point on the lens for defocus blur
+#define DIMENSION_BOUNCE 2 // First dimension of bounce 0
+#define DIMENSIONS_PER_BOUNCE 5
+#define BOUNCE_BSDF 0 // Scattered direction
+#define BOUNCE_CHOICE 1 // x picks reflection or refraction
+#define BOUNCE_LIGHT 2 // Direction or point on the light of next-event estimation
+#define BOUNCE_LIGHT_CHOICE 3 // x picks the sun or a light of the list
+#define BOUNCE_ROULETTE 4 // x decides whether the path survives Russian roulette
+
+// PCG hash (https://www.pcg-random.org)
+uint pcgHash(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// bitfieldReverse() needs GLSL 4.00
+uint reverseBits(uint x) {
+    x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+    x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+    x = ((x >> 4u) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4u);
+    x = ((x >> 8u) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8u);
+    return (x >> 16u) | (x << 16u);
+}
+
+// Laine-Karras style hash, every bit only depends on itself and the bits below it
+uint laineKarrasPermutation(uint x, uint seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16u) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+// Owen scrambling of a 0.32 fixed point number
+uint nestedUniformScramble(uint x, uint seed) {
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// Second Sobol dimension, the first is reverseBits(index)
+uint sobol1(uint index) {
+    uint direction = 0x80000000u;
+    uint result = 0u;
+    for (; index != 0u; index >>= 1u) {
+        if ((index & 1u) != 0u) result ^= direction;
+        direction ^= direction >> 1u;
+    }
+    return result;
+}
+
+// 24 bits so the float stays below 1
+float toUnitFloat(uint x) {
+    return float(x >> 8u) * (1.0 / 16777216.0);
+}
+
+// Sample values of one pixel, indexed by sample and dimension
+struct Sampler {
+    uint seed;
+    uint sampleIndex;
+    uint pcgState;
+    uint pcgIncrement;
+};
+
+Sampler makeSampler(ivec2 pixel) {
+    Sampler sampler;
+    sampler.seed = pcgHash(pcgHash(uint(pixel.x)) ^ uint(pixel.y));
+    sampler.sampleIndex = 0u;
+    sampler.pcgState = 0u;
+    sampler.pcgIncrement = (sampler.seed << 1u) | 1u; // Odd increments select independent streams
+    return sampler;
+}
+
+void startSample(inout Sampler sampler, int index) {
+    sampler.sampleIndex = uint(index);
+    sampler.pcgState = pcgHash(sampler.seed + pcgHash(uint(index)));
+}
+
+float nextPcg(inout Sampler sampler) {
+    sampler.pcgState = sampler.pcgState * 747796405u + sampler.pcgIncrement;
+    uint word = ((sampler.pcgState >> ((sampler.pcgState >> 28u) + 4u)) ^ sampler.pcgState) * 277803737u;
+    return toUnitFloat((word >> 22u) ^ word);
+}
 
+// Point in [0, 1)^2 (Burley, "Practical Hash-based Owen Scrambling"), SAMPLER_PCG takes the next two stream values
+vec2 sample2D(inout Sampler sampler, int dimension) {
+    if (samplerType == SAMPLER_PCG) {
+        float x = nextPcg(sampler);
+        return vec2(x, nextPcg(sampler));
+    }
+    uint dimensionSeed = pcgHash(sampler.seed ^ pcgHash(uint(dimension)));
+    uint index = nestedUniformScramble(sampler.sampleIndex, dimensionSeed);
+    uint x = nestedUniformScramble(reverseBits(index), pcgHash(dimensionSeed));
+    uint y = nestedUniformScramble(sobol1(index), pcgHash(dimensionSeed + 1u));
+    return vec2(toUnitFloat(x), toUnitFloat(y));
+}
 
-// Hash functtions from https://www.shadertoy.com/view/4djSRW
-float hash11(float p) {
-    p = fract(p * .1031);
-    p *= p + 33.33;
-    p *= p + p;
-    return fract(p);
+float sample1D(inout Sampler sampler, int dimension) {
+    return sample2D(sampler, dimension).x;
 }
 
-float hash13(vec3 p3) {
-	p3  = fract(p3 * .1031);
-    p3 += dot(p3, p3.zyx + 31.32);
-    return fract((p3.x + p3.y) * p3.z);
+int bounceDimension(int bounce, int which) {
+    return DIMENSION_BOUNCE + bounce * DIMENSIONS_PER_BOUNCE + which;
 }
 
-// Generate a random vector in 3D space
-vec3 randomVector(float seed) {
-    float z = hash11(seed) * 2.0 - 1.0;
-    float t = hash11(seed + 1.0) * 2.0 * pi;
+// Map a 2D sample to the unit sphere
+vec3 sphereSample(vec2 u) {
+    float z = u.x * 2.0 - 1.0;
+    float t = u.y * 2.0 * pi;
     float r = sqrt(1.0 - z * z);
     return vec3(r * cos(t), r * sin(t), z);
 }
 
-// Generate a random point in the circle perpendicular to the viewing direction of the camera
-vec3 randomInCircle(float seed) {
-    float r = sqrt(hash11(seed));
-    float t = 2.0 * pi * hash11(seed + 1.61803398875);
-    vec3 disk = pixelU * r * cos(t) + pixelV * r * sin(t);
-    return (length(disk) > smallValue && length(disk) < infinity) ? normalize(disk) : vec3(0.0);
+// Map a 2D sample to the unit disk perpendicular to the viewing direction of the camera
+vec3 diskSample(vec2 u) {
+    float r = sqrt(u.x);
+    float t = 2.0 * pi * u.y;
+    vec3 disk = pixelU * cos(t) + pixelV * sin(t);
+    return (length(disk) > smallValue && length(disk) < infinity) ? r * normalize(disk) : vec3(0.0);
+}
+
+// Map a 2D sample to the pixel square [-0.5, 0.5]
+vec3 pixelSample(vec2 u) {
+    return pixelU * (u.x - 0.5) + pixelV * (u.y - 0.5);
+}
+
+
+
+
+
+
+// ------------------
+// --- Scene Data ---
+// ------------------
+
+vec4 sceneTexel(int index) {
+    return texelFetch(sceneData, ivec2(index % SCENE_DATA_WIDTH, index / SCENE_DATA_WIDTH), 0);
+}
+
+int materialType(int materialIndex) {
+    return floatBitsToInt(sceneTexel(materialsOffset + materialIndex * 3).w);
 }
 
-// Generate a random point in a circle with a given radius
-vec3 defocusDiskSample(vec3 center, float defocusAngle, float seed) {
-    return center + randomInCircle(seed) * defocusAngle;
+vec3 materialAlbedo(int materialIndex) {
+    return sceneTexel(materialsOffset + materialIndex * 3).xyz;
 }
 
-// Generate a random point in a square from [-0.5, 0.5]
-vec3 randomInSquare(float seed) {
-    vec3 pU = pixelU * (hash11(seed) - 0.5);
-    vec3 pV = pixelV * (hash11(seed + 1.61803398875) - 0.5);
-    return pU + pV;
+vec3 materialEmmisiveColor(int materialIndex) {
+    return sceneTexel(materialsOffset + materialIndex * 3 + 1).xyz;
 }
 
-// Generate a random point in a square from [-0.5, 0.5] with stratified sampling
-vec3 randomInSquareStratified(float seed, int si, int sj, float recipSqrtSamples) {
-    vec3 pU = pixelU * (recipSqrtSamples * si * hash11(seed) - 0.5);
-    vec3 pV = pixelV * (recipSqrtSamples * sj * hash11(seed + 1.61803398875) - 0.5);
-    return pU + pV;
+float materialFuzz(int materialIndex) {
+    return sceneTexel(materialsOffset + materialIndex * 3 + 1).w;
+}
+
+float materialRefractionIndex(int materialIndex) {
+    return sceneTexel(materialsOffset + materialIndex * 3 + 2).x;
+}
+
+// Index into the textures section, -1 when the material has none
+int materialTexture(int materialIndex) {
+    return floatBitsToInt(sceneTexel(materialsOffset + materialIndex * 3 + 2).y);
+}
+
+// Nearest texel of the full-size level with wrapping
+// The CPU renderer picks a MIP level from the ray footprint, so the two only match where a footprint is under one texel
+vec3 sampleTexture(int textureIndex, vec2 uv) {
+    ivec4 rect = floatBitsToInt(sceneTexel(texturesOffset + textureIndex));
+    ivec2 texel = ivec2(mod(floor(uv * vec2(rect.zw)), vec2(rect.zw)));
+    return texelFetch(textureAtlas, rect.xy + texel, 0).rgb;
+}
+
+// Four item indices per texel, of the BVH whose items start at texel itemsOffset
+int bvhItem(int itemsOffset, int index) {
+    vec4 items = sceneTexel(itemsOffset + index / 4);
+    return floatBitsToInt(items[index % 4]);
 }
 
 
@@ -153,10 +312,14 @@ bool hitDisk(float alpha, float beta) {
 
 // Ray Quadrilateral intersection algorithm
 void hit2DPrimitive(Ray ray, inout HitRecord record, float tmin, float tmax, int quadIndex) {
+    vec4 quadOrigin = sceneTexel(quadsOffset + quadIndex * 3); // Material index in w
+    vec3 quadEdgeU = sceneTexel(quadsOffset + quadIndex * 3 + 1).xyz;
+    vec3 quadEdgeV = sceneTexel(quadsOffset + quadIndex * 3 + 2).xyz;
+
     // Initial calculations
-    vec3 n = cross(quadEdgesU[quadIndex], quadEdgesV[quadIndex]);
+    vec3 n = cross(quadEdgeU, quadEdgeV);
     vec3 normal = normalize(n);
-    float D = dot(normal, quadOrigins[quadIndex]);
+    float D = dot(normal, quadOrigin.xyz);
     vec3 w = n / dot(n, n);
 
     // Determine if the ray is parallel to the plane of the quad
@@ -174,10 +337,10 @@ void hit2DPrimitive(Ray ray, inout HitRecord record, float tmin, float tmax, int
 
     // Calculate the intersection point of the ray and the plane of the quad
     vec3 intersection = ray.origin + t * ray.direction;
-    vec3 planarHitPoint = intersection - quadOrigins[quadIndex];
+    vec3 planarHitPoint = intersection - quadOrigin.xyz;
     // Alpha and beta are values that determine the position of the intersection point in the plane of the quad
-    float alpha = dot(w, cross(planarHitPoint, quadEdgesV[quadIndex]));
-    float beta = dot(w, cross(quadEdgesU[quadIndex], planarHitPoint));
+    float alpha = dot(w, cross(planarHitPoint, quadEdgeV));
+    float beta = dot(w, cross(quadEdgeU, planarHitPoint));
 
     // Where alpha and beta belong to [0, 1]: the intersection point is inside the quad
     if (hitQuad(alpha, beta)) {
@@ -185,23 +348,75 @@ void hit2DPrimitive(Ray ray, inout HitRecord record, float tmin, float tmax, int
         record.t = t;
         record.point = intersection;
         record.normal = normal;
-        record.materialIndex = quadMaterialIndicies[quadIndex];
+        record.materialIndex = floatBitsToInt(quadOrigin.w);
+        record.item = spheresAmount + quadIndex;
         record.frontFace = true;
         record.uv = vec2(beta, 1.0 - alpha);
     }
 }
 
+// Ray Triangle intersection algorithm, the same plane test as hit2DPrimitive with the triangle bounds
+// The ray is in the object space of an instance, parallelLimit is smallValue scaled the way its direction is
+void hitMeshTriangle(Ray ray, inout HitRecord record, float tmin, float tmax, int triangleIndex, float parallelLimit) {
+    // Vertex indices in xyz, material index in w
+    ivec4 triangleData = floatBitsToInt(sceneTexel(trianglesOffset + triangleIndex));
+
+    // Initial calculations
+    vec3 origin = sceneTexel(verticesOffset + triangleData.x * 2).xyz;
+    vec3 edgeU = sceneTexel(verticesOffset + triangleData.y * 2).xyz - origin;
+    vec3 edgeV = sceneTexel(verticesOffset + triangleData.z * 2).xyz - origin;
+    vec3 n = cross(edgeU, edgeV);
+    vec3 normal = normalize(n);
+    float D = dot(normal, origin);
+    vec3 w = n / dot(n, n);
+
+    // Return if the ray is parallel to the plane of the triangle
+    float denominator = dot(normal, ray.direction);
+    if (abs(denominator) < parallelLimit) {
+        return;
+    }
+    // Return if the plane is outside the range of tmin to tmax
+    float t = (D - dot(normal, ray.origin)) / denominator;
+    if (t <= tmin || t >= tmax) {
+        return;
+    }
+
+    // Alpha and beta are the weights of the second and third vertex
+    vec3 intersection = ray.origin + t * ray.direction;
+    vec3 planarHitPoint = intersection - origin;
+    float alpha = dot(w, cross(planarHitPoint, edgeV));
+    float beta = dot(w, cross(edgeU, planarHitPoint));
+
+    if (hitTriangle(alpha, beta)) {
+        record.hit = true;
+        record.t = t;
+        record.point = intersection;
+        record.normal = normal;
+        record.materialIndex = triangleData.w;
+        // Meshes are closed surfaces, so the side matters like it does for spheres
+        record.frontFace = dot(ray.direction, normal) < 0.0;
+        if (!record.frontFace) {
+            record.normal = -normal;
+        }
+        vec2 uv0 = sceneTexel(verticesOffset + triangleData.x * 2 + 1).xy;
+        vec2 uv1 = sceneTexel(verticesOffset + triangleData.y * 2 + 1).xy;
+        vec2 uv2 = sceneTexel(verticesOffset + triangleData.z * 2 + 1).xy;
+        record.uv = (1.0 - alpha - beta) * uv0 + alpha * uv1 + beta * uv2;
+    }
+}
+
 // Ray Sphere intersection algorithm
 void hitSphere(Ray ray, inout HitRecord record, float tmin, float tmax, int sphereIndex) {
     // First 3 components are the center of the sphere
     // Last component is the radius of the sphere
+    vec4 sphere = sceneTexel(spheresOffset + sphereIndex * 2);
 
     // Calculate initial variables
     // Simplified quadratic formula application
-    vec3 oc = spheres[sphereIndex].xyz - ray.origin;
+    vec3 oc = sphere.xyz - ray.origin;
     float a = dot(ray.direction, ray.direction);
     float halfb = dot(ray.direction, oc);
-    float c = dot(oc, oc) - spheres[sphereIndex].w * spheres[sphereIndex].w;
+    float c = dot(oc, oc) - sphere.w * sphere.w;
     float discriminant = halfb * halfb - a * c;
 
     // The ray only intersects the sphere if the discriminant of the quadratic is greater than 0
@@ -222,8 +437,9 @@ void hitSphere(Ray ray, inout HitRecord record, float tmin, float tmax, int sphe
         record.hit = true;
         record.t = root;
         record.point = ray.origin + root * ray.direction;
-        record.normal = (record.point - spheres[sphereIndex].xyz) / spheres[sphereIndex].w;
-        record.materialIndex = sphereMaterialIndicies[sphereIndex];
+        record.normal = (record.point - sphere.xyz) / sphere.w;
+        record.materialIndex = floatBitsToInt(sceneTexel(spheresOffset + sphereIndex * 2 + 1).x);
+        record.item = sphereIndex;
         record.frontFace = dot(ray.direction, record.normal) < 0.0;
         if (!record.frontFace) {
             record.normal = -record.normal; // Flip the normal if the ray is inside the sphere
@@ -232,6 +448,151 @@ void hitSphere(Ray ray, inout HitRecord record, float tmin, float tmax, int sphe
     } 
 }
 
+// Slab test against a node of the BVH whose nodes start at texel nodesOffset, returns the entry distance or infinity on a miss
+float hitBvhNode(int nodesOffset, int node, vec3 origin, vec3 invDirection, float tmin, float tmax) {
+    vec3 t1 = (sceneTexel(nodesOffset + node * 2).xyz - origin) * invDirection;
+    vec3 t2 = (sceneTexel(nodesOffset + node * 2 + 1).xyz - origin) * invDirection;
+    vec3 tSmall = min(t1, t2);
+    vec3 tBig = max(t1, t2);
+    float tNear = max(max(tSmall.x, tSmall.y), max(tSmall.z, tmin));
+    float tFar = min(min(tBig.x, tBig.y), min(tBig.z, tmax));
+    return tNear <= tFar ? tNear : infinity;
+}
+
+// Avoid NaNs from 0 * inf in the slab test by replacing zero components with a tiny value
+vec3 safeInverse(vec3 direction) {
+    const float tiny = 1e-20;
+    return 1.0 / vec3(abs(direction.x) > tiny ? direction.x : tiny, abs(direction.y) > tiny ? direction.y : tiny, abs(direction.z) > tiny ? direction.z : tiny);
+}
+
+// Rotate a vector by a unit quaternion (x, y, z, w)
+vec3 rotateByQuaternion(vec3 v, vec4 q) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// BVH_GPU_STACK_SIZE in Bvh.h, the builder keeps every tree shallow enough for it
+#define BVH_STACK_SIZE 32
+
+// Ray mesh intersection through the BVH of the mesh, in the object space of the instance, the same traversal as hitScene
+// Distances along the ray are the same in both spaces, the direction is scaled along with everything else
+void hitInstance(Ray ray, inout HitRecord record, float tmin, int instanceIndex) {
+    vec4 placement = sceneTexel(instancesOffset + instanceIndex * 3); // Position in xyz, scale in w
+    vec4 rotation = sceneTexel(instancesOffset + instanceIndex * 3 + 1);
+    int root = floatBitsToInt(sceneTexel(instancesOffset + instanceIndex * 3 + 2).x);
+    vec4 inverseRotation = vec4(-rotation.xyz, rotation.w);
+
+    Ray local;
+    local.origin = rotateByQuaternion(ray.origin - placement.xyz, inverseRotation) / placement.w;
+    local.direction = rotateByQuaternion(ray.direction, inverseRotation) / placement.w;
+    vec3 invDirection = safeInverse(local.direction);
+
+    float tmax = record.t;
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int node = root;
+    if (hitBvhNode(meshBvhNodesOffset, root, local.origin, invDirection, tmin, record.t) == infinity) return;
+
+    while (true) {
+        int leftFirst = floatBitsToInt(sceneTexel(meshBvhNodesOffset + node * 2).w);
+        int count = floatBitsToInt(sceneTexel(meshBvhNodesOffset + node * 2 + 1).w);
+
+        if (count > 0) {
+            for (int i = 0; i < count; i++) {
+                hitMeshTriangle(local, record, tmin, record.t, bvhItem(meshBvhItemsOffset, leftFirst + i), smallValue / placement.w);
+            }
+        } else {
+            int left = node + 1;
+            int right = leftFirst;
+            float tLeft = hitBvhNode(meshBvhNodesOffset, left, local.origin, invDirection, tmin, record.t);
+            float tRight = hitBvhNode(meshBvhNodesOffset, right, local.origin, invDirection, tmin, record.t);
+            if (tLeft > tRight) {
+                float t = tLeft; tLeft = tRight; tRight = t;
+                int n = left; left = right; right = n;
+            }
+            if (tLeft != infinity) {
+                if (tRight != infinity && stackSize < BVH_STACK_SIZE) stack[stackSize++] = right;
+                node = left;
+                continue;
+            }
+        }
+
+        bool found = false;
+        while (stackSize > 0) {
+            node = stack[--stackSize];
+            if (hitBvhNode(meshBvhNodesOffset, node, local.origin, invDirection, tmin, record.t) != infinity) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+    }
+    if (record.t >= tmax) return;
+
+    // Uniform scale keeps normals perpendicular, rotating them back is enough
+    record.point = ray.origin + record.t * ray.direction;
+    record.normal = normalize(rotateByQuaternion(record.normal, rotation));
+    record.item = spheresAmount + quadsAmount + instanceIndex;
+}
+
+// Test one BVH item, record.t is the current tmax
+void hitItem(Ray ray, inout HitRecord record, float tmin, int item) {
+    if (item < spheresAmount) {
+        hitSphere(ray, record, tmin, record.t, item);
+    } else if (item < spheresAmount + quadsAmount) {
+        hit2DPrimitive(ray, record, tmin, record.t, item - spheresAmount);
+    } else {
+        hitInstance(ray, record, tmin, item - spheresAmount - quadsAmount);
+    }
+}
+
+// Nearest hit in the whole scene, the same traversal as Bvh::traverse
+void hitScene(Ray ray, inout HitRecord record, float tmin) {
+    if (bvhNodesAmount == 0) return;
+
+    vec3 invDirection = safeInverse(ray.direction);
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int node = 0;
+    if (hitBvhNode(bvhNodesOffset, 0, ray.origin, invDirection, tmin, record.t) == infinity) return;
+
+    while (true) {
+        int leftFirst = floatBitsToInt(sceneTexel(bvhNodesOffset + node * 2).w);
+        int count = floatBitsToInt(sceneTexel(bvhNodesOffset + node * 2 + 1).w);
+
+        if (count > 0) {
+            for (int i = 0; i < count; i++) {
+                hitItem(ray, record, tmin, bvhItem(bvhItemsOffset, leftFirst + i));
+            }
+        } else {
+            // Nearest child first, the other one waits on the stack
+            int left = node + 1;
+            int right = leftFirst;
+            float tLeft = hitBvhNode(bvhNodesOffset, left, ray.origin, invDirection, tmin, record.t);
+            float tRight = hitBvhNode(bvhNodesOffset, right, ray.origin, invDirection, tmin, record.t);
+            if (tLeft > tRight) {
+                float t = tLeft; tLeft = tRight; tRight = t;
+                int n = left; left = right; right = n;
+            }
+            if (tLeft != infinity) {
+                if (tRight != infinity && stackSize < BVH_STACK_SIZE) stack[stackSize++] = right;
+                node = left;
+                continue;
+            }
+        }
+
+        // Pop the next node that is still closer than the current hit
+        bool found = false;
+        while (stackSize > 0) {
+            node = stack[--stackSize];
+            if (hitBvhNode(bvhNodesOffset, node, ray.origin, invDirection, tmin, record.t) != infinity) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return;
+    }
+}
+
 
 
 
@@ -241,34 +602,49 @@ void hitSphere(Ray ray, inout HitRecord record, float tmin, float tmax, int sphe
 // --- Materials ---
 // -----------------
 
-void updateColor(inout HitRecord record) {
+// Color of the hit surface, the texture when it isn't black and the albedo otherwise
+vec3 surfaceColor(HitRecord record) {
     // Get the texure specified by the material index
-    vec3 textureColor = texture(materialTextures[record.materialIndex], record.uv).rgb;
-    // Only apply the texture if it isn't small (to only apply when a texture is present)
-    if (textureColor != materialAlbedo[record.materialIndex] && length(textureColor) > smallValue) {
-        record.color *= textureColor;
-    } else {
-        record.color *= materialAlbedo[record.materialIndex];
+    int textureIndex = materialTexture(record.materialIndex);
+    vec3 textureColor = textureIndex >= 0 ? sampleTexture(textureIndex, record.uv) : vec3(0.0);
+    // Only apply the texture if it isn't black, the same test the CPU renderer uses
+    if (length(textureColor) > smallValue) {
+        return textureColor;
     }
+    return materialAlbedo(record.materialIndex);
+}
 
-    record.emmisiveColor += materialEmmisiveColor[record.materialIndex];
+vec3 skyColor(vec3 unitDirection) {
+    float t = 0.5 * (unitDirection.y + 1.0);
+    return vec3(1.0 - t) + t * vec3(0.2, 0.4, 0.9);
+}
+
+// Angle between the direction and the sun, precise close to the sun unlike acos(dot())
+float sunAngle(vec3 unitDirection) {
+    return 2.0 * asin(min(length(unitDirection - normalize(sunDirection)) * 0.5, 1.0));
+}
+
+float sunEffect(vec3 unitDirection) {
+    return exp(-pow(sunAngle(unitDirection) / sunSize, 0.8));
 }
 
 // Determine background color based on the ray direction
 vec3 background(vec3 direction) {
     // Determine sky color based on the ray direction
     vec3 unitDirection = normalize(direction);
-    float t = 0.5 * (unitDirection.y + 1.0);
-    vec3 baseColor = vec3(1.0 - t) + t * vec3(0.2, 0.4, 0.9);
+    vec3 baseColor = skyColor(unitDirection);
 
     // Add sun effect
-    float angle = acos(dot(unitDirection, normalize(sunDirection)));
-    float sunEffect = exp(-pow(angle / sunSize, 0.8));
-    vec3 finalColor = mix(baseColor, sunColor, sunEffect);
+    vec3 finalColor = mix(baseColor, sunColor, sunEffect(unitDirection));
 
     return finalColor * backgroundOpacity;
 }
 
+// The share of background() the sun adds, mix(sky, sun, e) = sky + (sun - sky) * e
+vec3 sunRadiance(vec3 unitDirection) {
+    return (sunColor - skyColor(unitDirection)) * sunEffect(unitDirection) * backgroundOpacity;
+}
+
 // Schlick's approximation for reflectance
 float reflectance(float cosine, float refractionIndex) {
     float r0 = (1.0 - refractionIndex) / (1.0 + refractionIndex);
@@ -276,23 +652,24 @@ float reflectance(float cosine, float refractionIndex) {
     return r0 + (1.0 - r0) * pow((1.0 - cosine), 5.0);
 }
 
-void lambertian(inout Ray ray, inout HitRecord record, float seed) {
+void lambertian(inout Ray ray, inout HitRecord record, inout Sampler sampler, int bounce) {
     // Lambertian reflection using cosine-weighted sampling
-    ray.direction = record.normal + randomVector(seed);
-    // If normal and randomVector are opposite, the vector will be zero and will result in weird behavior
+    ray.direction = record.normal + sphereSample(sample2D(sampler, bounceDimension(bounce, BOUNCE_BSDF)));
+    // If normal and sphereSample, the vector will be zero and will result in weird behavior
     if (length(ray.direction) < smallValue) {
         ray.direction = record.normal;
     }
 }
 
-void metal(inout Ray ray, inout HitRecord record, float seed) {
+void metal(inout Ray ray, inout HitRecord record, inout Sampler sampler, int bounce) {
     // Reflect the ray direction around the normal and add fuzz
-    ray.direction = reflect(ray.direction, record.normal) + materialFuzz[record.materialIndex] * randomVector(seed);
+    vec3 fuzz = sphereSample(sample2D(sampler, bounceDimension(bounce, BOUNCE_BSDF)));
+    ray.direction = reflect(ray.direction, record.normal) + materialFuzz(record.materialIndex) * fuzz;
 }
 
-void dialetric(inout Ray ray, inout HitRecord record, float seed) {
+void dialetric(inout Ray ray, inout HitRecord record, inout Sampler sampler, int bounce) {
     // Ri is the ratio between the refractive index of the material and the refractive index of the medium the ray is coming from
-    float ri = record.frontFace ? (1.0 / materialRefractionIndex[record.materialIndex]) : materialRefractionIndex[record.materialIndex];
+    float ri = record.frontFace ? (1.0 / materialRefractionIndex(record.materialIndex)) : materialRefractionIndex(record.materialIndex);
     vec3 unitDirection = normalize(ray.direction); // Normalized ray direction
 
     // Calculate variables
@@ -301,30 +678,31 @@ void dialetric(inout Ray ray, inout HitRecord record, float seed) {
     bool cannotRefract = ri * sinTheta > 1.0;
 
     // If the ray cannot refract, reflect it
-    if (cannotRefract || reflectance(cosTheta, ri) > hash11(seed)) {
-        metal(ray, record, seed);
+    if (cannotRefract || reflectance(cosTheta, ri) > sample1D(sampler, bounceDimension(bounce, BOUNCE_CHOICE))) {
+        metal(ray, record, sampler, bounce);
         return;
     }
     // Otherwise refract the ray as normal
     ray.direction = refract(unitDirection, record.normal, ri);
 }
 
-void rayHit(inout Ray ray, inout HitRecord record, float seed) {
+void rayHit(inout Ray ray, inout HitRecord record, inout Sampler sampler, int bounce) {
     // Update the ray origin to the hit point and update the color
     ray.origin += record.t * ray.direction;
-    updateColor(record);
+    record.color *= surfaceColor(record);
 
     // Check the type of the material and update the Ray and HitRecord accordingly
-    if (materialType[record.materialIndex] == 0) { // Lambertian
-        lambertian(ray, record, seed);
+    int type = materialType(record.materialIndex);
+    if (type == 0) { // Lambertian
+        lambertian(ray, record, sampler, bounce);
         return;
     }
-    if (materialType[record.materialIndex] == 1) { // Metal
-        metal(ray, record, seed);
+    if (type == 1) { // Metal
+        metal(ray, record, sampler, bounce);
         return;
     }
-    if (materialType[record.materialIndex] == 2) { // Dielelectric
-        dialetric(ray, record, seed);
+    if (type == 2) { // Dielelectric
+        dialetric(ray, record, sampler, bounce);
         return;
     }
 }
@@ -334,42 +712,287 @@ void rayHit(inout Ray ray, inout HitRecord record, float seed) {
 
 
 
+// --------------
+// --- Lights ---
+// --------------
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Power heuristic weight of the strategy with pdf a when the other one has pdf b (Veach)
+float powerHeuristic(float a, float b) {
+    return a * a / (a * a + b * b);
+}
+
+// Orthonormal basis around the unit vector n (Duff et al., "Building an Orthonormal Basis, Revisited")
+void orthonormalBasis(vec3 n, out vec3 b1, out vec3 b2) {
+    float s = n.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + n.z);
+    float b = n.x * n.y * a;
+    b1 = vec3(1.0 + s * n.x * n.x * a, s * b, -s * n.x);
+    b2 = vec3(b, s + n.y * n.y * a, -n.y);
+}
+
+// Unit direction at angle acos(cosTheta) from the unit axis, turned by phi around it
+vec3 coneDirection(vec3 axis, float cosTheta, float phi) {
+    vec3 b1, b2;
+    orthonormalBasis(axis, b1, b2);
+    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+    return normalize(axis * cosTheta + (b1 * cos(phi) + b2 * sin(phi)) * sinTheta);
+}
+
+// Chance that next-event estimation picks the sun, the light list gets the rest
+float sunPickProbability() {
+    if (backgroundOpacity <= 0.0) return 0.0;
+    return lightsAmount > 0 ? 0.5 : 1.0;
+}
+
+// Direction towards the sun glow, the angle is exponentially distributed inside sunSampleAngle
+vec3 sunSample(vec2 u) {
+    float norm = 1.0 - exp(-sunSampleFalloff * sunSampleAngle);
+    float angle = -log(1.0 - u.x * norm) / sunSampleFalloff;
+    return coneDirection(normalize(sunDirection), cos(angle), 2.0 * pi * u.y);
+}
+
+// Solid angle pdf of sunSample(), 0 outside the sampled cone
+float sunPdf(vec3 unitDirection) {
+    float angle = sunAngle(unitDirection);
+    if (angle >= sunSampleAngle) return 0.0;
+    float norm = 1.0 - exp(-sunSampleFalloff * sunSampleAngle);
+    return sunSampleFalloff * exp(-sunSampleFalloff * angle) / (norm * 2.0 * pi * max(sin(angle), 1e-7));
+}
+
+// 1 - cos of the half angle of the cone a sphere covers seen from origin, 0 from inside
+float sphereCone(vec4 sphere, vec3 origin) {
+    vec3 toCenter = sphere.xyz - origin;
+    float sinSquared = sphere.w * sphere.w / dot(toCenter, toCenter);
+    if (sinSquared >= 1.0) return 0.0;
+    // Written so small spheres far away do not cancel to 0
+    return sinSquared / (1.0 + sqrt(1.0 - sinSquared));
+}
+
+// Emission luminance times surface area of a sphere or quad item, the same as sceneItemPower()
+float itemPower(int item) {
+    if (item < spheresAmount) {
+        vec4 sphere = sceneTexel(spheresOffset + item * 2);
+        int materialIndex = floatBitsToInt(sceneTexel(spheresOffset + item * 2 + 1).x);
+        return luminance(materialEmmisiveColor(materialIndex)) * 4.0 * pi * sphere.w * sphere.w;
+    }
+    int quadIndex = item - spheresAmount;
+    int materialIndex = floatBitsToInt(sceneTexel(quadsOffset + quadIndex * 3).w);
+    vec3 edgeU = sceneTexel(quadsOffset + quadIndex * 3 + 1).xyz;
+    vec3 edgeV = sceneTexel(quadsOffset + quadIndex * 3 + 2).xyz;
+    return luminance(materialEmmisiveColor(materialIndex)) * length(cross(edgeU, edgeV));
+}
+
+// Solid angle pdf of next-event estimation reaching lightPoint on item from origin, 0 when it never samples it
+float lightPdf(int item, vec3 origin, vec3 lightPoint) {
+    if (lightsAmount == 0 || item >= spheresAmount + quadsAmount) return 0.0;
+    float power = itemPower(item);
+    if (power <= 0.0) return 0.0;
+    float pick = (1.0 - sunPickProbability()) * power / lightPower;
+
+    if (item < spheresAmount) {
+        float cone = sphereCone(sceneTexel(spheresOffset + item * 2), origin);
+        return cone > 0.0 ? pick / (2.0 * pi * cone) : 0.0;
+    }
+    int quadIndex = item - spheresAmount;
+    vec3 n = cross(sceneTexel(quadsOffset + quadIndex * 3 + 1).xyz, sceneTexel(quadsOffset + quadIndex * 3 + 2).xyz);
+    vec3 toLight = lightPoint - origin;
+    float distanceSquared = dot(toLight, toLight);
+    float cosine = abs(dot(n, toLight)) / (length(n) * sqrt(distanceSquared));
+    // Grazing points are skipped by the sampling too
+    return cosine > smallValue ? pick * distanceSquared / (length(n) * cosine) : 0.0;
+}
+
+// Light of the list for a uniform number, the first whose cdf is above it
+int findLight(float u) {
+    int first = 0;
+    int last = lightsAmount - 1;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (sceneTexel(lightsOffset + middle).y > u) {
+            last = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+    return floatBitsToInt(sceneTexel(lightsOffset + first).x);
+}
+
+// Next-event estimation at a Lambertian hit: the light of a sampled sun or light direction that is not blocked,
+// weighted against finding it by scattering and multiplied by the cosine over pi of the Lambertian BRDF
+vec3 directLight(HitRecord record, inout Sampler sampler, int bounce) {
+    float sunPick = sunPickProbability();
+    float pick = sample1D(sampler, bounceDimension(bounce, BOUNCE_LIGHT_CHOICE));
+    vec2 u = sample2D(sampler, bounceDimension(bounce, BOUNCE_LIGHT));
+    if (sunPick <= 0.0 && lightsAmount == 0) return vec3(0.0);
+
+    Ray shadowRay;
+    shadowRay.origin = record.point;
+    float pdf;
+    int item = -1; // The sun
+    if (pick < sunPick) {
+        shadowRay.direction = sunSample(u);
+        pdf = sunPick * sunPdf(shadowRay.direction);
+    } else {
+        item = findLight(min((pick - sunPick) / (1.0 - sunPick), 1.0));
+        vec3 lightPoint = vec3(0.0); // Only used for quads
+        if (item < spheresAmount) {
+            vec4 sphere = sceneTexel(spheresOffset + item * 2);
+            float cosTheta = 1.0 - u.x * sphereCone(sphere, record.point);
+            shadowRay.direction = coneDirection(normalize(sphere.xyz - record.point), cosTheta, 2.0 * pi * u.y);
+        } else {
+            int quadIndex = item - spheresAmount;
+            lightPoint = sceneTexel(quadsOffset + quadIndex * 3).xyz + u.x * sceneTexel(quadsOffset + quadIndex * 3 + 1).xyz + u.y * sceneTexel(quadsOffset + quadIndex * 3 + 2).xyz;
+            shadowRay.direction = lightPoint - record.point;
+        }
+        pdf = lightPdf(item, record.point, lightPoint);
+    }
+
+    float cosine = dot(record.normal, normalize(shadowRay.direction));
+    if (pdf <= 0.0 || cosine <= 0.0) return vec3(0.0);
+
+    // The sun needs a free way out, a light has to be the nearest hit
+    HitRecord shadow;
+    shadow.hit = false;
+    shadow.t = infinity;
+    hitScene(shadowRay, shadow, smallValue);
+    vec3 emission;
+    if (item < 0) {
+        if (shadow.hit) return vec3(0.0);
+        emission = sunRadiance(normalize(shadowRay.direction));
+    } else {
+        if (!shadow.hit || shadow.item != item) return vec3(0.0);
+        emission = materialEmmisiveColor(shadow.materialIndex);
+    }
+
+    float scatterPdf = cosine / pi;
+    return emission * scatterPdf * powerHeuristic(pdf, scatterPdf) / pdf;
+}
+
+// Weight of emission a scattered ray hit, next-event estimation from the previous hit may have sampled it too
+// scatterPdf is 0 for camera rays and mirror-like bounces, which next-event estimation cannot stand in for
+float emissionWeight(HitRecord record, vec3 previousPoint, float scatterPdf) {
+    if (scatterPdf <= 0.0) return 1.0;
+    return powerHeuristic(scatterPdf, lightPdf(record.item, previousPoint, record.point));
+}
+
+// Background seen by a scattered ray, the sun glow weighted against next-event estimation
+vec3 missRadiance(vec3 direction, float scatterPdf) {
+    if (scatterPdf <= 0.0) return background(direction);
+    vec3 unitDirection = normalize(direction);
+    float weight = powerHeuristic(scatterPdf, sunPickProbability() * sunPdf(unitDirection));
+    return skyColor(unitDirection) * backgroundOpacity + sunRadiance(unitDirection) * weight;
+}
+
+
+
+
+
+
 // -------------------
 // --- Ray Tracing ---
 // -------------------
 
-vec3 rayColor(Ray ray, HitRecord record, float tmin, float tmax, float seed) {
+vec3 rayColor(Ray ray, HitRecord record, float tmin, float tmax, inout Sampler sampler) {
     record.color = vec3(1.0);
-    record.emmisiveColor = vec3(0.0);
+    vec3 radiance = vec3(0.0);
+    float scatterPdf = 0.0; // Solid angle pdf of the last Lambertian bounce, 0 for the camera ray and mirror-like bounces
 
-    // Trace the ray in the scene to a max amount of bounces
-    for (int bounce = 0; bounce <= maxBounces; bounce++) {
+    // Every path gets maxBounces bounces, after that Russian roulette ends it
+    for (int bounce = 0; bounce <= maxBounces + ROULETTE_MAX_BOUNCES; bounce++) {
         // Setup the hit record
         record.hit = false;
         record.t = tmax;
 
-        // Check for sphere intersections
-        for (int index = 0; index < spheresAmount; index++) {
-            hitSphere(ray, record, tmin, record.t, index);
+        // Check for sphere, 2D primitive and mesh triangle intersections
+        hitScene(ray, record, tmin);
+
+        // If nothing was hit, add the background color
+        if (!record.hit) {
+            radiance += record.color * missRadiance(ray.direction, scatterPdf);
+            break;
         }
 
-        // Check for 2D primitive intersections
-        for (int index = 0; index < quadsAmount; index++) {
-            hit2DPrimitive(ray, record, tmin, record.t, index);
+        // Light emitted by the hit object, ray.origin is still the previous hit
+        vec3 emission = materialEmmisiveColor(record.materialIndex);
+        if (emission != vec3(0.0)) {
+            radiance += record.color * emission * emissionWeight(record, ray.origin, scatterPdf);
         }
 
-        // If nothing was hit, return the background color
-        if (!record.hit) {
-            return record.color * (background(ray.direction) + record.emmisiveColor);
+        // Light reaching a Lambertian surface straight from the sun or a light
+        bool diffuse = materialType(record.materialIndex) == 0;
+        if (diffuse) {
+            radiance += record.color * surfaceColor(record) * directLight(record, sampler, bounce);
         }
-        
+
         // If the ray hits something, update the Ray and hitRecord accordingly
-        rayHit(ray, record, seed);
-        seed += bounce; // Update the seed for the next bounce
+        rayHit(ray, record, sampler, bounce);
+        scatterPdf = diffuse ? dot(record.normal, normalize(ray.direction)) / pi : 0.0;
+
+        // Russian roulette, surviving paths are weighted up so the mean stays the same
+        if (bounce >= maxBounces) {
+            float survival = min(max(record.color.r, max(record.color.g, record.color.b)), ROULETTE_MAX_SURVIVAL);
+            if (sample1D(sampler, bounceDimension(bounce, BOUNCE_ROULETTE)) >= survival) break;
+            record.color /= survival;
+        }
     }
 
-    // If the ray bounces the max amount of times, return black (as if the ray was absorbed completely)
-    return vec3(0.0);
+    return radiance;
+}
+
+
+
+
+
+
+// -----------------------
+// --- Denoiser Guides ---
+// -----------------------
+
+#define FEATURE_NONE 0 // Radiance
+#define FEATURE_ALBEDO_DEPTH 1 // Albedo to divide out in rgb, depth in alpha
+#define FEATURE_NORMAL 2 // Normal in rgb, zero for the sky and lights
+#define FEATURE_MAX_SPECULAR_BOUNCES 4 // Mirrors and glass followed before the surface is taken as it is
+#define FEATURE_MIN_ALBEDO 0.01 // Darker first hits are not divided out, their light would blow up
+
+// The first surface along the ray that is not a mirror or glass, seen through them and tinted by them
+// Glass is followed along the refracted ray unless it reflects totally
+void firstHitFeatures(Ray ray, out vec3 albedo, out vec3 normal, out float depth) {
+    albedo = vec3(1.0);
+    normal = vec3(0.0);
+    depth = 0.0;
+    for (int bounce = 0; bounce <= FEATURE_MAX_SPECULAR_BOUNCES; bounce++) {
+        HitRecord record;
+        record.hit = false;
+        record.t = infinity;
+        hitScene(ray, record, smallValue);
+        if (!record.hit) {
+            depth = infinity; // The sky, its normal stays zero
+            break;
+        }
+        depth += record.t * length(ray.direction);
+        albedo *= surfaceColor(record);
+        int type = materialType(record.materialIndex);
+        if (type == 0 || bounce == FEATURE_MAX_SPECULAR_BOUNCES) {
+            // Lights seen directly have no noise, they are kept out of the filter like the sky
+            normal = materialEmmisiveColor(record.materialIndex) == vec3(0.0) ? record.normal : vec3(0.0);
+            break;
+        }
+        ray.origin += record.t * ray.direction;
+        if (type == 1) {
+            ray.direction = reflect(ray.direction, record.normal);
+            continue;
+        }
+        float ri = record.frontFace ? (1.0 / materialRefractionIndex(record.materialIndex)) : materialRefractionIndex(record.materialIndex);
+        vec3 refracted = refract(normalize(ray.direction), record.normal, ri);
+        ray.direction = refracted == vec3(0.0) ? reflect(ray.direction, record.normal) : refracted;
+    }
+
+    // The denoiser divides the albedo out, black surfaces (like lights) are left alone
+    albedo = luminance(albedo) < FEATURE_MIN_ALBEDO ? vec3(1.0) : max(albedo, vec3(FEATURE_MIN_ALBEDO));
 }
 
 
@@ -381,36 +1004,93 @@ vec3 rayColor(Ray ray, HitRecord record, float tmin, float tmax, float seed) {
 // --- Entry Point ---
 // -------------------
 
+// Adaptive sampling
+#define ADAPTIVE_MIN_SAMPLES 16 // Fewer samples (or frames) say too little about the variance
+#define ADAPTIVE_MIN_LUMINANCE 0.01 // Keeps the relative error finite for black pixels
+#define ADAPTIVE_CHECK_INTERVAL 4 // Stopping after whole blocks of 4 Sobol points keeps the samples stratified
+
+// Standard error of the mean below noiseTarget times the mean
+bool converged(float mean, float meanVariance) {
+    return sqrt(meanVariance) <= noiseTarget * max(mean, ADAPTIVE_MIN_LUMINANCE);
+}
+
 void main() {
+    // The denoiser's guides come from one ray through the pixel center, without defocus
+    if (featureOutput != FEATURE_NONE) {
+        Ray ray;
+        ray.origin = cameraCenter;
+        ray.direction = pixel00 + (gl_FragCoord.x * pixelU) + (gl_FragCoord.y * pixelV) - cameraCenter;
+        vec3 albedo, normal;
+        float depth;
+        firstHitFeatures(ray, albedo, normal, depth);
+        finalColor = featureOutput == FEATURE_ALBEDO_DEPTH ? vec4(albedo, depth) : vec4(normal, 0.0);
+        return;
+    }
+
+    // Pixels whose accumulated mean is precise enough keep it instead of tracing more samples
+    if (frameIndex >= ADAPTIVE_MIN_SAMPLES && noiseTarget > 0.0) {
+        vec4 previous = texelFetch(previousFrame, ivec2(gl_FragCoord.xy), 0);
+        float mean = luminance(previous.rgb);
+        float meanVariance = max(previous.a - mean * mean, 0.0) / float(frameIndex - 1);
+        if (converged(mean, meanVariance)) {
+            finalColor = previous;
+            return;
+        }
+    }
+
     // Setup initial variables
-    vec3 color;
+    vec3 color = vec3(0.0);
     vec3 pixelCenter = pixel00 + (gl_FragCoord.x * pixelU) + (gl_FragCoord.y * pixelV);
 
-    int sqrtSamples = int(sqrt(float(samples)));
-    float recipSqrtSamples = 1.0 / float(sqrtSamples);
-    float sampleWeight = 1.0 / float(sqrtSamples * sqrtSamples);
-    
-    float seed = hash13(gl_FragCoord.xyz) + seedOffset;
-
-    // Stratified sampling
-    for (int si = 0; si < sqrtSamples; si++) {
-        for (int sj = 0; sj < sqrtSamples; sj++) {
-            // Ensure that the seed for the randomness is different for each sample
-            seed += hash11(si + sj * pi);
-            
-            // Generate a Ray from the camera to the pixel center
-            Ray ray;
-            ray.origin = (defocusAngle <= 0.0) ? cameraCenter : defocusDiskSample(cameraCenter, defocusAngle, seed);
-            // randomInSquareStratified is used for antialiasing
-            ray.direction = pixelCenter + randomInSquareStratified(seed, si, sj, recipSqrtSamples) - ray.origin;
-
-            // Setup the HitRecord
-            HitRecord record;
-
-            // Trace the ray and accumulate the color
-            color += sampleWeight * rayColor(ray, record, smallValue, infinity, seed);
+    int sampleCount = max(samples, 1);
+    Sampler sampler = makeSampler(ivec2(floor(gl_FragCoord.xy + tileOffset)));
+
+    // Running luminance mean and sum of squared differences (Welford)
+    float mean = 0.0;
+    float m2 = 0.0;
+
+    int k = 0;
+    while (k < sampleCount) {
+        // Every sample of the pixel has its own index, frames continue after the samples of earlier frames
+        startSample(sampler, sampleOffset + k);
+
+        // Generate a Ray from the camera to the pixel center
+        Ray ray;
+        ray.origin = (defocusAngle <= 0.0) ? cameraCenter : cameraCenter + diskSample(sample2D(sampler, DIMENSION_LENS)) * defocusAngle;
+        // The pixel sample is used for antialiasing
+        ray.direction = pixelCenter + pixelSample(sample2D(sampler, DIMENSION_PIXEL)) - ray.origin;
+
+        // Setup the HitRecord
+        HitRecord record;
+
+        // Trace the ray and accumulate the color
+        vec3 sampleColor = rayColor(ray, record, smallValue, infinity, sampler);
+        color += sampleColor;
+        k++;
+
+        float delta = luminance(sampleColor) - mean;
+        mean += delta / float(k);
+        m2 += delta * (luminance(sampleColor) - mean);
+
+        // Stop once the pixel is converged, checked after complete blocks so the samples stay stratified
+        if (noiseTarget > 0.0 && k >= ADAPTIVE_MIN_SAMPLES && k % ADAPTIVE_CHECK_INTERVAL == 0 && converged(mean, m2 / (float(k) * float(k - 1)))) {
+            break;
         }
     }
+    color /= float(k);
+
+    // Progressive accumulation keeps a linear running mean, gamma is applied when it is displayed
+    // The mean of the squared frame luminance goes into alpha so converged pixels can be skipped
+    if (frameIndex >= 0) {
+        float luminanceSquared = luminance(color) * luminance(color);
+        vec4 accumulated = vec4(color, luminanceSquared);
+        if (frameIndex > 0) {
+            vec4 previous = texelFetch(previousFrame, ivec2(gl_FragCoord.xy), 0);
+            accumulated = mix(previous, accumulated, frameWeight);
+        }
+        finalColor = accumulated;
+        return;
+    }
 
     // Gamma correction
     color = pow(color, vec3(1.0 / gamma));
@@ -0,0 +1,102 @@
+// Uses OpenGL version 330 core
+#version 330 core
+
+// Temporal accumulation: the last result is reprojected into the current view through the first-hit depth,
+// clamped to the neighbourhood of the current image and blended with it
+// Drawn as a rectangle over the whole target, inputs are read with texelFetch
+
+// Fragment shader output color
+out vec4 finalColor;
+
+uniform sampler2D currentImage; // Linear radiance of the current view
+uniform sampler2D history; // Last result in rgb, the samples per pixel it stands for in alpha
+uniform sampler2D albedoDepth; // First-hit depth of the current view in alpha
+uniform int historyValid; // 0 when there is no history to reproject
+uniform float currentSamples; // Samples per pixel in currentImage
+uniform float maxHistorySamples; // History counts as at most this many samples, so old light fades out
+
+// Current view, as the raytracing shader gets it
+uniform vec3 pixel00;
+uniform vec3 pixelU;
+uniform vec3 pixelV;
+uniform vec3 cameraCenter;
+
+// View of the history
+uniform vec3 previousPixel00;
+uniform vec3 previousPixelU;
+uniform vec3 previousPixelV;
+uniform vec3 previousCameraCenter;
+
+#define TEMPORAL_CLAMP_SIGMA 1.5 // History further than this many standard deviations from the current neighbourhood is pulled in
+
+// History at a fractional pixel position of the previous view, bilinear with the taps outside the image left out
+vec4 historyAt(vec2 position) {
+    ivec2 size = textureSize(history, 0);
+    vec2 base = position - 0.5;
+    ivec2 corner = ivec2(floor(base));
+    vec2 f = base - vec2(corner);
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 pixel = corner + offset;
+        if (pixel.x < 0 || pixel.y < 0 || pixel.x >= size.x || pixel.y >= size.y) continue;
+        float weight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        sum += weight * texelFetch(history, pixel, 0);
+        weightSum += weight;
+    }
+    return weightSum > 0.0 ? sum / weightSum : vec4(0.0);
+}
+
+// Pixel position (gl_FragCoord) of a world point in the previous view, false when it is behind that camera
+bool previousPosition(vec3 point, out vec2 position) {
+    vec3 normal = cross(previousPixelU, previousPixelV);
+    vec3 direction = point - previousCameraCenter;
+    float planeDistance = dot(previousPixel00 - previousCameraCenter, normal);
+    float along = dot(direction, normal);
+    if (along * planeDistance <= 0.0) return false;
+
+    vec3 onPlane = previousCameraCenter + direction * (planeDistance / along) - previousPixel00;
+    position = vec2(dot(onPlane, previousPixelU) / dot(previousPixelU, previousPixelU), dot(onPlane, previousPixelV) / dot(previousPixelV, previousPixelV));
+    return true;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(currentImage, 0);
+    vec3 current = texelFetch(currentImage, pixel, 0).rgb;
+
+    // Mean and standard deviation of the current image around the pixel
+    vec3 mean = vec3(0.0), meanSquared = vec3(0.0);
+    float count = 0.0;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            ivec2 q = pixel + ivec2(dx, dy);
+            if (q.x < 0 || q.y < 0 || q.x >= size.x || q.y >= size.y) continue;
+            vec3 color = texelFetch(currentImage, q, 0).rgb;
+            mean += color;
+            meanSquared += color * color;
+            count += 1.0;
+        }
+    }
+    mean /= count;
+    vec3 deviation = sqrt(max(meanSquared / count - mean * mean, vec3(0.0)));
+
+    // Where the first hit of the pixel was seen in the previous view, mirrors and glass move their reflections along
+    vec3 direction = normalize(pixel00 + (gl_FragCoord.x * pixelU) + (gl_FragCoord.y * pixelV) - cameraCenter);
+    vec3 point = cameraCenter + direction * texelFetch(albedoDepth, pixel, 0).a;
+    // The history may still have an older render size, positions are in its pixels
+    ivec2 historySize = textureSize(history, 0);
+    vec2 position;
+    vec4 previous = vec4(0.0);
+    if (historyValid != 0 && previousPosition(point, position)
+        && position.x >= 0.0 && position.y >= 0.0 && position.x <= float(historySize.x) && position.y <= float(historySize.y)) {
+        previous = historyAt(position);
+    }
+
+    // Disoccluded pixels bring history from another surface, it ends up outside the neighbourhood and is clamped
+    vec3 clamped = clamp(previous.rgb, mean - TEMPORAL_CLAMP_SIGMA * deviation, mean + TEMPORAL_CLAMP_SIGMA * deviation);
+    float historySamples = min(previous.a, maxHistorySamples);
+    float currentWeight = currentSamples / (currentSamples + historySamples);
+    finalColor = vec4(mix(clamped, current, currentWeight), historySamples + currentSamples);
+}
@@ -0,0 +1,91 @@
+// Uses OpenGL version 330 core
+#version 330 core
+
+// Draws a linear image rendered below the window resolution, upscaled with gamma correction
+// A Lanczos-like kernel over the nearest 4x4 texels is stretched along the local edge, so edges stay sharp
+// where bilinear would blur them (after the edge adaptive upsampling of AMD FidelityFX FSR 1)
+// The result is clamped to the nearest 2x2 texels, so the negative lobes don't ring
+
+// Input from the default raylib vertex shader
+in vec2 fragTexCoord;
+
+// Fragment shader output color
+out vec4 finalColor;
+
+// Linear image, drawn with DrawTexturePro over the window
+uniform sampler2D texture0;
+uniform float gamma;
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// How much a texel lies on a ramp rather than on a single bright or dark texel, 1 for edges and 0 for noise
+float edgeness(float before, float center, float after) {
+    float step = max(abs(after - center), abs(center - before));
+    float ratio = step > 0.0 ? clamp(abs(after - before) / step, 0.0, 1.0) : 0.0;
+    return ratio * ratio;
+}
+
+void main() {
+    ivec2 size = textureSize(texture0, 0);
+    vec2 position = fragTexCoord * vec2(size) - 0.5; // Texel centers are at whole numbers
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    // Texels base - 1 to base + 2, clamped to the image
+    vec3 taps[16];
+    float luminances[16];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            ivec2 texel = clamp(base + ivec2(i - 1, j - 1), ivec2(0), size - 1);
+            taps[j * 4 + i] = texelFetch(texture0, texel, 0).rgb;
+            luminances[j * 4 + i] = luminance(taps[j * 4 + i]);
+        }
+    }
+
+    // Luminance gradient and edgeness of the inner 2x2 texels, bilinearly weighted to the position
+    vec2 direction = vec2(0.0);
+    float edge = 0.0;
+    for (int j = 1; j <= 2; j++) {
+        for (int i = 1; i <= 2; i++) {
+            float weight = (i == 1 ? 1.0 - f.x : f.x) * (j == 1 ? 1.0 - f.y : f.y);
+            float center = luminances[j * 4 + i];
+            float left = luminances[j * 4 + i - 1], right = luminances[j * 4 + i + 1];
+            float below = luminances[(j - 1) * 4 + i], above = luminances[(j + 1) * 4 + i];
+            direction += weight * vec2(right - left, above - below);
+            edge += weight * 0.5 * (edgeness(left, center, right) + edgeness(below, center, above));
+        }
+    }
+    float directionLength = length(direction);
+    direction = directionLength > 1e-6 ? direction / directionLength : vec2(1.0, 0.0);
+
+    // Across the edge the kernel narrows, along it the kernel widens, diagonal edges narrow the most
+    float stretch = 1.0 / max(abs(direction.x), abs(direction.y));
+    vec2 axisScale = vec2(1.0 + (stretch - 1.0) * edge, 1.0 - 0.5 * edge);
+    float lobe = 0.5 - 0.29 * edge; // Window width, sharper on edges
+    float clip = 1.0 / lobe;
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            vec2 offset = vec2(i - 1, j - 1) - f;
+            vec2 rotated = vec2(dot(offset, direction), dot(offset, vec2(-direction.y, direction.x))) * axisScale;
+            float distanceSquared = min(dot(rotated, rotated), clip);
+            // Polynomial stand-in for Lanczos 2, windowed to the lobe
+            float lanczos = 2.0 / 5.0 * distanceSquared - 1.0;
+            float window = lobe * distanceSquared - 1.0;
+            float weight = (25.0 / 16.0 * lanczos * lanczos - (25.0 / 16.0 - 1.0)) * window * window;
+            sum += weight * taps[j * 4 + i];
+            weightSum += weight;
+        }
+    }
+    vec3 color = sum / weightSum;
+
+    vec3 low = min(min(taps[5], taps[6]), min(taps[9], taps[10]));
+    vec3 high = max(max(taps[5], taps[6]), max(taps[9], taps[10]));
+    color = clamp(color, low, high);
+
+    finalColor = vec4(pow(max(color, vec3(0.0)), vec3(1.0 / gamma)), 1.0);
+}